@@ -0,0 +1,5 @@
+#include <pthread.h>
+int main(void) {
+  pthread_t t;
+  return 0;
+}
@@ -0,0 +1,9 @@
+#include <time.h>
+int main() {
+#ifdef CLOCK_MONOTONIC
+  return 0; // Symbol is a macro
+#else
+  (void)CLOCK_MONOTONIC; // Symbol might be a function or variable
+  return 0;
+#endif
+}
@@ -0,0 +1,730 @@
+// IWKV benchmark in the spirit of LevelDB db_bench.
+// Measures throughput and p50/p99/p999 latencies of typical workloads:
+//
+//   ./iwkv_bench --benchmarks=fillseq,readrandom --num=1000000 --wal
+//
+// Run `./iwkv_bench --help` for the list of options.
+
+#include "iowow.h"
+#include "iwkv.h"
+#include "iwp.h"
+#include "iwlog.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_KEY_MAX  255
+#define BENCH_VBUF_PAD 4096
+
+typedef enum {
+  BENCH_DIST_UNIFORM = 0,
+  BENCH_DIST_ZIPF,
+} bench_dist_e;
+
+struct bench_thr;
+typedef iwrc (*bench_fn)(struct bench_thr*);
+
+struct bench {
+  const char *name;
+  bench_fn    fn;
+  bool fresh;     /**< Benchmark starts on empty database */
+  bool readonly;  /**< Benchmark does not modify database */
+  bool parallel;  /**< Benchmark runs in `--threads` threads */
+};
+
+struct bench_thr {
+  const struct bench *b;
+  pthread_t thr;
+  uint64_t  rnd;    /**< Thread local random generator state */
+  uint64_t  ops;    /**< Number of operations to perform */
+  uint64_t *lat;    /**< Operation latencies in nanoseconds */
+  uint64_t  nlat;   /**< Number of recorded latencies */
+  uint64_t  found;  /**< Number of found records for read operations */
+  uint64_t  bytes;  /**< Number of key/value bytes processed */
+  iwrc      rc;
+};
+
+static struct {
+  const char  *benchmarks;
+  const char  *path;
+  uint64_t     num;
+  uint64_t     reads;
+  int          threads;
+  int          key_size;
+  int          value_size;
+  int          read_percent;
+  bench_dist_e dist;
+  double       zipf_theta;
+  uint32_t     seed;
+  bool wal;
+  bool sync;
+  IWKV_OPTS    opts;
+  // Runtime state
+  IWKV     iwkv;
+  IWDB     db;
+  bool     filled;
+  uint8_t *vbuf;
+  // Zipfian generator constants
+  double zetan;
+  double zipf_alpha;
+  double zipf_eta;
+} g = {
+  .benchmarks   = "fillseq,fillrandom,overwrite,readrandom,readseq,seekrandom,deleterandom,mixed",
+  .path         = "iwkv_bench.db",
+  .num          = 100000,
+  .threads      = 4,
+  .key_size     = 16,
+  .value_size   = 100,
+  .read_percent = 90,
+  .dist         = BENCH_DIST_UNIFORM,
+  .zipf_theta   = 0.99,
+  .seed         = 301,
+};
+
+//--------------------------  Random numbers
+
+static uint64_t _rnd_next(uint64_t *s) {
+  // splitmix64
+  uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static double _rnd_double(uint64_t *s) {
+  return (_rnd_next(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void _zipf_init(void) {
+  double zeta2 = 1.0 + pow(0.5, g.zipf_theta);
+  g.zetan = 0;
+  for (uint64_t i = 1; i <= g.num; ++i) {
+    g.zetan += 1.0 / pow((double) i, g.zipf_theta);
+  }
+  g.zipf_alpha = 1.0 / (1.0 - g.zipf_theta);
+  g.zipf_eta = (1.0 - pow(2.0 / g.num, 1.0 - g.zipf_theta)) / (1.0 - zeta2 / g.zetan);
+}
+
+// Zipfian rank by Gray et al. "Quickly generating billion-record synthetic databases"
+static uint64_t _zipf_next(uint64_t *s) {
+  double u = _rnd_double(s);
+  double uz = u * g.zetan;
+  if (uz < 1.0) {
+    return 0;
+  }
+  if (uz < 1.0 + pow(0.5, g.zipf_theta)) {
+    return 1;
+  }
+  uint64_t r = (uint64_t) (g.num * pow(g.zipf_eta * u - g.zipf_eta + 1.0, g.zipf_alpha));
+  return r < g.num ? r : g.num - 1;
+}
+
+// Next random record number according to `--distribution`
+static uint64_t _key_next(struct bench_thr *t) {
+  if (g.dist == BENCH_DIST_ZIPF) {
+    // Scatter hot ranks over the whole key space
+    uint64_t r = _zipf_next(&t->rnd);
+    return _rnd_next(&r) % g.num;
+  } else {
+    return _rnd_next(&t->rnd) % g.num;
+  }
+}
+
+//--------------------------  Records
+
+static void _key_fill(IWKV_val *key, char buf[static BENCH_KEY_MAX + 1], uint64_t k) {
+  snprintf(buf, BENCH_KEY_MAX + 1, "%0*" PRIu64, g.key_size, k);
+  key->data = buf;
+  key->size = g.key_size;
+}
+
+static void _val_fill(struct bench_thr *t, IWKV_val *val) {
+  val->data = g.vbuf + _rnd_next(&t->rnd) % BENCH_VBUF_PAD;
+  val->size = g.value_size;
+}
+
+static uint64_t _now_ns(void) {
+  struct timespec ts;
+  iwp_clock_get_time(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+IW_INLINE void _lat_add(struct bench_thr *t, uint64_t start) {
+  if (t->nlat < t->ops) {
+    t->lat[t->nlat++] = _now_ns() - start;
+  }
+}
+
+//--------------------------  Workloads
+
+static iwrc _bm_fillseq(struct bench_thr *t) {
+  char kbuf[BENCH_KEY_MAX + 1];
+  iwkv_opflags opflags = g.sync ? IWKV_SYNC : 0;
+  for (uint64_t i = 0; i < t->ops; ++i) {
+    IWKV_val key, val;
+    _key_fill(&key, kbuf, i);
+    _val_fill(t, &val);
+    uint64_t ts = _now_ns();
+    iwrc rc = iwkv_put(g.db, &key, &val, opflags);
+    RCRET(rc);
+    _lat_add(t, ts);
+    t->bytes += key.size + val.size;
+  }
+  return 0;
+}
+
+static iwrc _bm_fillrandom(struct bench_thr *t) {
+  char kbuf[BENCH_KEY_MAX + 1];
+  iwkv_opflags opflags = g.sync ? IWKV_SYNC : 0;
+  for (uint64_t i = 0; i < t->ops; ++i) {
+    IWKV_val key, val;
+    _key_fill(&key, kbuf, _rnd_next(&t->rnd) % g.num);
+    _val_fill(t, &val);
+    uint64_t ts = _now_ns();
+    iwrc rc = iwkv_put(g.db, &key, &val, opflags);
+    RCRET(rc);
+    _lat_add(t, ts);
+    t->bytes += key.size + val.size;
+  }
+  return 0;
+}
+
+static iwrc _bm_overwrite(struct bench_thr *t) {
+  char kbuf[BENCH_KEY_MAX + 1];
+  iwkv_opflags opflags = g.sync ? IWKV_SYNC : 0;
+  for (uint64_t i = 0; i < t->ops; ++i) {
+    IWKV_val key, val;
+    _key_fill(&key, kbuf, _key_next(t));
+    _val_fill(t, &val);
+    uint64_t ts = _now_ns();
+    iwrc rc = iwkv_put(g.db, &key, &val, opflags);
+    RCRET(rc);
+    _lat_add(t, ts);
+    t->bytes += key.size + val.size;
+  }
+  return 0;
+}
+
+static iwrc _bm_readrandom(struct bench_thr *t) {
+  char kbuf[BENCH_KEY_MAX + 1];
+  uint8_t *vbuf = malloc(g.value_size + 1);
+  if (!vbuf) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  iwrc rc = 0;
+  for (uint64_t i = 0; i < t->ops; ++i) {
+    IWKV_val key;
+    size_t vsz;
+    _key_fill(&key, kbuf, _key_next(t));
+    uint64_t ts = _now_ns();
+    rc = iwkv_get_copy(g.db, &key, vbuf, g.value_size, &vsz);
+    _lat_add(t, ts);
+    if (!rc) {
+      ++t->found;
+      t->bytes += key.size + vsz;
+    } else if (rc == IWKV_ERROR_NOTFOUND) {
+      rc = 0;
+    } else {
+      break;
+    }
+  }
+  free(vbuf);
+  return rc;
+}
+
+static iwrc _bm_readseq(struct bench_thr *t) {
+  IWKV_cursor cur;
+  uint8_t *vbuf = malloc(g.value_size + 1);
+  if (!vbuf) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  iwrc rc = iwkv_cursor_open(g.db, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  if (rc) {
+    free(vbuf);
+    return rc;
+  }
+  for (uint64_t i = 0; i < t->ops; ++i) {
+    size_t ksz, vsz;
+    uint64_t ts = _now_ns();
+    rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT);
+    if (!rc) {
+      rc = iwkv_cursor_copy_val(cur, vbuf, g.value_size, &vsz);
+    }
+    if (!rc) {
+      rc = iwkv_cursor_copy_key(cur, 0, 0, &ksz, 0);
+    }
+    if (rc) {
+      if (rc == IWKV_ERROR_NOTFOUND) {
+        rc = 0;
+      }
+      break;
+    }
+    _lat_add(t, ts);
+    ++t->found;
+    t->bytes += ksz + vsz;
+  }
+  IWRC(iwkv_cursor_close(&cur), rc);
+  free(vbuf);
+  return rc;
+}
+
+static iwrc _bm_seekrandom(struct bench_thr *t) {
+  char kbuf[BENCH_KEY_MAX + 1];
+  uint8_t *vbuf = malloc(g.value_size + 1);
+  if (!vbuf) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  iwrc rc = 0;
+  for (uint64_t i = 0; i < t->ops; ++i) {
+    IWKV_val key;
+    IWKV_cursor cur;
+    size_t vsz;
+    _key_fill(&key, kbuf, _key_next(t));
+    uint64_t ts = _now_ns();
+    rc = iwkv_cursor_open(g.db, &cur, IWKV_CURSOR_GE, &key);
+    if (!rc) {
+      rc = iwkv_cursor_copy_val(cur, vbuf, g.value_size, &vsz);
+      if (!rc) {
+        ++t->found;
+        t->bytes += vsz;
+      }
+      IWRC(iwkv_cursor_close(&cur), rc);
+    }
+    _lat_add(t, ts);
+    if (rc == IWKV_ERROR_NOTFOUND) {
+      rc = 0;
+    }
+    RCBREAK(rc);
+  }
+  free(vbuf);
+  return rc;
+}
+
+static iwrc _bm_deleterandom(struct bench_thr *t) {
+  char kbuf[BENCH_KEY_MAX + 1];
+  iwkv_opflags opflags = g.sync ? IWKV_SYNC : 0;
+  iwrc rc = 0;
+  for (uint64_t i = 0; i < t->ops; ++i) {
+    IWKV_val key;
+    _key_fill(&key, kbuf, _key_next(t));
+    uint64_t ts = _now_ns();
+    rc = iwkv_del(g.db, &key, opflags);
+    _lat_add(t, ts);
+    if (!rc) {
+      ++t->found;
+    } else if (rc == IWKV_ERROR_NOTFOUND) {
+      rc = 0;
+    } else {
+      break;
+    }
+  }
+  return rc;
+}
+
+static iwrc _bm_mixed(struct bench_thr *t) {
+  char kbuf[BENCH_KEY_MAX + 1];
+  iwkv_opflags opflags = g.sync ? IWKV_SYNC : 0;
+  uint8_t *vbuf = malloc(g.value_size + 1);
+  if (!vbuf) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  iwrc rc = 0;
+  for (uint64_t i = 0; i < t->ops; ++i) {
+    IWKV_val key, val;
+    size_t vsz;
+    _key_fill(&key, kbuf, _key_next(t));
+    if (_rnd_next(&t->rnd) % 100 < g.read_percent) {
+      uint64_t ts = _now_ns();
+      rc = iwkv_get_copy(g.db, &key, vbuf, g.value_size, &vsz);
+      _lat_add(t, ts);
+      if (!rc) {
+        ++t->found;
+        t->bytes += key.size + vsz;
+      } else if (rc == IWKV_ERROR_NOTFOUND) {
+        rc = 0;
+      }
+    } else {
+      _val_fill(t, &val);
+      uint64_t ts = _now_ns();
+      rc = iwkv_put(g.db, &key, &val, opflags);
+      _lat_add(t, ts);
+      t->bytes += key.size + val.size;
+    }
+    RCBREAK(rc);
+  }
+  free(vbuf);
+  return rc;
+}
+
+static const struct bench _benches[] = {
+  { "fillseq",      _bm_fillseq,      .fresh = true                      },
+  { "fillrandom",   _bm_fillrandom,   .fresh = true                      },
+  { "overwrite",    _bm_overwrite                                        },
+  { "readrandom",   _bm_readrandom,   .readonly = true, .parallel = true },
+  { "readseq",      _bm_readseq,      .readonly = true                   },
+  { "seekrandom",   _bm_seekrandom,   .readonly = true, .parallel = true },
+  { "deleterandom", _bm_deleterandom                                     },
+  { "mixed",        _bm_mixed,        .parallel = true                   },
+  { 0 }
+};
+
+//--------------------------  Runner
+
+static iwrc _db_open(bool trunc) {
+  IWKV_OPTS opts = g.opts;
+  opts.path = g.path;
+  opts.oflags = trunc ? IWKV_TRUNC : 0;
+  opts.wal.enabled = g.wal;
+  iwrc rc = iwkv_open(&opts, &g.iwkv);
+  RCRET(rc);
+  return iwkv_db(g.iwkv, 1, 0, &g.db);
+}
+
+static iwrc _db_close(void) {
+  g.db = 0;
+  return g.iwkv ? iwkv_close(&g.iwkv) : 0;
+}
+
+static void* _bench_thr_fn(void *op) {
+  struct bench_thr *t = op;
+  t->rc = t->b->fn(t);
+  return 0;
+}
+
+static int _lat_cmp(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+  return x < y ? -1 : x > y;
+}
+
+static double _lat_pct(const uint64_t *lat, uint64_t nlat, double pct) {
+  if (!nlat) {
+    return 0;
+  }
+  uint64_t idx = (uint64_t) (pct * nlat);
+  return lat[idx < nlat ? idx : nlat - 1] / 1000.0;
+}
+
+static iwrc _bench_exec(const struct bench *b, bool report) {
+  iwrc rc = 0;
+  int nthr = b->parallel ? g.threads : 1;
+  uint64_t total = (b->readonly || b->parallel) && g.reads ? g.reads : g.num;
+  uint64_t nlat = 0, found = 0, bytes = 0;
+  uint64_t *lat = 0;
+
+  struct bench_thr *thr = calloc(nthr, sizeof(*thr));
+  if (!thr) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  if (b->fresh) {
+    RCC(rc, finish, _db_close());
+    RCC(rc, finish, _db_open(true));
+  }
+  for (int i = 0; i < nthr; ++i) {
+    struct bench_thr *t = &thr[i];
+    t->b = b;
+    t->rnd = g.seed + i * 7919ULL;
+    t->ops = total / nthr + (i < total % nthr);
+    t->lat = malloc((t->ops ? t->ops : 1) * sizeof(t->lat[0]));
+    if (!t->lat) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+  }
+
+  uint64_t ts = _now_ns();
+  if (nthr == 1) {
+    _bench_thr_fn(&thr[0]);
+  } else {
+    for (int i = 0; i < nthr; ++i) {
+      int rci = pthread_create(&thr[i].thr, 0, _bench_thr_fn, &thr[i]);
+      if (rci) {
+        rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+        for (int j = 0; j < i; ++j) {
+          pthread_join(thr[j].thr, 0);
+        }
+        goto finish;
+      }
+    }
+    for (int i = 0; i < nthr; ++i) {
+      pthread_join(thr[i].thr, 0);
+    }
+  }
+  double secs = (_now_ns() - ts) / 1e9;
+
+  for (int i = 0; i < nthr; ++i) {
+    IWRC(thr[i].rc, rc);
+    nlat += thr[i].nlat;
+    found += thr[i].found;
+    bytes += thr[i].bytes;
+  }
+  RCGO(rc, finish);
+  if (b->fresh) {
+    g.filled = true;
+  }
+  if (!report) {
+    goto finish;
+  }
+
+  lat = malloc((nlat ? nlat : 1) * sizeof(*lat));
+  if (!lat) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  nlat = 0;
+  for (int i = 0; i < nthr; ++i) {
+    memcpy(lat + nlat, thr[i].lat, thr[i].nlat * sizeof(*lat));
+    nlat += thr[i].nlat;
+  }
+  qsort(lat, nlat, sizeof(*lat), _lat_cmp);
+
+  fprintf(stdout, "%-12s : %10.0f ops/s %8.2f MB/s  p50 %8.2f  p99 %8.2f  p999 %9.2f us",
+          b->name,
+          secs > 0 ? nlat / secs : 0,
+          secs > 0 ? bytes / secs / 1048576.0 : 0,
+          _lat_pct(lat, nlat, 0.5),
+          _lat_pct(lat, nlat, 0.99),
+          _lat_pct(lat, nlat, 0.999));
+  if (b->readonly || b->fn == _bm_deleterandom || b->fn == _bm_mixed) {
+    fprintf(stdout, "  (%" PRIu64 " of %" PRIu64 " found)", found, nlat);
+  }
+  if (nthr > 1) {
+    fprintf(stdout, "  [%d threads]", nthr);
+  }
+  fprintf(stdout, "\n");
+  fflush(stdout);
+
+finish:
+  for (int i = 0; i < nthr; ++i) {
+    free(thr[i].lat);
+  }
+  free(thr);
+  free(lat);
+  return rc;
+}
+
+static iwrc _bench_run(const char *name) {
+  for (const struct bench *b = _benches; b->name; ++b) {
+    if (strcmp(b->name, name) == 0) {
+      if (!b->fresh && !g.filled) {
+        // Populate database for workloads requiring existing records
+        iwrc rc = _bench_exec(&_benches[0], false);
+        RCRET(rc);
+      }
+      return _bench_exec(b, true);
+    }
+  }
+  fprintf(stderr, "Unknown benchmark: %s\n", name);
+  return IW_ERROR_INVALID_ARGS;
+}
+
+//--------------------------  Main
+
+static void _usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --benchmarks=<list>             Comma separated list of benchmarks\n"
+          "                                  Default: %s\n"
+          "  --db=<path>                     Database file path. Default: %s\n"
+          "  --num=<n>                       Number of records. Default: %" PRIu64 "\n"
+          "  --reads=<n>                     Number of read/mixed operations. Default: --num\n"
+          "  --threads=<n>                   Number of threads for readrandom, seekrandom, mixed. Default: %d\n"
+          "  --read_percent=<n>              Percent of reads in mixed workload. Default: %d\n"
+          "  --key_size=<n>                  Key size in bytes. Default: %d\n"
+          "  --value_size=<n>                Value size in bytes. Default: %d\n"
+          "  --distribution=<uniform|zipf>   Keys access distribution. Default: uniform\n"
+          "  --zipf_theta=<n>                Zipfian distribution skew in (0, 1). Default: %.2f\n"
+          "  --seed=<n>                      Random seed. Default: %u\n"
+          "  --sync                          Use IWKV_SYNC for write operations\n"
+          "  --wal                           Enable WAL\n"
+          "  --wal_buffer_sz=<n>             iwkv_wal_opts.wal_buffer_sz\n"
+          "  --checkpoint_buffer_sz=<n>      iwkv_wal_opts.checkpoint_buffer_sz\n"
+          "  --checkpoint_timeout_sec=<n>    iwkv_wal_opts.checkpoint_timeout_sec\n"
+          "  --savepoint_timeout_sec=<n>     iwkv_wal_opts.savepoint_timeout_sec\n"
+          "  --help                          Show this help\n",
+          prog, g.benchmarks, g.path, g.num, g.threads, g.read_percent,
+          g.key_size, g.value_size, g.zipf_theta, g.seed);
+}
+
+enum {
+  OPT_BENCHMARKS = 1,
+  OPT_DB,
+  OPT_NUM,
+  OPT_READS,
+  OPT_THREADS,
+  OPT_READ_PERCENT,
+  OPT_KEY_SIZE,
+  OPT_VALUE_SIZE,
+  OPT_DISTRIBUTION,
+  OPT_ZIPF_THETA,
+  OPT_SEED,
+  OPT_SYNC,
+  OPT_WAL,
+  OPT_WAL_BUFFER_SZ,
+  OPT_CHECKPOINT_BUFFER_SZ,
+  OPT_CHECKPOINT_TIMEOUT_SEC,
+  OPT_SAVEPOINT_TIMEOUT_SEC,
+  OPT_HELP,
+};
+
+static bool _parse_args(int argc, char **argv) {
+  static const struct option lopts[] = {
+    { "benchmarks",             required_argument, 0, OPT_BENCHMARKS             },
+    { "db",                     required_argument, 0, OPT_DB                     },
+    { "num",                    required_argument, 0, OPT_NUM                    },
+    { "reads",                  required_argument, 0, OPT_READS                  },
+    { "threads",                required_argument, 0, OPT_THREADS                },
+    { "read_percent",           required_argument, 0, OPT_READ_PERCENT           },
+    { "key_size",               required_argument, 0, OPT_KEY_SIZE               },
+    { "value_size",             required_argument, 0, OPT_VALUE_SIZE             },
+    { "distribution",           required_argument, 0, OPT_DISTRIBUTION           },
+    { "zipf_theta",             required_argument, 0, OPT_ZIPF_THETA             },
+    { "seed",                   required_argument, 0, OPT_SEED                   },
+    { "sync",                   no_argument,       0, OPT_SYNC                   },
+    { "wal",                    no_argument,       0, OPT_WAL                    },
+    { "wal_buffer_sz",          required_argument, 0, OPT_WAL_BUFFER_SZ          },
+    { "checkpoint_buffer_sz",   required_argument, 0, OPT_CHECKPOINT_BUFFER_SZ   },
+    { "checkpoint_timeout_sec", required_argument, 0, OPT_CHECKPOINT_TIMEOUT_SEC },
+    { "savepoint_timeout_sec",  required_argument, 0, OPT_SAVEPOINT_TIMEOUT_SEC  },
+    { "help",                   no_argument,       0, OPT_HELP                   },
+    { 0 }
+  };
+  int ch;
+  while ((ch = getopt_long(argc, argv, "", lopts, 0)) != -1) {
+    switch (ch) {
+      case OPT_BENCHMARKS:
+        g.benchmarks = optarg;
+        break;
+      case OPT_DB:
+        g.path = optarg;
+        break;
+      case OPT_NUM:
+        g.num = strtoull(optarg, 0, 10);
+        break;
+      case OPT_READS:
+        g.reads = strtoull(optarg, 0, 10);
+        break;
+      case OPT_THREADS:
+        g.threads = atoi(optarg);
+        break;
+      case OPT_READ_PERCENT:
+        g.read_percent = atoi(optarg);
+        break;
+      case OPT_KEY_SIZE:
+        g.key_size = atoi(optarg);
+        break;
+      case OPT_VALUE_SIZE:
+        g.value_size = atoi(optarg);
+        break;
+      case OPT_DISTRIBUTION:
+        if (strcmp(optarg, "uniform") == 0) {
+          g.dist = BENCH_DIST_UNIFORM;
+        } else if (strcmp(optarg, "zipf") == 0 || strcmp(optarg, "zipfian") == 0) {
+          g.dist = BENCH_DIST_ZIPF;
+        } else {
+          fprintf(stderr, "Unknown distribution: %s\n", optarg);
+          return false;
+        }
+        break;
+      case OPT_ZIPF_THETA:
+        g.zipf_theta = strtod(optarg, 0);
+        break;
+      case OPT_SEED:
+        g.seed = strtoul(optarg, 0, 10);
+        break;
+      case OPT_SYNC:
+        g.sync = true;
+        break;
+      case OPT_WAL:
+        g.wal = true;
+        break;
+      case OPT_WAL_BUFFER_SZ:
+        g.opts.wal.wal_buffer_sz = strtoull(optarg, 0, 10);
+        break;
+      case OPT_CHECKPOINT_BUFFER_SZ:
+        g.opts.wal.checkpoint_buffer_sz = strtoull(optarg, 0, 10);
+        break;
+      case OPT_CHECKPOINT_TIMEOUT_SEC:
+        g.opts.wal.checkpoint_timeout_sec = strtoul(optarg, 0, 10);
+        break;
+      case OPT_SAVEPOINT_TIMEOUT_SEC:
+        g.opts.wal.savepoint_timeout_sec = strtoul(optarg, 0, 10);
+        break;
+      default:
+        return false;
+    }
+  }
+  if (optind < argc) {
+    fprintf(stderr, "Unexpected argument: %s\n", argv[optind]);
+    return false;
+  }
+  if (  g.num < 1 || g.threads < 1 || g.key_size < 1 || g.key_size > BENCH_KEY_MAX
+     || g.value_size < 0 || g.read_percent < 0 || g.read_percent > 100
+     || g.zipf_theta <= 0 || g.zipf_theta >= 1) {
+    fprintf(stderr, "Invalid option value\n");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  iwrc rc = 0;
+  char *list = 0;
+  if (!_parse_args(argc, argv)) {
+    _usage(argv[0]);
+    return 1;
+  }
+  rc = iw_init();
+  RCGO(rc, finish);
+
+  g.vbuf = malloc(g.value_size + BENCH_VBUF_PAD);
+  list = strdup(g.benchmarks);
+  if (!g.vbuf || !list) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  uint64_t rnd = g.seed;
+  for (int i = 0; i < g.value_size + BENCH_VBUF_PAD; ++i) {
+    g.vbuf[i] = _rnd_next(&rnd);
+  }
+  if (g.dist == BENCH_DIST_ZIPF) {
+    _zipf_init();
+  }
+
+  fprintf(stdout,
+          "iowow:        %s\n"
+          "Keys:         %d bytes\n"
+          "Values:       %d bytes\n"
+          "Entries:      %" PRIu64 "\n"
+          "Reads:        %" PRIu64 "\n"
+          "Threads:      %d\n"
+          "Distribution: %s\n"
+          "WAL:          %s\n"
+          "Sync:         %s\n"
+          "------------------------------------------------\n",
+          iowow_version_full(), g.key_size, g.value_size, g.num, g.reads ? g.reads : g.num,
+          g.threads, g.dist == BENCH_DIST_ZIPF ? "zipf" : "uniform",
+          g.wal ? "on" : "off", g.sync ? "on" : "off");
+  fflush(stdout);
+
+  RCC(rc, finish, _db_open(true));
+  char *sp = 0;
+  for (char *name = strtok_r(list, ",", &sp); name; name = strtok_r(0, ",", &sp)) {
+    RCC(rc, finish, _bench_run(name));
+  }
+
+finish:
+  IWRC(_db_close(), rc);
+  if (rc) {
+    iwlog_ecode_error3(rc);
+  }
+  free(list);
+  free(g.vbuf);
+  return rc ? 1 : 0;
+}
@@ -1,4 +1,5 @@
 #include "iwkv_internal.h"
+#include "iwtp.h"
 #include <sys/types.h>
 #include <fcntl.h>
 #include <time.h>
@@ -23,6 +24,17 @@ extern atomic_uint_fast64_t g_trigger;
 #define BKP_WAL_COPY1   0x4       /**< Copy most of WAL file content */
 #define BKP_WAL_COPY2   0x5       /**< Copy rest of WAL file in exclusive locked mode */
 
+#define CP_CHUNK_SZ (8UL * 1024 * 1024) /**< Amount of WAL bytes applied by incremental checkpoint between state checks */
+#define CP_APPLY    0x1                 /**< Incremental checkpoint applies WAL to the main file without locks */
+#define CP_SWITCH   0x2                 /**< WAL is applied up to `rollforward_offset`, waiting for the final switch */
+
+#define RF_THREADS_MAX  8                  /**< Max number of rollforward threads */
+#define RF_PARALLEL_MIN (1024UL * 1024)    /**< Min size of WAL records batch applied in parallel */
+#define RF_STRIPE_SZ    (64 * 1024)        /**< Main file stripe size, stripes are distributed over rollforward threads */
+
+#define WEXT_BITS    12                   /**< Number of bits in dirty extents table size */
+#define WEXT_MAX_LEN 4096                 /**< Max length of write record tracked in dirty extents table */
+
 struct iwal {
   IWDLSNR     lsnr;
   atomic_bool applying;             /**< WAL applying */
@@ -37,8 +49,10 @@ struct iwal {
   size_t   checkpoint_buffer_sz;    /**< Checkpoint buffer size in bytes. */
   uint32_t bufpos;                  /**< Current position in buffer */
   uint32_t bufsz;                   /**< Size of buffer */
+  uint32_t wbufpos;                 /**< Size of sealed data in `wbuf`, zero if `wbuf` is free */
   HANDLE   fh;                      /**< File handle */
-  uint8_t *buf;                     /**< File buffer */
+  uint8_t *buf;                     /**< Active file buffer */
+  uint8_t *wbuf;                    /**< File buffer sealed for writer thread */
   char    *path;                    /**< WAL file path */
   pthread_mutex_t *mtxp;            /**< Global WAL mutex */
   pthread_cond_t  *cpt_condp;       /**< Checkpoint thread cond variable */
@@ -53,8 +67,29 @@ struct iwal {
   uint32_t savepoint_timeout_sec;        /**< Savepoint timeout seconds */
   uint32_t checkpoint_timeout_sec;       /**< Checkpoint timeout seconds */
   atomic_size_t mbytes;                  /**< Estimated size of modifed private mmaped memory bytes */
-  off_t    rollforward_offset;           /**< Rollforward offset during online backup */
+  off_t    rollforward_offset;           /**< WAL offset rollforward starts from, records before it are in the main file */
   uint64_t checkpoint_ts;                /**< Last checkpoint timestamp milliseconds */
+  uint64_t wlsn;                         /**< Number of bytes appended to WAL */
+  uint64_t slsn;                         /**< Value of `wlsn` covered by the last durable savepoint */
+  uint32_t commit_window_us;             /**< Group commit window microseconds */
+  bool     committing;                   /**< Group commit leader is syncing WAL */
+  pthread_cond_t  commit_cond;           /**< Group commit followers cond variable */
+  pthread_cond_t  wrt_cond;              /**< Writer thread cond variable */
+  pthread_t       wrt;                   /**< Writer thread */
+  pthread_t      *wrtp;                  /**< Writer thread, zero if WAL buffers are written synchronously */
+  bool wrt_stop;                         /**< Writer thread stop requested */
+  iwrc wrt_rc;                           /**< Writer thread error */
+  bool wsyncing;                         /**< WAL file is synced outside of locks */
+  int  cp_stage;                         /**< Incremental checkpoint stage, zero if checkpoint is not running */
+  uint64_t cp_gen;                       /**< Number of WAL truncations */
+  pthread_cond_t cp_cond;                /**< Incremental checkpoint state cond variable */
+  uint64_t bufgen;                       /**< Generation of active buffer, incremented when buffer is reset */
+  uint32_t cbar;                         /**< Buffer position of the last record write records cannot be merged over */
+  struct wext {                          /**< Dirty extents of active buffer, indexed by main file block */
+    uint64_t blk;                        /**< Main file block number */
+    uint32_t pos;                        /**< Position of the last write record touching the block */
+    uint64_t gen;                        /**< Buffer generation */
+  } wexts[1U << WEXT_BITS];
   pthread_mutex_t mtx;                   /**< Global WAL mutex */
   pthread_cond_t  cpt_cond;              /**< Checkpoint thread cond variable */
   pthread_t       cpt;                   /**< Checkpoint thread */
@@ -112,6 +147,24 @@ static iwrc _init_locks(struct iwal *wal) {
   if (rci) {
     return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
   }
+  rci = pthread_cond_init(&wal->commit_cond, 0);
+  if (rci) {
+    pthread_mutex_destroy(&wal->mtx);
+    return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+  }
+  rci = pthread_cond_init(&wal->wrt_cond, 0);
+  if (rci) {
+    pthread_cond_destroy(&wal->commit_cond);
+    pthread_mutex_destroy(&wal->mtx);
+    return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+  }
+  rci = pthread_cond_init(&wal->cp_cond, 0);
+  if (rci) {
+    pthread_cond_destroy(&wal->wrt_cond);
+    pthread_cond_destroy(&wal->commit_cond);
+    pthread_mutex_destroy(&wal->mtx);
+    return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+  }
   wal->mtxp = &wal->mtx;
   return 0;
 }
@@ -130,6 +183,15 @@ static void _wal_shutdown(struct iwal *wal) {
     pthread_join(wal->cpt, 0);
     wal->cptp = 0;
   }
+  if (wal->wrtp) {
+    // Writer thread drains sealed buffer before exit
+    pthread_mutex_lock(wal->mtxp);
+    wal->wrt_stop = true;
+    pthread_cond_broadcast(&wal->wrt_cond);
+    pthread_mutex_unlock(wal->mtxp);
+    pthread_join(wal->wrt, 0);
+    wal->wrtp = 0;
+  }
 }
 
 static void _destroy(struct iwal *wal) {
@@ -144,6 +206,9 @@ static void _destroy(struct iwal *wal) {
       wal->cpt_condp = 0;
     }
     if (wal->mtxp) {
+      pthread_cond_destroy(&wal->cp_cond);
+      pthread_cond_destroy(&wal->wrt_cond);
+      pthread_cond_destroy(&wal->commit_cond);
       pthread_mutex_destroy(wal->mtxp);
       wal->mtxp = 0;
     }
@@ -152,25 +217,50 @@ static void _destroy(struct iwal *wal) {
       wal->buf -= sizeof(WBSEP);
       free(wal->buf);
     }
+    if (wal->wbuf) {
+      wal->wbuf -= sizeof(WBSEP);
+      free(wal->wbuf);
+    }
     free(wal);
   }
 }
 
+// Writes buffer prefixed by WBSEP header into WAL file
+static iwrc _write_buf(struct iwal *wal, uint8_t *buf, uint32_t len) {
+  uint32_t crc = wal->check_cp_crc ? iwu_crc32(buf, len, 0) : 0;
+  WBSEP sep = {
+    .id = WOP_SEP,
+    .crc = crc,
+    .len = len
+  };
+  uint8_t *wp = buf - sizeof(WBSEP);
+  memcpy(wp, &sep, sizeof(WBSEP));
+  return iwp_write(wal->fh, wp, len + sizeof(WBSEP));
+}
+
+// Waits until writer thread stores sealed buffer
+static iwrc _drain_wl(struct iwal *wal) {
+  while (wal->wbufpos && !wal->wrt_rc) {
+    int rci = pthread_cond_wait(&wal->wrt_cond, wal->mtxp);
+    if (rci) {
+      return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+    }
+  }
+  return wal->wrt_rc;
+}
+
 static iwrc _flush_wl(struct iwal *wal, bool sync) {
   iwrc rc = 0;
+  if (wal->wrtp) {
+    rc = _drain_wl(wal);
+    RCRET(rc);
+  }
   if (wal->bufpos) {
-    uint32_t crc = wal->check_cp_crc ? iwu_crc32(wal->buf, wal->bufpos, 0) : 0;
-    WBSEP sep = {
-      .id = WOP_SEP,
-      .crc = crc,
-      .len = wal->bufpos
-    };
-    size_t wz = wal->bufpos + sizeof(WBSEP);
-    uint8_t *wp = wal->buf - sizeof(WBSEP);
-    memcpy(wp, &sep, sizeof(WBSEP));
-    rc = iwp_write(wal->fh, wp, wz);
+    rc = _write_buf(wal, wal->buf, wal->bufpos);
     RCRET(rc);
     wal->bufpos = 0;
+    wal->cbar = 0;
+    ++wal->bufgen;
   }
   if (sync) {
     rc = iwp_fsync(wal->fh);
@@ -178,6 +268,26 @@ static iwrc _flush_wl(struct iwal *wal, bool sync) {
   return rc;
 }
 
+// Hands over active buffer to writer thread and switches to the free one
+static iwrc _rotate_wl(struct iwal *wal) {
+  if (!wal->wrtp) {
+    return _flush_wl(wal, false);
+  }
+  iwrc rc = _drain_wl(wal);
+  RCRET(rc);
+  if (wal->bufpos) {
+    uint8_t *buf = wal->wbuf;
+    wal->wbuf = wal->buf;
+    wal->wbufpos = wal->bufpos;
+    wal->buf = buf;
+    wal->bufpos = 0;
+    wal->cbar = 0;
+    ++wal->bufgen;
+    pthread_cond_broadcast(&wal->wrt_cond);
+  }
+  return 0;
+}
+
 IW_INLINE iwrc _truncate_wl(struct iwal *wal) {
   iwrc rc = iwp_ftruncate(wal->fh, 0);
   RCRET(rc);
@@ -188,30 +298,111 @@ IW_INLINE iwrc _truncate_wl(struct iwal *wal) {
   return rc;
 }
 
+/**
+ * Appends record to the active buffer.
+ * Called under `wal->mtx` which covers only copying into memory buffer,
+ * filled buffers are written by writer thread. Space is not reserved lock free since
+ * WAL records order must follow the order of file modifications and
+ * `_wext_merge_wl()` rewrites records of the active buffer in place.
+ */
 static iwrc _write_wl(struct iwal *wal, const void *op, off_t oplen, const uint8_t *data, off_t len) {
   iwrc rc = 0;
   const off_t bufsz = wal->bufsz;
   wal->synched = false;
+  wal->wlsn += oplen + len;
   if (bufsz - wal->bufpos < oplen) {
-    rc = _flush_wl(wal, false);
+    rc = _rotate_wl(wal);
     RCRET(rc);
   }
   assert(bufsz - wal->bufpos >= oplen);
   memcpy(wal->buf + wal->bufpos, op, (size_t) oplen);
   wal->bufpos += oplen;
   if (bufsz - wal->bufpos < len) {
-    rc = _flush_wl(wal, false);
-    RCRET(rc);
-    rc = iwp_write(wal->fh, data, (size_t) len);
-    RCRET(rc);
+    if (bufsz - oplen >= len) {
+      // Operation with data fits into the next buffer
+      wal->bufpos -= oplen;
+      rc = _rotate_wl(wal);
+      RCRET(rc);
+      memcpy(wal->buf, op, (size_t) oplen);
+      memcpy(wal->buf + oplen, data, (size_t) len);
+      wal->bufpos = oplen + len;
+    } else {
+      rc = _flush_wl(wal, false);
+      RCRET(rc);
+      rc = iwp_write(wal->fh, data, (size_t) len);
+      RCRET(rc);
+    }
   } else if (len > 0) {
     assert(bufsz - wal->bufpos >= len);
     memcpy(wal->buf + wal->bufpos, data, (size_t) len);
     wal->bufpos += len;
   }
+  if (*(const uint8_t*) op != WOP_WRITE) {
+    wal->cbar = wal->bufpos;
+  }
   return rc;
 }
 
+IW_INLINE struct wext* _wext(struct iwal *wal, uint64_t blk) {
+  return &wal->wexts[(blk * 0x9E3779B97F4A7C15ULL) >> (64 - WEXT_BITS)];
+}
+
+// Registers write record at `pos` of active buffer in dirty extents table
+static void _wext_track_wl(struct iwal *wal, off_t off, off_t len, uint32_t pos) {
+  for (uint64_t blk = off >> IWKV_FSM_BPOW, eblk = (off + len - 1) >> IWKV_FSM_BPOW; blk <= eblk; ++blk) {
+    struct wext *e = _wext(wal, blk);
+    e->blk = blk;
+    e->pos = pos;
+    e->gen = wal->bufgen;
+  }
+}
+
+/**
+ * Merges write into the data of earlier write record of active buffer
+ * if that record fully covers `[off, off + len)` and no record written after it touches
+ * blocks of this range. Returns false if write record should be appended to WAL.
+ */
+static bool _wext_merge_wl(struct iwal *wal, off_t off, const void *buf, off_t len) {
+  if ((len < 1) || (len > WEXT_MAX_LEN)) {
+    return false;
+  }
+  WBWRITE wb;
+  uint64_t blk = off >> IWKV_FSM_BPOW;
+  uint64_t eblk = (off + len - 1) >> IWKV_FSM_BPOW;
+  struct wext *e = _wext(wal, blk);
+  if ((e->gen != wal->bufgen) || (e->blk != blk) || (e->pos < wal->cbar)) {
+    return false;
+  }
+  uint32_t pos = e->pos;
+  memcpy(&wb, wal->buf + pos, sizeof(wb));
+  if ((off < wb.off) || (off + len > wb.off + wb.len)) {
+    return false;
+  }
+  for (++blk; blk <= eblk; ++blk) {
+    e = _wext(wal, blk);
+    if ((e->gen != wal->bufgen) || (e->blk != blk) || (e->pos != pos)) {
+      return false;
+    }
+  }
+  uint8_t *data = wal->buf + pos + sizeof(wb);
+  memcpy(data + (off - wb.off), buf, (size_t) len);
+  if (wal->check_cp_crc) {
+    wb.crc = iwu_crc32(data, wb.len, 0);
+    memcpy(wal->buf + pos, &wb, sizeof(wb));
+  }
+  wal->synched = false;
+  wal->wlsn += sizeof(wb) + len;
+  return true;
+}
+
+// Marks WAL records up to `lsn` as durable and wakes up waiting committers
+IW_INLINE void _committed_wl(struct iwal *wal, uint64_t lsn) {
+  if (lsn > wal->slsn) {
+    wal->slsn = lsn;
+    pthread_cond_broadcast(&wal->commit_cond);
+  }
+}
+
 IW_INLINE iwrc _write_op(struct iwal *wal, const void *op, off_t oplen, const uint8_t *data, off_t len) {
   iwrc rc = _lock(wal);
   RCRET(rc);
@@ -283,14 +474,30 @@ static iwrc _onwrite(struct iwdlsnr *self, off_t off, const void *buf, off_t len
   if (wal->applying) {
     return 0;
   }
+  // Checksum is computed before the lock is taken
   WBWRITE wb = {
     .id = WOP_WRITE,
     .crc = wal->check_cp_crc ? iwu_crc32(buf, len, 0) : 0,
     .len = len,
     .off = off
   };
+  iwrc rc = _lock(wal);
+  RCRET(rc);
+  if (_wext_merge_wl(wal, off, buf, len)) {
+    // Block image is updated in place, the latest one will be flushed
+    return _unlock(wal);
+  }
   wal->mbytes += len;
-  return _write_op(wal, &wb, sizeof(wb), buf, len);
+  rc = _write_wl(wal, &wb, sizeof(wb), buf, len);
+  if (!rc) {
+    if ((len > 0) && (len <= WEXT_MAX_LEN) && (wal->bufpos >= sizeof(wb) + len)) {
+      _wext_track_wl(wal, off, len, wal->bufpos - (uint32_t) (sizeof(wb) + len));
+    } else {
+      wal->cbar = wal->bufpos;
+    }
+  }
+  IWRC(_unlock(wal), rc);
+  return rc;
 }
 
 static iwrc _onresize(struct iwdlsnr *self, off_t osize, off_t nsize, int flags, bool *handled) {
@@ -404,6 +611,175 @@ static void _last_fix_and_reset_points(struct iwal *wal, uint8_t *wmm, off_t fsz
   }
 }
 
+/**
+ * Rollforward of WAL records batch.
+ * Batch contains only `WOP_SET` and `WOP_WRITE` records, `WOP_COPY` and `WOP_RESIZE` records
+ * depend on the previous ones, so they are applied between batches by the caller.
+ * Every rollforward task walks the whole batch in the WAL order but touches only
+ * main file stripes assigned to it, so records are applied in parallel
+ * without any ordering conflicts. CRC checksums are verified in the same way before apply.
+ */
+struct rfctx {
+  IWTP tp;
+  const uint8_t *bp; /**< Batch start */
+  off_t    blen;     /**< Batch length */
+  uint8_t *mm;       /**< Main file mmap */
+  int      nthreads; /**< Number of threads in pool */
+  int      n;        /**< Number of tasks */
+  bool     verify;   /**< Verify CRC checksums instead of apply */
+  int      pending;  /**< Number of running tasks */
+  iwrc     rc;
+  pthread_mutex_t mtx;
+  pthread_cond_t  cond;
+  struct rftask {
+    struct rfctx *ctx;
+    int k;
+  } tasks[RF_THREADS_MAX];
+};
+
+static void _rf_apply_range(struct rfctx *ctx, int k, off_t off, off_t len, const uint8_t *src, uint8_t val) {
+  if (ctx->n == 1) {
+    if (src) {
+      memcpy(ctx->mm + off, src, (size_t) len);
+    } else {
+      memset(ctx->mm + off, val, (size_t) len);
+    }
+    return;
+  }
+  off_t end = off + len;
+  for (off_t o = off, next; o < end; o = next) {
+    next = (o & ~((off_t) RF_STRIPE_SZ - 1)) + RF_STRIPE_SZ;
+    if (next > end) {
+      next = end;
+    }
+    if ((o / RF_STRIPE_SZ) % ctx->n == k) {
+      if (src) {
+        memcpy(ctx->mm + o, src + (o - off), (size_t) (next - o));
+      } else {
+        memset(ctx->mm + o, val, (size_t) (next - o));
+      }
+    }
+  }
+}
+
+static iwrc _rf_run(struct rfctx *ctx, int k) {
+  const uint8_t *rp = ctx->bp;
+  const uint8_t *ep = rp + ctx->blen;
+  uint32_t si = 0; // Index of checksummed block
+
+  while (rp < ep) {
+    uint8_t opid;
+    memcpy(&opid, rp, 1);
+    switch (opid) {
+      case WOP_SEP: {
+        WBSEP wb;
+        memcpy(&wb, rp, sizeof(wb));
+        rp += sizeof(wb);
+        if (ctx->verify && wb.crc && (si++ % ctx->n == k) && (iwu_crc32(rp, wb.len, 0) != wb.crc)) {
+          iwlog_ecode_error2(IWKV_ERROR_CORRUPTED_WAL_FILE, "Invalid CRC32 checksum of WAL segment (WBSEP)");
+          return IWKV_ERROR_CORRUPTED_WAL_FILE;
+        }
+        break;
+      }
+      case WOP_SET: {
+        WBSET wb;
+        memcpy(&wb, rp, sizeof(wb));
+        rp += sizeof(wb);
+        if (!ctx->verify) {
+          _rf_apply_range(ctx, k, wb.off, wb.len, 0, wb.val);
+        }
+        break;
+      }
+      case WOP_WRITE: {
+        WBWRITE wb;
+        memcpy(&wb, rp, sizeof(wb));
+        rp += sizeof(wb);
+        if (ctx->verify) {
+          if (wb.crc && (si++ % ctx->n == k) && (iwu_crc32(rp, wb.len, 0) != wb.crc)) {
+            iwlog_ecode_error2(IWKV_ERROR_CORRUPTED_WAL_FILE, "Invalid CRC32 checksum of WAL segment (WBWRITE)");
+            return IWKV_ERROR_CORRUPTED_WAL_FILE;
+          }
+        } else {
+          _rf_apply_range(ctx, k, wb.off, wb.len, rp, 0);
+        }
+        rp += wb.len;
+        break;
+      }
+      case WOP_SAVEPOINT:
+        rp += sizeof(WBSAVEPOINT);
+        break;
+      case WOP_RESET:
+        rp += sizeof(WBRESET);
+        break;
+      default:
+        return IW_ERROR_INVALID_STATE;
+    }
+  }
+  return 0;
+}
+
+static void _rf_task(void *op) {
+  struct rftask *t = op;
+  struct rfctx *ctx = t->ctx;
+  iwrc rc = _rf_run(ctx, t->k);
+  pthread_mutex_lock(&ctx->mtx);
+  if (rc && !ctx->rc) {
+    ctx->rc = rc;
+  }
+  if (--ctx->pending == 0) {
+    pthread_cond_broadcast(&ctx->cond);
+  }
+  pthread_mutex_unlock(&ctx->mtx);
+}
+
+static iwrc _rf_batch(struct rfctx *ctx, const uint8_t *bp, off_t blen, uint8_t *mm, bool ccrc) {
+  if (blen <= 0) {
+    return 0;
+  }
+  iwrc rc = 0;
+  ctx->bp = bp;
+  ctx->blen = blen;
+  ctx->mm = mm;
+  ctx->n = (ctx->tp && blen >= RF_PARALLEL_MIN) ? ctx->nthreads : 1;
+
+  for (int v = ccrc ? 1 : 0; v >= 0; --v) { // Verify checksums first then apply
+    ctx->verify = v;
+    if (ctx->n == 1) {
+      rc = _rf_run(ctx, 0);
+      RCRET(rc);
+      continue;
+    }
+    ctx->rc = 0;
+    ctx->pending = ctx->n;
+    for (int k = 0; k < ctx->n; ++k) {
+      ctx->tasks[k].ctx = ctx;
+      ctx->tasks[k].k = k;
+      if (iwtp_schedule(ctx->tp, _rf_task, &ctx->tasks[k])) {
+        _rf_task(&ctx->tasks[k]);
+      }
+    }
+    pthread_mutex_lock(&ctx->mtx);
+    while (ctx->pending > 0) {
+      pthread_cond_wait(&ctx->cond, &ctx->mtx);
+    }
+    rc = ctx->rc;
+    pthread_mutex_unlock(&ctx->mtx);
+    RCRET(rc);
+  }
+  return 0;
+}
+
+// Main file mapping, it is empty until WAL resize record is applied to new file
+static iwrc _rf_probe(IWFS_EXT *extf, uint8_t **mmp, size_t *spp) {
+  iwrc rc = extf->probe_mmap_unsafe(extf, 0, mmp, spp);
+  if (rc == IWFS_ERROR_NOT_MMAPED) {
+    *mmp = 0;
+    *spp = 0;
+    rc = 0;
+  }
+  return rc;
+}
+
 static iwrc _rollforward_exl(struct iwal *wal, IWFS_EXT *extf, int recover_mode) {
   assert(wal->bufpos == 0);
   off_t fsz = 0;
@@ -413,12 +789,12 @@ static iwrc _rollforward_exl(struct iwal *wal, IWFS_EXT *extf, int recover_mode)
     return 0;
   }
   size_t sp;
-  uint8_t *mm;
+  uint8_t *mm, *wmm;
   const bool ccrc = wal->check_cp_crc;
   off_t fpos = 0; // checkpoint
 #ifndef _WIN32
   off_t pfsz = IW_ROUNDUP(fsz, iwp_page_size());
-  uint8_t *wmm = mmap(0, (size_t) pfsz, PROT_READ, MAP_PRIVATE, wal->fh, 0);
+  uint8_t *wbase = mmap(0, (size_t) pfsz, PROT_READ, MAP_PRIVATE, wal->fh, 0);
   #if defined(MADV_SEQUENTIAL) || defined(MADV_DONTFORK)
   int adv = 0;
   #ifdef MADV_SEQUENTIAL
@@ -427,15 +803,16 @@ static iwrc _rollforward_exl(struct iwal *wal, IWFS_EXT *extf, int recover_mode)
   #ifdef MADV_DONTFORK
   adv |= MADV_DONTFORK;
   #endif
-  madvise(wmm, (size_t) fsz, adv);
+  madvise(wbase, (size_t) fsz, adv);
   #endif
 #else
   off_t pfsz = fsz;
-  uint8_t *wmm = mmap(0, 0, PROT_READ, MAP_PRIVATE, wal->fh, 0);
+  uint8_t *wbase = mmap(0, 0, PROT_READ, MAP_PRIVATE, wal->fh, 0);
 #endif
-  if (wmm == MAP_FAILED) {
+  if (wbase == MAP_FAILED) {
     return iwrc_set_errno(IW_ERROR_ERRNO, errno);
   }
+  wmm = wbase;
   // Temporary turn off extf locking
   wal->applying = true;
 
@@ -443,12 +820,17 @@ static iwrc _rollforward_exl(struct iwal *wal, IWFS_EXT *extf, int recover_mode)
   extf->remove_mmap_unsafe(extf, 0);
   rc = extf->add_mmap_unsafe(extf, 0, SIZE_T_MAX, IWFS_MMAP_SHARED);
   if (rc) {
-    munmap(wmm, (size_t) pfsz);
+    munmap(wbase, (size_t) pfsz);
     wal->iwkv->fatalrc = rc;
     wal->applying = false;
     return rc;
   }
 
+  struct rfctx rf = {
+    .mtx  = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER
+  };
+
 #define _WAL_CORRUPTED(msg_) do {             \
           rc = IWKV_ERROR_CORRUPTED_WAL_FILE; \
           iwlog_ecode_error2(rc, msg_);       \
@@ -475,19 +857,35 @@ static iwrc _rollforward_exl(struct iwal *wal, IWFS_EXT *extf, int recover_mode)
       fsz -= rpos;
     }
   } else if (wal->rollforward_offset > 0) {
-    if (wal->rollforward_offset >= fsz) {
+    // Records before offset are already in the main file
+    if (wal->rollforward_offset > fsz) {
       _WAL_CORRUPTED("Invalid rollforward offset");
     }
     wmm += wal->rollforward_offset;
     fsz -= wal->rollforward_offset;
   }
 
-  uint8_t *rp = wmm;
+  if (fsz >= RF_PARALLEL_MIN) {
+    rf.nthreads = MIN(iwp_num_cpu_cores(), RF_THREADS_MAX);
+    if (rf.nthreads > 1) {
+      iwrc rc2 = iwtp_start("iwal::RF", rf.nthreads, 0, &rf.tp);
+      if (rc2) { // Fallback to single threaded rollforward
+        iwlog_ecode_error3(rc2);
+        rf.tp = 0;
+      }
+    }
+  }
+  rc = _rf_probe(extf, &mm, &sp);
+  RCGO(rc, finish);
+
+  // Validate records and apply them in batches separated by `WOP_COPY` and `WOP_RESIZE`.
+  // Rollforward offset left by incremental checkpoint may point inside WAL segment.
+  uint8_t *rp = wmm, *bp = wmm;
   for (uint32_t i = 0; rp - wmm < fsz; ++i) {
     uint8_t opid;
     off_t avail = fsz - (rp - wmm);
     memcpy(&opid, rp, 1);
-    if ((i == 0) && (opid != WOP_SEP)) {
+    if ((i == 0) && (opid != WOP_SEP) && (wmm == wbase)) {
       rc = IWKV_ERROR_CORRUPTED_WAL_FILE;
       goto finish;
     }
@@ -502,12 +900,6 @@ static iwrc _rollforward_exl(struct iwal *wal, IWFS_EXT *extf, int recover_mode)
         if (wb.len > avail) {
           _WAL_CORRUPTED("Premature end of WAL (WBSEP)");
         }
-        if (ccrc && wb.crc) {
-          uint32_t crc = iwu_crc32(rp, wb.len, 0);
-          if (crc != wb.crc) {
-            _WAL_CORRUPTED("Invalid CRC32 checksum of WAL segment (WBSEP)");
-          }
-        }
         break;
       }
       case WOP_SET: {
@@ -517,9 +909,9 @@ static iwrc _rollforward_exl(struct iwal *wal, IWFS_EXT *extf, int recover_mode)
         }
         memcpy(&wb, rp, sizeof(wb));
         rp += sizeof(wb);
-        rc = extf->probe_mmap_unsafe(extf, 0, &mm, &sp);
-        RCGO(rc, finish);
-        memset(mm + wb.off, wb.val, (size_t) wb.len);
+        if ((wb.off < 0) || (wb.len < 0) || (wb.off + wb.len > sp)) {
+          _WAL_CORRUPTED("Invalid WBSET range");
+        }
         break;
       }
       case WOP_COPY: {
@@ -528,10 +920,15 @@ static iwrc _rollforward_exl(struct iwal *wal, IWFS_EXT *extf, int recover_mode)
           _WAL_CORRUPTED("Premature end of WAL (WBCOPY)");
         }
         memcpy(&wb, rp, sizeof(wb));
-        rp += sizeof(wb);
-        rc = extf->probe_mmap_unsafe(extf, 0, &mm, &sp);
+        if (  (wb.off < 0) || (wb.noff < 0) || (wb.len < 0)
+           || (wb.off + wb.len > sp) || (wb.noff + wb.len > sp)) {
+          _WAL_CORRUPTED("Invalid WBCOPY range");
+        }
+        rc = _rf_batch(&rf, bp, rp - bp, mm, ccrc);
         RCGO(rc, finish);
         memmove(mm + wb.noff, mm + wb.off, (size_t) wb.len);
+        rp += sizeof(wb);
+        bp = rp;
         break;
       }
       case WOP_WRITE: {
@@ -544,15 +941,9 @@ static iwrc _rollforward_exl(struct iwal *wal, IWFS_EXT *extf, int recover_mode)
         if (avail < wb.len) {
           _WAL_CORRUPTED("Premature end of WAL (WBWRITE)");
         }
-        if (ccrc && wb.crc) {
-          uint32_t crc = iwu_crc32(rp, wb.len, 0);
-          if (crc != wb.crc) {
-            _WAL_CORRUPTED("Invalid CRC32 checksum of WAL segment (WBWRITE)");
-          }
+        if ((wb.off < 0) || (wb.off + wb.len > sp)) {
+          _WAL_CORRUPTED("Invalid WBWRITE range");
         }
-        rc = extf->probe_mmap_unsafe(extf, 0, &mm, &sp);
-        RCGO(rc, finish);
-        memmove(mm + wb.off, rp, wb.len);
         rp += wb.len;
         break;
       }
@@ -562,23 +953,37 @@ static iwrc _rollforward_exl(struct iwal *wal, IWFS_EXT *extf, int recover_mode)
           _WAL_CORRUPTED("Premature end of WAL (WBRESIZE)");
         }
         memcpy(&wb, rp, sizeof(wb));
+        rc = _rf_batch(&rf, bp, rp - bp, mm, ccrc);
+        RCGO(rc, finish);
         rp += sizeof(wb);
+        bp = rp;
         rc = extf->truncate_unsafe(extf, wb.nsize);
         RCGO(rc, finish);
+        rc = _rf_probe(extf, &mm, &sp);
+        RCGO(rc, finish);
         break;
       }
       case WOP_SAVEPOINT:
         if (fpos == rp - wmm) { // last fixpoint to
           WBSAVEPOINT wb;
           memcpy(&wb, rp, sizeof(wb));
+          rc = _rf_batch(&rf, bp, rp - bp, mm, ccrc);
+          RCGO(rc, finish);
+          bp = rp;
           iwlog_warn("Database recovered at point of time: %"
                      PRIu64
                      " ms since epoch\n", wb.ts);
           goto finish;
         }
+        if (avail < sizeof(WBSAVEPOINT)) {
+          _WAL_CORRUPTED("Premature end of WAL (WBSAVEPOINT)");
+        }
         rp += sizeof(WBSAVEPOINT);
         break;
       case WOP_RESET: {
+        if (avail < sizeof(WBRESET)) {
+          _WAL_CORRUPTED("Premature end of WAL (WBRESET)");
+        }
         rp += sizeof(WBRESET);
         break;
       }
@@ -588,13 +993,19 @@ static iwrc _rollforward_exl(struct iwal *wal, IWFS_EXT *extf, int recover_mode)
       }
     }
   }
+  rc = _rf_batch(&rf, bp, rp - bp, mm, ccrc);
 #undef _WAL_CORRUPTED
 
 finish:
+  if (rf.tp) {
+    IWRC(iwtp_shutdown(&rf.tp, true), rc);
+  }
+  pthread_cond_destroy(&rf.cond);
+  pthread_mutex_destroy(&rf.mtx);
   if (!rc) {
     rc = extf->sync_mmap_unsafe(extf, 0, IWFS_SYNCDEFAULT);
   }
-  munmap(wmm, (size_t) pfsz);
+  munmap(wbase, (size_t) pfsz);
   IWRC(extf->remove_mmap_unsafe(extf, 0), rc);
   IWRC(extf->add_mmap_unsafe(extf, 0, SIZE_T_MAX, IWFS_MMAP_PRIVATE), rc);
   if (!rc) {
@@ -664,6 +1075,15 @@ static iwrc _checkpoint_exl(struct iwal *wal, uint64_t *tsp, bool no_fixpoint) {
   iwrc rc = 0;
   IWFS_EXT *extf;
   struct iwkv *iwkv = wal->iwkv;
+  while (wal->cp_stage == CP_APPLY) {
+    // Wait for incremental checkpoint to stop modifying the main file,
+    // rollforward continues from the WAL offset it has reached
+    int rci = pthread_cond_wait(&wal->cp_cond, wal->mtxp);
+    if (rci) {
+      rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+      goto finish;
+    }
+  }
   if (!no_fixpoint) {
     wal->force_cp = false;
     wal->force_sp = false;
@@ -681,6 +1101,10 @@ static iwrc _checkpoint_exl(struct iwal *wal, uint64_t *tsp, bool no_fixpoint) {
   RCGO(rc, finish);
 
   rc = _rollforward_exl(wal, extf, 0);
+  if (!rc) {
+    ++wal->cp_gen;
+    _committed_wl(wal, wal->wlsn);
+  }
   wal->mbytes = 0;
   wal->synched = true;
   iwp_current_time_ms(&wal->checkpoint_ts, true);
@@ -699,6 +1123,348 @@ finish:
   return rc;
 }
 
+#ifndef _WIN32
+
+#define _WAL_CORRUPTED(msg_) do {           \
+          iwrc rc_ = IWKV_ERROR_CORRUPTED_WAL_FILE; \
+          iwlog_ecode_error2(rc_, msg_);    \
+          return rc_;                       \
+} while (0);
+
+/**
+ * Applies WAL records to the memory mapped file of `msz` bytes.
+ * Unlike `_rollforward_exl()` file resizing is not supported: applying stops
+ * at `WOP_RESIZE` record so the rest of WAL is left to `_rollforward_exl()`.
+ * Sets `*posp` to the WAL position all records before which are applied.
+ * Returns `IW_ERROR_INVALID_STATE` if WAL is closed while applying `chunked` records.
+ */
+static iwrc _apply_mm(
+  struct iwal *wal, uint8_t *mm, off_t msz, const uint8_t *wmm, off_t fsz, bool chunked,
+  off_t *posp) {
+  const bool ccrc = wal->check_cp_crc;
+  const uint8_t *rp = wmm;
+  off_t chunk = 0;
+
+  for (uint32_t i = 0; rp - wmm < fsz; ++i) {
+    uint8_t opid;
+    off_t pos = rp - wmm;
+    off_t avail = fsz - pos;
+    *posp = pos;
+    if (chunked && pos - chunk >= CP_CHUNK_SZ) {
+      chunk = pos;
+      if (!wal->open) {
+        return IW_ERROR_INVALID_STATE;
+      }
+    }
+    memcpy(&opid, rp, 1);
+    if ((i == 0) && (opid != WOP_SEP)) {
+      _WAL_CORRUPTED("Invalid WAL segment start");
+    }
+    switch (opid) {
+      case WOP_SEP: {
+        WBSEP wb;
+        if (avail < sizeof(wb)) {
+          _WAL_CORRUPTED("Premature end of WAL (WBSEP)");
+        }
+        memcpy(&wb, rp, sizeof(wb));
+        rp += sizeof(wb);
+        if (wb.len > avail - sizeof(wb)) {
+          _WAL_CORRUPTED("Premature end of WAL (WBSEP)");
+        }
+        if (ccrc && wb.crc && (iwu_crc32(rp, wb.len, 0) != wb.crc)) {
+          _WAL_CORRUPTED("Invalid CRC32 checksum of WAL segment (WBSEP)");
+        }
+        break;
+      }
+      case WOP_SET: {
+        WBSET wb;
+        if (avail < sizeof(wb)) {
+          _WAL_CORRUPTED("Premature end of WAL (WBSET)");
+        }
+        memcpy(&wb, rp, sizeof(wb));
+        rp += sizeof(wb);
+        if ((wb.off < 0) || (wb.len < 0) || (wb.off + wb.len > msz)) {
+          _WAL_CORRUPTED("Invalid WBSET range");
+        }
+        memset(mm + wb.off, wb.val, (size_t) wb.len);
+        break;
+      }
+      case WOP_COPY: {
+        WBCOPY wb;
+        if (avail < sizeof(wb)) {
+          _WAL_CORRUPTED("Premature end of WAL (WBCOPY)");
+        }
+        memcpy(&wb, rp, sizeof(wb));
+        rp += sizeof(wb);
+        if (  (wb.off < 0) || (wb.noff < 0) || (wb.len < 0)
+           || (wb.off + wb.len > msz) || (wb.noff + wb.len > msz)) {
+          _WAL_CORRUPTED("Invalid WBCOPY range");
+        }
+        memmove(mm + wb.noff, mm + wb.off, (size_t) wb.len);
+        break;
+      }
+      case WOP_WRITE: {
+        WBWRITE wb;
+        if (avail < sizeof(wb)) {
+          _WAL_CORRUPTED("Premature end of WAL (WBWRITE)");
+        }
+        memcpy(&wb, rp, sizeof(wb));
+        rp += sizeof(wb);
+        if (avail - sizeof(wb) < wb.len) {
+          _WAL_CORRUPTED("Premature end of WAL (WBWRITE)");
+        }
+        if (ccrc && wb.crc && (iwu_crc32(rp, wb.len, 0) != wb.crc)) {
+          _WAL_CORRUPTED("Invalid CRC32 checksum of WAL segment (WBWRITE)");
+        }
+        if ((wb.off < 0) || (wb.off + wb.len > msz)) {
+          _WAL_CORRUPTED("Invalid WBWRITE range");
+        }
+        memcpy(mm + wb.off, rp, wb.len);
+        rp += wb.len;
+        break;
+      }
+      case WOP_SAVEPOINT:
+        rp += sizeof(WBSAVEPOINT);
+        break;
+      case WOP_RESET:
+        rp += sizeof(WBRESET);
+        break;
+      case WOP_RESIZE:
+        return 0;
+      default:
+        _WAL_CORRUPTED("Invalid WAL command");
+        break;
+    }
+  }
+  *posp = fsz;
+  return 0;
+}
+
+#undef _WAL_CORRUPTED
+
+/**
+ * Final step of incremental checkpoint: WAL records up to `cpend` are in the main file.
+ * Replaces WAL file by records written after `cpend`, switches database mapping
+ * to the main file and reapplies these records on it.
+ */
+static iwrc _checkpoint_switch_exl(struct iwal *wal, off_t cpend, size_t mbytes, uint64_t *tsp) {
+  off_t fsz = 0;
+  size_t sp;
+  uint8_t *mm;
+  IWFS_EXT *extf;
+  struct iwkv *iwkv = wal->iwkv;
+  uint8_t *wmm = MAP_FAILED;
+  HANDLE nfh = INVALID_HANDLE_VALUE;
+  size_t len = strlen(wal->path);
+  char *tpath = malloc(len + 4 /*-tmp*/ + 1 /*\0*/);
+  if (!tpath) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  memcpy(tpath, wal->path, len);
+  memcpy(tpath + len, "-tmp", 5);
+
+  iwrc rc = 0;
+  while (wal->wsyncing) { // WAL file handle is in use by group commit leader
+    int rci = pthread_cond_wait(&wal->cp_cond, wal->mtxp);
+    if (rci) {
+      rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+      goto finish;
+    }
+  }
+  RCC(rc, finish, _flush_wl(wal, false));
+  RCC(rc, finish, iwp_lseek(wal->fh, 0, IWP_SEEK_END, &fsz));
+  if (fsz < cpend) {
+    rc = IW_ERROR_INVALID_STATE;
+    goto finish;
+  }
+  if (fsz > cpend) {
+    wmm = mmap(0, (size_t) fsz, PROT_READ, MAP_PRIVATE, wal->fh, 0);
+    if (wmm == MAP_FAILED) {
+      rc = iwrc_set_errno(IW_ERROR_ERRNO, errno);
+      goto finish;
+    }
+  }
+
+  nfh = open(tpath, O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, IWFS_DEFAULT_FILEMODE);
+  if (INVALIDHANDLE(nfh)) {
+    rc = iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
+    goto finish;
+  }
+  RCC(rc, finish, iwp_flock(nfh, IWP_WLOCK));
+  if (fsz > cpend) {
+    RCC(rc, finish, iwp_write(nfh, wmm + cpend, (size_t) (fsz - cpend)));
+  }
+  RCC(rc, finish, iwp_fsync(nfh));
+  if (rename(tpath, wal->path)) {
+    rc = iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
+    goto finish;
+  }
+  iwp_unlock(wal->fh);
+  iwp_closefh(wal->fh);
+  wal->fh = nfh;
+  nfh = INVALID_HANDLE_VALUE;
+  ++wal->cp_gen;
+  wal->rollforward_offset = 0;
+
+  // Now drop private copies of pages modified by WAL records
+  // and reapply records written after `cpend`
+  RCC(rc, finish, iwkv->fsm.extfile(&iwkv->fsm, &extf));
+  wal->applying = true;
+  extf->remove_mmap_unsafe(extf, 0);
+  rc = extf->add_mmap_unsafe(extf, 0, SIZE_T_MAX, IWFS_MMAP_PRIVATE);
+  if (!rc && (fsz > cpend)) {
+    rc = extf->probe_mmap_unsafe(extf, 0, &mm, &sp);
+    if (!rc) {
+      off_t pos = 0;
+      rc = _apply_mm(wal, mm, (off_t) sp, wmm + cpend, fsz - cpend, false, &pos);
+      if (!rc && (pos < fsz - cpend)) {
+        // File is resized by a full checkpoint, so resize record cannot follow `cpend`
+        rc = IW_ERROR_INVALID_STATE;
+      }
+    }
+  }
+  wal->applying = false;
+  if (rc) {
+    iwkv->fatalrc = iwkv->fatalrc ? iwkv->fatalrc : rc;
+    goto finish;
+  }
+  wal->mbytes = wal->mbytes > mbytes ? wal->mbytes - mbytes : 0;
+  iwp_current_time_ms(&wal->checkpoint_ts, true);
+  if (tsp) {
+    *tsp = wal->checkpoint_ts;
+  }
+
+finish:
+  if (!INVALIDHANDLE(nfh)) {
+    iwp_closefh(nfh);
+    unlink(tpath);
+  }
+  if (wmm != MAP_FAILED) {
+    munmap(wmm, (size_t) fsz);
+  }
+  free(tpath);
+  return rc;
+}
+
+#endif
+
+/**
+ * Checkpoint holding exclusive lock only for a short time at start and at the end:
+ *  - A savepoint is written, the current WAL size becomes checkpoint end.
+ *  - WAL records up to checkpoint end are applied to the main file through a separate
+ *    shared mapping without any locks held. All pages modified by these records are private
+ *    copies in the database mapping, so concurrent readers and writers are not affected.
+ *  - The WAL position reached is stored as `rollforward_offset`, so checkpoints made
+ *    before the final switch do not apply these records again.
+ *  - `_checkpoint_switch_exl()` publishes the main file. If applying has stopped before
+ *    checkpoint end, e.g. at `WOP_RESIZE` record, `_checkpoint_exl()` takes over.
+ *
+ * Falls back to `_checkpoint_exl()` during online backup.
+ */
+static iwrc _checkpoint_inc(struct iwal *wal, uint64_t *tsp) {
+  struct iwkv *iwkv = wal->iwkv;
+  iwrc rc = _excl_lock(wal);
+  RCRET(rc);
+  if (!iwkv->open) {
+    goto unlock;
+  }
+#ifndef _WIN32
+  if (!wal->bkp_stage && !wal->rollforward_offset) {
+    off_t cpend = 0, pos = 0;
+    IWFS_FSM_STATE fstate = { 0 };
+    WBSAVEPOINT wb = {
+      .id = WOP_SAVEPOINT
+    };
+    wal->force_cp = false;
+    wal->force_sp = false;
+    RCC(rc, unlock, iwp_current_time_ms(&wb.ts, false));
+    RCC(rc, unlock, _write_wl(wal, &wb, sizeof(wb), 0, 0));
+    RCC(rc, unlock, _flush_wl(wal, false));
+    RCC(rc, unlock, iwp_lseek(wal->fh, 0, IWP_SEEK_END, &cpend));
+    RCC(rc, unlock, iwkv->fsm.state(&iwkv->fsm, &fstate));
+
+    HANDLE wfh = wal->fh;
+    HANDLE mfh = fstate.exfile.file.fh;
+    off_t msz = fstate.exfile.fsize;
+    uint64_t gen = wal->cp_gen;
+    size_t mbytes = wal->mbytes;
+    wal->cp_stage = CP_APPLY;
+    _excl_unlock(wal);
+
+    uint8_t *wmm = MAP_FAILED, *mm = MAP_FAILED;
+    // Savepoint must be durable before main file is modified
+    rc = iwp_fdatasync(wfh);
+    if (!rc) {
+      wmm = mmap(0, (size_t) cpend, PROT_READ, MAP_PRIVATE, wfh, 0);
+      mm = mmap(0, (size_t) msz, PROT_READ | PROT_WRITE, MAP_SHARED, mfh, 0);
+      if ((wmm == MAP_FAILED) || (mm == MAP_FAILED)) {
+        rc = iwrc_set_errno(IW_ERROR_ERRNO, errno);
+      }
+    }
+    if (!rc) {
+      rc = _apply_mm(wal, mm, msz, wmm, cpend, true, &pos);
+    }
+    if ((pos > 0) && msync(mm, (size_t) msz, MS_SYNC)) {
+      IWRC(iwrc_set_errno(IW_ERROR_IO_ERRNO, errno), rc);
+    }
+    if (wmm != MAP_FAILED) {
+      munmap(wmm, (size_t) cpend);
+    }
+    if (mm != MAP_FAILED) {
+      munmap(mm, (size_t) msz);
+    }
+
+#ifdef IW_TESTS
+    if (g_trigger & IWKVD_WAL_CHECKPOINT_HOLD) {
+      g_trigger |= IWKVD_WAL_CHECKPOINT_HELD;
+      while ((g_trigger & IWKVD_WAL_CHECKPOINT_HOLD) && wal->open) {
+        iwp_sleep(10);
+      }
+    }
+#endif
+    // Records before `pos` are in the main file,
+    // any rollforward made from now must start after them
+    _lock(wal);
+    bool closing = !wal->open;
+    wal->rollforward_offset = pos;
+    wal->cp_stage = closing ? 0 : CP_SWITCH;
+    pthread_cond_broadcast(&wal->cp_cond);
+    _unlock(wal);
+
+    if (closing) {
+      // Checkpoint on close continues from `pos`
+      return 0;
+    }
+    if (rc) {
+      iwlog_ecode_error2(rc, "Incremental WAL checkpoint failed, fallback to exclusive checkpoint");
+    }
+    bool applied = !rc && (pos == cpend);
+    rc = _excl_lock(wal);
+    if (rc) {
+      _lock(wal);
+      wal->cp_stage = 0;
+      _unlock(wal);
+      return rc;
+    }
+    // WAL is not changed if no checkpoint has been made since savepoint
+    if ((gen == wal->cp_gen) && !wal->bkp_stage && iwkv->open) {
+      if (applied) {
+        rc = _checkpoint_switch_exl(wal, cpend, mbytes, tsp);
+      } else {
+        rc = _checkpoint_exl(wal, tsp, false);
+      }
+    }
+    wal->cp_stage = 0;
+    goto unlock;
+  }
+#endif
+  rc = _checkpoint_exl(wal, tsp, false);
+
+unlock:
+  IWRC(_excl_unlock(wal), rc);
+  return rc;
+}
+
 #ifdef IW_TESTS
 
 iwrc iwal_test_checkpoint(struct iwkv *iwkv) {
@@ -777,6 +1543,7 @@ iwrc _savepoint_exl(struct iwal *wal, uint64_t *tsp, bool sync) {
   RCRET(rc);
   if (sync) {
     wal->synched = true;
+    _committed_wl(wal, wal->wlsn);
   }
   if (tsp) {
     *tsp = wbfp.ts;
@@ -784,6 +1551,79 @@ iwrc _savepoint_exl(struct iwal *wal, uint64_t *tsp, bool sync) {
   return 0;
 }
 
+static iwrc _commit_lead(struct iwal *wal, uint64_t *lsnp) {
+  if (wal->commit_window_us) {
+    // Let concurrent writers join this commit group
+    struct timespec ts = {
+      .tv_sec  = wal->commit_window_us / 1000000,
+      .tv_nsec = (wal->commit_window_us % 1000000) * 1000L
+    };
+    nanosleep(&ts, 0);
+  }
+  // Savepoint must not split records of writes in progress, so in-flight writers
+  // are drained first. Open cursors are not waited for (unlike `_excl_lock()`),
+  // since the caller itself may hold one.
+  iwrc rc = _api_excl_lock(wal->iwkv);
+  RCRET(rc);
+  rc = _lock(wal);
+  if (rc) {
+    IWRC(_api_excl_unlock(wal->iwkv), rc);
+    return rc;
+  }
+  rc = _savepoint_exl(wal, 0, false);
+  *lsnp = wal->wlsn;
+  wal->wsyncing = !rc;
+  HANDLE fh = wal->fh;
+  IWRC(_unlock(wal), rc);
+  IWRC(_api_excl_unlock(wal->iwkv), rc);
+  RCRET(rc);
+  // Writers are not blocked while WAL is synced
+  rc = iwp_fdatasync(fh);
+  _lock(wal);
+  wal->wsyncing = false;
+  pthread_cond_broadcast(&wal->cp_cond);
+  _unlock(wal);
+  return rc;
+}
+
+iwrc iwal_commit(struct iwkv *iwkv) {
+  struct iwal *wal = (struct iwal*) iwkv->dlsnr;
+  if (!wal) {
+    return 0;
+  }
+  if (wal->wal_lock_interceptor) {
+    // Savepoint cannot be made in the caller thread since
+    // interceptor may wait for locks held by caller
+    return iwal_poke_savepoint(iwkv);
+  }
+  iwrc rc = _lock(wal);
+  RCRET(rc);
+  const uint64_t lsn = wal->wlsn;
+  while (!rc && wal->slsn < lsn) {
+    if (wal->committing) {
+      // Wait for the current group leader
+      int rci = pthread_cond_wait(&wal->commit_cond, wal->mtxp);
+      if (rci) {
+        rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+      }
+      continue;
+    }
+    uint64_t glsn = 0;
+    wal->committing = true;
+    _unlock(wal);
+    rc = _commit_lead(wal, &glsn);
+    _lock(wal);
+    wal->committing = false;
+    if (!rc) {
+      _committed_wl(wal, glsn);
+    }
+    // Next follower takes the lead if this group does not cover it
+    pthread_cond_broadcast(&wal->commit_cond);
+  }
+  _unlock(wal);
+  return rc;
+}
+
 bool iwal_synched(struct iwkv *iwkv) {
   struct iwal *wal = (struct iwal*) iwkv->dlsnr;
   if (!wal) {
@@ -866,16 +1706,16 @@ static void* _cpt_worker_fn(void *op) {
 
 cprun:
     if (cp || sp) {
-      rc = _excl_lock(wal);
-      RCBREAK(rc);
-      if (iwkv->open) {
-        if (cp) {
-          rc = _checkpoint_exl(wal, &savepoint_ts, false);
-        } else {
+      if (cp) {
+        rc = _checkpoint_inc(wal, &savepoint_ts);
+      } else {
+        rc = _excl_lock(wal);
+        RCBREAK(rc);
+        if (iwkv->open) {
           rc = _savepoint_exl(wal, &savepoint_ts, true);
         }
+        _excl_unlock(wal);
       }
-      _excl_unlock(wal);
       if (rc) {
         iwlog_ecode_error2(rc, "WAL worker savepoint/checkpoint error\n");
         rc = 0;
@@ -1016,6 +1856,48 @@ finish:
   return rc;
 }
 
+static void* _wrt_worker_fn(void *op) {
+  iwp_set_current_thread_name("iwal::WRT");
+  struct iwal *wal = op;
+  pthread_mutex_lock(wal->mtxp);
+  while (true) {
+    if (wal->wbufpos && !wal->wrt_rc) {
+      uint8_t *buf = wal->wbuf;
+      uint32_t len = wal->wbufpos;
+      pthread_mutex_unlock(wal->mtxp);
+      iwrc rc = _write_buf(wal, buf, len);
+      pthread_mutex_lock(wal->mtxp);
+      if (rc) {
+        iwlog_ecode_error2(rc, "WAL writer error\n");
+        wal->wrt_rc = rc;
+        wal->iwkv->fatalrc = wal->iwkv->fatalrc ? wal->iwkv->fatalrc : rc;
+      }
+      wal->wbufpos = 0;
+      pthread_cond_broadcast(&wal->wrt_cond);
+    } else if (wal->wrt_stop) {
+      break;
+    } else {
+      pthread_cond_wait(&wal->wrt_cond, wal->mtxp);
+    }
+  }
+  pthread_mutex_unlock(wal->mtxp);
+  return 0;
+}
+
+static iwrc _init_wrt(struct iwal *wal) {
+  uint8_t *wbuf = malloc(wal->wal_buffer_sz);
+  if (!wbuf) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  wal->wbuf = wbuf + sizeof(WBSEP);
+  int rci = pthread_create(&wal->wrt, 0, _wrt_worker_fn, wal);
+  if (rci) {
+    return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+  }
+  wal->wrtp = &wal->wrt;
+  return 0;
+}
+
 iwrc _init_cpt(struct iwal *wal) {
   if (  (wal->savepoint_timeout_sec == UINT32_MAX)
      && (wal->checkpoint_timeout_sec == UINT32_MAX)) {
@@ -1142,6 +2024,7 @@ iwrc iwal_create(struct iwkv *iwkv, const struct iwkv_opts *opts, IWFS_FSM_OPTS
   }
 
   wal->check_cp_crc = opts->wal.check_crc_on_checkpoint;
+  wal->commit_window_us = opts->wal.commit_window_us;
 
   wal->buf = malloc(wal->wal_buffer_sz);
   if (!wal->buf) {
@@ -1150,6 +2033,7 @@ iwrc iwal_create(struct iwkv *iwkv, const struct iwkv_opts *opts, IWFS_FSM_OPTS
   }
   wal->buf += sizeof(WBSEP);
   wal->bufsz = wal->wal_buffer_sz - sizeof(WBSEP);
+  wal->bufgen = 1; // Zero generation marks unused dirty extents
 
   // Now open WAL file
 
@@ -1187,6 +2071,9 @@ iwrc iwal_create(struct iwkv *iwkv, const struct iwkv_opts *opts, IWFS_FSM_OPTS
   }
 
   wal->open = true;
+  // Start writer thread
+  rc = _init_wrt(wal);
+  RCGO(rc, finish);
   // Start checkpoint thread
   rc = _init_cpt(wal);
 
@@ -105,6 +105,14 @@ iwrc iwal_poke_checkpoint(struct iwkv *iwkv, bool force);
 
 iwrc iwal_poke_savepoint(struct iwkv *iwkv);
 
+/**
+ * @brief Makes all WAL records written before this call durable.
+ *
+ * Concurrent callers are grouped: one of them writes a savepoint and syncs WAL file
+ * on behalf of all others waiting.
+ */
+iwrc iwal_commit(struct iwkv *iwkv);
+
 iwrc iwal_savepoint_exl(struct iwkv *iwkv, bool sync);
 
 void iwal_shutdown(struct iwkv *iwkv);
@@ -2,8 +2,20 @@
 
 #include "iwkv_internal.h"
 #include "iwconv.h"
+#include "sort_r.h"
+#include "iwbits.h"
+#include "iwlz.h"
 #include <stdalign.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IWKV_X86_SIMD
+#endif
+
 #define _wnw_db_wl(db_) _api_db_wlock(db_)
 
 #ifdef IW_TESTS
@@ -161,6 +173,43 @@ IW_INLINE int _cmp_keys(iwdb_flags_t dbflg, const void *v1, int v1len, const str
   }
 }
 
+/**
+ * Compares `key` with front coded stored key: `pl` bytes of restart key `rk` followed by `v1`.
+ * Only plain keys are front coded. Result is consistent with `_cmp_keys()`.
+ */
+IW_INLINE int _cmp_keys_rk(
+  iwdb_flags_t dbflg, const uint8_t *rk, int pl, const void *v1, int v1len,
+  const struct iwkv_val *key) {
+  if (!pl) {
+    return _cmp_keys(dbflg, v1, v1len, key);
+  }
+  int ret, v2len = (int) key->size;
+  IW_CMP2(ret, key->data, v2len, rk, pl);
+  if (ret) {
+    return ret;
+  }
+  if (v2len <= pl) {
+    return v2len - pl - v1len;
+  }
+  struct iwkv_val tail = {
+    .data = (uint8_t*) key->data + pl,
+    .size = v2len - pl
+  };
+  return _cmp_keys(dbflg, v1, v1len, &tail);
+}
+
+/**
+ * Compares two effective keys.
+ * Result is consistent with `_cmp_keys()` called for a stored form of the key `k1`.
+ */
+static int _cmp_ekeys(iwdb_flags_t dbflg, const struct iwkv_val *k1, const struct iwkv_val *k2) {
+  int rv = _cmp_keys(dbflg & ~IWDB_COMPOUND_KEYS, k1->data, (int) k1->size, k2);
+  if ((rv == 0) && (dbflg & IWDB_COMPOUND_KEYS)) {
+    return k1->compound > k2->compound ? -1 : k1->compound < k2->compound ? 1 : 0;
+  }
+  return rv;
+}
+
 IW_INLINE void _kv_val_dispose(struct iwkv_val *v) {
   if (v) {
     free(v->data);
@@ -197,6 +246,41 @@ IW_INLINE void _num2lebuf(uint8_t buf[static 8], void *numdata, size_t sz) {
   }
 }
 
+/** Reads block number persisted as little endian number of `sz` bytes. */
+IW_INLINE blkn_t _blkn_read(const uint8_t *rp, size_t sz) {
+  blkn_t blkn = 0;
+  for (size_t i = sz; i > 0; --i) {
+    blkn = (blkn << 8) | rp[i - 1];
+  }
+  return blkn;
+}
+
+/** Persists block number as little endian number of `sz` bytes. */
+IW_INLINE void _blkn_write(uint8_t *wp, size_t sz, blkn_t blkn) {
+  for (size_t i = 0; i < sz; ++i) {
+    wp[i] = (uint8_t) blkn;
+    blkn >>= 8;
+  }
+}
+
+/** Size of file extent allocated for out of line value of the given length. */
+IW_INLINE off_t _kvblk_ext_asz(uint32_t len) {
+  return IW_ROUNDUP((off_t) len, 1ULL << IWKV_FSM_BPOW);
+}
+
+/** Size of out of line value reference for the given format version. */
+IW_INLINE size_t _kvblk_ext_ref_sz(int32_t fmt_version) {
+  return fmt_version > 4 ? KVP_EXT_REF_SZ_V5 : KVP_EXT_REF_SZ;
+}
+
+/** Decodes out of line value reference `[blkn:u4,len:u4]`, `[blkn:u5,len:u4]` since v5. */
+IW_INLINE void _kvblk_ext_ref(int32_t fmt_version, const uint8_t *rp, blkn_t *blkn, uint32_t *len) {
+  size_t bsz = BLKN_SZ(fmt_version);
+  *blkn = _blkn_read(rp, bsz);
+  memcpy(len, rp + bsz, 4);
+  *len = IW_ITOHL(*len);
+}
+
 //-------------------------- IWKV/struct iwdb* WORKERS
 
 static WUR iwrc _iwkv_worker_inc_nolk(struct iwkv *iwkv) {
@@ -279,11 +363,7 @@ static iwrc _db_worker_dec_nolk(struct iwdb *db) {
 }
 
 static WUR iwrc _wnw_iwkw_wl(struct iwkv *iwkv) {
-  int rci = pthread_rwlock_wrlock(&iwkv->rwl);
-  if (rci) {
-    return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
-  }
-  return 0;
+  return _api_excl_lock(iwkv);
 }
 
 static WUR iwrc _wnw(struct iwkv *iwkv, iwrc (*after)(struct iwkv *iwkv)) {
@@ -333,16 +413,8 @@ static WUR iwrc _wnw_db(struct iwdb *db, iwrc (*after)(struct iwdb *db)) {
 
 //--------------------------  DB
 
-static WUR iwrc _db_at(struct iwkv *iwkv, struct iwdb **dbp, off_t addr, uint8_t *mm) {
-  iwrc rc = 0;
-  uint8_t *rp, bv;
-  uint32_t lv;
+static WUR iwrc _db_init_locks(struct iwdb *db) {
   int rci;
-  struct iwdb *db = calloc(1, sizeof(struct iwdb));
-  *dbp = 0;
-  if (!db) {
-    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
-  }
   pthread_rwlockattr_t attr;
   pthread_rwlockattr_init(&attr);
 #if defined __linux__ && (defined __USE_UNIX98 || defined __USE_XOPEN2K)
@@ -350,16 +422,39 @@ static WUR iwrc _db_at(struct iwkv *iwkv, struct iwdb **dbp, off_t addr, uint8_t
 #endif
   rci = pthread_rwlock_init(&db->rwl, &attr);
   if (rci) {
-    free(db);
     return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
   }
   rci = pthread_spin_init(&db->cursors_slk, 0);
   if (rci) {
     pthread_rwlock_destroy(&db->rwl);
-    free(db);
     return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
   }
-  // [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u4,p0:u4,n[24]:u4,c[24]:u4,meta_blk:u4,meta_blkn:u4]:217
+  return 0;
+}
+
+static void _db_destroy_locks(struct iwdb *db) {
+  pthread_rwlock_destroy(&db->rwl);
+  pthread_spin_destroy(&db->cursors_slk);
+}
+
+static WUR iwrc _db_at(struct iwkv *iwkv, struct iwdb **dbp, off_t addr, uint8_t *mm) {
+  iwrc rc = 0;
+  uint8_t *rp, bv;
+  uint32_t lv;
+  struct iwdb *db = calloc(1, sizeof(struct iwdb));
+  *dbp = 0;
+  if (!db) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  rc = _db_init_locks(db);
+  if (rc) {
+    free(db);
+    return rc;
+  }
+  // [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u4,p0:u4,n[24]:u4,c[24]:u4,meta_blk:u4,meta_blkn:u4,
+  //  rcnt_magic:u4,rcnt:u8]:229
+  // v5: [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u5,p0:u5,n[24]:u5,c[24]:u4,meta_blk:u5,meta_blkn:u5,rcnt:u8]:253
+  size_t bsz = BLKN_SZ(iwkv->fmt_version);
   db->flags = SBLK_DB;
   db->addr = addr;
   db->db = db;
@@ -372,24 +467,38 @@ static WUR iwrc _db_at(struct iwkv *iwkv, struct iwdb **dbp, off_t addr, uint8_t
     goto finish;
   }
   IW_READBV(rp, bv, db->dbflg);
+  db->idxnum = (db->dbflg & IWDB_WIDE_NODES) ? KVBLK_IDXNUM_WIDE : KVBLK_IDXNUM;
   IW_READLV(rp, lv, db->id);
-  IW_READLV(rp, lv, db->next_db_addr);
-  db->next_db_addr = BLK2ADDR(db->next_db_addr); // blknum -> addr
+  db->next_db_addr = BLK2ADDR(_blkn_read(rp, bsz)); // blknum -> addr
 
-  rp = mm + addr + DOFF_C0_U4;
+  rp = mm + addr + (iwkv->fmt_version > 4 ? DOFF_C0_V5 : DOFF_C0_U4);
   for (int i = 0; i < SLEVELS; ++i) {
     IW_READLV(rp, lv, db->lcnt[i]);
   }
 
-  IW_READLV(rp, lv, db->meta_blk);
-  IW_READLV(rp, lv, db->meta_blkn);
+  db->meta_blk = _blkn_read(rp, bsz);
+  rp += bsz;
+  db->meta_blkn = _blkn_read(rp, bsz);
+  rp += bsz;
+  if (iwkv->fmt_version > 4) {
+    uint64_t llv;
+    IW_READLLV(rp, llv, db->rcnt);
+    db->rcnt_valid = true;
+  } else {
+    IW_READLV(rp, lv, lv);
+    if (lv == IWDB_RCNT_MAGIC) {
+      uint64_t llv;
+      IW_READLLV(rp, llv, db->rcnt);
+      db->rcnt_valid = true;
+    }
+  }
 
   db->open = true;
   *dbp = db;
 
 finish:
   if (rc) {
-    pthread_rwlock_destroy(&db->rwl);
+    _db_destroy_locks(db);
     free(db);
   }
   return rc;
@@ -401,32 +510,87 @@ static WUR iwrc _db_save(struct iwdb *db, bool newdb, uint8_t *mm) {
   uint8_t *wp = mm + db->addr, bv;
   uint8_t *sp = wp;
   struct iwdlsnr *dlsnr = db->iwkv->dlsnr;
+  bool v5 = db->iwkv->fmt_version > 4;
+  size_t bsz = BLKN_SZ(db->iwkv->fmt_version);
+  size_t lsz = bsz + SLEVELS * (bsz + 4); // p0 + n[24] + c[24]
   db->next_db_addr = db->next ? db->next->addr : 0;
-  // [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u4,p0:u4,n[24]:u4,c[24]:u4,meta_blk:u4,meta_blkn:u4]:217
+  // [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u4,p0:u4,n[24]:u4,c[24]:u4,meta_blk:u4,meta_blkn:u4,
+  //  rcnt_magic:u4,rcnt:u8]:229
+  // v5: [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u5,p0:u5,n[24]:u5,c[24]:u4,meta_blk:u5,meta_blkn:u5,rcnt:u8]:253
   IW_WRITELV(wp, lv, IWDB_MAGIC);
   IW_WRITEBV(wp, bv, db->dbflg);
   IW_WRITELV(wp, lv, db->id);
-  IW_WRITELV(wp, lv, ADDR2BLK(db->next_db_addr));
+  _blkn_write(wp, bsz, ADDR2BLK(db->next_db_addr));
+  wp += bsz;
   if (dlsnr) {
     rc = dlsnr->onwrite(dlsnr, db->addr, sp, wp - sp, 0);
     RCRET(rc);
   }
   if (newdb) {
-    memset(wp, 0, 4 + SLEVELS * 4 * 2);   // p0 + n[24] + c[24]
+    memset(wp, 0, lsz);
     sp = wp;
-    wp += 4 + SLEVELS * 4 * 2;   // set to zero
+    wp += lsz;   // set to zero
   } else {
-    wp += 4 + SLEVELS * 4 * 2;   // skip
+    wp += lsz;   // skip
     sp = wp;
   }
-  IW_WRITELV(wp, lv, db->meta_blk);
-  IW_WRITELV(wp, lv, db->meta_blkn);
+  _blkn_write(wp, bsz, db->meta_blk);
+  wp += bsz;
+  _blkn_write(wp, bsz, db->meta_blkn);
+  wp += bsz;
+  if (newdb || v5) {
+    if (newdb) {
+      db->rcnt = 0;
+    }
+    db->rcnt_valid = true;
+  }
+  if (db->rcnt_valid) {
+    uint64_t llv;
+    if (!v5) {
+      IW_WRITELV(wp, lv, IWDB_RCNT_MAGIC);
+    }
+    IW_WRITELLV(wp, llv, db->rcnt);
+  }
   if (dlsnr) {
     rc = dlsnr->onwrite(dlsnr, sp - mm, sp, wp - sp, 0);
   }
   return rc;
 }
 
+/** Adds `delta` to the number of database records stored in database header. */
+static WUR iwrc _db_rcnt_add_mm(struct iwdb *db, int64_t delta, uint8_t *mm) {
+  if (!db->rcnt_valid || !delta) {
+    return 0;
+  }
+  uint64_t llv;
+  off_t off = db->addr + (db->iwkv->fmt_version > 4 ? DOFF_RCNT_V5 : DOFF_RCNT_U8);
+  uint8_t *wp = mm + off;
+  struct iwdlsnr *dlsnr = db->iwkv->dlsnr;
+  if ((delta < 0) && (db->rcnt < (uint64_t) -delta)) {
+    db->rcnt = 0;
+  } else {
+    db->rcnt += delta;
+  }
+  IW_WRITELLV(wp, llv, db->rcnt);
+  if (dlsnr) {
+    return dlsnr->onwrite(dlsnr, off, wp - sizeof(llv), sizeof(llv), 0);
+  }
+  return 0;
+}
+
+static WUR iwrc _db_rcnt_add(struct iwdb *db, int64_t delta) {
+  if (!db->rcnt_valid || !delta) {
+    return 0;
+  }
+  uint8_t *mm;
+  IWFS_FSM *fsm = &db->iwkv->fsm;
+  iwrc rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+  RCRET(rc);
+  rc = _db_rcnt_add_mm(db, delta, mm);
+  IWRC(fsm->release_mmap(fsm), rc);
+  return rc;
+}
+
 static WUR iwrc _db_load_chain(struct iwkv *iwkv, off_t addr, uint8_t *mm) {
   iwrc rc;
   struct iwdb *db = 0, *ndb;
@@ -455,11 +619,17 @@ static WUR iwrc _db_load_chain(struct iwkv *iwkv, off_t addr, uint8_t *mm) {
   return 0;
 }
 
+static void _sbc_destroy(struct iwdb *db);
+static void _bloom_destroy(struct iwdb *db);
+static void _sbc_invalidate(struct iwdb *db, off_t addr);
+IW_INLINE bool _kvblk_has_rk(struct iwdb *db);
+
 static void _db_release_lw(struct iwdb **dbp) {
   assert(dbp && *dbp);
   struct iwdb *db = *dbp;
-  pthread_rwlock_destroy(&db->rwl);
-  pthread_spin_destroy(&db->cursors_slk);
+  _db_destroy_locks(db);
+  _sbc_destroy(db);
+  _bloom_destroy(db);
   free(db);
   *dbp = 0;
 }
@@ -472,26 +642,64 @@ struct dispose_db_ctx {
 
 static iwrc _db_dispose_chain(struct dispose_db_ctx *dctx) {
   iwrc rc = 0;
-  uint8_t *mm, kvszpow;
+  uint8_t *mm, kvszpow = 0;
   IWFS_FSM *fsm = &dctx->iwkv->fsm;
   blkn_t sbn = dctx->sbn, kvblkn;
   off_t page = 0;
+  off_t ext[KVBLK_IDXNUM_MAX][2]; // Extents of out of line values: [addr, size]
+  int extn;
 
   while (sbn) {
     off_t sba = BLK2ADDR(sbn);
+    extn = 0;
     rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
     RCBREAK(rc);
-    memcpy(&kvblkn, mm + sba + SOFF_KBLK_U4, 4);
-    kvblkn = IW_ITOHL(kvblkn);
-    memcpy(&sbn, mm + sba + SOFF_N0_U4, 4);
-    sbn = IW_ITOHL(sbn);
+    kvblkn = _blkn_read(mm + sba + SOFF_KBLK(dctx->iwkv->fmt_version), BLKN_SZ(dctx->iwkv->fmt_version));
+    sbn = _blkn_read(mm + sba + SOFF_N(dctx->iwkv->fmt_version, 0), BLKN_SZ(dctx->iwkv->fmt_version));
     if (kvblkn) {
       memcpy(&kvszpow, mm + BLK2ADDR(kvblkn) + KBLK_SZPOW_OFF, 1);
+      if (dctx->iwkv->fmt_version > 2) {
+        // [szpow:u1,idxsz:u2,[ps0:vn,pl0:vn,..., ps32,pl32]____[[KV],...]]
+        // v4 blocks of plain key databases: [...,ps32,pl32,rkl:u1,rk____[[KV],...]]
+        const uint8_t *kp = mm + BLK2ADDR(kvblkn);
+        const uint8_t *rp = kp + KVBLK_HDRSZ;
+        uint8_t rkl = 0;
+        for (int i = 0; i < dctx->db->idxnum; ++i) {
+          off_t off;
+          uint32_t len;
+          int step;
+          IW_READVNUMBUF64(rp, off, step);
+          rp += step;
+          IW_READVNUMBUF(rp, len, step);
+          rp += step;
+          if (len & KVP_EXT_BIT) {
+            ext[extn++][0] = off;
+          }
+        }
+        if (_kvblk_has_rk(dctx->db)) {
+          memcpy(&rkl, rp, 1);
+        }
+        for (int i = 0; i < extn; ++i) {
+          blkn_t blkn;
+          uint32_t len, klen, plen;
+          int step;
+          const uint8_t *vp = kp + (1ULL << kvszpow) - ext[i][0];
+          IW_READVNUMBUF(vp, klen, step);
+          vp += step;
+          if (rkl) {
+            IW_READVNUMBUF(vp, plen, step);
+            vp += step;
+          }
+          _kvblk_ext_ref(dctx->iwkv->fmt_version, vp + klen, &blkn, &len);
+          ext[i][0] = BLK2ADDR(blkn);
+          ext[i][1] = _kvblk_ext_asz(len);
+        }
+      }
     }
 
     {
       uint8_t bpos;
-      memcpy(&bpos, mm + sba + SOFF_BPOS_U1_V2, 1);
+      memcpy(&bpos, mm + sba + SOFF_BPOS_U1(dctx->db), 1);
       rc = fsm->release_mmap(fsm);
       RCBREAK(rc);
       if (bpos <= SBLK_PAGE_SBLK_NUM_V2) {
@@ -508,7 +716,11 @@ static iwrc _db_dispose_chain(struct dispose_db_ctx *dctx) {
       }
     }
 
-    // Deallocate `struct kvblk`
+    // Deallocate `struct kvblk` and extents of its out of line values
+    for (int i = 0; i < extn && !rc; ++i) {
+      rc = fsm->deallocate(fsm, ext[i][0], ext[i][1]);
+    }
+    RCBREAK(rc);
     if (kvblkn) {
       rc = fsm->deallocate(fsm, BLK2ADDR(kvblkn), 1ULL << kvszpow);
       RCBREAK(rc);
@@ -531,7 +743,7 @@ static WUR iwrc _db_destroy_lw(struct iwdb **dbp) {
   struct iwdb *prev = db->prev;
   struct iwdb *next = db->next;
   IWFS_FSM *fsm = &iwkv->fsm;
-  uint32_t first_sblkn;
+  blkn_t first_sblkn;
 
   if (!iwhmap_get_u32(iwkv->dbs, db->id)) {
     iwlog_ecode_error3(IW_ERROR_INVALID_STATE);
@@ -558,8 +770,7 @@ static WUR iwrc _db_destroy_lw(struct iwdb **dbp) {
     }
   }
   // [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u4,p0:u4,n[24]:u4,c[24]:u4,meta_blk:u4,meta_blkn:u4]:217
-  memcpy(&first_sblkn, mm + db->addr + DOFF_N0_U4, 4);
-  first_sblkn = IW_ITOHL(first_sblkn);
+  first_sblkn = _blkn_read(mm + db->addr + DOFF_N(iwkv->fmt_version, 0), BLKN_SZ(iwkv->fmt_version));
   fsm->release_mmap(fsm);
 
   if (iwkv->first_db && (iwkv->first_db->addr == db->addr)) {
@@ -593,30 +804,21 @@ static WUR iwrc _db_destroy_lw(struct iwdb **dbp) {
 
 static WUR iwrc _db_create_lw(struct iwkv *iwkv, dbid_t dbid, iwdb_flags_t dbflg, struct iwdb **odb) {
   iwrc rc;
-  int rci;
   uint8_t *mm = 0;
   off_t baddr = 0, blen;
   IWFS_FSM *fsm = &iwkv->fsm;
   *odb = 0;
+  if ((dbflg & IWDB_WIDE_NODES) && (iwkv->fmt_version < 5)) {
+    return IWKV_ERROR_INCOMPATIBLE_DB_FORMAT;
+  }
   struct iwdb *db = calloc(1, sizeof(struct iwdb));
   if (!db) {
     return iwrc_set_errno(IW_ERROR_ALLOC, errno);
   }
-  pthread_rwlockattr_t attr;
-  pthread_rwlockattr_init(&attr);
-#if defined __linux__ && (defined __USE_UNIX98 || defined __USE_XOPEN2K)
-  pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
-#endif
-  rci = pthread_rwlock_init(&db->rwl, &attr);
-  if (rci) {
-    free(db);
-    return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
-  }
-  rci = pthread_spin_init(&db->cursors_slk, 0);
-  if (rci) {
-    pthread_rwlock_destroy(&db->rwl);
+  rc = _db_init_locks(db);
+  if (rc) {
     free(db);
-    return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+    return rc;
   }
   rc = fsm->allocate(fsm, DB_SZ, &baddr, &blen, IWKV_FSM_ALLOC_FLAGS);
   if (rc) {
@@ -625,6 +827,7 @@ static WUR iwrc _db_create_lw(struct iwkv *iwkv, dbid_t dbid, iwdb_flags_t dbflg
   }
   db->iwkv = iwkv;
   db->dbflg = dbflg;
+  db->idxnum = (dbflg & IWDB_WIDE_NODES) ? KVBLK_IDXNUM_WIDE : KVBLK_IDXNUM;
   db->addr = baddr;
   db->id = dbid;
   db->prev = iwkv->last_db;
@@ -665,12 +868,26 @@ finish:
 
 //--------------------------  struct kvblk
 
+/**
+ * Returns true if keys in `struct kvblk` of the given database are front coded
+ * against restart key of the block. Only plain keys are front coded.
+ */
+IW_INLINE bool _kvblk_has_rk(struct iwdb *db) {
+  return db->iwkv->fmt_version > 3 && !(db->dbflg & (IWDB_COMPOUND_KEYS | IWDB_VNUM64_KEYS | IWDB_REALNUM_KEYS));
+}
+
+/** Size of restart key `[rkl:u1,rk]` stored after kv pairs index. */
+IW_INLINE uint16_t _kvblk_rk_sz(const struct kvblk *kb) {
+  return _kvblk_has_rk(kb->db) ? 1 + kb->rkl : 0;
+}
+
 IW_INLINE void _kvblk_create(struct iwlctx *lx, off_t baddr, uint8_t kvbpow, struct kvblk **oblk) {
   struct kvblk *kblk = &lx->kaa[lx->kaan];
   kblk->db = lx->db;
   kblk->addr = baddr;
   kblk->maxoff = 0;
-  kblk->idxsz = 2 * IW_VNUMSIZE(0) * KVBLK_IDXNUM;
+  kblk->rkl = 0;
+  kblk->idxsz = 2 * IW_VNUMSIZE(0) * lx->db->idxnum + _kvblk_rk_sz(kblk);
   kblk->zidx = 0;
   kblk->szpow = kvbpow;
   kblk->flags = KVBLK_DURTY;
@@ -679,52 +896,316 @@ IW_INLINE void _kvblk_create(struct iwlctx *lx, off_t baddr, uint8_t kvbpow, str
   AAPOS_INC(lx->kaan);
 }
 
+/**
+ * Reads header of kv pair at `rp`: `[klen:vn,key,value]` or `[klen:vn,plen:vn,key,value]`
+ * if block has restart key. Full key is `plen` bytes of `kb->rk` followed by `klen` bytes of `key`.
+ * @return Size of header in bytes.
+ */
+IW_INLINE int _kvblk_kv_hdr(const struct kvblk *kb, const uint8_t *rp, uint32_t *klen, uint32_t *plen) {
+  int step, pstep = 0;
+  IW_READVNUMBUF(rp, *klen, step);
+  *plen = 0;
+  if (kb->rkl) {
+    IW_READVNUMBUF(rp + step, *plen, pstep);
+  }
+  return step + pstep;
+}
+
+/**
+ * Locates key of nonempty kv pair at `idx`.
+ * @param [out] okp Key suffix, full key is `*oplen` bytes of `kb->rk` followed by `*oklen` bytes of `*okp`
+ * @return Size of kv pair header or error.
+ */
+static WUR iwrc _kvblk_key_locate(
+  const struct kvblk *kb, uint8_t idx, const uint8_t *mm, uint8_t **okp,
+  uint32_t *oklen, uint32_t *oplen, int *ostep) {
+  const struct kvp *kvp = &kb->pidx[idx];
+  const uint8_t *rp = mm + kb->addr + (1ULL << kb->szpow) - kvp->off;
+  int step = _kvblk_kv_hdr(kb, rp, oklen, oplen);
+  if (  !(*oklen + *oplen) || (*oplen > kb->rkl)
+     || (step + *oklen > kvp->len) || (*oklen > kvp->off)) {
+    iwlog_ecode_error3(IWKV_ERROR_CORRUPTED);
+    return IWKV_ERROR_CORRUPTED;
+  }
+  *okp = (uint8_t*) rp + step;
+  if (ostep) {
+    *ostep = step;
+  }
+  return 0;
+}
+
+/**
+ * Peeks front coded key of kv pair at `idx` without its reconstruction.
+ * Full key is `*oplen` bytes of `kb->rk` followed by `*olen` bytes of `*obuf`.
+ */
 IW_INLINE WUR iwrc _kvblk_key_peek(
   const struct kvblk *kb,
   uint8_t idx, const uint8_t *mm, uint8_t **obuf,
-  uint32_t *olen) {
+  uint32_t *olen, uint32_t *oplen) {
   if (kb->pidx[idx].len) {
-    uint32_t klen, step;
-    const uint8_t *rp = mm + kb->addr + (1ULL << kb->szpow) - kb->pidx[idx].off;
-    IW_READVNUMBUF(rp, klen, step);
-    if (!klen) {
+    iwrc rc = _kvblk_key_locate(kb, idx, mm, obuf, olen, oplen, 0);
+    if (rc) {
       *obuf = 0;
       *olen = 0;
-      iwlog_ecode_error3(IWKV_ERROR_CORRUPTED);
-      return IWKV_ERROR_CORRUPTED;
+      *oplen = 0;
     }
-    rp += step;
-    *obuf = (uint8_t*) rp;
-    *olen = klen;
+    return rc;
   } else {
     *obuf = 0;
     *olen = 0;
+    *oplen = 0;
   }
   return 0;
 }
 
+/**
+ * Compares `key` with key of kv pair at `idx`.
+ * Result is consistent with `_cmp_keys()`.
+ */
+IW_INLINE WUR iwrc _kvblk_key_cmp(
+  const struct kvblk *kb, uint8_t idx, const uint8_t *mm,
+  const struct iwkv_val *key, int *cr) {
+  uint8_t *k;
+  uint32_t kl, pl;
+  iwrc rc = _kvblk_key_peek(kb, idx, mm, &k, &kl, &pl);
+  RCRET(rc);
+  *cr = _cmp_keys_rk(kb->db->dbflg, kb->rk, (int) pl, k, (int) kl, key);
+  return 0;
+}
+
+/** Copies prefix of key of kv pair at `idx` into `buf`, `*klen` is set to the full key length. */
+IW_INLINE WUR iwrc _kvblk_key_copy(
+  const struct kvblk *kb, uint8_t idx, const uint8_t *mm,
+  uint8_t *buf, uint32_t bufsz, uint32_t *klen) {
+  uint8_t *k;
+  uint32_t kl, pl;
+  iwrc rc = _kvblk_key_peek(kb, idx, mm, &k, &kl, &pl);
+  RCRET(rc);
+  *klen = pl + kl;
+  memcpy(buf, kb->rk, MIN(pl, bufsz));
+  if (bufsz > pl) {
+    memcpy(buf + pl, k, MIN(kl, bufsz - pl));
+  }
+  return 0;
+}
+
+/** Length of kv pair as persisted in `struct kvblk` index. */
+IW_INLINE uint32_t _kvp_plen(const struct kvp *kvp) {
+  return kvp->ext ? (kvp->len | KVP_EXT_BIT) : kvp->len;
+}
+
+/** Returns true if value of the given stored size should be placed out of line. */
+IW_INLINE bool _kvblk_is_ext_value(struct iwdb *db, size_t vsz) {
+  struct iwkv *iwkv = db->iwkv;
+  return iwkv->ext_value_threshold && vsz >= iwkv->ext_value_threshold && iwkv->fmt_version > 2;
+}
+
+/**
+ * Peeks value of kv pair at `idx`. Out of line values are resolved
+ * to their extents, no data is copied.
+ */
 IW_INLINE void _kvblk_value_peek(
   const struct kvblk *kb, uint8_t idx, const uint8_t *mm, uint8_t **obuf,
   uint32_t *olen) {
-  assert(idx < KVBLK_IDXNUM);
+  assert(idx < kb->db->idxnum);
   if (kb->pidx[idx].len) {
-    uint32_t klen, step;
+    uint32_t klen, plen;
     const uint8_t *rp = mm + kb->addr + (1ULL << kb->szpow) - kb->pidx[idx].off;
-    IW_READVNUMBUF(rp, klen, step);
+    int step = _kvblk_kv_hdr(kb, rp, &klen, &plen);
     rp += step;
     rp += klen;
-    *obuf = (uint8_t*) rp;
-    *olen = kb->pidx[idx].len - klen - step;
+    if (kb->pidx[idx].ext) {
+      blkn_t blkn;
+      _kvblk_ext_ref(kb->db->iwkv->fmt_version, rp, &blkn, olen);
+      *obuf = (uint8_t*) mm + BLK2ADDR(blkn);
+    } else {
+      *obuf = (uint8_t*) rp;
+      *olen = kb->pidx[idx].len - klen - step;
+    }
   } else {
     *obuf = 0;
     *olen = 0;
   }
 }
 
-static WUR iwrc _kvblk_key_get(struct kvblk *kb, uint8_t *mm, uint8_t idx, struct iwkv_val *key) {
-  assert(mm && idx < KVBLK_IDXNUM);
-  int32_t klen;
+/** Expiration time of value of kv pair at `idx`, zero if value never expires. */
+IW_INLINE uint64_t _kvblk_value_expire(const struct kvblk *kb, uint8_t idx, const uint8_t *mm) {
+  uint8_t *rp;
+  uint32_t len;
+  uint64_t llv;
+  if (!(kb->db->dbflg & IWDB_EXPIRING_VALUES)) {
+    return 0;
+  }
+  _kvblk_value_peek(kb, idx, mm, &rp, &len);
+  if (len < sizeof(llv)) {
+    return 0;
+  }
+  memcpy(&llv, rp, sizeof(llv));
+  return IW_ITOHLL(llv);
+}
+
+/**
+ * Peeks value of kv pair at `idx` like `_kvblk_value_peek()`
+ * skipping expiration time header of `IWDB_EXPIRING_VALUES` database.
+ */
+IW_INLINE void _kvblk_value_peek_data(
+  const struct kvblk *kb, uint8_t idx, const uint8_t *mm, uint8_t **obuf,
+  uint32_t *olen) {
+  _kvblk_value_peek(kb, idx, mm, obuf, olen);
+  if (kb->db->dbflg & IWDB_EXPIRING_VALUES) {
+    if (*olen >= sizeof(uint64_t)) {
+      *obuf += sizeof(uint64_t);
+      *olen -= sizeof(uint64_t);
+    } else {
+      *olen = 0;
+    }
+  }
+}
+
+/** Current time used to check expiration of records. */
+IW_INLINE uint64_t _expire_now(void) {
+  uint64_t ts = 0;
+  iwp_current_time_ms(&ts, false);
+  return ts;
+}
+
+/**
+ * Packs value of `IWDB_COMPRESSED_VALUES` or `IWDB_EXPIRING_VALUES` database into `*bufp` buffer.
+ * Value of expiring database is prefixed by `[expire:u8]` header,
+ * value of compressed database is stored as `[usz:vn,compressed value]`
+ * or `[0,value]` if value is small or not compressible.
+ */
+static WUR iwrc _kvblk_value_pack(
+  struct iwdb *db, const struct iwkv_val *val, uint64_t expire,
+  struct iwkv_val *pval, uint8_t **bufp) {
+  int len = 0;
+  size_t csz = 0;
+  size_t hsz = (db->dbflg & IWDB_EXPIRING_VALUES) ? sizeof(expire) : 0;
+  if (!val->size && !hsz) {
+    pval->data = 0;
+    pval->size = 0;
+    return 0;
+  }
+  uint8_t *buf = realloc(*bufp, hsz + 1 + val->size);
+  if (!buf) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  *bufp = buf;
+  uint8_t *wp = buf + hsz;
+  if (hsz) {
+    uint64_t llv = IW_HTOILL(expire);
+    memcpy(buf, &llv, sizeof(llv));
+  }
+  if (!(db->dbflg & IWDB_COMPRESSED_VALUES) || !val->size) {
+    if (val->size) {
+      memcpy(wp, val->data, val->size);
+    }
+    pval->size = hsz + val->size;
+  } else {
+    if (val->size >= IWKV_COMPRESS_MIN_VALUE_SZ) {
+      IW_SETVNUMBUF(len, wp, val->size);
+      csz = iwlz_compress(val->data, val->size, wp + len, val->size - len);
+    }
+    if (csz) {
+      pval->size = hsz + len + csz;
+    } else {
+      wp[0] = 0;
+      memcpy(wp + 1, val->data, val->size);
+      pval->size = hsz + 1 + val->size;
+    }
+  }
+  pval->data = buf;
+  pval->compound = val->compound;
+  return 0;
+}
+
+/**
+ * Unpacks value stored by `_kvblk_value_pack()` into `buf`.
+ * Only first `bufsz` bytes of value are unpacked.
+ * @param [out] usz Size of unpacked value
+ */
+static WUR iwrc _kvblk_value_unpack(const uint8_t *rp, uint32_t len, void *buf, size_t bufsz, size_t *usz) {
   int step;
+  int32_t vsz;
+  size_t osz;
+  *usz = 0;
+  if (!len) {
+    return 0;
+  }
+  IW_READVNUMBUF(rp, vsz, step);
+  if ((vsz < 0) || (step > len)) {
+    iwlog_ecode_error3(IWKV_ERROR_CORRUPTED);
+    return IWKV_ERROR_CORRUPTED;
+  }
+  rp += step;
+  len -= step;
+  if (!vsz) {
+    *usz = len;
+    if (bufsz) {
+      memcpy(buf, rp, MIN(bufsz, len));
+    }
+    return 0;
+  }
+  *usz = vsz;
+  bufsz = MIN(bufsz, (size_t) vsz);
+  iwrc rc = iwlz_decompress(rp, len, buf, bufsz, &osz);
+  if (rc || (osz != bufsz)) {
+    rc = IWKV_ERROR_CORRUPTED;
+    iwlog_ecode_error3(rc);
+  }
+  return rc;
+}
+
+/**
+ * Replaces packed value of `IWDB_COMPRESSED_VALUES` database allocated in `val` with unpacked one.
+ */
+static WUR iwrc _kvblk_value_unpack_val(struct iwdb *db, struct iwkv_val *val) {
+  if (!(db->dbflg & IWDB_COMPRESSED_VALUES) || !val->size) {
+    return 0;
+  }
+  size_t usz;
+  iwrc rc = _kvblk_value_unpack(val->data, val->size, 0, 0, &usz);
+  if (!rc) {
+    uint8_t *buf = usz ? malloc(usz) : 0;
+    if (usz && !buf) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    } else {
+      rc = _kvblk_value_unpack(val->data, val->size, buf, usz, &usz);
+    }
+    free(val->data);
+    val->data = buf;
+    val->size = usz;
+    if (rc) {
+      free(buf);
+      val->data = 0;
+      val->size = 0;
+    }
+  }
+  return rc;
+}
+
+/**
+ * Copies value into `vbuf` unpacking it if needed.
+ * @param [out] vsz Size of value
+ */
+IW_INLINE WUR iwrc _kvblk_value_copy(
+  const struct kvblk *kb, uint8_t idx, const uint8_t *mm,
+  void *vbuf, size_t vbufsz, size_t *vsz) {
+  uint8_t *rp;
+  uint32_t len;
+  _kvblk_value_peek_data(kb, idx, mm, &rp, &len);
+  if (kb->db->dbflg & IWDB_COMPRESSED_VALUES) {
+    return _kvblk_value_unpack(rp, len, vbuf, vbufsz, vsz);
+  }
+  *vsz = len;
+  memcpy(vbuf, rp, MIN(vbufsz, len));
+  return 0;
+}
+
+static WUR iwrc _kvblk_key_get(struct kvblk *kb, uint8_t *mm, uint8_t idx, struct iwkv_val *key) {
+  assert(mm && idx < kb->db->idxnum);
+  uint32_t klen, plen;
+  uint8_t *rp;
   struct kvp *kvp = &kb->pidx[idx];
   key->compound = 0;
   if (!kvp->len) {
@@ -732,15 +1213,9 @@ static WUR iwrc _kvblk_key_get(struct kvblk *kb, uint8_t *mm, uint8_t idx, struc
     key->size = 0;
     return 0;
   }
-  // [klen:vn,key,value]
-  uint8_t *rp = mm + kb->addr + (1ULL << kb->szpow) - kvp->off;
-  IW_READVNUMBUF(rp, klen, step);
-  rp += step;
-  if ((klen < 1) || (klen > kvp->len) || (klen > kvp->off)) {
-    iwlog_ecode_error3(IWKV_ERROR_CORRUPTED);
-    return IWKV_ERROR_CORRUPTED;
-  }
-  key->size = (size_t) klen;
+  iwrc rc = _kvblk_key_locate(kb, idx, mm, &rp, &klen, &plen, 0);
+  RCRET(rc);
+  key->size = (size_t) plen + klen;
   if (kb->db->dbflg & IWDB_VNUM64_KEYS) {
     // Needed to provide enough buffer in _unpack_effective_key()
     key->data = malloc(MAX(key->size, sizeof(int64_t)));
@@ -750,39 +1225,38 @@ static WUR iwrc _kvblk_key_get(struct kvblk *kb, uint8_t *mm, uint8_t idx, struc
   if (!key->data) {
     return iwrc_set_errno(IW_ERROR_ALLOC, errno);
   }
-  memcpy(key->data, rp, key->size);
+  memcpy(key->data, kb->rk, plen);
+  memcpy((uint8_t*) key->data + plen, rp, klen);
   return 0;
 }
 
 static WUR iwrc _kvblk_value_get(struct kvblk *kb, uint8_t *mm, uint8_t idx, struct iwkv_val *val) {
-  assert(mm && idx < KVBLK_IDXNUM);
-  int32_t klen;
-  int step;
+  assert(mm && idx < kb->db->idxnum);
+  uint32_t klen, plen;
+  uint8_t *rp;
   struct kvp *kvp = &kb->pidx[idx];
   val->compound = 0;
+  val->expire = 0;
   if (!kvp->len) {
     val->data = 0;
     val->size = 0;
     return 0;
   }
-  // [klen:vn,key,value]
-  uint8_t *rp = mm + kb->addr + (1ULL << kb->szpow) - kvp->off;
-  IW_READVNUMBUF(rp, klen, step);
-  rp += step;
-  if ((klen < 1) || (klen > kvp->len) || (klen > kvp->off)) {
-    iwlog_ecode_error3(IWKV_ERROR_CORRUPTED);
-    return IWKV_ERROR_CORRUPTED;
-  }
-  rp += klen;
-  if (kvp->len > klen + step) {
-    val->size = kvp->len - klen - step;
+  iwrc rc = _kvblk_key_locate(kb, idx, mm, &rp, &klen, &plen, 0);
+  RCRET(rc);
+  uint32_t len;
+  val->expire = _kvblk_value_expire(kb, idx, mm);
+  _kvblk_value_peek_data(kb, idx, mm, &rp, &len);
+  if (len) {
+    val->size = len;
     val->data = malloc(val->size);
     if (!val->data) {
-      iwrc rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
       val->size = 0;
       return rc;
     }
     memcpy(val->data, rp, val->size);
+    return _kvblk_value_unpack_val(kb->db, val);
   } else {
     val->data = 0;
     val->size = 0;
@@ -790,9 +1264,14 @@ static WUR iwrc _kvblk_value_get(struct kvblk *kb, uint8_t *mm, uint8_t idx, str
   return 0;
 }
 
+/**
+ * Gets kv pair in the stored form: value is not unpacked
+ * and out of line value reference is not resolved.
+ */
 static WUR iwrc _kvblk_kv_get(struct kvblk *kb, uint8_t *mm, uint8_t idx, struct iwkv_val *key, struct iwkv_val *val) {
-  assert(mm && idx < KVBLK_IDXNUM);
-  int32_t klen;
+  assert(mm && idx < kb->db->idxnum);
+  uint32_t klen, plen;
+  uint8_t *rp;
   int step;
   struct kvp *kvp = &kb->pidx[idx];
   key->compound = 0;
@@ -804,15 +1283,9 @@ static WUR iwrc _kvblk_kv_get(struct kvblk *kb, uint8_t *mm, uint8_t idx, struct
     val->size = 0;
     return 0;
   }
-  // [klen:vn,key,value]
-  uint8_t *rp = mm + kb->addr + (1ULL << kb->szpow) - kvp->off;
-  IW_READVNUMBUF(rp, klen, step);
-  rp += step;
-  if ((klen < 1) || (klen > kvp->len) || (klen > kvp->off)) {
-    iwlog_ecode_error3(IWKV_ERROR_CORRUPTED);
-    return IWKV_ERROR_CORRUPTED;
-  }
-  key->size = (size_t) klen;
+  iwrc rc = _kvblk_key_locate(kb, idx, mm, &rp, &klen, &plen, &step);
+  RCRET(rc);
+  key->size = (size_t) plen + klen;
   if (kb->db->dbflg & IWDB_VNUM64_KEYS) {
     // Needed to provide enough buffer in _unpack_effective_key()
     key->data = malloc(MAX(key->size, sizeof(int64_t)));
@@ -822,13 +1295,14 @@ static WUR iwrc _kvblk_kv_get(struct kvblk *kb, uint8_t *mm, uint8_t idx, struct
   if (!key->data) {
     return iwrc_set_errno(IW_ERROR_ALLOC, errno);
   }
-  memcpy(key->data, rp, key->size);
+  memcpy(key->data, kb->rk, plen);
+  memcpy((uint8_t*) key->data + plen, rp, klen);
   rp += klen;
   if (kvp->len > klen + step) {
     val->size = kvp->len - klen - step;
     val->data = malloc(val->size);
     if (!val->data) {
-      iwrc rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
       free(key->data);
       key->data = 0;
       key->size = 0;
@@ -856,6 +1330,7 @@ static WUR iwrc _kvblk_at_mm(struct iwlctx *lx, off_t addr, uint8_t *mm, struct
   kb->zidx = -1;
   kb->szpow = 0;
   kb->flags = KVBLK_DEFAULT;
+  kb->rkl = 0;
   memset(kb->pidx, 0, sizeof(kb->pidx));
 
   *blkp = 0;
@@ -868,11 +1343,15 @@ static WUR iwrc _kvblk_at_mm(struct iwlctx *lx, off_t addr, uint8_t *mm, struct
     iwlog_ecode_error3(rc);
     goto finish;
   }
-  for (uint8_t i = 0; i < KVBLK_IDXNUM; ++i) {
+  for (uint8_t i = 0; i < kb->db->idxnum; ++i) {
     IW_READVNUMBUF64(rp, kb->pidx[i].off, step);
     rp += step;
     IW_READVNUMBUF(rp, kb->pidx[i].len, step);
     rp += step;
+    if (kb->pidx[i].len & KVP_EXT_BIT) {
+      kb->pidx[i].len &= ~KVP_EXT_BIT;
+      kb->pidx[i].ext = true;
+    }
     if (kb->pidx[i].len) {
       if (IW_UNLIKELY(!kb->pidx[i].off)) {
         rc = IWKV_ERROR_CORRUPTED;
@@ -887,10 +1366,21 @@ static WUR iwrc _kvblk_at_mm(struct iwlctx *lx, off_t addr, uint8_t *mm, struct
     }
     kb->pidx[i].ridx = i;
   }
-  *blkp = kb;
-  assert(rp - (mm + addr) <= (1ULL << kb->szpow));
-  if (!kbp) {
-    AAPOS_INC(lx->kaan);
+  if (_kvblk_has_rk(kb->db)) {
+    memcpy(&kb->rkl, rp, 1);
+    rp += 1;
+    if (IW_UNLIKELY(kb->rkl > KVBLK_MAX_RK_LEN)) {
+      rc = IWKV_ERROR_CORRUPTED;
+      iwlog_ecode_error3(rc);
+      goto finish;
+    }
+    memcpy(kb->rk, rp, kb->rkl);
+    rp += kb->rkl;
+  }
+  *blkp = kb;
+  assert(rp - (mm + addr) <= (1ULL << kb->szpow));
+  if (!kbp) {
+    AAPOS_INC(lx->kaan);
   }
 
 finish:
@@ -899,17 +1389,17 @@ finish:
 
 IW_INLINE off_t _kvblk_compacted_offset(struct kvblk *kb) {
   off_t coff = 0;
-  for (int i = 0; i < KVBLK_IDXNUM; ++i) {
+  for (int i = 0; i < kb->db->idxnum; ++i) {
     coff += kb->pidx[i].len;
   }
   return coff;
 }
 
 IW_INLINE off_t _kvblk_compacted_dsize(struct kvblk *kb) {
-  off_t coff = KVBLK_HDRSZ;
-  for (int i = 0; i < KVBLK_IDXNUM; ++i) {
+  off_t coff = KVBLK_HDRSZ + _kvblk_rk_sz(kb);
+  for (int i = 0; i < kb->db->idxnum; ++i) {
     coff += kb->pidx[i].len;
-    coff += IW_VNUMSIZE32(kb->pidx[i].len);
+    coff += IW_VNUMSIZE32(_kvp_plen(&kb->pidx[i]));
     coff += IW_VNUMSIZE(kb->pidx[i].off);
   }
   return coff;
@@ -929,13 +1419,19 @@ static WUR iwrc _kvblk_sync_mm(struct kvblk *kb, uint8_t *mm) {
   wp += 1;
   szp = wp;
   wp += sizeof(uint16_t);
-  for (int i = 0; i < KVBLK_IDXNUM; ++i) {
+  for (int i = 0; i < kb->db->idxnum; ++i) {
     struct kvp *kvp = &kb->pidx[i];
     IW_SETVNUMBUF64(sp, wp, kvp->off);
     wp += sp;
-    IW_SETVNUMBUF(sp, wp, kvp->len);
+    IW_SETVNUMBUF(sp, wp, _kvp_plen(kvp));
     wp += sp;
   }
+  if (_kvblk_has_rk(kb->db)) {
+    memcpy(wp, &kb->rkl, 1);
+    wp += 1;
+    memcpy(wp, kb->rk, kb->rkl);
+    wp += kb->rkl;
+  }
   sp = wp - szp - sizeof(uint16_t);
   kb->idxsz = sp;
   assert(kb->idxsz <= KVBLK_MAX_IDX_SZ);
@@ -963,16 +1459,16 @@ static WUR iwrc _kvblk_compact_mm(struct kvblk *kb, uint8_t *mm) {
   }
   iwrc rc = 0;
   uint16_t idxsiz = 0;
-  struct kvp tidx[KVBLK_IDXNUM];
-  struct kvp tidx_tmp[KVBLK_IDXNUM];
+  struct kvp tidx[KVBLK_IDXNUM_MAX];
+  struct kvp tidx_tmp[KVBLK_IDXNUM_MAX];
   struct iwdlsnr *dlsnr = kb->db->iwkv->dlsnr;
   off_t blkend = kb->addr + (1ULL << kb->szpow);
   uint8_t *wp = mm + blkend;
   memcpy(tidx, kb->pidx, sizeof(tidx));
-  ks_mergesort_kvblk(KVBLK_IDXNUM, tidx, tidx_tmp, 0);
+  ks_mergesort_kvblk(kb->db->idxnum, tidx, tidx_tmp, 0);
 
   coff = 0;
-  for (i = 0; i < KVBLK_IDXNUM && tidx[i].off; ++i) {
+  for (i = 0; i < kb->db->idxnum && tidx[i].off; ++i) {
 #ifndef NDEBUG
     if (i > 0) {
       assert(tidx[i - 1].off < tidx[i].off);
@@ -990,10 +1486,11 @@ static WUR iwrc _kvblk_compact_mm(struct kvblk *kb, uint8_t *mm) {
     }
     coff += kvp->len;
     idxsiz += IW_VNUMSIZE(kvp->off);
-    idxsiz += IW_VNUMSIZE32(kvp->len);
+    idxsiz += IW_VNUMSIZE32(_kvp_plen(kvp));
   }
-  idxsiz += (KVBLK_IDXNUM - i) * 2;
-  for (i = 0; i < KVBLK_IDXNUM; ++i) {
+  idxsiz += (kb->db->idxnum - i) * 2;
+  idxsiz += _kvblk_rk_sz(kb);
+  for (i = 0; i < kb->db->idxnum; ++i) {
     if (!kb->pidx[i].len) {
       kb->zidx = i;
       break;
@@ -1002,7 +1499,7 @@ static WUR iwrc _kvblk_compact_mm(struct kvblk *kb, uint8_t *mm) {
   assert(idxsiz <= kb->idxsz);
   kb->idxsz = idxsiz;
   kb->maxoff = coff;
-  if (i == KVBLK_IDXNUM) {
+  if (i == kb->db->idxnum) {
     kb->zidx = -1;
   }
   kb->flags |= KVBLK_DURTY;
@@ -1012,7 +1509,7 @@ static WUR iwrc _kvblk_compact_mm(struct kvblk *kb, uint8_t *mm) {
 
 IW_INLINE off_t _kvblk_maxkvoff(struct kvblk *kb) {
   off_t off = 0;
-  for (int i = 0; i < KVBLK_IDXNUM; ++i) {
+  for (int i = 0; i < kb->db->idxnum; ++i) {
     if (kb->pidx[i].off > off) {
       off = kb->pidx[i].off;
     }
@@ -1020,14 +1517,32 @@ IW_INLINE off_t _kvblk_maxkvoff(struct kvblk *kb) {
   return off;
 }
 
+/** Releases file extent of out of line value of kv pair at `idx`. */
+static WUR iwrc _kvblk_ext_free(struct kvblk *kb, uint8_t idx) {
+  uint8_t *mm, *rp;
+  uint32_t len;
+  IWFS_FSM *fsm = &kb->db->iwkv->fsm;
+  iwrc rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+  RCRET(rc);
+  _kvblk_value_peek(kb, idx, mm, &rp, &len);
+  off_t addr = rp - mm;
+  fsm->release_mmap(fsm);
+  kb->pidx[idx].ext = false;
+  return fsm->deallocate(fsm, addr, _kvblk_ext_asz(len));
+}
+
 static WUR iwrc _kvblk_rmkv(struct kvblk *kb, uint8_t idx, kvblk_rmkv_opts_t opts) {
   iwrc rc = 0;
   uint8_t *mm = 0;
   struct iwdlsnr *dlsnr = kb->db->iwkv->dlsnr;
   IWFS_FSM *fsm = &kb->db->iwkv->fsm;
+  if (kb->pidx[idx].ext) {
+    rc = _kvblk_ext_free(kb, idx);
+    RCRET(rc);
+  }
   if (kb->pidx[idx].off >= kb->maxoff) {
     kb->maxoff = 0;
-    for (int i = 0; i < KVBLK_IDXNUM; ++i) {
+    for (int i = 0; i < kb->db->idxnum; ++i) {
       if ((i != idx) && (kb->pidx[i].off > kb->maxoff)) {
         kb->maxoff = kb->pidx[i].off;
       }
@@ -1089,7 +1604,7 @@ static WUR iwrc _kvblk_addkv(
   const struct iwkv_val *key,
   const struct iwkv_val *val,
   uint8_t               *oidx,
-  bool                   raw_key) {
+  kvblk_addkv_opts_t     opts) {
   *oidx = 0;
 
   iwrc rc = 0;
@@ -1100,11 +1615,16 @@ static WUR iwrc _kvblk_addkv(
   size_t i, sp;
   struct kvp *kvp;
   struct iwdb *db = kb->db;
-  bool compound = !raw_key && (db->dbflg & IWDB_COMPOUND_KEYS);
+  bool compound = !(opts & ADDKV_RAW) && (db->dbflg & IWDB_COMPOUND_KEYS);
+  bool ext = (opts & ADDKV_EXT);
   IWFS_FSM *fsm = &db->iwkv->fsm;
   bool compacted = false;
   struct iwdlsnr *dlsnr = kb->db->iwkv->dlsnr;
   struct iwkv_val *uval = (struct iwkv_val*) val;
+  struct iwkv_val rval; // Out of line value reference
+  uint8_t eref[KVP_EXT_REF_SZ_V5];
+  off_t eaddr = 0, elen = 0;
+  uint32_t plen = 0; // Length of key prefix shared with restart key
 
   size_t ksize = key->size;
   if (compound) {
@@ -1115,17 +1635,56 @@ static WUR iwrc _kvblk_addkv(
   if (kb->zidx < 0) {
     return _IWKV_RC_KVBLOCK_FULL;
   }
-  psz += uval->size;
-  if (psz > IWKV_MAX_KVSZ) {
+  if (psz + uval->size > IWKV_MAX_KVSZ) {
     return IWKV_ERROR_MAXKVSZ;
   }
+  if (_kvblk_has_rk(db)) {
+    if (kb->maxoff == 0) { // Block is empty, take restart key from the first key added
+      uint8_t rkl = (uint8_t) MIN(key->size, KVBLK_MAX_RK_LEN);
+      kb->idxsz = kb->idxsz - kb->rkl + rkl;
+      kb->rkl = rkl;
+      memcpy(kb->rk, key->data, rkl);
+      kb->flags |= KVBLK_DURTY;
+    }
+    if (kb->rkl) {
+      const uint8_t *kp = key->data;
+      while (plen < kb->rkl && plen < key->size && kp[plen] == kb->rk[plen]) {
+        ++plen;
+      }
+      psz = IW_VNUMSIZE32(ksize - plen) + IW_VNUMSIZE32(plen) + ksize - plen;
+    }
+  }
+  if (!(opts & ADDKV_RAW) && _kvblk_is_ext_value(db, uval->size)) {
+    // Store value in its own extent, kv pair holds `[blkn:u4,len:u4]` reference
+    uint32_t lv;
+    size_t bsz = BLKN_SZ(db->iwkv->fmt_version);
+    rc = fsm->allocate(fsm, _kvblk_ext_asz(uval->size), &eaddr, &elen, IWKV_FSM_ALLOC_FLAGS);
+    RCRET(rc);
+    rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+    RCGO(rc, finish);
+    memcpy(mm + eaddr, uval->data, uval->size);
+    if (dlsnr) {
+      rc = dlsnr->onwrite(dlsnr, eaddr, uval->data, uval->size, 0);
+    }
+    fsm->release_mmap(fsm);
+    RCGO(rc, finish);
+    _blkn_write(eref, bsz, ADDR2BLK(eaddr));
+    lv = IW_HTOIL((uint32_t) uval->size);
+    memcpy(eref + bsz, &lv, 4);
+    rval.data = eref;
+    rval.size = bsz + 4;
+    rval.compound = 0;
+    uval = &rval;
+    ext = true;
+  }
+  psz += uval->size;
 
 start:
   // [szpow:u1,idxsz:u2,[ps0:vn,pl0:vn,..., ps32,pl32]____[[KV],...]] // struct kvblk
   msz = (1ULL << kb->szpow) - (KVBLK_HDRSZ + kb->idxsz + kb->maxoff);
   assert(msz >= 0);
   noff = kb->maxoff + psz;
-  rsz = psz + IW_VNUMSIZE(noff) + IW_VNUMSIZE(psz);
+  rsz = psz + IW_VNUMSIZE(noff) + IW_VNUMSIZE32(ext ? (psz | KVP_EXT_BIT) : psz);
 
   if (msz < rsz) { // not enough space
     if (!compacted) {
@@ -1176,15 +1735,17 @@ start:
   kvp->len = (uint32_t) psz;
   kvp->off = noff;
   kvp->ridx = (uint8_t) kb->zidx;
+  kvp->ext = ext;
+  elen = 0; // Value extent is owned by kv pair now
   kb->maxoff = noff;
   kb->flags |= KVBLK_DURTY;
-  for (i = 0; i < KVBLK_IDXNUM; ++i) {
+  for (i = 0; i < kb->db->idxnum; ++i) {
     if (!kb->pidx[i].len && (i != kb->zidx)) {
       kb->zidx = i;
       break;
     }
   }
-  if (i >= KVBLK_IDXNUM) {
+  if (i >= kb->db->idxnum) {
     kb->zidx = -1;
   }
   rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
@@ -1193,15 +1754,19 @@ start:
   assert(kvp->off < (1ULL << kb->szpow) && kvp->len <= kvp->off);
   wp = mm + kb->addr + (1ULL << kb->szpow) - kvp->off;
   sptr = wp;
-  // [klen:vn,key,value]
-  IW_SETVNUMBUF(sp, wp, ksize);
+  // [klen:vn,key,value] or [klen:vn,plen:vn,key,value] if block has restart key
+  IW_SETVNUMBUF(sp, wp, ksize - plen);
   wp += sp;
+  if (kb->rkl) {
+    IW_SETVNUMBUF(sp, wp, plen);
+    wp += sp;
+  }
   if (compound) {
     IW_SETVNUMBUF64(sp, wp, key->compound);
     wp += sp;
   }
-  memcpy(wp, key->data, key->size);
-  wp += key->size;
+  memcpy(wp, (const uint8_t*) key->data + plen, key->size - plen);
+  wp += key->size - plen;
   if (uval->size) {
     memcpy(wp, uval->data, uval->size);
     wp += uval->size;
@@ -1213,8 +1778,12 @@ start:
     rc = dlsnr->onwrite(dlsnr, kb->addr + (1ULL << kb->szpow) - kvp->off, sptr, wp - sptr, 0);
   }
   fsm->release_mmap(fsm);
+  return rc;
 
 finish:
+  if (elen) {
+    IWRC(fsm->deallocate(fsm, eaddr, elen), rc);
+  }
   return rc;
 }
 
@@ -1223,9 +1792,9 @@ static WUR iwrc _kvblk_updatev(
   uint8_t               *idxp,
   const struct iwkv_val *key,                              /* Nullable */
   const struct iwkv_val *val) {
-  assert(*idxp < KVBLK_IDXNUM);
+  assert(*idxp < kb->db->idxnum);
   int32_t i;
-  uint32_t len, nlen, sz;
+  uint32_t len, plen, nlen, sz;
   uint8_t pidx = *idxp, *mm = 0, *wp, *sp;
   struct iwdb *db = kb->db;
   struct iwdlsnr *dlsnr = kb->db->iwkv->dlsnr;
@@ -1236,6 +1805,7 @@ static WUR iwrc _kvblk_updatev(
   size_t kbsz = 1ULL << kb->szpow;                            // kvblk size
   off_t freesz = kbsz - KVBLK_HDRSZ - kb->idxsz - kb->maxoff; // free space available
   IWFS_FSM *fsm = &db->iwkv->fsm;
+  bool ext = kvp->ext || _kvblk_is_ext_value(db, uval->size); // Out of line value involved
 
   iwrc rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
   RCRET(rc);
@@ -1243,16 +1813,35 @@ static WUR iwrc _kvblk_updatev(
 
   wp = mm + kb->addr + kbsz - kvp->off;
   sp = wp;
-  IW_READVNUMBUF(wp, len, sz);
+  sz = _kvblk_kv_hdr(kb, wp, &len, &plen);
   wp += sz;
-  if (ukey && (len != ukey->size)) {
+  if (ukey && (len + plen != ukey->size)) {
     rc = IWKV_ERROR_CORRUPTED;
     iwlog_ecode_error3(rc);
     goto finish;
   }
   wp += len;
+  if (kvp->ext && _kvblk_is_ext_value(db, uval->size)) {
+    blkn_t blkn;
+    uint32_t elen;
+    size_t bsz = BLKN_SZ(db->iwkv->fmt_version);
+    _kvblk_ext_ref(db->iwkv->fmt_version, wp, &blkn, &elen);
+    off_t easz = _kvblk_ext_asz(elen);
+    off_t nasz = _kvblk_ext_asz(uval->size);
+    if ((nasz <= easz) && (2 * nasz > easz)) { // Rewrite value in its extent
+      uint32_t lv = IW_HTOIL((uint32_t) uval->size);
+      memcpy(mm + BLK2ADDR(blkn), uval->data, uval->size);
+      memcpy(wp + bsz, &lv, 4);
+      if (dlsnr) {
+        rc = dlsnr->onwrite(dlsnr, BLK2ADDR(blkn), uval->data, uval->size, 0);
+        RCGO(rc, finish);
+        rc = dlsnr->onwrite(dlsnr, wp + bsz - mm, &lv, 4, 0);
+      }
+      goto finish;
+    }
+  }
   off_t rsize = sz + len + uval->size; // required size
-  if (rsize <= kvp->len) {
+  if (!ext && (rsize <= kvp->len)) {
     memcpy(wp, uval->data, uval->size);
     if (dlsnr) {
       rc = dlsnr->onwrite(dlsnr, wp - mm, uval->data, uval->size, 0);
@@ -1264,20 +1853,20 @@ static WUR iwrc _kvblk_updatev(
       kb->flags |= KVBLK_DURTY;
     }
   } else {
-    struct kvp tidx[KVBLK_IDXNUM];
-    struct kvp tidx_tmp[KVBLK_IDXNUM];
+    struct kvp tidx[KVBLK_IDXNUM_MAX];
+    struct kvp tidx_tmp[KVBLK_IDXNUM_MAX];
     off_t koff = kb->pidx[pidx].off;
-    memcpy(tidx, kb->pidx, KVBLK_IDXNUM * sizeof(kb->pidx[0]));
-    ks_mergesort_kvblk(KVBLK_IDXNUM, tidx, tidx_tmp, 0);
+    memcpy(tidx, kb->pidx, kb->db->idxnum * sizeof(kb->pidx[0]));
+    ks_mergesort_kvblk(kb->db->idxnum, tidx, tidx_tmp, 0);
     kb->flags |= KVBLK_DURTY;
     if (!ukey) { // we need a key
       ukey = &skey;
       rc = _kvblk_key_get(kb, mm, pidx, ukey);
       RCGO(rc, finish);
     }
-    for (i = 0; i < KVBLK_IDXNUM; ++i) {
+    for (i = 0; i < kb->db->idxnum; ++i) {
       if (tidx[i].off == koff) {
-        if (koff - ((i > 0) ? tidx[i - 1].off : 0) >= rsize) {
+        if (!ext && (koff - ((i > 0) ? tidx[i - 1].off : 0) >= rsize)) {
           nlen = wp + uval->size - sp;
           if (!((nlen > kvp->len) && (freesz - IW_VNUMSIZE32(nlen) + IW_VNUMSIZE32(kvp->len) < 0))) { // enough space?
             memcpy(wp, uval->data, uval->size);
@@ -1295,7 +1884,7 @@ static WUR iwrc _kvblk_updatev(
         fsm->release_mmap(fsm);
         rc = _kvblk_rmkv(kb, pidx, RMKV_NO_RESIZE);
         RCGO(rc, finish);
-        rc = _kvblk_addkv(kb, ukey, uval, idxp, false);
+        rc = _kvblk_addkv(kb, ukey, uval, idxp, 0);
         break;
       }
     }
@@ -1313,6 +1902,87 @@ finish:
 
 //--------------------------  struct sblk
 
+/**
+ * Maximum length of the lower key prefix stored in `SBLK` of the given database.
+ * Since v5 it depends on node level `lvl`, since next node pointers share the block tail with lower key.
+ */
+IW_INLINE uint8_t _sblk_lklen(struct iwdb *db, uint8_t lvl) {
+  int32_t fmt = db->iwkv->fmt_version;
+  return fmt > 4 ? PREFIX_KEY_LEN_V5(lvl) : fmt > 2 ? PREFIX_KEY_LEN_V3 : PREFIX_KEY_LEN_V2;
+}
+
+/**
+ * Returns true if `SBLK` key fingerprints can be used to lookup keys in the given database.
+ * Real number keys are excluded since equal numbers may have different textual forms.
+ * Wide nodes have no room for fingerprints.
+ */
+IW_INLINE bool _sblk_has_fp(struct iwdb *db) {
+  return db->iwkv->fmt_version > 2 && !(db->dbflg & (IWDB_REALNUM_KEYS | IWDB_WIDE_NODES));
+}
+
+IW_INLINE uint32_t _sblk_fp_hash(uint32_t h, const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    h = (h << 5) - h + data[i];
+  }
+  return h;
+}
+
+/**
+ * One byte fingerprint of a key in its stored form.
+ * @param raw_key If true `key` is already in stored form with compound prefix included.
+ */
+static uint8_t _sblk_key_fp(iwdb_flags_t dbflg, const struct iwkv_val *key, bool raw_key) {
+  uint32_t h = 0;
+  if (!raw_key && (dbflg & IWDB_COMPOUND_KEYS)) {
+    int len;
+    uint8_t buf[IW_VNUMBUFSZ];
+    IW_SETVNUMBUF64(len, buf, key->compound);
+    h = _sblk_fp_hash(h, buf, len);
+  }
+  h = _sblk_fp_hash(h, key->data, key->size);
+  h ^= h >> 16;
+  h ^= h >> 8;
+  return (uint8_t) h;
+}
+
+#ifdef IWKV_X86_SIMD
+
+__attribute__((target("avx2")))
+static uint32_t _sblk_fp_match_avx2(const uint8_t fp[KVBLK_IDXNUM], uint8_t v) {
+  __m256i a = _mm256_loadu_si256((const __m256i*) fp);
+  return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, _mm256_set1_epi8((char) v)));
+}
+
+__attribute__((target("sse2")))
+static uint32_t _sblk_fp_match_sse2(const uint8_t fp[KVBLK_IDXNUM], uint8_t v) {
+  __m128i b = _mm_set1_epi8((char) v);
+  __m128i a1 = _mm_loadu_si128((const __m128i*) fp);
+  __m128i a2 = _mm_loadu_si128((const __m128i*) (fp + 16));
+  return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(a1, b))
+         | ((uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(a2, b)) << 16);
+}
+
+#endif
+
+/** Returns bitmask of kv slots having fingerprint `v`. */
+static uint32_t _sblk_fp_match(const uint8_t fp[KVBLK_IDXNUM], uint8_t v) {
+  static_assert(KVBLK_IDXNUM == 32, "KVBLK_IDXNUM == 32");
+#ifdef IWKV_X86_SIMD
+  if (iwcpuflags & IWCPU_AVX2) {
+    return _sblk_fp_match_avx2(fp, v);
+  } else if (iwcpuflags & IWCPU_SSE2) {
+    return _sblk_fp_match_sse2(fp, v);
+  }
+#endif
+  uint32_t mask = 0;
+  for (int i = 0; i < KVBLK_IDXNUM; ++i) {
+    if (fp[i] == v) {
+      mask |= (1U << i);
+    }
+  }
+  return mask;
+}
+
 IW_INLINE void _sblk_release(struct iwlctx *lx, struct sblk **sblkp) {
   assert(sblkp && *sblkp);
   struct sblk *sblk = *sblkp;
@@ -1329,6 +1999,20 @@ IW_INLINE WUR iwrc _sblk_loadkvblk_mm(struct iwlctx *lx, struct sblk *sblk, uint
   }
 }
 
+/** Returns true if record at `idx` position of `sblk` node has expired at `now` time. */
+IW_INLINE bool _sblk_expired_at_mm(const struct sblk *sblk, uint8_t idx, const uint8_t *mm, uint64_t now) {
+  uint64_t expire = _kvblk_value_expire(sblk->kvblk, sblk->pi[idx], mm);
+  return expire && expire <= now;
+}
+
+/** Returns true if record at `idx` position of `sblk` node has expired. */
+IW_INLINE bool _sblk_is_expired_mm(const struct sblk *sblk, uint8_t idx, const uint8_t *mm) {
+  if (!(sblk->db->dbflg & IWDB_EXPIRING_VALUES)) {
+    return false;
+  }
+  return _sblk_expired_at_mm(sblk, idx, mm, _expire_now());
+}
+
 static bool _sblk_is_only_one_on_page_v2(struct iwlctx *lx, uint8_t *mm, struct sblk *sblk, off_t *page_addr) {
   *page_addr = 0;
   if ((sblk->bpos > 0) && (sblk->bpos <= SBLK_PAGE_SBLK_NUM_V2)) {
@@ -1337,7 +2021,7 @@ static bool _sblk_is_only_one_on_page_v2(struct iwlctx *lx, uint8_t *mm, struct
     for (int i = 0; i < SBLK_PAGE_SBLK_NUM_V2; ++i) {
       if (i != sblk->bpos - 1) {
         uint8_t bv;
-        memcpy(&bv, mm + addr + i * SBLK_SZ + SOFF_BPOS_U1_V2, 1);
+        memcpy(&bv, mm + addr + i * SBLK_SZ + SOFF_BPOS_U1(lx->db), 1);
         if (bv) {
           return false;
         }
@@ -1354,6 +2038,7 @@ IW_INLINE WUR iwrc _sblk_destroy(struct iwlctx *lx, struct sblk **sblkp) {
   iwrc rc = 0;
   struct sblk *sblk = *sblkp;
   lx->destroy_addr = sblk->addr;
+  _sbc_invalidate(lx->db, sblk->addr);
 
   if (!(sblk->flags & SBLK_DB)) {
     uint8_t kvb_szpow, *mm;
@@ -1382,10 +2067,10 @@ IW_INLINE WUR iwrc _sblk_destroy(struct iwlctx *lx, struct sblk **sblkp) {
         // Deallocate whole page
         rc = fsm->deallocate(fsm, paddr, SBLK_PAGE_SZ_V2);
       } else {
-        memset(mm + sblk->addr + SOFF_BPOS_U1_V2, 0, 1);
+        memset(mm + sblk->addr + SOFF_BPOS_U1(lx->db), 0, 1);
         fsm->release_mmap(fsm);
         if (dlsnr) {
-          dlsnr->onset(dlsnr, sblk->addr + SOFF_BPOS_U1_V2, 0, 1, 0);
+          dlsnr->onset(dlsnr, sblk->addr + SOFF_BPOS_U1(lx->db), 0, 1, 0);
         }
       }
     }
@@ -1477,7 +2162,7 @@ static void _sblk_find_free_page_slot_v2(
   off_t paddr = sblk->addr - (sblk->bpos - 1) * SBLK_SZ;
   for (int i = sblk->bpos + 1; i <= SBLK_PAGE_SBLK_NUM_V2; ++i) {
     uint8_t slot;
-    memcpy(&slot, mm + paddr + (i - 1) * SBLK_SZ + SOFF_BPOS_U1_V2, 1);
+    memcpy(&slot, mm + paddr + (i - 1) * SBLK_SZ + SOFF_BPOS_U1(lx->db), 1);
     if (!slot) {
       *obaddr = paddr + (i - 1) * SBLK_SZ;
       *oslot = i;
@@ -1486,7 +2171,7 @@ static void _sblk_find_free_page_slot_v2(
   }
   for (int i = sblk->bpos - 1; i > 0; --i) {
     uint8_t slot;
-    memcpy(&slot, mm + paddr + (i - 1) * SBLK_SZ + SOFF_BPOS_U1_V2, 1);
+    memcpy(&slot, mm + paddr + (i - 1) * SBLK_SZ + SOFF_BPOS_U1(lx->db), 1);
     if (!slot) {
       *obaddr = paddr + (i - 1) * SBLK_SZ;
       *oslot = i;
@@ -1566,13 +2251,115 @@ IW_INLINE WUR iwrc _sblk_create(
   return _sblk_create_v2(lx, nlevel, kvbpow, lower, upper, oblk);
 }
 
+//--------------------------  SBLK cache
+
+IW_INLINE uint32_t _sbc_slot_idx(off_t addr) {
+  return (uint32_t) (addr / SBLK_SZ) & (SBLK_CACHE_SIZE - 1);
+}
+
+static void _sbc_destroy(struct iwdb *db) {
+  struct sblk_cache *sbc = atomic_load(&db->sbc);
+  if (sbc) {
+    for (int i = 0; i < SBLK_CACHE_LOCKS; ++i) {
+      pthread_spin_destroy(&sbc->stripes[i].slk);
+    }
+    free(sbc);
+    atomic_store(&db->sbc, 0);
+  }
+}
+
+static struct sblk_cache* _sbc_ensure(struct iwdb *db) {
+  struct sblk_cache *sbc = atomic_load_explicit(&db->sbc, memory_order_acquire);
+  if (sbc) {
+    return sbc;
+  }
+  sbc = calloc(1, sizeof(*sbc));
+  if (!sbc) {
+    return 0;
+  }
+  for (int i = 0; i < SBLK_CACHE_LOCKS; ++i) {
+    pthread_spin_init(&sbc->stripes[i].slk, 0);
+  }
+  struct sblk_cache *expected = 0;
+  if (!atomic_compare_exchange_strong(&db->sbc, &expected, sbc)) {
+    // Cache has been set by concurrent reader
+    for (int i = 0; i < SBLK_CACHE_LOCKS; ++i) {
+      pthread_spin_destroy(&sbc->stripes[i].slk);
+    }
+    free(sbc);
+    sbc = expected;
+  }
+  return sbc;
+}
+
+/**
+ * Copies decoded block at `addr` from cache into `sblk`.
+ * Returns false on cache miss.
+ */
+static bool _sbc_get(struct iwdb *db, off_t addr, struct sblk *sblk) {
+  bool found = false;
+  struct sblk_cache *sbc = atomic_load_explicit(&db->sbc, memory_order_acquire);
+  if (sbc) {
+    uint32_t idx = _sbc_slot_idx(addr);
+    struct sblk_cslot *slot = &sbc->slots[idx];
+    struct sblk_cstripe *stripe = &sbc->stripes[idx & (SBLK_CACHE_LOCKS - 1)];
+    pthread_spin_lock(&stripe->slk);
+    if (slot->addr == addr) {
+      memcpy(sblk, &slot->sblk, sizeof(*sblk));
+      found = true;
+      ++stripe->hits;
+    } else {
+      ++stripe->misses;
+    }
+    pthread_spin_unlock(&stripe->slk);
+  }
+  return found;
+}
+
+/** Stores decoded block with persistent flags only into cache. */
+static void _sbc_put(struct iwdb *db, const struct sblk *sblk) {
+  struct sblk_cache *sbc = _sbc_ensure(db);
+  if (!sbc) {
+    return;
+  }
+  uint32_t idx = _sbc_slot_idx(sblk->addr);
+  struct sblk_cslot *slot = &sbc->slots[idx];
+  pthread_spinlock_t *slk = &sbc->stripes[idx & (SBLK_CACHE_LOCKS - 1)].slk;
+  pthread_spin_lock(slk);
+  memcpy(&slot->sblk, sblk, sizeof(*sblk));
+  slot->sblk.kvblk = 0;
+  slot->sblk.flags &= SBLK_PERSISTENT_FLAGS;
+  slot->addr = sblk->addr;
+  pthread_spin_unlock(slk);
+}
+
+/** Drops block at `addr` from cache. Must be called on every `SBLK` modification. */
+static void _sbc_invalidate(struct iwdb *db, off_t addr) {
+  struct sblk_cache *sbc = atomic_load_explicit(&db->sbc, memory_order_acquire);
+  if (sbc) {
+    uint32_t idx = _sbc_slot_idx(addr);
+    struct sblk_cslot *slot = &sbc->slots[idx];
+    pthread_spinlock_t *slk = &sbc->stripes[idx & (SBLK_CACHE_LOCKS - 1)].slk;
+    pthread_spin_lock(slk);
+    if (slot->addr == addr) {
+      slot->addr = 0;
+    }
+    pthread_spin_unlock(slk);
+  }
+}
+
 static WUR iwrc _sblk_at2(struct iwlctx *lx, off_t addr, sblk_flags_t flgs, struct sblk *sblk) {
   iwrc rc;
   uint8_t *mm;
-  uint32_t lv;
   sblk_flags_t flags = lx->sbflags | flgs;
   struct iwdb *db = lx->db;
   IWFS_FSM *fsm = &db->iwkv->fsm;
+
+  if (addr && (addr != db->addr) && _sbc_get(db, addr, sblk)) {
+    sblk->flags |= flags;
+    sblk->db = db;
+    return 0;
+  }
   sblk->kvblk = 0;
   sblk->bpos = 0;
   sblk->db = db;
@@ -1581,7 +2368,8 @@ static WUR iwrc _sblk_at2(struct iwlctx *lx, off_t addr, sblk_flags_t flgs, stru
   RCRET(rc);
 
   if (IW_UNLIKELY(addr == db->addr)) {
-    uint8_t *rp = mm + addr + DOFF_N0_U4;
+    size_t bsz = BLKN_SZ(db->iwkv->fmt_version);
+    uint8_t *rp = mm + addr + DOFF_N(db->iwkv->fmt_version, 0);
     // [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u4,p0:u4,n[24]:u4,c[24]:u4,meta_blk:u4,meta_blkn:u4]:217
     sblk->addr = addr;
     sblk->flags = SBLK_DB | flags;
@@ -1589,10 +2377,10 @@ static WUR iwrc _sblk_at2(struct iwlctx *lx, off_t addr, sblk_flags_t flgs, stru
     sblk->p0 = 0;
     sblk->kvblkn = 0;
     sblk->lkl = 0;
-    sblk->pnum = KVBLK_IDXNUM;
+    sblk->pnum = db->idxnum;
     memset(sblk->pi, 0, sizeof(sblk->pi));
-    for (int i = 0; i < SLEVELS; ++i) {
-      IW_READLV(rp, lv, sblk->n[i]);
+    for (int i = 0; i < SLEVELS; ++i, rp += bsz) {
+      sblk->n[i] = _blkn_read(rp, bsz);
       if (sblk->n[i]) {
         ++sblk->lvl;
       } else {
@@ -1622,7 +2410,7 @@ static WUR iwrc _sblk_at2(struct iwlctx *lx, off_t addr, sblk_flags_t flgs, stru
       goto finish;
     }
     memcpy(&sblk->lkl, rp++, 1);
-    if (sblk->lkl > PREFIX_KEY_LEN_V2) {
+    if (sblk->lkl > _sblk_lklen(db, sblk->lvl)) {
       rc = IWKV_ERROR_CORRUPTED;
       iwlog_ecode_error3(rc);
       goto finish;
@@ -1633,39 +2421,37 @@ static WUR iwrc _sblk_at2(struct iwlctx *lx, off_t addr, sblk_flags_t flgs, stru
       iwlog_ecode_error3(rc);
       goto finish;
     }
-    memcpy(&sblk->p0, rp, 4);
-    sblk->p0 = IW_ITOHL(sblk->p0);
-    rp += 4;
-    memcpy(&sblk->kvblkn, rp, 4);
-    sblk->kvblkn = IW_ITOHL(sblk->kvblkn);
-    rp += 4;
-    memcpy(sblk->pi, rp, KVBLK_IDXNUM);
-    rp += KVBLK_IDXNUM;
-
-#ifdef IW_BIGENDIAN
+    int32_t fmt = db->iwkv->fmt_version;
+    size_t bsz = BLKN_SZ(fmt);
+    sblk->p0 = _blkn_read(rp, bsz);
+    rp += bsz;
+    sblk->kvblkn = _blkn_read(rp, bsz);
+    rp += bsz;
+    memcpy(sblk->pi, rp, db->idxnum);
     for (int i = 0; i <= sblk->lvl; ++i) {
-      memcpy(&sblk->n[i], rp, 4);
-      sblk->n[i] = IW_ITOHL(sblk->n[i]);
-      rp += 4;
+      sblk->n[i] = _blkn_read(mm + addr + SOFF_N(fmt, i), bsz);
     }
-#else
-    memcpy(sblk->n, rp, 4UL * (sblk->lvl + 1));
-    rp += 4UL * (sblk->lvl + 1);
-#endif
-    rp = mm + addr + SOFF_BPOS_U1_V2;
+    rp = mm + addr + SOFF_BPOS_U1(db);
     memcpy(&sblk->bpos, rp++, 1);
+    if ((fmt > 2) && (db->idxnum == KVBLK_IDXNUM)) {
+      memcpy(sblk->fp, rp, KVBLK_IDXNUM);
+      rp += KVBLK_IDXNUM;
+    }
     // Lower key
     memcpy(sblk->lk, rp, (size_t) sblk->lkl);
+    if (sblk->lvl) {
+      _sbc_put(db, sblk);
+    }
   } else { // Database tail
-    uint8_t *rp = mm + db->addr + DOFF_P0_U4;
+    uint8_t *rp = mm + db->addr + DOFF_P0(db->iwkv->fmt_version);
     sblk->addr = 0;
     sblk->flags = SBLK_DB | flags;
     sblk->lvl = 0;
     sblk->kvblkn = 0;
     sblk->lkl = 0;
-    sblk->pnum = KVBLK_IDXNUM;
+    sblk->pnum = db->idxnum;
     memset(sblk->pi, 0, sizeof(sblk->pi));
-    IW_READLV(rp, lv, sblk->p0);
+    sblk->p0 = _blkn_read(rp, BLKN_SZ(db->iwkv->fmt_version));
     if (!sblk->p0) {
       sblk->p0 = ADDR2BLK(db->addr);
     }
@@ -1690,26 +2476,29 @@ static WUR iwrc _sblk_sync_mm(struct iwlctx *lx, struct sblk *sblk, uint8_t *mm)
   if (sblk->flags & SBLK_DURTY) {
     uint32_t lv;
     struct iwdlsnr *dlsnr = lx->db->iwkv->dlsnr;
+    int32_t fmt = lx->db->iwkv->fmt_version;
+    size_t bsz = BLKN_SZ(fmt);
     sblk->flags &= ~SBLK_DURTY;
     if (IW_UNLIKELY(sblk->flags & SBLK_DB)) {
       uint8_t *sp;
       uint8_t *wp = mm + sblk->db->addr;
       if (sblk->addr) {
         assert(sblk->addr == sblk->db->addr);
-        wp += DOFF_N0_U4;
+        wp += DOFF_N(fmt, 0);
         sp = wp;
         // [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u4,p0:u4,n[24]:u4,c[24]:u4,meta_blk:u4,meta_blkn:u4]:217
-        for (int i = 0; i < SLEVELS; ++i) {
-          IW_WRITELV(wp, lv, sblk->n[i]);
+        for (int i = 0; i < SLEVELS; ++i, wp += bsz) {
+          _blkn_write(wp, bsz, sblk->n[i]);
         }
         assert(wp - (mm + sblk->db->addr) <= SBLK_SZ);
         for (int i = 0; i < SLEVELS; ++i) {
           IW_WRITELV(wp, lv, lx->db->lcnt[i]);
         }
       } else { // Database tail
-        wp += DOFF_P0_U4;
+        wp += DOFF_P0(fmt);
         sp = wp;
-        IW_WRITELV(wp, lv, sblk->p0);
+        _blkn_write(wp, bsz, sblk->p0);
+        wp += bsz;
         assert(wp - (mm + sblk->db->addr) <= SBLK_SZ);
       }
       if (dlsnr) {
@@ -1719,29 +2508,29 @@ static WUR iwrc _sblk_sync_mm(struct iwlctx *lx, struct sblk *sblk, uint8_t *mm)
     } else {
       uint8_t *wp = mm + sblk->addr;
       sblk_flags_t flags = (sblk->flags & SBLK_PERSISTENT_FLAGS);
+      _sbc_invalidate(sblk->db, sblk->addr);
       uint8_t uflags = flags;
-      assert(sblk->lkl <= PREFIX_KEY_LEN_V2);
+      assert(sblk->lkl <= _sblk_lklen(sblk->db, sblk->lvl));
       // [u1:flags,lvl:u1,lkl:u1,pnum:u1,p0:u4,kblk:u4,[pi0:u1,... pi32],n0-n23:u4,lk:u116]:u256
       wp += SOFF_FLAGS_U1;
       memcpy(wp++, &uflags, 1);
       memcpy(wp++, &sblk->lvl, 1);
       memcpy(wp++, &sblk->lkl, 1);
       memcpy(wp++, &sblk->pnum, 1);
-      IW_WRITELV(wp, lv, sblk->p0);
-      IW_WRITELV(wp, lv, sblk->kvblkn);
-      memcpy(wp, sblk->pi, KVBLK_IDXNUM);
-      wp = mm + sblk->addr + SOFF_N0_U4;
-
-#ifdef IW_BIGENDIAN
+      _blkn_write(wp, bsz, sblk->p0);
+      wp += bsz;
+      _blkn_write(wp, bsz, sblk->kvblkn);
+      wp += bsz;
+      memcpy(wp, sblk->pi, sblk->db->idxnum);
       for (int i = 0; i <= sblk->lvl; ++i) {
-        IW_WRITELV(wp, lv, sblk->n[i]);
+        _blkn_write(mm + sblk->addr + SOFF_N(fmt, i), bsz, sblk->n[i]);
       }
-#else
-      memcpy(wp, sblk->n, 4UL * (sblk->lvl + 1));
-      wp += 4UL * (sblk->lvl + 1);
-#endif
-      wp = mm + sblk->addr + SOFF_BPOS_U1_V2;
+      wp = mm + sblk->addr + SOFF_BPOS_U1(sblk->db);
       memcpy(wp++, &sblk->bpos, 1);
+      if ((fmt > 2) && (sblk->db->idxnum == KVBLK_IDXNUM)) {
+        memcpy(wp, sblk->fp, KVBLK_IDXNUM);
+        wp += KVBLK_IDXNUM;
+      }
       memcpy(wp, sblk->lk, (size_t) sblk->lkl);
       if (dlsnr) {
         rc = dlsnr->onwrite(dlsnr, sblk->addr, mm + sblk->addr, SOFF_END, 0);
@@ -1784,13 +2573,10 @@ IW_INLINE WUR iwrc _sblk_sync_and_release_mm(struct iwlctx *lx, struct sblk **sb
 static WUR iwrc _sblk_find_pi_mm(struct sblk *sblk, struct iwlctx *lx, const uint8_t *mm, bool *found, uint8_t *idxp) {
   *found = false;
   if (sblk->flags & SBLK_DB) {
-    *idxp = KVBLK_IDXNUM;
+    *idxp = lx->db->idxnum;
     return 0;
   }
-  uint8_t *k;
-  uint32_t kl;
   int idx = 0, lb = 0, ub = sblk->pnum - 1;
-  iwdb_flags_t dbflg = lx->db->dbflg;
 
   if (sblk->pnum < 1) {
     *idxp = 0;
@@ -1798,9 +2584,9 @@ static WUR iwrc _sblk_find_pi_mm(struct sblk *sblk, struct iwlctx *lx, const uin
   }
   while (1) {
     idx = (ub + lb) / 2;
-    iwrc rc = _kvblk_key_peek(sblk->kvblk, sblk->pi[idx], mm, &k, &kl);
+    int cr;
+    iwrc rc = _kvblk_key_cmp(sblk->kvblk, sblk->pi[idx], mm, lx->key, &cr);
     RCRET(rc);
-    int cr = _cmp_keys(dbflg, k, kl, lx->key);
     if (!cr) {
       *found = true;
       break;
@@ -1821,13 +2607,47 @@ static WUR iwrc _sblk_find_pi_mm(struct sblk *sblk, struct iwlctx *lx, const uin
   return 0;
 }
 
+/**
+ * Exact key lookup within `SBLK` using key fingerprints.
+ * Only kv slots with matching fingerprint are compared with the key,
+ * `*idxp` is meaningful only if key is found.
+ */
+static WUR iwrc _sblk_find_pi_fp_mm(
+  struct sblk *sblk, struct iwlctx *lx, const uint8_t *mm,
+  bool *found, uint8_t *idxp) {
+  if ((sblk->flags & SBLK_DB) || !_sblk_has_fp(lx->db)) {
+    return _sblk_find_pi_mm(sblk, lx, mm, found, idxp);
+  }
+  uint32_t active = 0;
+  uint8_t pos[KVBLK_IDXNUM];
+
+  *found = false;
+  *idxp = 0;
+  for (int i = 0; i < sblk->pnum; ++i) {
+    active |= (1U << sblk->pi[i]);
+    pos[sblk->pi[i]] = i;
+  }
+  uint32_t mask = _sblk_fp_match(sblk->fp, _sblk_key_fp(lx->db->dbflg, lx->key, false)) & active;
+  while (mask) {
+    uint8_t kvidx = iwbits_find_first_sbit64(mask);
+    mask &= ~(1U << kvidx);
+    int cr;
+    iwrc rc = _kvblk_key_cmp(sblk->kvblk, kvidx, mm, lx->key, &cr);
+    RCRET(rc);
+    if (!cr) {
+      *found = true;
+      *idxp = pos[kvidx];
+      break;
+    }
+  }
+  return 0;
+}
+
 static WUR iwrc _sblk_insert_pi_mm(
   struct sblk *sblk, uint8_t nidx, struct iwlctx *lx,
   const uint8_t *mm, uint8_t *idxp) {
   assert(sblk->kvblk);
 
-  uint8_t *k;
-  uint32_t kl;
   int idx = 0, lb = 0, ub = sblk->pnum - 1, nels = sblk->pnum; // NOLINT
 
   if (nels < 1) {
@@ -1836,12 +2656,11 @@ static WUR iwrc _sblk_insert_pi_mm(
     *idxp = 0;
     return 0;
   }
-  iwdb_flags_t dbflg = sblk->db->dbflg;
   while (1) {
     idx = (ub + lb) / 2;
-    iwrc rc = _kvblk_key_peek(sblk->kvblk, sblk->pi[idx], mm, &k, &kl);
+    int cr;
+    iwrc rc = _kvblk_key_cmp(sblk->kvblk, sblk->pi[idx], mm, lx->key, &cr);
     RCRET(rc);
-    int cr = _cmp_keys(dbflg, k, kl, lx->key);
     if (!cr) {
       break;
     } else if (cr < 0) {
@@ -1872,18 +2691,22 @@ static WUR iwrc _sblk_addkv2(
   int8_t                 idx,
   const struct iwkv_val *key,
   const struct iwkv_val *val,
-  bool                   raw_key) {
+  kvblk_addkv_opts_t     opts) {
   assert(sblk && key && key->size && key->data && val && idx >= 0 && sblk->kvblk);
 
   uint8_t kvidx;
+  bool raw_key = (opts & ADDKV_RAW);
   struct iwdb *db = sblk->db;
   struct kvblk *kvblk = sblk->kvblk;
-  if (sblk->pnum >= KVBLK_IDXNUM) {
+  if (sblk->pnum >= db->idxnum) {
     return _IWKV_RC_KVBLOCK_FULL;
   }
 
-  iwrc rc = _kvblk_addkv(kvblk, key, val, &kvidx, raw_key);
+  iwrc rc = _kvblk_addkv(kvblk, key, val, &kvidx, opts);
   RCRET(rc);
+  if (_sblk_has_fp(db)) {
+    sblk->fp[kvidx] = _sblk_key_fp(db->dbflg, key, raw_key);
+  }
   if (sblk->pnum - idx > 0) {
     memmove(sblk->pi + idx + 1, sblk->pi + idx, sblk->pnum - idx);
   }
@@ -1899,7 +2722,7 @@ static WUR iwrc _sblk_addkv2(
     if (compound) {
       ksize += IW_VNUMSIZE(key->compound);
     }
-    sblk->lkl = MIN(PREFIX_KEY_LEN_V2, ksize);
+    sblk->lkl = MIN(_sblk_lklen(db, sblk->lvl), ksize);
     uint8_t *wp = sblk->lk;
     if (compound) {
       int len;
@@ -1907,7 +2730,7 @@ static WUR iwrc _sblk_addkv2(
       wp += len;
     }
     memcpy(wp, key->data, sblk->lkl - (ksize - key->size));
-    if (ksize <= PREFIX_KEY_LEN_V2) {
+    if (ksize <= _sblk_lklen(db, sblk->lvl)) {
       sblk->flags |= SBLK_FULL_LKEY;
     } else {
       sblk->flags &= ~SBLK_FULL_LKEY;
@@ -1945,11 +2768,14 @@ static WUR iwrc _sblk_addkv(struct sblk *sblk, struct iwlctx *lx) {
   struct iwdb *db = sblk->db;
   struct kvblk *kvblk = sblk->kvblk;
   IWFS_FSM *fsm = &sblk->db->iwkv->fsm;
-  if (sblk->pnum >= KVBLK_IDXNUM) {
+  if (sblk->pnum >= db->idxnum) {
     return _IWKV_RC_KVBLOCK_FULL;
   }
-  iwrc rc = _kvblk_addkv(kvblk, key, val, &kvidx, false);
+  iwrc rc = _kvblk_addkv(kvblk, key, val, &kvidx, 0);
   RCRET(rc);
+  if (_sblk_has_fp(db)) {
+    sblk->fp[kvidx] = _sblk_key_fp(db->dbflg, key, false);
+  }
   rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
   RCRET(rc);
   rc = _sblk_insert_pi_mm(sblk, kvidx, lx, mm, &idx);
@@ -1961,7 +2787,7 @@ static WUR iwrc _sblk_addkv(struct sblk *sblk, struct iwlctx *lx) {
     if (compound) {
       ksize += IW_VNUMSIZE(key->compound);
     }
-    sblk->lkl = MIN(PREFIX_KEY_LEN_V2, ksize);
+    sblk->lkl = MIN(_sblk_lklen(db, sblk->lvl), ksize);
     uint8_t *wp = sblk->lk;
     if (compound) {
       int len;
@@ -1969,7 +2795,7 @@ static WUR iwrc _sblk_addkv(struct sblk *sblk, struct iwlctx *lx) {
       wp += len;
     }
     memcpy(wp, key->data, sblk->lkl - (ksize - key->size));
-    if (ksize <= PREFIX_KEY_LEN_V2) {
+    if (ksize <= _sblk_lklen(db, sblk->lvl)) {
       sblk->flags |= SBLK_FULL_LKEY;
     } else {
       sblk->flags &= ~SBLK_FULL_LKEY;
@@ -2016,6 +2842,9 @@ static WUR iwrc _sblk_updatekv(
   if (sblk->kvblkn != ADDR2BLK(kvblk->addr)) {
     sblk->kvblkn = ADDR2BLK(kvblk->addr);
   }
+  if (_sblk_has_fp(db)) {
+    sblk->fp[kvidx] = sblk->fp[sblk->pi[idx]];
+  }
   sblk->pi[idx] = kvidx;
   sblk->flags |= SBLK_DURTY;
   // Update active cursors inside this block
@@ -2036,7 +2865,7 @@ static WUR iwrc _sblk_rmkv(struct sblk *sblk, uint8_t idx) {
   struct iwdb *db = sblk->db;
   struct kvblk *kvblk = sblk->kvblk;
   IWFS_FSM *fsm = &sblk->db->iwkv->fsm;
-  assert(kvblk && idx < sblk->pnum && sblk->pi[idx] < KVBLK_IDXNUM);
+  assert(kvblk && idx < sblk->pnum && sblk->pi[idx] < db->idxnum);
 
   iwrc rc = _kvblk_rmkv(kvblk, sblk->pi[idx], 0);
   RCRET(rc);
@@ -2054,19 +2883,18 @@ static WUR iwrc _sblk_rmkv(struct sblk *sblk, uint8_t idx) {
   if (idx == 0) { // Lowest key removed
     // Replace the lowest key with the next one or reset
     if (sblk->pnum > 0) {
-      uint8_t *mm, *kbuf;
+      uint8_t *mm;
       uint32_t klen;
       rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
       RCRET(rc);
-      rc = _kvblk_key_peek(sblk->kvblk, sblk->pi[idx], mm, &kbuf, &klen);
+      rc = _kvblk_key_copy(sblk->kvblk, sblk->pi[idx], mm, sblk->lk, _sblk_lklen(db, sblk->lvl), &klen);
       if (rc) {
         fsm->release_mmap(fsm);
         return rc;
       }
-      sblk->lkl = MIN(PREFIX_KEY_LEN_V2, klen);
-      memcpy(sblk->lk, kbuf, sblk->lkl);
+      sblk->lkl = MIN(_sblk_lklen(db, sblk->lvl), klen);
       fsm->release_mmap(fsm);
-      if (klen <= PREFIX_KEY_LEN_V2) {
+      if (klen <= _sblk_lklen(db, sblk->lvl)) {
         sblk->flags |= SBLK_FULL_LKEY;
       } else {
         sblk->flags &= ~SBLK_FULL_LKEY;
@@ -2102,6 +2930,206 @@ static WUR iwrc _sblk_rmkv(struct sblk *sblk, uint8_t idx) {
   return 0;
 }
 
+//--------------------------  Bloom filter
+
+IW_INLINE uint64_t _bloom_hash(uint64_t h, const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    h ^= data[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+/**
+ * 64 bit hash of a key in its stored form.
+ * @param raw_key If true `key` is already in stored form with compound prefix included.
+ */
+static uint64_t _bloom_key_hash(iwdb_flags_t dbflg, const struct iwkv_val *key, bool raw_key) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  if (!raw_key && (dbflg & IWDB_COMPOUND_KEYS)) {
+    int len;
+    uint8_t buf[IW_VNUMBUFSZ];
+    IW_SETVNUMBUF64(len, buf, key->compound);
+    h = _bloom_hash(h, buf, len);
+  }
+  h = _bloom_hash(h, key->data, key->size);
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+IW_INLINE void _bloom_set(struct iwdb_bloom *bf, uint64_t h) {
+  uint64_t d = ((h >> 32) | (h << 32)) | 1;
+  for (int i = 0; i < bf->nhash; ++i, h += d) {
+    uint64_t b = h & bf->mask;
+    bf->bits[b >> 6] |= 1ULL << (b & 63);
+  }
+}
+
+IW_INLINE bool _bloom_test(const struct iwdb_bloom *bf, uint64_t h) {
+  uint64_t d = ((h >> 32) | (h << 32)) | 1;
+  for (int i = 0; i < bf->nhash; ++i, h += d) {
+    uint64_t b = h & bf->mask;
+    if (!(bf->bits[b >> 6] & (1ULL << (b & 63)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void _bloom_destroy(struct iwdb *db) {
+  struct iwdb_bloom *bf = db->bloom;
+  if (bf) {
+    db->bloom = 0;
+    free(bf->bits);
+    free(bf);
+  }
+}
+
+/**
+ * Builds database Bloom filter by scanning all database keys.
+ * Filter is disabled if build failed.
+ */
+static iwrc _bloom_build_lw(struct iwdb *db) {
+  iwrc rc;
+  uint8_t *mm;
+  struct sblk *sb;
+  blkn_t sbn;
+  uint64_t *hv = 0;
+  uint8_t *kbuf = 0;
+  size_t hnum = 0, hcap = 0, kbufsz = 0;
+  struct iwdb_bloom *bf = 0;
+  IWFS_FSM *fsm = &db->iwkv->fsm;
+  struct iwlctx lx = {
+    .db = db,
+    .nlvl = -1
+  };
+
+  _bloom_destroy(db);
+  rc = _sblk_at(&lx, db->addr, 0, &sb);
+  RCRET(rc);
+  sbn = sb->n[0];
+  _sblk_release(&lx, &sb);
+
+  while (sbn) {
+    rc = _sblk_at(&lx, BLK2ADDR(sbn), 0, &sb);
+    RCGO(rc, finish);
+    rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+    if (!rc) {
+      rc = _sblk_loadkvblk_mm(&lx, sb, mm);
+      for (int i = 0; !rc && i < sb->pnum; ++i) {
+        struct iwkv_val key;
+        uint32_t klen, plen;
+        rc = _kvblk_key_peek(sb->kvblk, sb->pi[i], mm, (uint8_t**) &key.data, &klen, &plen);
+        if (rc || !(klen + plen)) {
+          break;
+        }
+        if (plen) {
+          if (plen + klen > kbufsz) {
+            uint8_t *nkbuf = realloc(kbuf, plen + klen);
+            if (!nkbuf) {
+              rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+              break;
+            }
+            kbuf = nkbuf;
+            kbufsz = plen + klen;
+          }
+          memcpy(kbuf, sb->kvblk->rk, plen);
+          memcpy(kbuf + plen, key.data, klen);
+          key.data = kbuf;
+          klen += plen;
+        }
+        if (hnum == hcap) {
+          size_t ncap = hcap ? 2 * hcap : IWDB_BLOOM_MIN_KEYS;
+          uint64_t *nhv = realloc(hv, ncap * sizeof(*hv));
+          if (!nhv) {
+            rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+            break;
+          }
+          hv = nhv;
+          hcap = ncap;
+        }
+        key.size = klen;
+        hv[hnum++] = _bloom_key_hash(db->dbflg, &key, true);
+      }
+      IWRC(fsm->release_mmap(fsm), rc);
+    }
+    sbn = sb->n[0];
+    _sblk_release(&lx, &sb);
+    RCGO(rc, finish);
+  }
+
+  uint64_t nbits = 64;
+  while (nbits < MAX(2 * hnum, IWDB_BLOOM_MIN_KEYS) * db->bloom_bpk) {
+    nbits <<= 1;
+  }
+  bf = calloc(1, sizeof(*bf));
+  if (!bf) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto finish;
+  }
+  bf->bits = calloc(nbits / 64, sizeof(*bf->bits));
+  if (!bf->bits) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    free(bf);
+    goto finish;
+  }
+  bf->mask = nbits - 1;
+  bf->capacity = nbits / db->bloom_bpk;
+  bf->nkeys = hnum;
+  bf->nhash = (db->bloom_bpk * 69U + 50) / 100; // bpk * ln(2) probes
+  if (bf->nhash < 1) {
+    bf->nhash = 1;
+  } else if (bf->nhash > IWDB_BLOOM_MAX_HASHES) {
+    bf->nhash = IWDB_BLOOM_MAX_HASHES;
+  }
+  for (size_t i = 0; i < hnum; ++i) {
+    _bloom_set(bf, hv[i]);
+  }
+  db->bloom = bf;
+
+finish:
+  free(hv);
+  free(kbuf);
+  return rc;
+}
+
+/**
+ * Rebuilds database Bloom filter if it is overfilled or has many stale keys.
+ */
+static void _bloom_maintain_lw(struct iwdb *db) {
+  struct iwdb_bloom *bf = db->bloom;
+  if (bf && ((bf->nkeys > bf->capacity) || (bf->ndel > bf->nkeys / 2))) {
+    iwrc rc = _bloom_build_lw(db);
+    if (rc) {
+      iwlog_ecode_error2(rc, "Database Bloom filter disabled");
+    }
+  }
+}
+
+IW_INLINE void _bloom_add_lw(struct iwdb *db, const struct iwkv_val *key) {
+  struct iwdb_bloom *bf = db->bloom;
+  if (bf) {
+    _bloom_set(bf, _bloom_key_hash(db->dbflg, key, false));
+    ++bf->nkeys;
+  }
+}
+
+/**
+ * Returns true if `key` is definitely absent in the database.
+ */
+IW_INLINE bool _bloom_rejects(struct iwdb *db, const struct iwkv_val *key) {
+  struct iwdb_bloom *bf = db->bloom;
+  if (bf && !_bloom_test(bf, _bloom_key_hash(db->dbflg, key, false))) {
+    atomic_fetch_add_explicit(&db->bloom_negatives, 1, memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
 //--------------------------  struct iwlctx
 
 WUR iwrc _lx_sblk_cmp_key(struct iwlctx *lx, struct sblk *sblk, int *resp) {
@@ -2127,8 +3155,7 @@ WUR iwrc _lx_sblk_cmp_key(struct iwlctx *lx, struct sblk *sblk, int *resp) {
   } else {
     res = _cmp_keys_prefix(dbflg, sblk->lk, lkl, key);
     if (res == 0) {
-      uint32_t kl;
-      uint8_t *mm, *k;
+      uint8_t *mm;
       IWFS_FSM *fsm = &lx->db->iwkv->fsm;
       rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
       if (rc) {
@@ -2143,10 +3170,12 @@ WUR iwrc _lx_sblk_cmp_key(struct iwlctx *lx, struct sblk *sblk, int *resp) {
           return rc;
         }
       }
-      rc = _kvblk_key_peek(sblk->kvblk, sblk->pi[0], mm, &k, &kl);
-      RCRET(rc);
-      res = _cmp_keys(dbflg, k, kl, key);
+      rc = _kvblk_key_cmp(sblk->kvblk, sblk->pi[0], mm, key, &res);
       fsm->release_mmap(fsm);
+      if (rc) {
+        *resp = 0;
+        return rc;
+      }
     }
   }
   *resp = res;
@@ -2210,6 +3239,9 @@ static WUR iwrc _lx_find_bounds(struct iwlctx *lx) {
     dblk->flags |= SBLK_DURTY;
   }
   lvl = lx->lower->lvl;
+  if (lx->finger) {
+    lx->finger->lvl = (int8_t) lvl;
+  }
   while (lvl > -1) {
     rc = _lx_roll_forward(lx, (uint8_t) lvl);
     RCRET(rc);
@@ -2223,11 +3255,70 @@ static WUR iwrc _lx_find_bounds(struct iwlctx *lx) {
         lx->plower[lvl] = lx->lower;
         lx->pupper[lvl] = lx->upper;
       }
+      if (lx->finger) {
+        lx->finger->lower[lvl] = lx->lower->addr;
+        lx->finger->upper[lvl] = lx->upper ? lx->upper->addr : 0;
+      }
     } while (lvl-- && lx->lower->n[lvl] == blkn);
   }
   return 0;
 }
 
+/**
+ * Sets `lx->lower` as a search starting point using the bounds
+ * of the previous (less or equal) key recorded in `lx->finger`.
+ * Picks the lowest level where recorded upper bound is still greater than the current key.
+ * `lx->lower` remains unset if the search should be started from the database block.
+ */
+static WUR iwrc _lx_finger_start(struct iwlctx *lx) {
+  iwrc rc;
+  int cret;
+  struct sblk usb;
+  struct lxfinger *f = lx->finger;
+  for (int lvl = 0; lvl <= f->lvl; ++lvl) {
+    if (lvl && (f->upper[lvl] == f->upper[lvl - 1])) {
+      continue;
+    }
+    if (f->upper[lvl]) {
+      rc = _sblk_at2(lx, f->upper[lvl], 0, &usb);
+      RCRET(rc);
+      rc = _lx_sblk_cmp_key(lx, &usb, &cret);
+      RCRET(rc);
+      if (cret <= 0) { // upper <= key
+        continue;
+      }
+    }
+    if (f->lower[lvl] != lx->db->addr) {
+      rc = _sblk_at(lx, f->lower[lvl], 0, &lx->lower);
+      RCRET(rc);
+    }
+    return 0;
+  }
+  return 0;
+}
+
+/**
+ * Hints OS to read ahead pages which will likely be touched by lookup of the next key
+ * following the current one in the database order: the head of `KVBLK` of
+ * the upper `SBLK` found at zero level and the `SBLK` next to it.
+ */
+static void _lx_prefetch_mm(struct iwlctx *lx, uint8_t *mm) {
+#if !defined(_WIN32) && defined(MADV_WILLNEED)
+  struct sblk *usb = lx->upper;
+  if (!usb || !usb->addr) {
+    return;
+  }
+  size_t psz = iwp_page_size();
+  off_t addr[] = { BLK2ADDR(usb->kvblkn), BLK2ADDR(usb->n[0]) };
+  for (int i = 0; i < sizeof(addr) / sizeof(addr[0]); ++i) {
+    if (addr[i]) {
+      off_t paddr = IW_ROUNDOWN(addr[i], psz);
+      madvise(mm + paddr, 2 * psz, MADV_WILLNEED);
+    }
+  }
+#endif
+}
+
 static iwrc _lx_release_mm(struct iwlctx *lx, uint8_t *mm) {
   iwrc rc = 0;
   if (lx->nlvl > -1) {
@@ -2299,7 +3390,7 @@ static iwrc _lx_split_addkv(struct iwlctx *lx, int idx, struct sblk *sblk) {
   blkn_t nblk;
   struct iwdb *db = sblk->db;
   bool uside = (idx == sblk->pnum);
-  register const int8_t pivot = (KVBLK_IDXNUM / 2) + 1; // 32
+  register const int8_t pivot = (db->idxnum / 2) + 1;
 
   if (uside) { // Upper side
     rc = _sblk_create(lx, (uint8_t) lx->nlvl, 0, sblk, lx->upper, &nb);
@@ -2317,9 +3408,10 @@ static iwrc _lx_split_addkv(struct iwlctx *lx, int idx, struct sblk *sblk) {
       sz += sblk->kvblk->pidx[sblk->pi[i]].len;
     }
     if (idx > pivot) {
-      sz += IW_VNUMSIZE(lx->key->size) + lx->key->size + lx->val->size;
+      sz += IW_VNUMSIZE(lx->key->size) + lx->key->size;
+      sz += _kvblk_is_ext_value(db, lx->val->size) ? _kvblk_ext_ref_sz(db->iwkv->fmt_version) : lx->val->size;
     }
-    sz += KVBLK_MAX_NKV_SZ;
+    sz += KVBLK_MAX_NKV_SZ_N(db->idxnum);
     uint8_t kvbpow = (uint8_t) iwlog2_64(sz);
     while ((1ULL << kvbpow) < sz) kvbpow++;
 
@@ -2338,18 +3430,21 @@ static iwrc _lx_split_addkv(struct iwlctx *lx, int idx, struct sblk *sblk) {
       fsm->release_mmap(fsm);
       RCBREAK(rc);
 
-      rc = _sblk_addkv2(nb, i - pivot, &key, &val, true);
+      // Out of line value reference is moved as is
+      rc = _sblk_addkv2(nb, i - pivot, &key, &val,
+                        sblk->kvblk->pidx[sblk->pi[i]].ext ? ADDKV_RAW | ADDKV_EXT : ADDKV_RAW);
       _kv_dispose(&key, &val);
 
       RCBREAK(rc);
       sblk->kvblk->pidx[sblk->pi[i]].len = 0;
       sblk->kvblk->pidx[sblk->pi[i]].off = 0;
+      sblk->kvblk->pidx[sblk->pi[i]].ext = false;
       --sblk->pnum;
     }
     sblk->kvblk->flags |= KVBLK_DURTY;
     sblk->kvblk->zidx = sblk->pi[pivot];
     sblk->kvblk->maxoff = 0;
-    for (int i = 0; i < KVBLK_IDXNUM; ++i) {
+    for (int i = 0; i < db->idxnum; ++i) {
       if (sblk->kvblk->pidx[i].off > sblk->kvblk->maxoff) {
         sblk->kvblk->maxoff = sblk->kvblk->pidx[i].off;
       }
@@ -2415,9 +3510,23 @@ IW_INLINE iwrc _lx_init_chute(struct iwlctx *lx) {
   return 0;
 }
 
+/**
+ * Replaces `*valp` with the packed value if database stores compressed or expiring values.
+ */
+IW_INLINE WUR iwrc _lx_value_pack(struct iwlctx *lx, struct iwkv_val **valp) {
+  if (!(lx->db->dbflg & (IWDB_COMPRESSED_VALUES | IWDB_EXPIRING_VALUES))) {
+    return 0;
+  }
+  iwrc rc = _kvblk_value_pack(lx->db, *valp, lx->expire, &lx->pval, &lx->pbuf);
+  if (!rc) {
+    *valp = &lx->pval;
+  }
+  return rc;
+}
+
 static WUR iwrc _lx_addkv(struct iwlctx *lx) {
   iwrc rc;
-  bool found, uadd;
+  bool found, expired, uadd;
   uint8_t *mm = 0, idx;
   struct sblk *sblk = lx->lower;
   IWFS_FSM *fsm = &lx->db->iwkv->fsm;
@@ -2434,13 +3543,15 @@ static WUR iwrc _lx_addkv(struct iwlctx *lx) {
   }
   rc = _sblk_find_pi_mm(sblk, lx, mm, &found, &idx);
   RCRET(rc);
-  if (found && (lx->opflags & IWKV_NO_OVERWRITE)) {
+  // Expired record is replaced like an absent one
+  expired = found && _sblk_is_expired_mm(sblk, idx, mm);
+  if (found && !expired && (lx->opflags & IWKV_NO_OVERWRITE)) {
     fsm->release_mmap(fsm);
     return IWKV_ERROR_KEY_EXISTS;
   }
   uadd = (  !found
-         && sblk->pnum > KVBLK_IDXNUM - 1 && idx > KVBLK_IDXNUM - 1
-         && lx->upper && lx->upper->pnum < KVBLK_IDXNUM);
+         && sblk->pnum > lx->db->idxnum - 1 && idx > lx->db->idxnum - 1
+         && lx->upper && lx->upper->pnum < lx->db->idxnum);
   if (uadd) {
     rc = _sblk_loadkvblk_mm(lx, lx->upper, mm);
     if (rc) {
@@ -2450,10 +3561,10 @@ static WUR iwrc _lx_addkv(struct iwlctx *lx) {
   }
   if (found) {
     struct iwkv_val sval, *val = lx->val;
-    if (lx->opflags & IWKV_VAL_INCREMENT) {
+    if ((lx->opflags & IWKV_VAL_INCREMENT) && !expired) {
       int64_t ival;
-      uint8_t *rp;
-      uint32_t len;
+      size_t len;
+      uint8_t ibuf[8];
       if (val->size == 4) {
         int32_t lv;
         memcpy(&lv, val->data, val->size);
@@ -2467,8 +3578,12 @@ static WUR iwrc _lx_addkv(struct iwlctx *lx) {
         fsm->release_mmap(fsm);
         return rc;
       }
-      _kvblk_value_peek(sblk->kvblk, sblk->pi[idx], mm, &rp, &len);
-      sval.data = rp;
+      rc = _kvblk_value_copy(sblk->kvblk, sblk->pi[idx], mm, ibuf, sizeof(ibuf), &len);
+      if (rc) {
+        fsm->release_mmap(fsm);
+        return rc;
+      }
+      sval.data = ibuf;
       sval.size = len;
       if (sval.size == 4) {
         uint32_t lv;
@@ -2495,49 +3610,55 @@ static WUR iwrc _lx_addkv(struct iwlctx *lx) {
       rc = _kvblk_value_get(sblk->kvblk, mm, sblk->pi[idx], &oldval);
       fsm->release_mmap(fsm);
       if (!rc) {
+        if (expired) {
+          _kv_val_dispose(&oldval);
+        }
         // note: oldval should be disposed by ph
-        rc = lx->ph(lx->key, lx->val, &oldval, lx->phop);
+        rc = lx->ph(lx->key, lx->val, expired ? 0 : &oldval, lx->phop);
       }
       RCRET(rc);
     } else {
       fsm->release_mmap(fsm);
     }
+    rc = _lx_value_pack(lx, &val);
+    RCRET(rc);
     return _sblk_updatekv(sblk, idx, lx->key, val);
   } else {
     fsm->release_mmap(fsm);
-    if (sblk->pnum > KVBLK_IDXNUM - 1) {
+    if ((sblk->pnum > lx->db->idxnum - 1) && !uadd && (lx->nlvl < 0)) {
+      return _IWKV_RC_REQUIRE_NLEVEL;
+    }
+    if (lx->ph) {
+      rc = lx->ph(lx->key, lx->val, 0, lx->phop);
+      RCRET(rc);
+    }
+    rc = _lx_value_pack(lx, &lx->val);
+    RCRET(rc);
+    if (sblk->pnum > lx->db->idxnum - 1) {
       if (uadd) {
-        if (lx->ph) {
-          rc = lx->ph(lx->key, lx->val, 0, lx->phop);
-          RCRET(rc);
-        }
-        return _sblk_addkv(lx->upper, lx);
-      }
-      if (lx->nlvl < 0) {
-        return _IWKV_RC_REQUIRE_NLEVEL;
+        rc = _sblk_addkv(lx->upper, lx);
+      } else {
+        rc = _lx_split_addkv(lx, idx, sblk);
       }
-      if (lx->ph) {
-        rc = lx->ph(lx->key, lx->val, 0, lx->phop);
-        RCRET(rc);
-      }
-      return _lx_split_addkv(lx, idx, sblk);
     } else {
-      if (lx->ph) {
-        rc = lx->ph(lx->key, lx->val, 0, lx->phop);
-        RCRET(rc);
-      }
-      return _sblk_addkv2(sblk, idx, lx->key, lx->val, false);
+      rc = _sblk_addkv2(sblk, idx, lx->key, lx->val, 0);
     }
+    if (!rc) {
+      rc = _db_rcnt_add(lx->db, 1);
+    }
+    return rc;
   }
 }
 
 IW_INLINE WUR iwrc _lx_put_lw(struct iwlctx *lx) {
   iwrc rc;
+  struct iwkv_val *val = lx->val;
+  _bloom_add_lw(lx->db, lx->key);
 start:
   rc = _lx_find_bounds(lx);
   if (rc) {
     _lx_release_mm(lx, 0);
-    return rc;
+    goto finish;
   }
   rc = _lx_addkv(lx);
   if (rc == _IWKV_RC_REQUIRE_NLEVEL) {
@@ -2555,23 +3676,34 @@ start:
     iwlog_ecode_error3(rc);
   }
   IWRC(_lx_release(lx), rc);
+  if (!rc) {
+    _bloom_maintain_lw(lx->db);
+  }
+
+finish:
+  lx->val = val;
+  free(lx->pbuf);
+  lx->pbuf = 0;
   return rc;
 }
 
 IW_INLINE WUR iwrc _lx_get_lr(struct iwlctx *lx) {
+  lx->val->size = 0;
+  if (_bloom_rejects(lx->db, lx->key)) {
+    return IWKV_ERROR_NOTFOUND;
+  }
   iwrc rc = _lx_find_bounds(lx);
   RCRET(rc);
   bool found;
   uint8_t *mm, idx;
   IWFS_FSM *fsm = &lx->db->iwkv->fsm;
-  lx->val->size = 0;
   rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
   RCRET(rc);
   rc = _sblk_loadkvblk_mm(lx, lx->lower, mm);
   RCGO(rc, finish);
-  rc = _sblk_find_pi_mm(lx->lower, lx, mm, &found, &idx);
+  rc = _sblk_find_pi_fp_mm(lx->lower, lx, mm, &found, &idx);
   RCGO(rc, finish);
-  if (found) {
+  if (found && !_sblk_is_expired_mm(lx->lower, idx, mm)) {
     rc = _kvblk_value_get(lx->lower->kvblk, mm, lx->lower->pi[idx], lx->val);
   } else {
     rc = IWKV_ERROR_NOTFOUND;
@@ -2684,6 +3816,9 @@ static WUR iwrc _lx_del_lw(struct iwlctx *lx) {
   IWFS_FSM *fsm = &db->iwkv->fsm;
   struct sblk *sblk;
 
+  if (_bloom_rejects(db, lx->key)) {
+    return IWKV_ERROR_NOTFOUND;
+  }
   rc = _lx_find_bounds(lx);
   RCRET(rc);
 
@@ -2692,9 +3827,9 @@ static WUR iwrc _lx_del_lw(struct iwlctx *lx) {
   RCGO(rc, finish);
   rc = _sblk_loadkvblk_mm(lx, sblk, mm);
   RCGO(rc, finish);
-  rc = _sblk_find_pi_mm(sblk, lx, mm, &found, &idx);
+  rc = _sblk_find_pi_fp_mm(sblk, lx, mm, &found, &idx);
   RCGO(rc, finish);
-  if (!found) {
+  if (!found || (lx->reap_ts && !_sblk_expired_at_mm(sblk, idx, mm, lx->reap_ts))) {
     rc = IWKV_ERROR_NOTFOUND;
     goto finish;
   }
@@ -2706,6 +3841,9 @@ static WUR iwrc _lx_del_lw(struct iwlctx *lx) {
   } else {
     rc = _sblk_rmkv(sblk, idx);
   }
+  if (!rc) {
+    rc = _db_rcnt_add(db, -1);
+  }
 
 finish:
   if (mm) {
@@ -2714,8 +3852,616 @@ finish:
   if (rc) {
     _lx_release_mm(lx, 0);
   } else {
-    rc = _lx_release(lx);
+    rc = _lx_release(lx);
+  }
+  if (!rc && db->bloom) {
+    ++db->bloom->ndel;
+    _bloom_maintain_lw(db);
+  }
+  return rc;
+}
+
+/** Blocks released by range delete. */
+struct _delr_ctx {
+  struct iwlctx *lx;
+  off_t (*ext)[2];   ///< File extents to deallocate: [addr, size]
+  size_t extn;
+  size_t extcap;
+  off_t *sba;        ///< Addresses of unlinked `SBLK` blocks
+  size_t sban;
+  size_t sbacap;
+  uint64_t nrec;     ///< Number of removed records
+};
+
+static iwrc _delr_push_ext(struct _delr_ctx *dc, off_t addr, off_t len) {
+  if (dc->extn == dc->extcap) {
+    size_t ncap = dc->extcap ? 2 * dc->extcap : 64;
+    off_t (*next)[2] = realloc(dc->ext, ncap * sizeof(*next));
+    if (!next) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    dc->ext = next;
+    dc->extcap = ncap;
+  }
+  dc->ext[dc->extn][0] = addr;
+  dc->ext[dc->extn][1] = len;
+  ++dc->extn;
+  return 0;
+}
+
+static iwrc _delr_push_sblk(struct _delr_ctx *dc, off_t addr) {
+  if (dc->sban == dc->sbacap) {
+    size_t ncap = dc->sbacap ? 2 * dc->sbacap : 64;
+    off_t *nsba = realloc(dc->sba, ncap * sizeof(*nsba));
+    if (!nsba) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    dc->sba = nsba;
+    dc->sbacap = ncap;
+  }
+  dc->sba[dc->sban++] = addr;
+  return 0;
+}
+
+static int _delr_ext_cmp(const void *o1, const void *o2) {
+  const off_t *e1 = o1, *e2 = o2;
+  return e1[0] < e2[0] ? -1 : e1[0] > e2[0] ? 1 : 0;
+}
+
+/**
+ * Releases blocks collected by range delete: frees slots of unlinked `SBLK` blocks
+ * in their pages then deallocates all file extents sorted and merged by address.
+ */
+static iwrc _delr_release(struct _delr_ctx *dc) {
+  iwrc rc = 0;
+  uint8_t *mm;
+  struct iwdb *db = dc->lx->db;
+  struct iwdlsnr *dlsnr = db->iwkv->dlsnr;
+  IWFS_FSM *fsm = &db->iwkv->fsm;
+
+  for (size_t i = 0; i < dc->sban; ++i) {
+    off_t paddr;
+    struct sblk sb = {
+      .addr = dc->sba[i]
+    };
+    rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+    RCRET(rc);
+    memcpy(&sb.bpos, mm + sb.addr + SOFF_BPOS_U1(db), 1);
+    if (_sblk_is_only_one_on_page_v2(dc->lx, mm, &sb, &paddr)) {
+      fsm->release_mmap(fsm);
+      rc = _delr_push_ext(dc, paddr, SBLK_PAGE_SZ_V2);
+    } else {
+      memset(mm + sb.addr + SOFF_BPOS_U1(db), 0, 1);
+      fsm->release_mmap(fsm);
+      if (dlsnr) {
+        rc = dlsnr->onset(dlsnr, sb.addr + SOFF_BPOS_U1(db), 0, 1, 0);
+      }
+    }
+    RCRET(rc);
+  }
+  dc->sban = 0;
+
+  if (dc->extn) {
+    qsort(dc->ext, dc->extn, sizeof(*dc->ext), _delr_ext_cmp);
+    off_t addr = dc->ext[0][0], len = dc->ext[0][1];
+    for (size_t i = 1; i <= dc->extn; ++i) {
+      if ((i < dc->extn) && (dc->ext[i][0] == addr + len)) {
+        len += dc->ext[i][1];
+        continue;
+      }
+      IWRC(fsm->deallocate(fsm, addr, len), rc);
+      if (i < dc->extn) {
+        addr = dc->ext[i][0];
+        len = dc->ext[i][1];
+      }
+    }
+    dc->extn = 0;
+  }
+  return rc;
+}
+
+/**
+ * Finds position of the first kv pair of `sblk` which is not before `key`.
+ * Sets `*oidx` to `sblk->pnum` if there is no such pair.
+ */
+static WUR iwrc _sblk_lbound_mm(struct sblk *sblk, const uint8_t *mm, const struct iwkv_val *key, uint8_t *oidx) {
+  int cr, lb = 0, ub = sblk->pnum;
+  while (lb < ub) {
+    int idx = (lb + ub) / 2;
+    iwrc rc = _kvblk_key_cmp(sblk->kvblk, sblk->pi[idx], mm, key, &cr);
+    RCRET(rc);
+    if (cr < 0) {
+      lb = idx + 1;
+    } else {
+      ub = idx;
+    }
+  }
+  *oidx = (uint8_t) lb;
+  return 0;
+}
+
+/** Updates copies of `sblk` held by active cursors of database. */
+static void _delr_cursors_refresh(struct iwdb *db, const struct sblk *sblk) {
+  pthread_spin_lock(&db->cursors_slk);
+  for (struct iwkv_cursor *cur = db->cursors; cur; cur = cur->next) {
+    if (!cur->cn || (cur->cn->addr != sblk->addr) || ((cur->cn->flags ^ sblk->flags) & SBLK_DB)) {
+      continue;
+    }
+    if (sblk->flags & SBLK_DB) {
+      memcpy(cur->cn->n, sblk->n, sizeof(sblk->n));
+      cur->cn->lvl = sblk->lvl;
+      cur->cn->p0 = sblk->p0;
+    } else {
+      memcpy(cur->cn, sblk, sizeof(*cur->cn));
+      cur->cn->kvblk = 0;
+      cur->cn->flags &= SBLK_PERSISTENT_FLAGS;
+    }
+  }
+  pthread_spin_unlock(&db->cursors_slk);
+}
+
+/**
+ * Unlinks `sblk` fully covered by range from skiplist.
+ * Its blocks are collected into `dc`, cursors positioned in it are moved to the next node `nb`.
+ */
+static WUR iwrc _delr_unlink_mm(
+  struct _delr_ctx *dc, struct sblk *pred[static SLEVELS],
+  struct sblk *sblk, struct sblk *nb, uint8_t *mm) {
+  iwrc rc;
+  struct iwlctx *lx = dc->lx;
+  struct iwdb *db = lx->db;
+  struct kvblk *kb = sblk->kvblk;
+
+  for (int i = 0; i < db->idxnum; ++i) {
+    if (kb->pidx[i].ext) {
+      uint8_t *vp;
+      uint32_t vlen;
+      _kvblk_value_peek(kb, i, mm, &vp, &vlen);
+      rc = _delr_push_ext(dc, vp - mm, _kvblk_ext_asz(vlen));
+      RCRET(rc);
+    }
+  }
+  rc = _delr_push_ext(dc, kb->addr, 1ULL << kb->szpow);
+  RCRET(rc);
+  rc = _delr_push_sblk(dc, sblk->addr);
+  RCRET(rc);
+  _sbc_invalidate(db, sblk->addr);
+
+  for (int i = 0; i <= sblk->lvl; ++i) {
+    pred[i]->n[i] = sblk->n[i];
+    pred[i]->flags |= SBLK_DURTY;
+  }
+  if (db->lcnt[sblk->lvl]) {
+    db->lcnt[sblk->lvl]--;
+  }
+  lx->dblk.flags |= SBLK_DURTY;
+  dc->nrec += sblk->pnum;
+
+  pthread_spin_lock(&db->cursors_slk);
+  for (struct iwkv_cursor *cur = db->cursors; cur; cur = cur->next) {
+    if (!cur->cn || (cur->cn->addr != sblk->addr) || (cur->cn->flags & SBLK_DB)) {
+      continue;
+    }
+    if (nb->flags & SBLK_DB) {
+      if (!(pred[0]->flags & SBLK_DB)) {
+        memcpy(cur->cn, pred[0], sizeof(*cur->cn));
+        cur->cn->flags &= SBLK_PERSISTENT_FLAGS;
+        cur->cn->kvblk = 0;
+        cur->skip_next = -1;
+        cur->cnpos = pred[0]->pnum;
+        if (cur->cnpos) {
+          cur->cnpos--;
+        }
+      } else {
+        cur->cn = 0;
+        cur->cnpos = 0;
+        cur->skip_next = 0;
+      }
+    } else {
+      memcpy(cur->cn, nb, sizeof(*nb));
+      cur->cn->flags &= SBLK_PERSISTENT_FLAGS;
+      cur->cn->kvblk = 0;
+      cur->cnpos = 0;
+      cur->skip_next = 1;
+    }
+  }
+  pthread_spin_unlock(&db->cursors_slk);
+  return 0;
+}
+
+/**
+ * Removes kv pairs of `sblk` at positions `[lidx, uidx)` one by one.
+ */
+static WUR iwrc _delr_rmkvs(struct _delr_ctx *dc, struct sblk *sblk, uint8_t lidx, uint8_t uidx) {
+  while (uidx > lidx) {
+    iwrc rc = _sblk_rmkv(sblk, --uidx);
+    RCRET(rc);
+    ++dc->nrec;
+  }
+  return 0;
+}
+
+static WUR iwrc _lx_del_range_lw(struct iwlctx *lx, const struct iwkv_val *lo, const struct iwkv_val *hi) {
+  iwrc rc;
+  uint8_t *mm = 0;
+  bool head = true;
+  struct iwdb *db = lx->db;
+  IWFS_FSM *fsm = &db->iwkv->fsm;
+  struct sblk *pred[SLEVELS];     // Last nodes preceding range on every level
+  struct sblk ps[SLEVELS + 1];    // Storage of `pred` nodes
+  struct sblk sbs[2], *sb = &sbs[0], *nb = &sbs[1], *tmp;
+  struct _delr_ctx dc = {
+    .lx = lx
+  };
+  int psn = 0;
+  off_t saddr;
+
+  // Node where range starts
+  if (lo) {
+    lx->key = lo;
+    rc = _lx_find_bounds(lx);
+    RCRET(rc);
+    saddr = (lx->lower->flags & SBLK_DB) ? BLK2ADDR(lx->dblk.n[0]) : lx->lower->addr;
+    _lx_release_mm(lx, 0);
+  } else {
+    rc = _sblk_at2(lx, db->addr, 0, &lx->dblk);
+    RCRET(rc);
+    saddr = BLK2ADDR(lx->dblk.n[0]);
+  }
+  if (!saddr) {
+    return 0;
+  }
+  for (int i = 0; i < SLEVELS; ++i) {
+    pred[i] = &lx->dblk;
+  }
+  if (lo && (saddr != BLK2ADDR(lx->dblk.n[0]))) {
+    // Find nodes preceding starting node on every level
+    lx->nlvl = lx->dblk.lvl;
+    lx->upper_addr = saddr;
+    rc = _lx_find_bounds(lx);
+    RCRET(rc);
+    for (int i = 0; i <= lx->nlvl; ++i) {
+      struct sblk *s = lx->plower[i];
+      if (s->flags & SBLK_DB) {
+        continue;
+      }
+      if (i && (s->addr == pred[i - 1]->addr)) {
+        pred[i] = pred[i - 1];
+      } else {
+        memcpy(&ps[psn], s, sizeof(ps[psn]));
+        ps[psn].kvblk = 0;
+        pred[i] = &ps[psn++];
+      }
+    }
+    _lx_release_mm(lx, 0);
+    lx->nlvl = -1;
+    lx->upper_addr = 0;
+  }
+
+  rc = _sblk_at2(lx, saddr, 0, sb);
+  RCRET(rc);
+
+  while (!(sb->flags & SBLK_DB)) {
+    uint8_t lidx = 0, uidx;
+    rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+    RCGO(rc, finish);
+    rc = _sblk_loadkvblk_mm(lx, sb, mm);
+    RCGO(rc, finish);
+    uidx = sb->pnum;
+    if (head && lo) {
+      rc = _sblk_lbound_mm(sb, mm, lo, &lidx);
+      RCGO(rc, finish);
+    }
+    if (hi && sb->pnum) {
+      int cr;
+      rc = _kvblk_key_cmp(sb->kvblk, sb->pi[sb->pnum - 1], mm, hi, &cr);
+      RCGO(rc, finish);
+      if (cr >= 0) {
+        rc = _sblk_lbound_mm(sb, mm, hi, &uidx);
+        RCGO(rc, finish);
+      }
+    }
+    if (!lidx && (uidx == sb->pnum)) {
+      // Whole node is in range
+      fsm->release_mmap(fsm);
+      mm = 0;
+      rc = _sblk_at2(lx, BLK2ADDR(sb->n[0]), 0, nb);
+      RCGO(rc, finish);
+      rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+      RCGO(rc, finish);
+      rc = _delr_unlink_mm(&dc, pred, sb, nb, mm);
+      RCGO(rc, finish);
+      fsm->release_mmap(fsm);
+      mm = 0;
+      tmp = sb, sb = nb, nb = tmp;
+      head = false;
+      continue;
+    }
+    fsm->release_mmap(fsm);
+    mm = 0;
+
+    rc = _delr_rmkvs(&dc, sb, lidx, uidx);
+    RCGO(rc, finish);
+    if (!head || (uidx < sb->pnum)) {
+      break; // Range ends in this node
+    }
+    // Range starts in the middle of this node
+    rc = _sblk_sync(lx, sb);
+    RCGO(rc, finish);
+    sb->kvblk = 0;
+    memcpy(&ps[psn], sb, sizeof(ps[psn]));
+    for (int i = 0; i <= sb->lvl; ++i) {
+      pred[i] = &ps[psn];
+    }
+    ++psn;
+    rc = _sblk_at2(lx, BLK2ADDR(sb->n[0]), 0, sb);
+    RCGO(rc, finish);
+    head = false;
+  }
+
+  // `sb` is the first node after range
+  if (dc.sban) {
+    sb->p0 = ADDR2BLK(pred[0]->addr);
+    sb->flags |= SBLK_DURTY;
+    while (lx->dblk.lvl && !lx->dblk.n[lx->dblk.lvl]) {
+      --lx->dblk.lvl;
+    }
+  }
+
+finish:
+  if (mm) {
+    fsm->release_mmap(fsm);
+  }
+  if (!rc) {
+    for (int i = 0; i < psn; ++i) {
+      rc = _sblk_sync(lx, &ps[i]);
+      RCBREAK(rc);
+    }
+  }
+  if (!rc) {
+    rc = _sblk_sync(lx, sb);
+  }
+  if (!rc) {
+    rc = _sblk_sync(lx, &lx->dblk);
+  }
+  if (!rc) {
+    rc = _db_rcnt_add(db, -(int64_t) dc.nrec);
+  }
+  if (!rc) {
+    for (int i = 0; i < psn; ++i) {
+      _delr_cursors_refresh(db, &ps[i]);
+    }
+    _delr_cursors_refresh(db, sb);
+    _delr_cursors_refresh(db, &lx->dblk);
+    rc = _delr_release(&dc);
+    if (db->bloom) {
+      db->bloom->ndel += dc.nrec;
+      _bloom_maintain_lw(db);
+    }
+  }
+  free(dc.ext);
+  free(dc.sba);
+  return rc;
+}
+
+/**
+ * Adds size of `sblk` node and its `KVBLK` to `obytes`.
+ */
+static WUR iwrc _est_node_bytes(struct iwlctx *lx, struct sblk *sblk, uint64_t *obytes) {
+  uint8_t *mm;
+  IWFS_FSM *fsm = &lx->db->iwkv->fsm;
+  iwrc rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+  RCRET(rc);
+  *obytes += SBLK_SZ + (1ULL << *(mm + BLK2ADDR(sblk->kvblkn)));
+  fsm->release_mmap(fsm);
+  return 0;
+}
+
+/** Results of skiplist level walk accumulated by `_est_walk_lr()` */
+struct _est_walk {
+  uint64_t    num;   /**< Number of visited nodes */
+  uint64_t    cnt;   /**< Number of records in visited nodes */
+  uint64_t    bytes; /**< Size of visited nodes and their KVBLKs */
+  off_t       first; /**< Address of the first visited node */
+  struct sblk last;  /**< Last visited node */
+  bool        more;  /**< Walk is stopped by `max` nodes limit */
+};
+
+/**
+ * Walks `lvl` level of skiplist starting from the node next to `saddr`
+ * while node lower keys are before optional `hi` key and node is not the `stop` node.
+ * Stops after `max` visited nodes if `max` is not zero.
+ */
+static WUR iwrc _est_walk_lr(
+  struct iwlctx *lx, off_t saddr, uint8_t lvl, const struct iwkv_val *hi,
+  off_t stop, uint64_t max, struct _est_walk *w) {
+  iwrc rc;
+  int cret;
+  struct sblk sb;
+  uint64_t num = 0;
+
+  rc = _sblk_at2(lx, saddr, 0, &sb);
+  RCRET(rc);
+  lx->key = hi;
+  while (sb.n[lvl] && BLK2ADDR(sb.n[lvl]) != stop) {
+    if (max && num >= max) {
+      w->more = true;
+      break;
+    }
+    rc = _sblk_at2(lx, BLK2ADDR(sb.n[lvl]), 0, &sb);
+    RCRET(rc);
+    if (hi) {
+      rc = _lx_sblk_cmp_key(lx, &sb, &cret);
+      RCRET(rc);
+      if (cret >= 0) { // node lower key >= hi
+        break;
+      }
+    }
+    rc = _est_node_bytes(lx, &sb, &w->bytes);
+    RCRET(rc);
+    if (!w->num) {
+      w->first = sb.addr;
+    }
+    w->cnt += sb.pnum;
+    ++w->num;
+    ++num;
+    memcpy(&w->last, &sb, sizeof(w->last));
+    w->last.kvblk = 0;
+  }
+  lx->key = 0;
+  return 0;
+}
+
+/**
+ * Finds position of the first record not before `key` in the node `sblk`.
+ */
+static WUR iwrc _est_lbound(struct iwlctx *lx, struct sblk *sblk, const struct iwkv_val *key, uint8_t *oidx) {
+  uint8_t *mm;
+  IWFS_FSM *fsm = &lx->db->iwkv->fsm;
+  iwrc rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+  RCRET(rc);
+  rc = _sblk_loadkvblk_mm(lx, sblk, mm);
+  if (!rc) {
+    rc = _sblk_lbound_mm(sblk, mm, key, oidx);
+  }
+  sblk->kvblk = 0;
+  fsm->release_mmap(fsm);
+  return rc;
+}
+
+/**
+ * Estimates number of records and bytes in `[lo, hi)` range.
+ *
+ * Going down from the top skiplist level picks the first level having at least
+ * `EST_SAMPLE_MIN` nodes with lower keys in range. Records between these sampled nodes
+ * are estimated by the number of database records (or sampled records) per node at that level.
+ * Records of the range boundaries: from `lo` to the first sampled node and from the last
+ * sampled node to `hi` are counted on zero level, if it takes at most `EST_SAMPLE_MIN` nodes.
+ * Small ranges are counted exactly.
+ */
+static WUR iwrc _db_estimate_lr(
+  struct iwlctx *lx, const struct iwkv_val *lo, const struct iwkv_val *hi,
+  uint64_t *ocount, uint64_t *obytes) {
+  iwrc rc;
+  int lvl;
+  uint8_t lidx = 0, uidx;
+  uint64_t ln[SLEVELS], n = 0;
+  struct iwdb *db = lx->db;
+  struct sblk sb, *tl;
+  struct lxfinger f = { 0 };
+  struct _est_walk s = { 0 }, h = { 0 }, t = { 0 };
+  const uint64_t rcnt = db->rcnt_valid ? db->rcnt : 0;
+
+  if (lo) {
+    lx->key = lo;
+    lx->finger = &f;
+    rc = _lx_find_bounds(lx);
+    lx->finger = 0;
+    _lx_release_mm(lx, 0);
+    RCRET(rc);
+  } else {
+    rc = _sblk_at2(lx, db->addr, 0, &lx->dblk);
+    RCRET(rc);
+    f.lvl = (int8_t) lx->dblk.lvl;
+    for (int i = 0; i <= f.lvl; ++i) {
+      f.lower[i] = db->addr;
+    }
+  }
+  for (int i = SLEVELS - 1; i >= 0; --i) {
+    n += db->lcnt[i];
+    ln[i] = n;
+  }
+  for (lvl = f.lvl; lvl > 0; --lvl) {
+    memset(&s, 0, sizeof(s));
+    rc = _est_walk_lr(lx, f.lower[lvl], (uint8_t) lvl, hi, 0, 0, &s);
+    RCRET(rc);
+    if ((s.num >= EST_SAMPLE_MIN) && ln[lvl]) {
+      break;
+    }
+  }
+
+  // Records of the node containing `lo`
+  if (f.lower[0] != db->addr) {
+    rc = _sblk_at2(lx, f.lower[0], 0, &sb);
+    RCRET(rc);
+    rc = _est_lbound(lx, &sb, lo, &lidx);
+    RCRET(rc);
+    uidx = sb.pnum;
+    if (hi && !lvl) {
+      rc = _est_lbound(lx, &sb, hi, &uidx);
+      RCRET(rc);
+    }
+    if (uidx > lidx) {
+      h.cnt = uidx - lidx;
+      rc = _est_node_bytes(lx, &sb, &h.bytes);
+      RCRET(rc);
+    }
+  }
+
+  if (!lvl) { // Count zero level records exactly
+    rc = _est_walk_lr(lx, f.lower[0], 0, hi, 0, 0, &h);
+    RCRET(rc);
+    if (h.num && hi) {
+      rc = _est_lbound(lx, &h.last, hi, &uidx);
+      RCRET(rc);
+      h.cnt -= h.last.pnum - uidx;
+    }
+    *ocount = h.cnt;
+    *obytes = h.bytes;
+    return 0;
+  }
+
+  // Records per gap between sampled nodes
+  double gap = rcnt ? (double) rcnt / ln[lvl] : (double) s.cnt * ln[0] / ((double) s.num * ln[lvl]);
+  double bgap = (double) s.bytes * ln[0] / ((double) s.num * ln[lvl]);
+  double count = gap * (s.num - 1);
+  double bytes = bgap * (s.num - 1);
+
+  // From `lo` to the first sampled node
+  rc = _est_walk_lr(lx, f.lower[0], 0, 0, s.first, EST_SAMPLE_MIN, &h);
+  RCRET(rc);
+  if (h.more) {
+    count += gap / 2;
+    bytes += bgap / 2;
+  } else {
+    count += h.cnt;
+    bytes += h.bytes;
+  }
+
+  // From the last sampled node to `hi`
+  t.cnt = s.last.pnum;
+  rc = _est_node_bytes(lx, &s.last, &t.bytes);
+  RCRET(rc);
+  rc = _est_walk_lr(lx, s.last.addr, 0, hi, 0, EST_SAMPLE_MIN, &t);
+  RCRET(rc);
+  if (t.more) {
+    count += gap / 2;
+    bytes += bgap / 2;
+  } else {
+    if (hi) {
+      tl = t.num ? &t.last : &s.last;
+      rc = _est_lbound(lx, tl, hi, &uidx);
+      RCRET(rc);
+      t.cnt -= tl->pnum - uidx;
+    }
+    count += t.cnt;
+    bytes += t.bytes;
+  }
+  if (rcnt && (count > rcnt)) {
+    count = rcnt;
   }
+  *ocount = (uint64_t) count;
+  *obytes = (uint64_t) bytes;
+  return 0;
+}
+
+/**
+ * Counts records of database by walking zero level of skiplist.
+ */
+static WUR iwrc _db_rcnt_scan_lr(struct iwlctx *lx, uint64_t *ocount) {
+  struct _est_walk w = { 0 };
+  iwrc rc = _est_walk_lr(lx, lx->db->addr, 0, 0, 0, 0, &w);
+  *ocount = w.cnt;
   return rc;
 }
 
@@ -2748,6 +4494,233 @@ finish:
   return rc;
 }
 
+IW_INLINE bool _cursor_has_bounds(const struct iwkv_cursor *cur) {
+  return cur->end.data || cur->prefix.data;
+}
+
+/** Checks if record at `idx` position of the cursor node is within cursor range. */
+static WUR iwrc _cursor_rec_in_bounds_mm(struct iwkv_cursor *cur, uint8_t idx, const uint8_t *mm, bool *ores) {
+  struct kvblk *kb = cur->cn->kvblk;
+  uint8_t kvidx = cur->cn->pi[idx];
+  *ores = false;
+  if (cur->end.data) {
+    int cr;
+    iwrc rc = _kvblk_key_cmp(kb, kvidx, mm, &cur->end, &cr);
+    RCRET(rc);
+    if ((cr > 0) || (!cr && !cur->end_incl)) {
+      return 0;
+    }
+  }
+  if (cur->prefix.data) {
+    uint8_t *k;
+    uint32_t kl, pl;
+    const uint8_t *p = cur->prefix.data;
+    uint32_t psz = cur->prefix.size;
+    iwrc rc = _kvblk_key_peek(kb, kvidx, mm, &k, &kl, &pl);
+    RCRET(rc);
+    if (  (pl + kl < psz)
+       || memcmp(kb->rk, p, MIN(pl, psz))
+       || ((psz > pl) && memcmp(k, p + pl, psz - pl))) {
+      return 0;
+    }
+  }
+  *ores = true;
+  return 0;
+}
+
+/**
+ * Checks if the current cursor record is within cursor range.
+ * Keys in range are adjacent in the database order, so if the first and the last records
+ * of `SBLK` node are in range the whole node is marked as checked.
+ */
+static WUR iwrc _cursor_check_bounds(struct iwkv_cursor *cur) {
+  struct sblk *sb = cur->cn;
+  struct iwdb *db = cur->lx.db;
+  if (  !sb || (sb->flags & SBLK_DB) || (cur->cnpos >= sb->pnum)
+     || ((cur->bnd_addr == sb->addr) && (cur->bnd_wgen == db->wgen))) {
+    return 0;
+  }
+  bool in;
+  uint8_t *mm;
+  IWFS_FSM *fsm = &db->iwkv->fsm;
+  iwrc rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+  RCRET(rc);
+  if (!sb->kvblk) {
+    RCC(rc, finish, _sblk_loadkvblk_mm(&cur->lx, sb, mm));
+  }
+  RCC(rc, finish, _cursor_rec_in_bounds_mm(cur, sb->pnum - 1, mm, &in));
+  if (in) {
+    RCC(rc, finish, _cursor_rec_in_bounds_mm(cur, 0, mm, &in));
+    if (in) {
+      cur->bnd_addr = sb->addr;
+      cur->bnd_wgen = db->wgen;
+      goto finish;
+    }
+  }
+  RCC(rc, finish, _cursor_rec_in_bounds_mm(cur, cur->cnpos, mm, &in));
+  if (!in) {
+    rc = IWKV_ERROR_NOTFOUND;
+  }
+
+finish:
+  IWRC(fsm->release_mmap(fsm), rc);
+  return rc;
+}
+
+/** Checks if the current cursor record of `IWDB_EXPIRING_VALUES` database has expired. */
+static WUR iwrc _cursor_is_expired(struct iwkv_cursor *cur, bool *ores) {
+  struct sblk *sb = cur->cn;
+  struct iwdb *db = cur->lx.db;
+  *ores = false;
+  if (!sb || (sb->flags & SBLK_DB) || (cur->cnpos >= sb->pnum)) {
+    return 0;
+  }
+  uint8_t *mm;
+  IWFS_FSM *fsm = &db->iwkv->fsm;
+  iwrc rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+  RCRET(rc);
+  rc = _sblk_loadkvblk_mm(&cur->lx, sb, mm);
+  if (!rc) {
+    *ores = _sblk_is_expired_mm(sb, cur->cnpos, mm);
+  }
+  IWRC(fsm->release_mmap(fsm), rc);
+  return rc;
+}
+
+/**
+ * Positions cursor at the record found by `IWKV_CURSOR_GE` lookup of the given `key`.
+ * Cursor node is left empty if there is no such record.
+ */
+static WUR iwrc _cursor_ge_lr(struct iwkv_cursor *cur, const struct iwkv_val *key) {
+  struct iwlctx *lx = &cur->lx;
+  const struct iwkv_val *pkey = lx->key;
+  lx->key = key;
+  iwrc rc = _cursor_get_ge_idx(lx, IWKV_CURSOR_GE, &cur->cnpos);
+  lx->key = pkey;
+  if (lx->upper) {
+    _sblk_release(lx, &lx->upper);
+  }
+  if (!rc) {
+    cur->cn = lx->lower;
+    cur->dbaddr = 0;
+    lx->lower = 0;
+  } else if (lx->lower) {
+    _sblk_release(lx, &lx->lower);
+  }
+  return rc;
+}
+
+/**
+ * Moves cursor positioned by `IWKV_CURSOR_BEFORE_FIRST` or `IWKV_CURSOR_AFTER_LAST`
+ * to the corresponding edge of cursor range.
+ */
+static WUR iwrc _cursor_to_bounds_lr(struct iwkv_cursor *cur, IWKV_cursor_op op) {
+  iwrc rc = 0;
+  struct iwdb *db = cur->lx.db;
+  if (op == IWKV_CURSOR_BEFORE_FIRST) {
+    // Records preceding the least key following prefixed keys are out of range
+    if (!cur->prefix_sk.size) {
+      return 0;
+    }
+    rc = _cursor_ge_lr(cur, &cur->prefix_sk);
+    if (rc == IWKV_ERROR_NOTFOUND) {
+      cur->dbaddr = db->addr;
+      cur->cnpos = db->idxnum - 1;
+      rc = 0;
+    }
+    return rc;
+  }
+  // IWKV_CURSOR_AFTER_LAST, find the last record preceding both range edges
+  const struct iwkv_val *key = cur->end.data ? &cur->end : &cur->prefix;
+  if (  cur->end.data && cur->prefix.data
+     && (_cmp_keys(db->dbflg, cur->end.data, (int) cur->end.size, &cur->prefix) > 0)) {
+    key = &cur->prefix;
+  }
+  cur->dbaddr = 0;
+  rc = _cursor_ge_lr(cur, key);
+  if (rc == IWKV_ERROR_NOTFOUND) {
+    return 0;
+  }
+  RCRET(rc);
+  rc = _cursor_check_bounds(cur);
+  if (!rc) {
+    cur->skip_next = -1;
+  } else if (rc == IWKV_ERROR_NOTFOUND) {
+    rc = 0;
+  }
+  return rc;
+}
+
+IW_INLINE void _madvise_willneed(uint8_t *mm, size_t msz, off_t addr, off_t len) {
+#if !defined(_WIN32) && defined(MADV_WILLNEED)
+  size_t psz = iwp_page_size();
+  off_t paddr = IW_ROUNDOWN(addr, psz);
+  if (addr + len > msz) {
+    len = msz - addr;
+  }
+  if (len > 0) {
+    madvise(mm + paddr, IW_ROUNDUP(addr + len - paddr, psz), MADV_WILLNEED);
+  }
+#endif
+}
+
+/**
+ * Hints OS to read ahead up to `cur->ra` nodes following the current cursor node
+ * in the direction `dir` of its movement along with their `KVBLK` blocks.
+ * Readahead window is extended by one node on every node change. Block of the node
+ * is prefetched in two steps: its head first, then the whole block using size from the head.
+ */
+static void _cursor_readahead(struct iwkv_cursor *cur, int8_t dir) {
+#if !defined(_WIN32) && defined(MADV_WILLNEED)
+  uint8_t *mm;
+  size_t msz;
+  struct iwdb *db = cur->lx.db;
+  IWFS_FSM *fsm = &db->iwkv->fsm;
+  int32_t fmt = db->iwkv->fmt_version;
+  blkn_t dblk = ADDR2BLK(db->addr);
+  if (fsm->acquire_mmap(fsm, 0, &mm, &msz)) {
+    return;
+  }
+  if ((cur->ra_dir != dir) || (cur->ra_wgen != db->wgen) || !cur->ra_num) {
+    cur->ra_dir = dir;
+    cur->ra_wgen = db->wgen;
+    cur->ra_num = 0;
+    cur->ra_blkn = ADDR2BLK(cur->cn->addr);
+    cur->ra_kvblkn = 0;
+  } else {
+    --cur->ra_num;
+  }
+  while (cur->ra_blkn && cur->ra_num < cur->ra) {
+    blkn_t n, kvblkn;
+    off_t addr = BLK2ADDR(cur->ra_blkn);
+    if (addr + SBLK_SZ > msz) {
+      break;
+    }
+    n = _blkn_read(mm + addr + (dir > 0 ? SOFF_N(fmt, 0) : SOFF_P0(fmt)), BLKN_SZ(fmt));
+    kvblkn = _blkn_read(mm + addr + SOFF_KBLK(fmt), BLKN_SZ(fmt));
+    if (cur->ra_kvblkn) {
+      off_t kaddr = BLK2ADDR(cur->ra_kvblkn);
+      uint8_t szpow = kaddr < msz ? *(mm + kaddr + KBLK_SZPOW_OFF) : 0;
+      if (szpow && (szpow < 32)) {
+        _madvise_willneed(mm, msz, kaddr, 1LL << szpow);
+      }
+    }
+    cur->ra_kvblkn = kvblkn;
+    if (kvblkn) {
+      _madvise_willneed(mm, msz, BLK2ADDR(kvblkn), KVBLK_HDRSZ);
+    }
+    if (!n || (n == dblk)) {
+      cur->ra_blkn = 0;
+      break;
+    }
+    _madvise_willneed(mm, msz, BLK2ADDR(n), SBLK_SZ);
+    cur->ra_blkn = n;
+    ++cur->ra_num;
+  }
+  fsm->release_mmap(fsm);
+#endif
+}
+
 static WUR iwrc _cursor_to_lr(struct iwkv_cursor *cur, IWKV_cursor_op op) {
   iwrc rc = 0;
   struct iwdb *db = cur->lx.db;
@@ -2759,12 +4732,20 @@ static WUR iwrc _cursor_to_lr(struct iwkv_cursor *cur, IWKV_cursor_op op) {
     }
     if (op == IWKV_CURSOR_BEFORE_FIRST) {
       cur->dbaddr = db->addr;
-      cur->cnpos = KVBLK_IDXNUM - 1;
+      cur->cnpos = db->idxnum - 1;
     } else {
       cur->dbaddr = -1; // Negative as sign of dbtail
       cur->cnpos = 0;
     }
-    return 0;
+    cur->skip_next = 0;
+    cur->ra_num = 0;
+    if (_cursor_has_bounds(cur)) {
+      rc = _cursor_to_bounds_lr(cur, op);
+      if (rc && cur->cn) {
+        _sblk_release(lx, &cur->cn);
+      }
+    }
+    return rc;
   }
 
 start:
@@ -2797,6 +4778,9 @@ start:
         if (IW_UNLIKELY(!cur->cn->pnum)) {
           goto start;
         }
+        if (cur->ra) {
+          _cursor_readahead(cur, 1);
+        }
       } else {
         if (cur->cn->flags & SBLK_DB) {
           rc = IWKV_ERROR_NOTFOUND;
@@ -2823,6 +4807,9 @@ start:
         } else {
           goto start;
         }
+        if (cur->ra) {
+          _cursor_readahead(cur, -1);
+        }
       } else {
         if (cur->cn->flags & SBLK_DB) {
           rc = IWKV_ERROR_NOTFOUND;
@@ -2844,10 +4831,30 @@ start:
       cur->cn = lx->lower;
       lx->lower = 0;
     }
+    cur->ra_num = 0;
   }
 
 finish:
   cur->skip_next = 0;
+  if (!rc && _cursor_has_bounds(cur)) {
+    rc = _cursor_check_bounds(cur);
+  }
+  if (!rc && (db->dbflg & IWDB_EXPIRING_VALUES)) {
+    bool expired;
+    rc = _cursor_is_expired(cur, &expired);
+    if (!rc && expired) {
+      if (op == IWKV_CURSOR_EQ) {
+        _sblk_release(lx, &cur->cn);
+        rc = IWKV_ERROR_NOTFOUND;
+      } else {
+        // Records following `IWKV_CURSOR_GE` position are visited by `IWKV_CURSOR_PREV`
+        if (op == IWKV_CURSOR_GE) {
+          op = IWKV_CURSOR_PREV;
+        }
+        goto start;
+      }
+    }
+  }
   if (rc && (rc != IWKV_ERROR_NOTFOUND)) {
     if (cur->cn) {
       _sblk_release(lx, &cur->cn);
@@ -2887,6 +4894,10 @@ static const char* _kv_ecodefn(locale_t locale, uint32_t ecode) {
       return "Operation requires WAL enabled database. (IWKV_ERROR_WAL_MODE_REQUIRED)";
     case IWKV_ERROR_BACKUP_IN_PROGRESS:
       return "Backup operation in progress. (IWKV_ERROR_BACKUP_IN_PROGRESS)";
+    case IWKV_ERROR_DB_NOT_EMPTY:
+      return "Database is not empty (IWKV_ERROR_DB_NOT_EMPTY)";
+    case IWKV_ERROR_KEYS_ORDER:
+      return "Keys are not in strictly ascending database order (IWKV_ERROR_KEYS_ORDER)";
     default:
       break;
   }
@@ -2902,8 +4913,14 @@ iwrc iwkv_init(void) {
 }
 
 static off_t _szpolicy(off_t nsize, off_t csize, struct IWFS_EXT *f, void **_ctx) {
+  if (nsize < 0) {
+    return 0; // dispose
+  }
   off_t res;
   size_t aunit = iwp_alloc_unit();
+  struct iwkv *iwkv = *_ctx;
+  // Files of formats prior to v5 are limited by 32 bit block numbers
+  off_t maxsz = (iwkv && iwkv->fmt_version < 5) ? IWKV_MAX_DBSZ : IWKV_MAX_DBSZ_V5;
   if (csize < 0x4000000) { // Doubled alloc up to 64M
     res = csize ? csize : aunit;
     while (res < nsize) {
@@ -2913,6 +4930,9 @@ static off_t _szpolicy(off_t nsize, off_t csize, struct IWFS_EXT *f, void **_ctx
     res = nsize + 10L * 1024 * 1024; // + 10M extra space
   }
   res = IW_ROUNDUP(res, aunit);
+  if (res > maxsz) {
+    res = IW_ROUNDOWN(maxsz, aunit); // Resize fails if `nsize` doesn't fit
+  }
   return res;
 }
 
@@ -2933,6 +4953,119 @@ iwrc iwkv_online_backup(struct iwkv *iwkv, uint64_t *ts, const char *target_file
   return iwal_online_backup(iwkv, ts, target_file);
 }
 
+//--------------------------  Format conversion
+
+struct _convert_db {
+  dbid_t       id;
+  iwdb_flags_t dbflg;
+};
+
+struct _convert_ctx {
+  struct iwkv_cursor *cur;
+  struct iwkv_val     key;
+  struct iwkv_val     val;
+};
+
+static iwrc _convert_next(struct iwkv_val *key, struct iwkv_val *val, void *op) {
+  struct _convert_ctx *ctx = op;
+  _kv_dispose(&ctx->key, &ctx->val);
+  iwrc rc = iwkv_cursor_to(ctx->cur, IWKV_CURSOR_NEXT);
+  RCRET(rc);
+  rc = iwkv_cursor_get(ctx->cur, &ctx->key, &ctx->val);
+  RCRET(rc);
+  *key = ctx->key;
+  *val = ctx->val;
+  return 0;
+}
+
+static iwrc _convert_db(struct iwdb *sdb, struct iwkv *tkv) {
+  struct iwdb *tdb;
+  struct _convert_ctx ctx = { 0 };
+  iwrc rc = iwkv_db(tkv, sdb->id, sdb->dbflg, &tdb);
+  RCRET(rc);
+  if (sdb->meta_blkn) {
+    size_t sz = BLK2ADDR(sdb->meta_blkn), rsz;
+    void *buf = malloc(sz);
+    if (!buf) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    rc = iwkv_db_get_meta(sdb, buf, sz, &rsz);
+    if (!rc && rsz) {
+      rc = iwkv_db_set_meta(tdb, buf, rsz);
+    }
+    free(buf);
+    RCRET(rc);
+  }
+  rc = iwkv_cursor_open(sdb, &ctx.cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  RCRET(rc);
+  // Expired records are skipped by cursor, expiration time of others is kept
+  rc = iwkv_bulk_load(tdb, _convert_next, &ctx, (sdb->dbflg & IWDB_EXPIRING_VALUES) ? IWKV_VAL_EXPIRE : 0);
+  _kv_dispose(&ctx.key, &ctx.val);
+  IWRC(iwkv_cursor_close(&ctx.cur), rc);
+  return rc;
+}
+
+iwrc iwkv_convert(struct iwkv *iwkv, const struct iwkv_opts *opts) {
+  if (!iwkv || !opts || !opts->path || (opts->oflags & IWKV_RDONLY)) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  int rci;
+  iwrc rc = 0;
+  size_t num = 0;
+  struct iwkv *tkv = 0;
+  struct _convert_db *dbs = 0;
+  struct iwkv_opts topts = *opts;
+  IWFS_FSM_STATE fstate = { 0 };
+  topts.oflags |= IWKV_TRUNC;
+
+  API_RLOCK(iwkv, rci);
+  rc = iwkv->fsm.state(&iwkv->fsm, &fstate);
+  if (!rc && !strcmp(fstate.exfile.file.opts.path, opts->path)) {
+    rc = IW_ERROR_INVALID_ARGS; // Refuse to truncate the source
+  }
+  if (rc) {
+    API_UNLOCK(iwkv, rci, rc);
+    return rc;
+  }
+  for (struct iwdb *db = iwkv->first_db; db; db = db->next) {
+    ++num;
+  }
+  if (num) {
+    dbs = malloc(num * sizeof(*dbs));
+    if (!dbs) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    } else {
+      num = 0;
+      for (struct iwdb *db = iwkv->first_db; db; db = db->next, ++num) {
+        dbs[num].id = db->id;
+        dbs[num].dbflg = db->dbflg;
+      }
+    }
+  }
+  API_UNLOCK(iwkv, rci, rc);
+  RCRET(rc);
+
+  RCC(rc, finish, iwkv_open(&topts, &tkv));
+  for (size_t i = 0; i < num; ++i) {
+    struct iwdb *sdb;
+    RCC(rc, finish, _api_rlock(iwkv));
+    sdb = iwhmap_get_u32(iwkv->dbs, dbs[i].id);
+    API_UNLOCK(iwkv, rci, rc);
+    RCGO(rc, finish);
+    if (!sdb) { // Database destroyed in the meantime
+      continue;
+    }
+    RCC(rc, finish, _convert_db(sdb, tkv));
+  }
+
+finish:
+  if (tkv) {
+    IWRC(iwkv_close(&tkv), rc);
+  }
+  free(dbs);
+  return rc;
+}
+
 static iwrc _iwkv_check_online_backup(const char *path, iwp_lockmode extra_lock_flags, bool *out_has_online_bkp) {
   size_t sp;
   uint32_t lv;
@@ -3048,31 +5181,278 @@ static iwrc _iwkv_check_online_backup(const char *path, iwp_lockmode extra_lock_
       if (sp > fsz) {
         sp = fsz;
       }
-      fsz -= sp;
-      rc = iwp_write(fw.fh, buf, sp);
-      RCGO(rc, finish);
-    } while (fsz > 0 && sp > 0);
+      fsz -= sp;
+      rc = iwp_write(fw.fh, buf, sp);
+      RCGO(rc, finish);
+    } while (fsz > 0 && sp > 0);
+  }
+  rc = iwp_fsync(fw.fh);
+  RCGO(rc, finish);
+
+  rc = iwp_ftruncate(fs.fh, waloff);
+  RCGO(rc, finish);
+
+  rc = iwp_fsync(fs.fh);
+  RCGO(rc, finish);
+
+finish:
+  if (f.impl) {
+    IWRC(f.close(&f), rc);
+  }
+  if (w.impl) {
+    IWRC(w.close(&w), rc);
+  }
+  free(wpath);
+  return rc;
+}
+
+//--------------------------  Expired records reaper
+
+// Max number of `SBLK` nodes scanned by one reaper step
+#define REAP_NODES 64
+
+/** Converts key `_kvblk_key_get()` into effective key used in lookups. */
+static void _reap_ekey(struct iwdb *db, struct iwkv_val *key) {
+  if (db->dbflg & IWDB_COMPOUND_KEYS) {
+    int step;
+    IW_READVNUMBUF64(key->data, key->compound, step);
+    key->size -= step;
+    memmove(key->data, (uint8_t*) key->data + step, key->size);
+  }
+}
+
+/**
+ * Deletes expired records of up to `REAP_NODES` nodes starting from the node of `rkey` key.
+ * Nodes are scanned under database read lock, expired records of every node are deleted
+ * under a single write lock. `rkey` is set to the last scanned key, `odone` is set
+ * when the last database node is scanned.
+ */
+static iwrc _db_reap_step(struct iwdb *db, uint64_t now, struct iwkv_val *rkey, uint64_t *ocnt, bool *odone) {
+  int rci;
+  iwrc rc = 0;
+  uint8_t *mm = 0;
+  size_t num = 0, ngrp = 0, gend[REAP_NODES];
+  struct sblk sb;
+  struct iwkv_val *keys;
+  IWFS_FSM *fsm = &db->iwkv->fsm;
+  struct iwlctx lx = {
+    .db = db,
+    .nlvl = -1
+  };
+  *odone = false;
+
+  keys = malloc(REAP_NODES * db->idxnum * sizeof(*keys));
+  if (!keys) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  rc = _api_db_rlock(db);
+  RCGO(rc, finish);
+  off_t addr = db->addr;
+  if (rkey->size) {
+    lx.key = rkey;
+    rc = _lx_find_bounds(&lx);
+    if (!rc) {
+      addr = lx.lower->addr;
+    }
+    _lx_release_mm(&lx, 0);
+    lx.key = 0;
+    RCGO(rc, unlock);
+  }
+  RCC(rc, unlock, _sblk_at2(&lx, addr, 0, &sb));
+  RCC(rc, unlock, fsm->acquire_mmap(fsm, 0, &mm, 0));
+  for (int n = 0; n < REAP_NODES; ++n) {
+    if (!(sb.flags & SBLK_DB) && sb.pnum) {
+      RCC(rc, unlock, _sblk_loadkvblk_mm(&lx, &sb, mm));
+      for (uint8_t i = 0; i < sb.pnum; ++i) {
+        if (_sblk_expired_at_mm(&sb, i, mm, now)) {
+          RCC(rc, unlock, _kvblk_key_get(sb.kvblk, mm, sb.pi[i], &keys[num]));
+          _reap_ekey(db, &keys[num++]);
+        }
+      }
+      if (num > (ngrp ? gend[ngrp - 1] : 0)) {
+        gend[ngrp++] = num;
+      }
+      _kv_val_dispose(rkey);
+      RCC(rc, unlock, _kvblk_key_get(sb.kvblk, mm, sb.pi[sb.pnum - 1], rkey));
+      _reap_ekey(db, rkey);
+      sb.kvblk = 0;
+    }
+    if (!sb.n[0]) {
+      *odone = true;
+      break;
+    }
+    RCC(rc, unlock, _sblk_at2(&lx, BLK2ADDR(sb.n[0]), 0, &sb));
+  }
+
+unlock:
+  if (mm) {
+    fsm->release_mmap(fsm);
+  }
+  API_DB_UNLOCK(db, rci, rc);
+
+  for (size_t g = 0, i = 0; !rc && g < ngrp; ++g) {
+    rc = _api_db_wlock(db);
+    RCBREAK(rc);
+    for ( ; i < gend[g]; ++i) {
+      struct iwlctx dlx = {
+        .db = db,
+        .key = &keys[i],
+        .nlvl = -1,
+        .op = IWLCTX_DEL,
+        .reap_ts = now
+      };
+      rc = _lx_del_lw(&dlx);
+      if (!rc) {
+        ++*ocnt;
+      } else if (rc == IWKV_ERROR_NOTFOUND) {
+        rc = 0; // Record is updated or deleted since scan
+      } else {
+        break;
+      }
+    }
+    API_DB_UNLOCK(db, rci, rc);
+  }
+  if (!rc && ngrp) {
+    rc = iwal_poke_checkpoint(db->iwkv, false);
+  }
+
+finish:
+  for (size_t i = 0; i < num; ++i) {
+    _kv_val_dispose(&keys[i]);
+  }
+  free(keys);
+  return rc;
+}
+
+iwrc iwkv_db_reap(struct iwdb *db, uint64_t *ocount) {
+  if (!db || !db->iwkv) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  if (!(db->dbflg & IWDB_EXPIRING_VALUES)) {
+    return IWKV_ERROR_INCOMPATIBLE_DB_MODE;
+  }
+  if (db->iwkv->oflags & IWKV_RDONLY) {
+    return IW_ERROR_READONLY;
+  }
+  iwrc rc = 0;
+  bool done = false;
+  uint64_t cnt = 0, now = _expire_now();
+  struct iwkv_val rkey = { 0 };
+  while (!rc && !done) {
+    rc = _db_reap_step(db, now, &rkey, &cnt, &done);
+  }
+  _kv_val_dispose(&rkey);
+  if (ocount) {
+    *ocount = cnt;
+  }
+  return rc;
+}
+
+/** Runs reaper pass over all `IWDB_EXPIRING_VALUES` databases. */
+static iwrc _reaper_pass(struct iwkv *iwkv) {
+  iwrc rc = 0;
+  size_t num = 0;
+  dbid_t *ids = 0;
+  uint64_t now = _expire_now();
+
+  // Databases are created and destroyed under exclusive lock
+  rc = _api_enter(iwkv);
+  RCRET(rc);
+  for (struct iwdb *db = iwkv->first_db; db; db = db->next) {
+    if (db->dbflg & IWDB_EXPIRING_VALUES) {
+      dbid_t *nids = realloc(ids, (num + 1) * sizeof(*ids));
+      if (!nids) {
+        rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+        break;
+      }
+      ids = nids;
+      ids[num++] = db->id;
+    }
   }
-  rc = iwp_fsync(fw.fh);
-  RCGO(rc, finish);
+  _api_leave(iwkv);
 
-  rc = iwp_ftruncate(fs.fh, waloff);
-  RCGO(rc, finish);
+  for (size_t i = 0; !rc && i < num; ++i) {
+    bool done = false;
+    uint64_t cnt = 0;
+    struct iwkv_val rkey = { 0 };
+    while (!rc && !done && iwkv->open) {
+      // `reaper_mtx` keeps database from being destroyed by `iwkv_db_destroy()`
+      pthread_mutex_lock(&iwkv->reaper_mtx);
+      rc = _api_enter(iwkv);
+      if (!rc) {
+        struct iwdb *db = iwhmap_get_u32(iwkv->dbs, ids[i]);
+        _api_leave(iwkv);
+        if (db) {
+          rc = _db_reap_step(db, now, &rkey, &cnt, &done);
+        } else {
+          done = true;
+        }
+      }
+      pthread_mutex_unlock(&iwkv->reaper_mtx);
+    }
+    _kv_val_dispose(&rkey);
+  }
+  free(ids);
+  return rc;
+}
 
-  rc = iwp_fsync(fs.fh);
-  RCGO(rc, finish);
+static void* _reaper_fn(void *op) {
+  iwp_set_current_thread_name("iwkv::REAP");
+  struct iwkv *iwkv = op;
+  pthread_mutex_lock(&iwkv->reaper_mtx);
+  while (iwkv->open) {
+    struct timespec tp;
+    iwrc rc = iwp_clock_get_time(CLOCK_REALTIME, &tp);
+    if (rc) {
+      iwlog_ecode_error3(rc);
+      break;
+    }
+    tp.tv_sec += iwkv->reaper_interval_sec;
+    pthread_cond_timedwait(&iwkv->reaper_cond, &iwkv->reaper_mtx, &tp);
+    if (!iwkv->open) {
+      break;
+    }
+    pthread_mutex_unlock(&iwkv->reaper_mtx);
+    rc = _reaper_pass(iwkv);
+    if (rc && iwkv->open) {
+      iwlog_ecode_error2(rc, "Expired records reaper error\n");
+    }
+    pthread_mutex_lock(&iwkv->reaper_mtx);
+  }
+  pthread_mutex_unlock(&iwkv->reaper_mtx);
+  return 0;
+}
 
-finish:
-  if (f.impl) {
-    IWRC(f.close(&f), rc);
+/** Starts reaper thread if it is enabled and not started yet. */
+static iwrc _reaper_start(struct iwkv *iwkv) {
+  iwrc rc = 0;
+  if ((iwkv->reaper_interval_sec < 0) || (iwkv->oflags & IWKV_RDONLY)) {
+    return 0;
   }
-  if (w.impl) {
-    IWRC(w.close(&w), rc);
+  pthread_mutex_lock(&iwkv->reaper_mtx);
+  if (!iwkv->reaper_started) {
+    int rci = pthread_create(&iwkv->reaper, 0, _reaper_fn, iwkv);
+    if (rci) {
+      rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+    } else {
+      iwkv->reaper_started = true;
+    }
   }
-  free(wpath);
+  pthread_mutex_unlock(&iwkv->reaper_mtx);
   return rc;
 }
 
+static void _reaper_stop(struct iwkv *iwkv) {
+  pthread_mutex_lock(&iwkv->reaper_mtx);
+  bool started = iwkv->reaper_started;
+  iwkv->reaper_started = false;
+  pthread_cond_broadcast(&iwkv->reaper_cond);
+  pthread_mutex_unlock(&iwkv->reaper_mtx);
+  if (started) {
+    pthread_join(iwkv->reaper, 0);
+  }
+}
+
 iwrc iwkv_open(const struct iwkv_opts *opts, struct iwkv **iwkvp) {
   if (!opts || !iwkvp || !opts->path) {
     return IW_ERROR_INVALID_ARGS;
@@ -3121,6 +5501,9 @@ iwrc iwkv_open(const struct iwkv_opts *opts, struct iwkv **iwkvp) {
     iwlog_ecode_error3(rc);
     return rc;
   }
+  if (opts->ext_value_threshold) {
+    iwkv->ext_value_threshold = MAX(opts->ext_value_threshold, IWKV_EXT_VALUE_MIN_THRESHOLD);
+  }
 
   pthread_rwlockattr_t attr;
   pthread_rwlockattr_init(&attr);
@@ -3145,6 +5528,24 @@ iwrc iwkv_open(const struct iwkv_opts *opts, struct iwkv **iwkvp) {
     free(*iwkvp);
     return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
   }
+  rci = pthread_mutex_init(&iwkv->reaper_mtx, 0);
+  if (rci) {
+    pthread_rwlock_destroy(&iwkv->rwl);
+    pthread_mutex_destroy(&iwkv->wk_mtx);
+    pthread_cond_destroy(&iwkv->wk_cond);
+    free(*iwkvp);
+    return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+  }
+  rci = pthread_cond_init(&iwkv->reaper_cond, 0);
+  if (rci) {
+    pthread_rwlock_destroy(&iwkv->rwl);
+    pthread_mutex_destroy(&iwkv->wk_mtx);
+    pthread_cond_destroy(&iwkv->wk_cond);
+    pthread_mutex_destroy(&iwkv->reaper_mtx);
+    free(*iwkvp);
+    return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+  }
+  iwkv->reaper_interval_sec = opts->reaper_interval_sec ? opts->reaper_interval_sec : 60;
 
   iwkv->oflags = oflags;
   IWFS_FSM_STATE fsmstate;
@@ -3156,7 +5557,8 @@ iwrc iwkv_open(const struct iwkv_opts *opts, struct iwkv **iwkvp) {
         .lock_mode = (oflags & IWKV_RDONLY) ? IWP_RLOCK : IWP_WLOCK
       },
       .rspolicy = _szpolicy,
-      .maxoff = IWKV_MAX_DBSZ,
+      .rspolicy_ctx = iwkv,
+      .maxoff = IWKV_MAX_DBSZ_V5,
       .use_locks = true
     },
     .bpow = IWKV_FSM_BPOW,          // 64 bytes block size
@@ -3226,15 +5628,48 @@ finish:
   return rc;
 }
 
+// Max number of stores a thread tracks nested API calls for
+#define API_RREFS_NUM 4
+
+static atomic_uint _api_rslot_seq;
+
+/** Shared user registrations of the current thread */
+static _Thread_local struct {
+  int idx;                               /**< Reader slot index, -1 if not assigned yet */
+  struct iwkv_rref refs[API_RREFS_NUM];  /**< Registrations, entry is free if its `depth` is zero */
+  struct iwkv_rref spill;                /**< Untracked registration used if all `refs` are busy */
+} _api_tls = { .idx = -1 };
+
+struct iwkv_rref* _api_rref(struct iwkv *iwkv) {
+  struct iwkv_rref *ref = 0;
+  if (IW_UNLIKELY(_api_tls.idx < 0)) {
+    _api_tls.idx = (int) (atomic_fetch_add(&_api_rslot_seq, 1) & (IWKV_RSLOTS_NUM - 1));
+  }
+  for (int i = 0; i < API_RREFS_NUM; ++i) {
+    struct iwkv_rref *r = &_api_tls.refs[i];
+    if (r->depth == 0) {
+      if (!ref) {
+        ref = r;
+      }
+    } else if (r->iwkv == iwkv) {
+      return r;
+    }
+  }
+  if (ref) {
+    ref->iwkv = iwkv;
+  } else {
+    ref = &_api_tls.spill;
+  }
+  ref->slot = &iwkv->rslots[_api_tls.idx];
+  return ref;
+}
+
 iwrc iwkv_exclusive_lock(struct iwkv *iwkv) {
   return _wnw(iwkv, _wnw_iwkw_wl);
 }
 
 iwrc iwkv_exclusive_unlock(struct iwkv *iwkv) {
-  int rci;
-  iwrc rc = 0;
-  API_UNLOCK(iwkv, rci, rc);
-  return rc;
+  return _api_excl_unlock(iwkv);
 }
 
 iwrc iwkv_close(struct iwkv **iwkvp) {
@@ -3244,6 +5679,7 @@ iwrc iwkv_close(struct iwkv **iwkvp) {
     return IW_ERROR_INVALID_STATE;
   }
   iwal_shutdown(iwkv);
+  _reaper_stop(iwkv);
   iwrc rc = iwkv_exclusive_lock(iwkv);
   RCRET(rc);
   struct iwdb *db = iwkv->first_db;
@@ -3263,6 +5699,8 @@ iwrc iwkv_close(struct iwkv **iwkvp) {
   pthread_rwlock_destroy(&iwkv->rwl);
   pthread_mutex_destroy(&iwkv->wk_mtx);
   pthread_cond_destroy(&iwkv->wk_cond);
+  pthread_mutex_destroy(&iwkv->reaper_mtx);
+  pthread_cond_destroy(&iwkv->reaper_cond);
   free(iwkv);
   *iwkvp = 0;
   return rc;
@@ -3275,13 +5713,14 @@ static iwrc _iwkv_sync(struct iwkv *iwkv, iwfs_sync_flags _flags) {
   }
   iwrc rc;
   if (iwkv->dlsnr) {
-    rc = iwal_poke_savepoint(iwkv);
+    rc = iwal_commit(iwkv);
   } else {
     IWFS_FSM *fsm = &iwkv->fsm;
-    pthread_rwlock_wrlock(&iwkv->rwl);
+    rc = _api_excl_lock(iwkv);
+    RCRET(rc);
     iwfs_sync_flags flags = IWFS_FDATASYNC | _flags;
     rc = fsm->sync(fsm, flags);
-    pthread_rwlock_unlock(&iwkv->rwl);
+    IWRC(_api_excl_unlock(iwkv), rc);
   }
   return rc;
 }
@@ -3299,10 +5738,11 @@ iwrc iwkv_sync(struct iwkv *iwkv, iwfs_sync_flags _flags) {
     iwkv_exclusive_unlock(iwkv);
   } else {
     IWFS_FSM *fsm = &iwkv->fsm;
-    pthread_rwlock_wrlock(&iwkv->rwl);
+    rc = _api_excl_lock(iwkv);
+    RCRET(rc);
     iwfs_sync_flags flags = IWFS_FDATASYNC | _flags;
     rc = fsm->sync(fsm, flags);
-    pthread_rwlock_unlock(&iwkv->rwl);
+    IWRC(_api_excl_unlock(iwkv), rc);
   }
   return rc;
 }
@@ -3323,7 +5763,7 @@ iwrc iwkv_db(struct iwkv *iwkv, uint32_t dbid, iwdb_flags_t dbflg, struct iwdb *
       return IWKV_ERROR_INCOMPATIBLE_DB_MODE;
     }
     *dbp = db;
-    return 0;
+    return (dbflg & IWDB_EXPIRING_VALUES) ? _reaper_start(iwkv) : 0;
   }
   if (iwkv->oflags & IWKV_RDONLY) {
     return IW_ERROR_READONLY;
@@ -3344,6 +5784,9 @@ iwrc iwkv_db(struct iwkv *iwkv, uint32_t dbid, iwdb_flags_t dbflg, struct iwdb *
     rc = iwal_savepoint_exl(iwkv, true);
   }
   iwkv_exclusive_unlock(iwkv);
+  if (!rc && (dbflg & IWDB_EXPIRING_VALUES)) {
+    rc = _reaper_start(iwkv);
+  }
   return rc;
 }
 
@@ -3375,6 +5818,9 @@ iwrc iwkv_new_db(struct iwkv *iwkv, iwdb_flags_t dbflg, uint32_t *dbidp, struct
     rc = iwal_savepoint_exl(iwkv, true);
   }
   iwkv_exclusive_unlock(iwkv);
+  if (!rc && (dbflg & IWDB_EXPIRING_VALUES)) {
+    rc = _reaper_start(iwkv);
+  }
   return rc;
 }
 
@@ -3389,61 +5835,474 @@ iwrc iwkv_db_destroy(struct iwdb **dbp) {
   if (iwkv->oflags & IWKV_RDONLY) {
     return IW_ERROR_READONLY;
   }
-  iwrc rc = iwkv_exclusive_lock(iwkv);
-  RCRET(rc);
-  rc = _db_destroy_lw(&db);
-  iwkv_exclusive_unlock(iwkv);
-  return rc;
+  // Wait for reaper leaving database
+  pthread_mutex_lock(&iwkv->reaper_mtx);
+  iwrc rc = iwkv_exclusive_lock(iwkv);
+  if (!rc) {
+    rc = _db_destroy_lw(&db);
+    iwkv_exclusive_unlock(iwkv);
+  }
+  pthread_mutex_unlock(&iwkv->reaper_mtx);
+  return rc;
+}
+
+/**
+ * Gets expiration time of value `val` stored with `opflags`.
+ */
+static WUR iwrc _db_value_expire(
+  struct iwdb *db, const struct iwkv_val *val, iwkv_opflags opflags,
+  uint64_t *oexpire) {
+  *oexpire = 0;
+  if (!(opflags & IWKV_VAL_EXPIRE)) {
+    return 0;
+  }
+  if (!(db->dbflg & IWDB_EXPIRING_VALUES)) {
+    return IWKV_ERROR_INCOMPATIBLE_DB_MODE;
+  }
+  *oexpire = val->expire;
+  return 0;
+}
+
+iwrc iwkv_puth(
+  struct iwdb *db, const struct iwkv_val *key, const struct iwkv_val *val,
+  iwkv_opflags opflags, IWKV_PUT_HANDLER ph, void *phop) {
+  if (!db || !db->iwkv || !key || !key->size || !val) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  struct iwkv *iwkv = db->iwkv;
+  if (iwkv->oflags & IWKV_RDONLY) {
+    return IW_ERROR_READONLY;
+  }
+  if (opflags & IWKV_VAL_INCREMENT) {
+    // No overwrite for increment
+    opflags &= ~IWKV_NO_OVERWRITE;
+  }
+
+  int rci;
+  uint64_t expire;
+  struct iwkv_val ekey;
+  uint8_t nbuf[IW_VNUMBUFSZ];
+  iwrc rc = _db_value_expire(db, val, opflags, &expire);
+  RCRET(rc);
+  rc = _to_effective_key(db, key, &ekey, nbuf);
+  RCRET(rc);
+
+  struct iwlctx lx = {
+    .db = db,
+    .key = &ekey,
+    .val = (struct iwkv_val*) val,
+    .nlvl = -1,
+    .op = IWLCTX_PUT,
+    .opflags = opflags,
+    .ph = ph,
+    .phop = phop,
+    .expire = expire
+  };
+  API_DB_WLOCK(db, rci);
+  rc = _lx_put_lw(&lx);
+  API_DB_UNLOCK(db, rci, rc);
+  if (!rc) {
+    if (lx.opflags & IWKV_SYNC) {
+      rc = _iwkv_sync(iwkv, 0);
+    } else {
+      rc = iwal_poke_checkpoint(iwkv, false);
+    }
+  }
+  return rc;
+}
+
+iwrc iwkv_put(struct iwdb *db, const struct iwkv_val *key, const struct iwkv_val *val, iwkv_opflags opflags) {
+  return iwkv_puth(db, key, val, opflags, 0, 0);
+}
+
+struct _batch_entry {
+  struct iwkv_val ekey;
+  size_t  idx;
+  uint8_t nbuf[IW_VNUMBUFSZ];
+};
+
+static int _batch_entry_cmp(const void *o1, const void *o2, void *op) {
+  const struct _batch_entry *e1 = *(struct _batch_entry**) o1;
+  const struct _batch_entry *e2 = *(struct _batch_entry**) o2;
+  int rv = _cmp_ekeys(*(iwdb_flags_t*) op, &e1->ekey, &e2->ekey);
+  if (rv) {
+    return rv;
+  }
+  // Keep original order of the same keys
+  return e1->idx < e2->idx ? -1 : e1->idx > e2->idx ? 1 : 0;
+}
+
+/**
+ * Creates array of `num` batch entries sorted in the database key order.
+ * Key of i-th entry is located at `keys + i * stride` address.
+ * Returned array must be freed by `free()`.
+ */
+static iwrc _batch_create(
+  struct iwdb *db, const void *keys, size_t stride, size_t num,
+  struct _batch_entry ***oea) {
+  iwrc rc = 0;
+  bool sorted = true;
+  iwdb_flags_t dbflg = db->dbflg;
+  struct _batch_entry **ea = malloc(num * (sizeof(*ea) + sizeof(**ea)));
+  if (!ea) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  struct _batch_entry *entries = (void*) (ea + num);
+  for (size_t i = 0; i < num; ++i) {
+    struct _batch_entry *e = &entries[i];
+    const struct iwkv_val *key = (const void*) ((const char*) keys + i * stride);
+    if (!key->size) {
+      rc = IW_ERROR_INVALID_ARGS;
+      goto finish;
+    }
+    e->idx = i;
+    rc = _to_effective_key(db, key, &e->ekey, e->nbuf);
+    RCGO(rc, finish);
+    ea[i] = e;
+    if (sorted && i && (_cmp_ekeys(dbflg, &entries[i - 1].ekey, &e->ekey) > 0)) {
+      sorted = false;
+    }
+  }
+  if (!sorted) {
+    sort_r(ea, num, sizeof(*ea), _batch_entry_cmp, &dbflg);
+  }
+
+finish:
+  if (rc) {
+    free(ea);
+  } else {
+    *oea = ea;
+  }
+  return rc;
+}
+
+iwrc iwkv_put_batch(struct iwdb *db, const struct iwkv_kv *kvs, size_t num, iwkv_opflags opflags) {
+  if (!db || !db->iwkv || (!kvs && num)) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  struct iwkv *iwkv = db->iwkv;
+  if (iwkv->oflags & IWKV_RDONLY) {
+    return IW_ERROR_READONLY;
+  }
+  if (!num) {
+    return 0;
+  }
+  if (opflags & IWKV_VAL_INCREMENT) {
+    // No overwrite for increment
+    opflags &= ~IWKV_NO_OVERWRITE;
+  }
+
+  if ((opflags & IWKV_VAL_EXPIRE) && !(db->dbflg & IWDB_EXPIRING_VALUES)) {
+    return IWKV_ERROR_INCOMPATIBLE_DB_MODE;
+  }
+
+  int rci;
+  struct _batch_entry **ea = 0;
+  iwrc rc = _batch_create(db, &kvs[0].key, sizeof(kvs[0]), num, &ea);
+  RCRET(rc);
+
+  struct lxfinger finger = {
+    .lvl = -1
+  };
+  struct iwlctx lx = {
+    .db = db,
+    .nlvl = -1,
+    .op = IWLCTX_PUT,
+    .finger = &finger
+  };
+  rc = _api_db_wlock(db);
+  RCGO(rc, finish);
+  for (size_t i = 0; i < num; ++i) {
+    lx.key = &ea[i]->ekey;
+    lx.val = (struct iwkv_val*) &kvs[ea[i]->idx].val;
+    lx.opflags = opflags;
+    lx.expire = (opflags & IWKV_VAL_EXPIRE) ? lx.val->expire : 0;
+    lx.nlvl = -1;
+    lx.lower = 0;
+    lx.upper = 0;
+    rc = _lx_finger_start(&lx);
+    if (rc) {
+      _lx_release_mm(&lx, 0);
+      break;
+    }
+    rc = _lx_put_lw(&lx);
+    RCBREAK(rc);
+  }
+  API_DB_UNLOCK(db, rci, rc);
+  if (!rc) {
+    if (opflags & IWKV_SYNC) {
+      rc = _iwkv_sync(iwkv, 0);
+    } else {
+      rc = iwal_poke_checkpoint(iwkv, false);
+    }
+  }
+
+finish:
+  free(ea);
+  return rc;
+}
+
+struct _bulk_kv {
+  size_t  koff; /**< Key offset in staging buffer, value follows key */
+  size_t  ksz;
+  size_t  vsz;
+  int64_t compound;
+};
+
+struct _bulk_ctx {
+  struct iwlctx  *lx;
+  struct _bulk_kv kvs[KVBLK_IDXNUM_MAX]; /**< Records staged for the next block */
+  struct _bulk_kv prev;              /**< Last record of the previous block */
+  uint8_t *buf;                      /**< Staging buffer */
+  uint8_t *pbuf;                     /**< Packed value buffer */
+  size_t   bufsz;
+  size_t   bufcap;
+  off_t    paddr;                    /**< Address of current `SBLK` page */
+  off_t    last[SLEVELS];            /**< Addresses of the last blocks per level */
+  int      num;                      /**< Number of staged records */
+  uint8_t  ppos;                     /**< Last used slot in the current `SBLK` page */
+  bool     has_prev;
+};
+
+static WUR iwrc _bulk_flush(struct _bulk_ctx *bc) {
+  iwrc rc;
+  uint8_t *mm;
+  struct sblk *sb;
+  struct iwlctx *lx = bc->lx;
+  struct iwdb *db = lx->db;
+  struct iwdlsnr *dlsnr = db->iwkv->dlsnr;
+  IWFS_FSM *fsm = &db->iwkv->fsm;
+
+  size_t sz = KVBLK_MAX_NKV_SZ_N(db->idxnum);
+  for (int i = 0; i < bc->num; ++i) {
+    sz += IW_VNUMSIZE(bc->kvs[i].ksz) + bc->kvs[i].ksz;
+    sz += _kvblk_is_ext_value(db, bc->kvs[i].vsz) ? _kvblk_ext_ref_sz(db->iwkv->fmt_version) : bc->kvs[i].vsz;
+  }
+  uint8_t kvbpow = (uint8_t) iwlog2_64(sz);
+  while ((1ULL << kvbpow) < sz) kvbpow++;
+
+  if (!bc->paddr || (bc->ppos >= SBLK_PAGE_SBLK_NUM_V2)) {
+    off_t blen;
+    rc = fsm->allocate(fsm, SBLK_PAGE_SZ_V2, &bc->paddr, &blen, IWKV_FSM_ALLOC_FLAGS);
+    RCRET(rc);
+    rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+    RCRET(rc);
+    memset(mm + bc->paddr, 0, blen);
+    if (dlsnr) {
+      rc = dlsnr->onset(dlsnr, bc->paddr, 0, blen, 0);
+    }
+    fsm->release_mmap(fsm);
+    RCRET(rc);
+    bc->ppos = 0;
+  }
+  ++bc->ppos;
+  uint8_t lvl = _sblk_genlevel(db);
+  rc = _sblk_create_v1(lx, lvl, kvbpow, bc->paddr + (bc->ppos - 1) * SBLK_SZ, bc->ppos, &sb);
+  RCRET(rc);
+  for (int i = 0; i < bc->num; ++i) {
+    struct _bulk_kv *kv = &bc->kvs[i];
+    struct iwkv_val key = {
+      .data = bc->buf + kv->koff,
+      .size = kv->ksz,
+      .compound = kv->compound
+    };
+    struct iwkv_val val = {
+      .data = bc->buf + kv->koff + kv->ksz,
+      .size = kv->vsz
+    };
+    rc = _sblk_addkv2(sb, (int8_t) i, &key, &val, 0);
+    RCRET(rc);
+  }
+
+  // Link new block as the last one on all its levels
+  blkn_t nblk = ADDR2BLK(sb->addr);
+  sb->p0 = ADDR2BLK(bc->last[0]);
+  rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+  RCRET(rc);
+  for (int i = 0; i <= lvl; ++i) {
+    if (bc->last[i] == db->addr) {
+      lx->dblk.n[i] = nblk;
+      lx->dblk.flags |= SBLK_DURTY;
+    } else {
+      off_t noff = bc->last[i] + SOFF_N(db->iwkv->fmt_version, i);
+      size_t bsz = BLKN_SZ(db->iwkv->fmt_version);
+      _sbc_invalidate(db, bc->last[i]);
+      _blkn_write(mm + noff, bsz, nblk);
+      if (dlsnr) {
+        rc = dlsnr->onwrite(dlsnr, noff, mm + noff, bsz, 0);
+        RCGO(rc, finish);
+      }
+    }
+    bc->last[i] = sb->addr;
+  }
+  rc = _sblk_sync_and_release_mm(lx, &sb, mm);
+  if (!rc) {
+    rc = _db_rcnt_add_mm(db, bc->num, mm);
+  }
+
+  // Keep the last key for order checking
+  bc->prev = bc->kvs[bc->num - 1];
+  memmove(bc->buf, bc->buf + bc->prev.koff, bc->prev.ksz);
+  bc->prev.koff = 0;
+  bc->has_prev = true;
+  bc->bufsz = bc->prev.ksz;
+  bc->num = 0;
+
+finish:
+  fsm->release_mmap(fsm);
+  return rc;
+}
+
+static WUR iwrc _bulk_add(struct _bulk_ctx *bc, const struct iwkv_val *key, const struct iwkv_val *val) {
+  iwrc rc;
+  struct iwkv_val ekey, pval;
+  uint8_t nbuf[IW_VNUMBUFSZ];
+  struct iwdb *db = bc->lx->db;
+
+  rc = _to_effective_key(db, key, &ekey, nbuf);
+  RCRET(rc);
+  if (db->dbflg & (IWDB_COMPRESSED_VALUES | IWDB_EXPIRING_VALUES)) {
+    rc = _kvblk_value_pack(db, val, (bc->lx->opflags & IWKV_VAL_EXPIRE) ? val->expire : 0, &pval, &bc->pbuf);
+    RCRET(rc);
+    val = &pval;
+  }
+  size_t ksize = ekey.size;
+  if (db->dbflg & IWDB_COMPOUND_KEYS) {
+    ksize += IW_VNUMSIZE(ekey.compound);
+  }
+  if (IW_VNUMSIZE(ksize) + ksize + val->size > IWKV_MAX_KVSZ) {
+    return IWKV_ERROR_MAXKVSZ;
+  }
+  struct _bulk_kv *pkv = bc->num ? &bc->kvs[bc->num - 1] : bc->has_prev ? &bc->prev : 0;
+  if (pkv) {
+    struct iwkv_val pkey = {
+      .data = bc->buf + pkv->koff,
+      .size = pkv->ksz,
+      .compound = pkv->compound
+    };
+    if (_cmp_ekeys(db->dbflg, &pkey, &ekey) >= 0) {
+      return IWKV_ERROR_KEYS_ORDER;
+    }
+  }
+  if (bc->num == db->idxnum) {
+    rc = _bulk_flush(bc);
+    RCRET(rc);
+  }
+  size_t nsz = bc->bufsz + ekey.size + val->size;
+  if (nsz > bc->bufcap) {
+    size_t ncap = MAX(nsz, 2 * bc->bufcap);
+    uint8_t *nbuf = realloc(bc->buf, ncap);
+    if (!nbuf) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    bc->buf = nbuf;
+    bc->bufcap = ncap;
+  }
+  struct _bulk_kv *kv = &bc->kvs[bc->num++];
+  kv->koff = bc->bufsz;
+  kv->ksz = ekey.size;
+  kv->vsz = val->size;
+  kv->compound = ekey.compound;
+  memcpy(bc->buf + bc->bufsz, ekey.data, ekey.size);
+  if (val->size) {
+    memcpy(bc->buf + bc->bufsz + ekey.size, val->data, val->size);
+  }
+  bc->bufsz = nsz;
+  return 0;
 }
 
-iwrc iwkv_puth(
-  struct iwdb *db, const struct iwkv_val *key, const struct iwkv_val *val,
-  iwkv_opflags opflags, IWKV_PUT_HANDLER ph, void *phop) {
-  if (!db || !db->iwkv || !key || !key->size || !val) {
+iwrc iwkv_bulk_load(struct iwdb *db, IWKV_BULK_LOAD_FN fn, void *op, iwkv_opflags opflags) {
+  if (!db || !db->iwkv || !fn) {
     return IW_ERROR_INVALID_ARGS;
   }
   struct iwkv *iwkv = db->iwkv;
   if (iwkv->oflags & IWKV_RDONLY) {
     return IW_ERROR_READONLY;
   }
-  if (opflags & IWKV_VAL_INCREMENT) {
-    // No overwrite for increment
-    opflags &= ~IWKV_NO_OVERWRITE;
-  }
 
   int rci;
-  struct iwkv_val ekey;
-  uint8_t nbuf[IW_VNUMBUFSZ];
-  iwrc rc = _to_effective_key(db, key, &ekey, nbuf);
-  RCRET(rc);
-
+  uint8_t *mm;
+  struct sblk *s;
+  IWFS_FSM *fsm = &iwkv->fsm;
+  if ((opflags & IWKV_VAL_EXPIRE) && !(db->dbflg & IWDB_EXPIRING_VALUES)) {
+    return IWKV_ERROR_INCOMPATIBLE_DB_MODE;
+  }
   struct iwlctx lx = {
     .db = db,
-    .key = &ekey,
-    .val = (struct iwkv_val*) val,
     .nlvl = -1,
     .op = IWLCTX_PUT,
-    .opflags = opflags,
-    .ph = ph,
-    .phop = phop
+    .opflags = opflags
   };
-  API_DB_WLOCK(db, rci);
-  rc = _lx_put_lw(&lx);
+  struct _bulk_ctx bc = {
+    .lx = &lx
+  };
+  for (int i = 0; i < SLEVELS; ++i) {
+    bc.last[i] = db->addr;
+  }
+
+  iwrc rc = _api_db_wlock(db);
+  RCRET(rc);
+  rc = _sblk_at(&lx, db->addr, 0, &s);
+  RCGO(rc, finish);
+  memcpy(&lx.dblk, s, sizeof(lx.dblk));
+  if (lx.dblk.n[0]) {
+    rc = IWKV_ERROR_DB_NOT_EMPTY;
+    goto finish;
+  }
+
+  while (1) {
+    struct iwkv_val key = { 0 }, val = { 0 };
+    rc = fn(&key, &val, op);
+    if (rc == IWKV_ERROR_NOTFOUND) {
+      rc = 0;
+      break;
+    }
+    RCBREAK(rc);
+    if (!key.size || (val.size && !val.data)) {
+      rc = IW_ERROR_INVALID_ARGS;
+      break;
+    }
+    rc = _bulk_add(&bc, &key, &val);
+    RCBREAK(rc);
+  }
+  if (!rc && bc.num) {
+    rc = _bulk_flush(&bc);
+  }
+
+  // Finalize the loaded part of skiplist: tail back pointer and database block levels
+  if (bc.last[0] != db->addr) {
+    struct sblk *tail;
+    IWRC(_sblk_at(&lx, 0, 0, &tail), rc);
+    if (tail) {
+      tail->p0 = ADDR2BLK(bc.last[0]);
+      tail->flags |= SBLK_DURTY;
+      iwrc rc2 = fsm->acquire_mmap(fsm, 0, &mm, 0);
+      if (!rc2) {
+        rc2 = _sblk_sync_mm(&lx, tail, mm);
+        IWRC(_sblk_sync_mm(&lx, &lx.dblk, mm), rc2);
+        fsm->release_mmap(fsm);
+      }
+      IWRC(rc2, rc);
+    }
+  }
+  if (!rc && db->bloom) {
+    rc = _bloom_build_lw(db);
+  }
+
+finish:
   API_DB_UNLOCK(db, rci, rc);
+  free(bc.buf);
+  free(bc.pbuf);
   if (!rc) {
-    if (lx.opflags & IWKV_SYNC) {
+    if (iwkv->dlsnr) {
+      rc = iwal_poke_checkpoint(iwkv, true);
+    } else if (opflags & IWKV_SYNC) {
       rc = _iwkv_sync(iwkv, 0);
-    } else {
-      rc = iwal_poke_checkpoint(iwkv, false);
     }
   }
   return rc;
 }
 
-iwrc iwkv_put(struct iwdb *db, const struct iwkv_val *key, const struct iwkv_val *val, iwkv_opflags opflags) {
-  return iwkv_puth(db, key, val, opflags, 0, 0);
-}
-
 iwrc iwkv_get(struct iwdb *db, const struct iwkv_val *key, struct iwkv_val *oval) {
   if (!db || !db->iwkv || !key || !oval) {
     return IW_ERROR_INVALID_ARGS;
@@ -3477,8 +6336,7 @@ iwrc iwkv_get_copy(struct iwdb *db, const struct iwkv_val *key, void *vbuf, size
   int rci;
   bool found;
   struct iwkv_val ekey;
-  uint32_t ovalsz;
-  uint8_t *mm = 0, *oval, idx;
+  uint8_t *mm = 0, idx;
   IWFS_FSM *fsm = &db->iwkv->fsm;
   uint8_t nbuf[IW_VNUMBUFSZ];
   iwrc rc = _to_effective_key(db, key, &ekey, nbuf);
@@ -3490,18 +6348,20 @@ iwrc iwkv_get_copy(struct iwdb *db, const struct iwkv_val *key, void *vbuf, size
     .nlvl = -1
   };
   API_DB_RLOCK(db, rci);
+  if (_bloom_rejects(db, &ekey)) {
+    rc = IWKV_ERROR_NOTFOUND;
+    goto finish;
+  }
   rc = _lx_find_bounds(&lx);
   RCGO(rc, finish);
   rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
   RCGO(rc, finish);
   rc = _sblk_loadkvblk_mm(&lx, lx.lower, mm);
   RCGO(rc, finish);
-  rc = _sblk_find_pi_mm(lx.lower, &lx, mm, &found, &idx);
+  rc = _sblk_find_pi_fp_mm(lx.lower, &lx, mm, &found, &idx);
   RCGO(rc, finish);
-  if (found) {
-    _kvblk_value_peek(lx.lower->kvblk, lx.lower->pi[idx], mm, &oval, &ovalsz);
-    *vsz = ovalsz;
-    memcpy(vbuf, oval, MIN(vbufsz, ovalsz));
+  if (found && !_sblk_is_expired_mm(lx.lower, idx, mm)) {
+    rc = _kvblk_value_copy(lx.lower->kvblk, lx.lower->pi[idx], mm, vbuf, vbufsz, vsz);
   } else {
     rc = IWKV_ERROR_NOTFOUND;
   }
@@ -3515,6 +6375,98 @@ finish:
   return rc;
 }
 
+iwrc iwkv_get_multi(struct iwdb *db, const struct iwkv_val *keys, size_t num, struct iwkv_val *vals, iwrc *rcs) {
+  if (!db || !db->iwkv || ((!keys || !vals) && num)) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  for (size_t i = 0; i < num; ++i) {
+    vals[i].data = 0;
+    vals[i].size = 0;
+    vals[i].compound = 0;
+    if (rcs) {
+      rcs[i] = 0;
+    }
+  }
+  if (!num) {
+    return 0;
+  }
+
+  int rci;
+  bool found;
+  uint8_t *mm, idx;
+  off_t pfaddr = 0;
+  struct _batch_entry **ea = 0;
+  IWFS_FSM *fsm = &db->iwkv->fsm;
+  iwrc rc = _batch_create(db, keys, sizeof(keys[0]), num, &ea);
+  RCRET(rc);
+
+  struct lxfinger finger = {
+    .lvl = -1
+  };
+  struct iwlctx lx = {
+    .db = db,
+    .finger = &finger
+  };
+  rc = _api_db_rlock(db);
+  RCGO(rc, finish);
+  for (size_t i = 0; i < num; ++i) {
+    size_t vidx = ea[i]->idx;
+    lx.key = &ea[i]->ekey;
+    lx.val = &vals[vidx];
+    lx.nlvl = -1;
+    lx.lower = 0;
+    lx.upper = 0;
+    if (_bloom_rejects(db, lx.key)) {
+      if (rcs) {
+        rcs[vidx] = IWKV_ERROR_NOTFOUND;
+      }
+      continue;
+    }
+    rc = _lx_finger_start(&lx);
+    if (!rc) {
+      rc = _lx_find_bounds(&lx);
+    }
+    if (!rc) {
+      rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+      if (!rc) {
+        rc = _sblk_loadkvblk_mm(&lx, lx.lower, mm);
+        if (!rc) {
+          rc = _sblk_find_pi_fp_mm(lx.lower, &lx, mm, &found, &idx);
+        }
+        if (!rc) {
+          if (found && !_sblk_is_expired_mm(lx.lower, idx, mm)) {
+            rc = _kvblk_value_get(lx.lower->kvblk, mm, lx.lower->pi[idx], lx.val);
+          } else if (rcs) {
+            rcs[vidx] = IWKV_ERROR_NOTFOUND;
+          }
+        }
+        if (!rc && lx.upper && (lx.upper->addr != pfaddr) && (i < num - 1)) {
+          pfaddr = lx.upper->addr;
+          _lx_prefetch_mm(&lx, mm);
+        }
+        IWRC(fsm->release_mmap(fsm), rc);
+      }
+    }
+    _lx_release_mm(&lx, 0);
+    if (rc) {
+      if (rcs) {
+        rcs[vidx] = rc;
+      }
+      break;
+    }
+  }
+  API_DB_UNLOCK(db, rci, rc);
+
+finish:
+  if (rc) {
+    for (size_t i = 0; i < num; ++i) {
+      _kv_val_dispose(&vals[i]);
+    }
+  }
+  free(ea);
+  return rc;
+}
+
 iwrc iwkv_db_set_meta(struct iwdb *db, void *buf, size_t sz) {
   if (!db || !db->iwkv || !buf) {
     return IW_ERROR_INVALID_ARGS;
@@ -3554,11 +6506,13 @@ iwrc iwkv_db_set_meta(struct iwdb *db, void *buf, size_t sz) {
     RCGO(rc, finish);
   }
   if (resized) {
-    uint32_t lv;
-    wp = mm + db->addr + DOFF_METABLK_U4;
+    size_t bsz = BLKN_SZ(db->iwkv->fmt_version);
+    wp = mm + db->addr + DOFF_METABLK(db->iwkv->fmt_version);
     sp = wp;
-    IW_WRITELV(wp, lv, db->meta_blk);
-    IW_WRITELV(wp, lv, db->meta_blkn);
+    _blkn_write(wp, bsz, db->meta_blk);
+    wp += bsz;
+    _blkn_write(wp, bsz, db->meta_blkn);
+    wp += bsz;
     if (db->iwkv->dlsnr) {
       rc = db->iwkv->dlsnr->onwrite(db->iwkv->dlsnr, sp - mm, sp, wp - sp, 0);
       RCGO(rc, finish);
@@ -3608,6 +6562,140 @@ finish:
   return rc;
 }
 
+iwrc iwkv_db_cache_stats(struct iwdb *db, struct iwkv_db_cache_stats *stats) {
+  if (!db || !stats) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  stats->hits = 0;
+  stats->misses = 0;
+  struct sblk_cache *sbc = atomic_load_explicit(&db->sbc, memory_order_acquire);
+  if (sbc) {
+    for (int i = 0; i < SBLK_CACHE_LOCKS; ++i) {
+      struct sblk_cstripe *stripe = &sbc->stripes[i];
+      pthread_spin_lock(&stripe->slk);
+      stats->hits += stripe->hits;
+      stats->misses += stripe->misses;
+      pthread_spin_unlock(&stripe->slk);
+    }
+  }
+  stats->bloom_negatives = atomic_load_explicit(&db->bloom_negatives, memory_order_relaxed);
+  return 0;
+}
+
+iwrc iwkv_db_set_bloom(struct iwdb *db, uint8_t bits_per_key) {
+  if (!db || !db->iwkv) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  if (db->dbflg & IWDB_REALNUM_KEYS) {
+    return IW_ERROR_UNSUPPORTED;
+  }
+  int rci;
+  iwrc rc = 0;
+  API_DB_WLOCK(db, rci);
+  db->bloom_bpk = bits_per_key;
+  if (bits_per_key) {
+    rc = _bloom_build_lw(db);
+  } else {
+    _bloom_destroy(db);
+  }
+  API_DB_UNLOCK(db, rci, rc);
+  return rc;
+}
+
+iwrc iwkv_db_count(struct iwdb *db, uint64_t *ocount) {
+  if (!db || !db->iwkv || !ocount) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  int rci;
+  iwrc rc = 0;
+  uint64_t cnt = 0;
+  bool rdonly = db->iwkv->oflags & IWKV_RDONLY;
+  *ocount = 0;
+
+  API_DB_RLOCK(db, rci);
+  if (db->rcnt_valid) {
+    *ocount = db->rcnt;
+    API_DB_UNLOCK(db, rci, rc);
+    return rc;
+  }
+  API_DB_UNLOCK(db, rci, rc);
+  RCRET(rc);
+
+  // Database created by previous library version, count records once
+  struct iwlctx lx = {
+    .db = db,
+    .nlvl = -1
+  };
+  if (rdonly) {
+    API_DB_RLOCK(db, rci);
+  } else {
+    API_DB_WLOCK(db, rci);
+  }
+  if (db->rcnt_valid) {
+    cnt = db->rcnt;
+  } else {
+    rc = _db_rcnt_scan_lr(&lx, &cnt);
+    if (!rc && !rdonly) {
+      uint8_t *mm;
+      IWFS_FSM *fsm = &db->iwkv->fsm;
+      rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
+      if (!rc) {
+        db->rcnt = cnt;
+        db->rcnt_valid = true;
+        rc = _db_save(db, false, mm);
+        fsm->release_mmap(fsm);
+      }
+    }
+  }
+  API_DB_UNLOCK(db, rci, rc);
+  if (!rc) {
+    *ocount = cnt;
+  }
+  return rc;
+}
+
+iwrc iwkv_db_estimate(
+  struct iwdb           *db,
+  const struct iwkv_val *lo,
+  const struct iwkv_val *hi,
+  uint64_t              *ocount,
+  uint64_t              *obytes) {
+  if (!db || !db->iwkv) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  int rci;
+  struct iwkv_val elo, ehi;
+  uint8_t lnbuf[IW_VNUMBUFSZ], hnbuf[IW_VNUMBUFSZ];
+  uint64_t count = 0, bytes = 0;
+  iwrc rc = 0;
+
+  if (lo) {
+    rc = _to_effective_key(db, lo, &elo, lnbuf);
+    RCRET(rc);
+  }
+  if (hi) {
+    rc = _to_effective_key(db, hi, &ehi, hnbuf);
+    RCRET(rc);
+  }
+  struct iwlctx lx = {
+    .db = db,
+    .nlvl = -1
+  };
+  API_DB_RLOCK(db, rci);
+  rc = _db_estimate_lr(&lx, lo ? &elo : 0, hi ? &ehi : 0, &count, &bytes);
+  if (!lo && !hi && db->rcnt_valid) {
+    count = db->rcnt;
+  }
+  API_DB_UNLOCK(db, rci, rc);
+  if (ocount) {
+    *ocount = count;
+  }
+  if (obytes) {
+    *obytes = bytes;
+  }
+  return rc;
+}
+
 iwrc iwkv_del(struct iwdb *db, const struct iwkv_val *key, iwkv_opflags opflags) {
   if (!db || !db->iwkv || !key) {
     return IW_ERROR_INVALID_ARGS;
@@ -3639,6 +6727,45 @@ iwrc iwkv_del(struct iwdb *db, const struct iwkv_val *key, iwkv_opflags opflags)
   return rc;
 }
 
+iwrc iwkv_del_range(
+  struct iwdb *db, const struct iwkv_val *lo, const struct iwkv_val *hi,
+  iwkv_opflags opflags) {
+  if (!db || !db->iwkv) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  int rci;
+  struct iwkv_val elo, ehi;
+  struct iwkv *iwkv = db->iwkv;
+  uint8_t lnbuf[IW_VNUMBUFSZ], hnbuf[IW_VNUMBUFSZ];
+  iwrc rc = 0;
+
+  if (lo) {
+    rc = _to_effective_key(db, lo, &elo, lnbuf);
+    RCRET(rc);
+  }
+  if (hi) {
+    rc = _to_effective_key(db, hi, &ehi, hnbuf);
+    RCRET(rc);
+  }
+  struct iwlctx lx = {
+    .db = db,
+    .nlvl = -1,
+    .op = IWLCTX_DEL,
+    .opflags = opflags
+  };
+  API_DB_WLOCK(db, rci);
+  rc = _lx_del_range_lw(&lx, lo ? &elo : 0, hi ? &ehi : 0);
+  API_DB_UNLOCK(db, rci, rc);
+  if (!rc) {
+    if (lx.opflags & IWKV_SYNC) {
+      rc = _iwkv_sync(iwkv, 0);
+    } else {
+      rc = iwal_poke_checkpoint(iwkv, false);
+    }
+  }
+  return rc;
+}
+
 IW_INLINE iwrc _cursor_close_lw(struct iwkv_cursor *cur) {
   iwrc rc = 0;
   cur->closed = true;
@@ -3658,11 +6785,71 @@ IW_INLINE iwrc _cursor_close_lw(struct iwkv_cursor *cur) {
   return rc;
 }
 
+IW_INLINE void _cursor_dispose(struct iwkv_cursor *cur) {
+  free(cur->end.data);
+  free(cur->prefix.data);
+  free(cur);
+}
+
+static iwrc _cursor_init_opts(struct iwkv_cursor *cur, const struct iwkv_cursor_opts *opts) {
+  struct iwdb *db = cur->lx.db;
+  cur->ra = opts->readahead;
+  cur->end_incl = opts->end_inclusive;
+  if (opts->end) {
+    uint8_t nbuf[IW_VNUMBUFSZ];
+    struct iwkv_val ekey;
+    iwrc rc = _to_effective_key(db, opts->end, &ekey, nbuf);
+    RCRET(rc);
+    cur->end.data = malloc(ekey.size ? ekey.size : 1);
+    if (!cur->end.data) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    memcpy(cur->end.data, ekey.data, ekey.size);
+    cur->end.size = ekey.size;
+    cur->end.compound = ekey.compound;
+  }
+  if (opts->prefix && opts->prefix->size) {
+    if (db->dbflg & (IWDB_COMPOUND_KEYS | IWDB_VNUM64_KEYS | IWDB_REALNUM_KEYS)) {
+      return IW_ERROR_UNSUPPORTED;
+    }
+    size_t psz = opts->prefix->size;
+    uint8_t *p = malloc(2 * psz);
+    if (!p) {
+      return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    }
+    memcpy(p, opts->prefix->data, psz);
+    cur->prefix.data = p;
+    cur->prefix.size = psz;
+    // Least key following all prefixed keys: prefix with trailing 0xff bytes
+    // stripped and the last byte incremented
+    uint8_t *sk = p + psz;
+    memcpy(sk, p, psz);
+    while (psz && sk[psz - 1] == 0xff) {
+      --psz;
+    }
+    if (psz) {
+      ++sk[psz - 1];
+      cur->prefix_sk.data = sk;
+      cur->prefix_sk.size = psz;
+    }
+  }
+  return 0;
+}
+
 iwrc iwkv_cursor_open(
   struct iwdb           *db,
   struct iwkv_cursor   **curptr,
   enum iwkv_cursor_op    op,
   const struct iwkv_val *key) {
+  return iwkv_cursor_open2(db, curptr, op, key, 0);
+}
+
+iwrc iwkv_cursor_open2(
+  struct iwdb                   *db,
+  struct iwkv_cursor           **curptr,
+  enum iwkv_cursor_op            op,
+  const struct iwkv_val         *key,
+  const struct iwkv_cursor_opts *opts) {
   if (  !db || !db->iwkv || !curptr
      || (key && (op < IWKV_CURSOR_EQ)) || (op < IWKV_CURSOR_BEFORE_FIRST)) {
     return IW_ERROR_INVALID_ARGS;
@@ -3686,6 +6873,10 @@ iwrc iwkv_cursor_open(
   struct iwlctx *lx = &cur->lx;
   lx->db = db;
   lx->nlvl = -1;
+  if (opts) {
+    rc = _cursor_init_opts(cur, opts);
+    RCGO(rc, finish);
+  }
   if (key) {
     rc = _to_effective_key(db, key, &lx->ekey, lx->nbuf);
     RCGO(rc, finish);
@@ -3698,7 +6889,7 @@ finish:
     if (rc) {
       *curptr = 0;
       IWRC(_cursor_close_lw(cur), rc);
-      free(cur);
+      _cursor_dispose(cur);
     } else {
       pthread_spin_lock(&db->cursors_slk);
       cur->next = db->cursors;
@@ -3724,7 +6915,7 @@ iwrc iwkv_cursor_close(struct iwkv_cursor **curp) {
 
   struct iwkv *iwkv = cur->lx.db->iwkv;
   if (cur->closed) {
-    free(cur);
+    _cursor_dispose(cur);
     return 0;
   }
   if (!cur->lx.db) {
@@ -3734,7 +6925,7 @@ iwrc iwkv_cursor_close(struct iwkv_cursor **curp) {
   rc = _cursor_close_lw(cur);
   API_DB_UNLOCK(cur->lx.db, rci, rc);
   IWRC(_db_worker_dec_nolk(cur->lx.db), rc);
-  free(cur);
+  _cursor_dispose(cur);
   if (!rc) {
     rc = iwal_poke_checkpoint(iwkv, false);
   }
@@ -3798,7 +6989,13 @@ iwrc iwkv_cursor_get(
   }
   uint8_t idx = cur->cn->pi[cur->cnpos];
   if (okey && oval) {
-    rc = _kvblk_kv_get(cur->cn->kvblk, mm, idx, okey, oval);
+    rc = _kvblk_key_get(cur->cn->kvblk, mm, idx, okey);
+    if (!rc) {
+      rc = _kvblk_value_get(cur->cn->kvblk, mm, idx, oval);
+      if (rc) {
+        _kv_val_dispose(okey);
+      }
+    }
   } else if (oval) {
     rc = _kvblk_value_get(cur->cn->kvblk, mm, idx, oval);
   } else if (okey) {
@@ -3830,8 +7027,7 @@ iwrc iwkv_cursor_copy_val(struct iwkv_cursor *cur, void *vbuf, size_t vbufsz, si
   *vsz = 0;
   struct iwlctx *lx = &cur->lx;
   API_DB_RLOCK(lx->db, rci);
-  uint8_t *mm = 0, *oval;
-  uint32_t ovalsz;
+  uint8_t *mm = 0;
   IWFS_FSM *fsm = &lx->db->iwkv->fsm;
   rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
   RCGO(rc, finish);
@@ -3840,9 +7036,7 @@ iwrc iwkv_cursor_copy_val(struct iwkv_cursor *cur, void *vbuf, size_t vbufsz, si
     RCGO(rc, finish);
   }
   uint8_t idx = cur->cn->pi[cur->cnpos];
-  _kvblk_value_peek(cur->cn->kvblk, idx, mm, &oval, &ovalsz);
-  *vsz = ovalsz;
-  memcpy(vbuf, oval, MIN(vbufsz, ovalsz));
+  rc = _kvblk_value_copy(cur->cn->kvblk, idx, mm, vbuf, vbufsz, vsz);
 
 finish:
   if (mm) {
@@ -3870,7 +7064,7 @@ iwrc iwkv_cursor_is_matched_key(struct iwkv_cursor *cur, const struct iwkv_val *
   struct iwlctx *lx = &cur->lx;
   API_DB_RLOCK(lx->db, rci);
   uint8_t *mm = 0, *okey;
-  uint32_t okeysz;
+  uint32_t okeysz, okeypl;
   iwdb_flags_t dbflg = lx->db->dbflg;
   IWFS_FSM *fsm = &lx->db->iwkv->fsm;
   rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
@@ -3881,7 +7075,7 @@ iwrc iwkv_cursor_is_matched_key(struct iwkv_cursor *cur, const struct iwkv_val *
   }
 
   uint8_t idx = cur->cn->pi[cur->cnpos];
-  rc = _kvblk_key_peek(cur->cn->kvblk, idx, mm, &okey, &okeysz);
+  rc = _kvblk_key_peek(cur->cn->kvblk, idx, mm, &okey, &okeysz, &okeypl);
   RCGO(rc, finish);
 
   if (dbflg & (IWDB_COMPOUND_KEYS | IWDB_VNUM64_KEYS)) {
@@ -3903,7 +7097,9 @@ iwrc iwkv_cursor_is_matched_key(struct iwkv_cursor *cur, const struct iwkv_val *
       *ores = !memcmp(okey + (okeysz - rkey.size), key->data, key->size);
     }
   } else {
-    *ores = (okeysz == key->size) && !memcmp(okey, key->data, key->size);
+    *ores = (okeypl + okeysz == key->size)
+            && !memcmp(cur->cn->kvblk->rk, key->data, okeypl)
+            && !memcmp(okey, (uint8_t*) key->data + okeypl, okeysz);
   }
 
 finish:
@@ -3928,7 +7124,7 @@ iwrc iwkv_cursor_copy_key(struct iwkv_cursor *cur, void *kbuf, size_t kbufsz, si
   struct iwlctx *lx = &cur->lx;
   API_DB_RLOCK(lx->db, rci);
   uint8_t *mm = 0, *okey;
-  uint32_t okeysz;
+  uint32_t okeysz, okeypl;
   iwdb_flags_t dbflg = lx->db->dbflg;
   IWFS_FSM *fsm = &lx->db->iwkv->fsm;
   rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
@@ -3939,7 +7135,7 @@ iwrc iwkv_cursor_copy_key(struct iwkv_cursor *cur, void *kbuf, size_t kbufsz, si
   }
 
   uint8_t idx = cur->cn->pi[cur->cnpos];
-  rc = _kvblk_key_peek(cur->cn->kvblk, idx, mm, &okey, &okeysz);
+  rc = _kvblk_key_peek(cur->cn->kvblk, idx, mm, &okey, &okeysz, &okeypl);
   RCGO(rc, finish);
 
   if (dbflg & (IWDB_COMPOUND_KEYS | IWDB_VNUM64_KEYS)) {
@@ -3958,11 +7154,14 @@ iwrc iwkv_cursor_copy_key(struct iwkv_cursor *cur, void *kbuf, size_t kbufsz, si
       memcpy(kbuf, okey + (okeysz - rkey.size), MIN(kbufsz, rkey.size));
     }
   } else {
-    *ksz = okeysz;
+    *ksz = okeypl + okeysz;
     if (compound) {
       *compound = 0;
     }
-    memcpy(kbuf, okey, MIN(kbufsz, okeysz));
+    memcpy(kbuf, cur->cn->kvblk->rk, MIN(kbufsz, okeypl));
+    if (kbufsz > okeypl) {
+      memcpy((uint8_t*) kbuf + okeypl, okey, MIN(kbufsz - okeypl, okeysz));
+    }
   }
 
 finish:
@@ -3981,6 +7180,9 @@ IW_EXPORT iwrc iwkv_cursor_seth(
   if (!cur || !cur->lx.db) {
     return IW_ERROR_INVALID_ARGS;
   }
+  if (cur->lx.db->iwkv->oflags & IWKV_RDONLY) {
+    return IW_ERROR_READONLY;
+  }
   if (!cur->cn || (cur->cn->flags & SBLK_DB) || (cur->cnpos >= cur->cn->pnum)) {
     return IWKV_ERROR_NOTFOUND;
   }
@@ -3990,6 +7192,8 @@ IW_EXPORT iwrc iwkv_cursor_seth(
   struct iwkv *iwkv = db->iwkv;
   struct sblk *sblk = cur->cn;
 
+  rc = _db_value_expire(db, val, opflags, &lx->expire);
+  RCRET(rc);
   API_DB_WLOCK(db, rci);
   if (ph) {
     uint8_t *mm;
@@ -3997,7 +7201,13 @@ IW_EXPORT iwrc iwkv_cursor_seth(
     IWFS_FSM *fsm = &db->iwkv->fsm;
     rc = fsm->acquire_mmap(fsm, 0, &mm, 0);
     RCGO(rc, finish);
-    rc = _kvblk_kv_get(sblk->kvblk, mm, sblk->pi[cur->cnpos], &key, &oldval);
+    rc = _kvblk_key_get(sblk->kvblk, mm, sblk->pi[cur->cnpos], &key);
+    if (!rc) {
+      rc = _kvblk_value_get(sblk->kvblk, mm, sblk->pi[cur->cnpos], &oldval);
+      if (rc) {
+        _kv_val_dispose(&key);
+      }
+    }
     fsm->release_mmap(fsm);
     if (!rc) {
       // note: oldval should be disposed by ph
@@ -4007,6 +7217,8 @@ IW_EXPORT iwrc iwkv_cursor_seth(
     RCGO(rc, finish);
   }
 
+  rc = _lx_value_pack(lx, &val);
+  RCGO(rc, finish);
   rc = _sblk_updatekv(sblk, cur->cnpos, 0, val);
   if (IWKV_IS_INTERNAL_RC(rc)) {
     irc = rc;
@@ -4031,6 +7243,8 @@ IW_EXPORT iwrc iwkv_cursor_seth(
   pthread_spin_unlock(&db->cursors_slk);
 
 finish:
+  free(lx->pbuf);
+  lx->pbuf = 0;
   API_DB_UNLOCK(db, rci, rc);
   if (!rc) {
     if (opflags & IWKV_SYNC) {
@@ -4060,6 +7274,9 @@ iwrc iwkv_cursor_del(struct iwkv_cursor *cur, iwkv_opflags opflags) {
   if (!cur || !cur->lx.db) {
     return IW_ERROR_INVALID_ARGS;
   }
+  if (cur->lx.db->iwkv->oflags & IWKV_RDONLY) {
+    return IW_ERROR_READONLY;
+  }
   if (!cur->cn || (cur->cn->flags & SBLK_DB) || (cur->cnpos >= cur->cn->pnum)) {
     return IWKV_ERROR_NOTFOUND;
   }
@@ -4111,6 +7328,9 @@ finish2:
     RCGO(rc, finish);
     rc = _sblk_sync(lx, sblk);
   }
+  if (!rc) {
+    rc = _db_rcnt_add(db, -1);
+  }
 
 finish:
   API_DB_UNLOCK(db, rci, rc);
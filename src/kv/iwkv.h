@@ -85,6 +85,10 @@ typedef enum {
   /**< Operation requires WAL enabled database. (IWKV_ERROR_WAL_MODE_REQUIRED)
    */
   IWKV_ERROR_BACKUP_IN_PROGRESS,          /**< Backup operation in progress. (IWKV_ERROR_BACKUP_IN_PROGRESS) */
+  IWKV_ERROR_DB_NOT_EMPTY,                /**< Database is not empty (IWKV_ERROR_DB_NOT_EMPTY) */
+  IWKV_ERROR_KEYS_ORDER,
+  /**< Keys are not in strictly ascending database order
+     (IWKV_ERROR_KEYS_ORDER) */
   _IWKV_ERROR_END,
   // Internal only
   _IWKV_RC_KVBLOCK_FULL,
@@ -103,6 +107,21 @@ typedef uint8_t iwkv_openflags;
 /** Database initialization modes */
 typedef uint8_t iwdb_flags_t;
 
+/**
+ * Wide skiplist nodes holding up to 64 key/value pairs instead of 32.
+ * Gives a shorter nodes chain and better sequential locality for large read-mostly databases,
+ * at the cost of bigger blocks rewritten on every update and no key fingerprints.
+ * Requires storage format version 5 and above.
+ */
+#define IWDB_WIDE_NODES ((iwdb_flags_t) 0x08U)
+
+/**
+ * Records may have expiration time set by `IWKV_VAL_EXPIRE` put option.
+ * Expired records are not visible to lookups and cursors and deleted
+ * by background reaper, see `struct iwkv_opts.reaper_interval_sec`.
+ */
+#define IWDB_EXPIRING_VALUES ((iwdb_flags_t) 0x04U)
+
 /** Floating point number keys represented as string (char*) value. */
 #define IWDB_REALNUM_KEYS ((iwdb_flags_t) 0x10U)
 
@@ -116,6 +135,18 @@ typedef uint8_t iwdb_flags_t;
  */
 #define IWDB_COMPOUND_KEYS ((iwdb_flags_t) 0x40U)
 
+/**
+ * Store values compressed. Values smaller than `IWKV_COMPRESS_MIN_VALUE_SZ` bytes
+ * or not compressible are stored as is.
+ */
+#define IWDB_COMPRESSED_VALUES ((iwdb_flags_t) 0x80U)
+
+/** Min size of value compressed in `IWDB_COMPRESSED_VALUES` databases */
+#define IWKV_COMPRESS_MIN_VALUE_SZ 64U
+
+/** Min value of `struct iwkv_opts.ext_value_threshold` if it is set */
+#define IWKV_EXT_VALUE_MIN_THRESHOLD 1024U
+
 /**  Record store modes used in `iwkv_put()` and `iwkv_cursor_set()` functions. */
 typedef uint8_t iwkv_opflags;
 
@@ -123,13 +154,20 @@ typedef uint8_t iwkv_opflags;
    `IWKV_ERROR_KEY_EXISTS` will be returned in such cases. */
 #define IWKV_NO_OVERWRITE ((iwkv_opflags) 0x01U)
 
-/** Flush changes on disk after operation */
+/** Flush changes on disk after operation.
+    In WAL mode operation returns once WAL savepoint covering it is synced,
+    concurrent `IWKV_SYNC` writers share a single WAL sync.
+    If `iwkv_wal_opts.wal_lock_interceptor` is set WAL savepoint is only scheduled. */
 #define IWKV_SYNC ((iwkv_opflags) 0x04U)
 
 /** Increment/decrement stored UINT32|UINT64 value by given INT32|INT64 number
     `IWKV_ERROR_KEY_EXISTS` does not makes sense if this flag set. */
 #define IWKV_VAL_INCREMENT ((iwkv_opflags) 0x10U)
 
+/** Set record expiration time to `struct iwkv_val.expire` of stored value.
+    Supported only by databases created with `IWDB_EXPIRING_VALUES` flag. */
+#define IWKV_VAL_EXPIRE ((iwkv_opflags) 0x20U)
+
 struct iwkv;
 typedef struct iwkv*IWKV;
 
@@ -144,7 +182,12 @@ struct iwkv_wal_opts {
   bool     check_crc_on_checkpoint; /**< Check CRC32 sum of data blocks during checkpoint. Default: false */
   uint32_t savepoint_timeout_sec;   /**< Savepoint timeout seconds. Default: 10 sec */
   uint32_t checkpoint_timeout_sec;  /**< Checkpoint timeout seconds. Default: 300 sec (5 min); */
-  size_t   wal_buffer_sz;           /**< WAL file intermediate buffer size. Default: 8Mb */
+  /**
+   * WAL file intermediate buffer size. Default: 8Mb
+   * Two buffers of this size are used: filled buffer is written
+   * into WAL file by background writer thread while the other one accepts new records.
+   */
+  size_t   wal_buffer_sz;
   uint64_t checkpoint_buffer_sz;    /**< Checkpoint buffer size in bytes. Default: 1Gb */
   iwrc     (*wal_lock_interceptor)(bool, void*);
   /**< Optional function called
@@ -153,6 +196,11 @@ struct iwkv_wal_opts {
        exclusive database lock by WAL checkpoint thread.
        In the case of `before lock` first argument will be set to true */
   void *wal_lock_interceptor_opaque; /**< Opaque data for `wal_lock_interceptor` */
+  /**
+   * Time in microseconds a leader of `IWKV_SYNC` group commit waits for concurrent
+   * writers before WAL file sync. Default: 0
+   */
+  uint32_t commit_window_us;
 };
 
 typedef struct iwkv_wal_opts IWKV_WAL_OPTS;
@@ -171,6 +219,20 @@ struct iwkv_opts {
   int32_t fmt_version;
   iwkv_openflags oflags;            /**< Bitmask of database file open modes */
   bool file_lock_fail_fast;         /**< Do not wait and raise error if database is locked by another process */
+  /**
+   * Values of this size in bytes or larger are stored out of line in separate
+   * file extents referenced from `KVBLK`, so updates of neighbour records
+   * do not move them. Zero disables out of line storage.
+   * Smaller nonzero values are raised to `IWKV_EXT_VALUE_MIN_THRESHOLD`.
+   * Supported by storage format version 3 and above.
+   */
+  uint32_t ext_value_threshold;
+  /**
+   * Interval in seconds between runs of background reaper deleting expired records
+   * of `IWDB_EXPIRING_VALUES` databases. Reaper is started when such database is opened.
+   * Default: 60 sec. Negative value disables reaper.
+   */
+  int32_t reaper_interval_sec;
   struct iwkv_wal_opts wal;         /**< WAL options */
 };
 
@@ -188,10 +250,24 @@ struct iwkv_val {
    *  `compound` field ignored if db not in `IWDB_COMPOUND_KEYS` mode.
    */
   int64_t compound;
+  /** Record expiration time in milliseconds since epoch, zero if record never expires.
+   *  Used by put operations with `IWKV_VAL_EXPIRE` flag, set by value getters
+   *  of `IWDB_EXPIRING_VALUES` databases. */
+  uint64_t expire;
 };
 
 typedef struct iwkv_val IWKV_val;
 
+/**
+ * @brief Key/value pair used in batch operations.
+ */
+struct iwkv_kv {
+  struct iwkv_val key; /**< Key data container */
+  struct iwkv_val val; /**< Value data container */
+};
+
+typedef struct iwkv_kv IWKV_kv;
+
 /**
  * @brief Cursor opaque handler.
  */
@@ -212,6 +288,29 @@ enum iwkv_cursor_op {
 
 typedef enum iwkv_cursor_op IWKV_cursor_op;
 
+/**
+ * @brief Cursor options.
+ *
+ * Cursor range is a set of records visited by cursor: records preceding `end` key
+ * (or equal to it if `end_inclusive` is set) in the database key order and having keys
+ * starting with `prefix`. Cursor moved outside of its range returns `IWKV_ERROR_NOTFOUND`.
+ */
+struct iwkv_cursor_opts {
+  const struct iwkv_val *end;   /**< Optional end key of cursor range */
+  bool end_inclusive;           /**< Record with `end` key belongs to cursor range */
+  /** Optional prefix of keys in cursor range.
+   *  Cursor positioned by `IWKV_CURSOR_BEFORE_FIRST` or `IWKV_CURSOR_AFTER_LAST`
+   *  is placed at the corresponding edge of the range of prefixed keys.
+   *  Supported only by databases without `IWDB_COMPOUND_KEYS`, `IWDB_VNUM64_KEYS`,
+   *  `IWDB_REALNUM_KEYS` flags. */
+  const struct iwkv_val *prefix;
+  /** Number of skiplist nodes ahead of cursor moved by `IWKV_CURSOR_NEXT` or `IWKV_CURSOR_PREV`
+   *  prefetched from disk along with their key/value blocks. Zero disables readahead. */
+  uint8_t readahead;
+};
+
+typedef struct iwkv_cursor_opts IWKV_CURSOR_OPTS;
+
 /**
  * @brief Initialize iwkv storage.
  * @details This method must be called before using of any iwkv public API function.
@@ -294,6 +393,7 @@ IW_EXPORT iwrc iwkv_close(struct iwkv **iwkvp);
  * iwkv_opflags opflags:
  * - `IWKV_NO_OVERWRITE` If a key is already exists the `IWKV_ERROR_KEY_EXISTS` error will returned.
  * - `IWKV_SYNC` Flush changes on disk after operation
+ * - `IWKV_VAL_EXPIRE` Set record expiration time to `val->expire`
  *
  * @note `iwkv_put()` adds a new value to sorted values array for existing keys if
  * database created with `IWDB_DUP_UINT32_VALS`|`IWDB_DUP_UINT64_VALS` flags
@@ -313,6 +413,7 @@ IW_EXPORT iwrc iwkv_put(struct iwdb *db, const struct iwkv_val *key, const struc
  * @param key Key used in put operation
  * @param val Value used in put operation
  * @param oldval Old value which will be replaced by `val` may be `NULL`
+ *               if there is no record for `key` or record has expired
  * @param op Arbitrary opaqued data passed to this handler
  */
 typedef iwrc (*IWKV_PUT_HANDLER)(
@@ -321,12 +422,74 @@ typedef iwrc (*IWKV_PUT_HANDLER)(
 
 /**
  * @brief Store record in database.
+ *
+ * Put handler `ph` is called under database write lock before `val` is stored,
+ * so it may be used for read-modify-write updates performed within a single skiplist lookup:
+ * handler may rewrite contents of caller's `val->data` buffer using `oldval`,
+ * record is stored with `val` contents as they are after handler returns.
+ * See also `IWKV_VAL_INCREMENT` put option for numeric counters.
+ *
  * @see iwkv_put()
  */
 IW_EXPORT iwrc iwkv_puth(
   struct iwdb *db, const struct iwkv_val *key, const struct iwkv_val *val,
   iwkv_opflags opflags, IWKV_PUT_HANDLER ph, void *phop);
 
+/**
+ * @brief Store a batch of records in database.
+ *
+ * All records are stored under a single database lock in the database key order
+ * (the order records are visited by cursor moved by `IWKV_CURSOR_NEXT`).
+ * If `kvs` is not in this order a sorted array of record references is made,
+ * records having the same key are stored in the order they appear in `kvs` so the last one wins.
+ * Skiplist search bounds of the previous key are reused as a starting point for the next one,
+ * so a batch of ordered keys is stored much faster than a sequence of `iwkv_put()` calls.
+ *
+ * @note Operation is stopped on the first failed record: records
+ *       preceding it in the key order remain stored.
+ *
+ * @param db Database handler
+ * @param kvs Array of key/value pairs
+ * @param num Number of elements in `kvs`
+ * @param opflags Put options applied to every record, see `iwkv_put()`
+ */
+IW_EXPORT iwrc iwkv_put_batch(struct iwdb *db, const struct iwkv_kv *kvs, size_t num, iwkv_opflags opflags);
+
+/**
+ * @brief Records provider for `iwkv_bulk_load()`.
+ *
+ * Provider sets `key` and `val` to the next record to be loaded.
+ * Data of provided record must remain valid until the next provider call.
+ *
+ * @param [out] key Key data container
+ * @param [out] val Value data container
+ * @param op Arbitrary opaqued data passed to `iwkv_bulk_load()`
+ * @return `0` if a record is provided, `IWKV_ERROR_NOTFOUND` if there are no more records.
+ *         Any other error code aborts loading.
+ */
+typedef iwrc (*IWKV_BULK_LOAD_FN)(struct iwkv_val *key, struct iwkv_val *val, void *op);
+
+/**
+ * @brief Load records into an empty database.
+ *
+ * Records must be provided in strictly ascending database key order
+ * (the order records are visited by cursor moved by `IWKV_CURSOR_NEXT`).
+ * Database is built bottom-up without searching and splitting of skiplist nodes:
+ * every 32 records (64 for `IWDB_WIDE_NODES` databases) are packed into a key/value block sized to fit them,
+ * skiplist nodes are placed sequentially into fresh pages and linked on all levels in one pass.
+ *
+ * @note Records loaded before a failure remain in database.
+ * @note In WAL mode a checkpoint is forced when loading finished.
+ *
+ * @param db Empty database handler
+ * @param fn Records provider
+ * @param op Arbitrary opaqued data passed to `fn`
+ * @param opflags Only `IWKV_SYNC` is applicable
+ * @return `IWKV_ERROR_DB_NOT_EMPTY` if database is not empty,
+ *         `IWKV_ERROR_KEYS_ORDER` if records are not in strictly ascending order.
+ */
+IW_EXPORT iwrc iwkv_bulk_load(struct iwdb *db, IWKV_BULK_LOAD_FN fn, void *op, iwkv_opflags opflags);
+
 /**
  * @brief Get value for given `key`.
  *
@@ -350,6 +513,26 @@ IW_EXPORT iwrc iwkv_get(struct iwdb *db, const struct iwkv_val *key, struct iwkv
  */
 IW_EXPORT iwrc iwkv_get_copy(struct iwdb *db, const struct iwkv_val *key, void *vbuf, size_t vbufsz, size_t *vsz);
 
+/**
+ * @brief Get values for a set of `keys`.
+ *
+ * All keys are looked up under a single database lock in the database key order,
+ * skiplist search bounds of the previous key are reused by the next one
+ * and OS is hinted to read ahead database pages which will be touched next.
+ *
+ * @note Missing keys are not treated as errors: value of missing key is set to zero
+ *       and `IWKV_ERROR_NOTFOUND` is set in the corresponding `rcs` element.
+ * @note On success every returned value must be freed with `iwkv_val_dispose()`.
+ *       If operation fails no values are returned.
+ *
+ * @param db Database handler
+ * @param keys Array of `num` keys
+ * @param num Number of keys
+ * @param [out] vals Array of `num` values associated with `keys`
+ * @param [out] rcs Optional array of `num` per key lookup result codes, may be `NULL`
+ */
+IW_EXPORT iwrc iwkv_get_multi(struct iwdb *db, const struct iwkv_val *keys, size_t num, struct iwkv_val *vals, iwrc *rcs);
+
 /**
  * @brief Set arbitrary data associated with database.
  * Database write lock will acquired for this operation.
@@ -369,6 +552,93 @@ IW_EXPORT iwrc iwkv_db_set_meta(struct iwdb *db, void *buf, size_t sz);
  */
 IW_EXPORT iwrc iwkv_db_get_meta(struct iwdb *db, void *buf, size_t sz, size_t *rsz);
 
+/**
+ * @brief Database cache statistics.
+ */
+struct iwkv_db_cache_stats {
+  uint64_t hits;   /**< Number of skiplist nodes taken from cache of decoded nodes */
+  uint64_t misses; /**< Number of skiplist nodes decoded from database file */
+  uint64_t bloom_negatives; /**< Number of lookups of absent keys rejected by database Bloom filter */
+};
+
+/**
+ * @brief Get statistics of database cache of decoded skiplist nodes.
+ *
+ * Nodes of upper skiplist levels visited by lookups are kept decoded
+ * in a bounded per database cache.
+ *
+ * @param db Database handler
+ * @param [out] stats Cache statistics
+ */
+IW_EXPORT iwrc iwkv_db_cache_stats(struct iwdb *db, struct iwkv_db_cache_stats *stats);
+
+/**
+ * @brief Enable in-memory Bloom filter of database keys.
+ *
+ * Filter allows `iwkv_get()`, `iwkv_get_copy()`, `iwkv_get_multi()` and `iwkv_del()`
+ * to return `IWKV_ERROR_NOTFOUND` for most of absent keys without skiplist traversal.
+ * Filter is built by scanning database keys and then maintained by database updates.
+ * Filter is not persisted so it should be enabled every time database is opened.
+ *
+ * Returns `IW_ERROR_UNSUPPORTED` for databases with `IWDB_REALNUM_KEYS` flag.
+ *
+ * @param db Database handler
+ * @param bits_per_key Number of filter bits per key, `10` gives about 1% of false positives.
+ *                     Zero disables filter.
+ */
+IW_EXPORT iwrc iwkv_db_set_bloom(struct iwdb *db, uint8_t bits_per_key);
+
+/**
+ * @brief Get number of database records.
+ *
+ * Records count is kept in database header so this call takes constant time.
+ * Databases created by previous library versions are scanned once to initialize records count.
+ * Expired records of `IWDB_EXPIRING_VALUES` database are counted until they are deleted by reaper.
+ *
+ * @param db Database handler
+ * @param [out] ocount Number of database records
+ */
+IW_EXPORT iwrc iwkv_db_count(struct iwdb *db, uint64_t *ocount);
+
+/**
+ * @brief Delete expired records of `IWDB_EXPIRING_VALUES` database.
+ *
+ * Performs a full pass of background reaper over the database:
+ * skiplist nodes are scanned in batches under database read lock,
+ * expired records of every node are deleted under a single write lock.
+ *
+ * Returns `IWKV_ERROR_INCOMPATIBLE_DB_MODE` for databases without `IWDB_EXPIRING_VALUES` flag.
+ *
+ * @param db Database handler
+ * @param [out] ocount Optional number of deleted records
+ */
+IW_EXPORT iwrc iwkv_db_reap(struct iwdb *db, uint64_t *ocount);
+
+/**
+ * @brief Estimate number of records and their size for keys in `[lo, hi)` range.
+ *
+ * Range is given in the database key order like in `iwkv_del_range()`,
+ * zero `lo` or `hi` denotes unbounded range side.
+ * Estimation is based on a sample of range skiplist nodes taken from the highest skiplist
+ * level having enough nodes in range, records near range boundaries are counted exactly,
+ * so estimation of large ranges costs as a few hundreds of node reads.
+ * Estimated records count is clamped to the database records count when it is known.
+ * Records count of small ranges spanning a few skiplist nodes is exact.
+ *
+ * @param db Database handler
+ * @param lo Optional key of the first record in range
+ * @param hi Optional key of the first record following range
+ * @param [out] ocount Approximate number of records in range, can be zero
+ * @param [out] obytes Approximate size in bytes of skiplist nodes and key/value blocks
+ *                     of records in range, can be zero. Out of line values are not included.
+ */
+IW_EXPORT iwrc iwkv_db_estimate(
+  struct iwdb           *db,
+  const struct iwkv_val *lo,
+  const struct iwkv_val *hi,
+  uint64_t              *ocount,
+  uint64_t              *obytes);
+
 /**
  * @brief Remove record identified by `key`.
  *
@@ -378,6 +648,24 @@ IW_EXPORT iwrc iwkv_db_get_meta(struct iwdb *db, void *buf, size_t sz, size_t *r
  */
 IW_EXPORT iwrc iwkv_del(struct iwdb *db, const struct iwkv_val *key, iwkv_opflags opflags);
 
+/**
+ * @brief Remove all records with keys in `[lo, hi)` range.
+ *
+ * Range is given in the database key order (the order records are visited by
+ * cursor moved by `IWKV_CURSOR_NEXT`): `lo` is the first key to be removed, `hi` is
+ * the first key to be kept. Skiplist nodes fully covered by range are unlinked on all
+ * levels at once and their blocks are released in a single pass over the free-space map,
+ * only boundary nodes are updated record by record.
+ *
+ * @param db Database handler
+ * @param lo Lower bound of range (inclusive). If zero range starts from the first record.
+ * @param hi Upper bound of range (exclusive). If zero range ends with the last record.
+ * @param opflags Only `IWKV_SYNC` is applicable
+ */
+IW_EXPORT iwrc iwkv_del_range(
+  struct iwdb *db, const struct iwkv_val *lo, const struct iwkv_val *hi,
+  iwkv_opflags opflags);
+
 /**
  * @brief Destroy key/value data container.
  *
@@ -412,6 +700,27 @@ IW_EXPORT WUR iwrc iwkv_cursor_open(
   IWKV_cursor_op         op,
   const struct iwkv_val *key);
 
+/**
+ * @brief Open database cursor bounded by range and/or with readahead.
+ *
+ * Records are checked against cursor range by engine, bounds of the whole
+ * skiplist node are checked at once so records inside node are visited without key comparisons.
+ *
+ * @see iwkv_cursor_open()
+ * @see struct iwkv_cursor_opts
+ * @param db Database handler
+ * @param cur Pointer to an allocated cursor structure to be initialized
+ * @param op Cursor open mode/initial positions flags
+ * @param key Optional key argument, required to point cursor to the given key.
+ * @param opts Cursor options, can be zero.
+ */
+IW_EXPORT WUR iwrc iwkv_cursor_open2(
+  struct iwdb                   *db,
+  struct iwkv_cursor           **cur,
+  IWKV_cursor_op                 op,
+  const struct iwkv_val         *key,
+  const struct iwkv_cursor_opts *opts);
+
 /**
  * @brief Move cursor to the next position.
  *
@@ -492,6 +801,7 @@ IW_EXPORT iwrc iwkv_cursor_is_matched_key(
  * iwkv_opflags opflags:
  * - `IWKV_NO_OVERWRITE` If a key is already exists the `IWKV_ERROR_KEY_EXISTS` error will returned.
  * - `IWKV_SYNC` Flush changes on disk after operation
+ * - `IWKV_VAL_EXPIRE` Set record expiration time to `val->expire`
  *
  * @note `iwkv_cursor_set()` adds a new value to sorted values array for existing keys if
  * database created with `IWDB_DUP_UINT32_VALS`|`IWDB_DUP_UINT64_VALS` flags
@@ -536,6 +846,27 @@ IW_EXPORT iwrc iwkv_cursor_close(struct iwkv_cursor **cur);
  */
 IW_EXPORT iwrc iwkv_online_backup(struct iwkv *iwkv, uint64_t *ts, const char *target_file);
 
+/**
+ * @brief Copies all databases of `iwkv` into a new file created with `opts`.
+ *
+ * Target file is always truncated and written in storage format
+ * given by `iwkv_opts::fmt_version` (the latest format by default).
+ * Used to upgrade files created by older library versions, e.g.
+ * stores limited to ~512Gb by 32 bit block numbers of formats prior to v5.
+ * Database records, flags and meta data are copied by `iwkv_bulk_load()`.
+ *
+ * Conversion runs online: `iwkv` remains available for readers and writers,
+ * though concurrent updates may or may not be present in target file.
+ * Convert an online backup (see `iwkv_online_backup()`) to get point in time copy.
+ *
+ * @note In order to avoid deadlocks: close all opened database cursors
+ * before calling this method.
+ *
+ * @param iwkv Source store
+ * @param opts Target store open options, `path` must differ from the source file path
+ */
+IW_EXPORT iwrc iwkv_convert(struct iwkv *iwkv, const struct iwkv_opts *opts);
+
 /**
  * @brief Get database file status info.
  * @note Database should be in opened state.
@@ -13,6 +13,7 @@
 #include "ksort.h"
 
 #include <pthread.h>
+#include <sched.h>
 #include <stdatomic.h>
 #include <unistd.h>
 
@@ -29,17 +30,23 @@
 #define IWKV_BACKUP_MAGIC 0xBACBAC69U
 
 // struct iwkv* file format version
-#define IWKV_FORMAT 2U
+#define IWKV_FORMAT 5U
 
 // struct iwdb* magic number
 #define IWDB_MAGIC 0x69776462U
 
+// struct iwdb* records count magic number
+#define IWDB_RCNT_MAGIC 0x69776372U
+
 #ifdef IW_32
 // Max database file size on 32 bit systems: 2Gb
-#define IWKV_MAX_DBSZ 0x7fffffff
+#define IWKV_MAX_DBSZ    0x7fffffff
+#define IWKV_MAX_DBSZ_V5 0x7fffffff
 #else
 // Max database file size: ~512Gb
 #define IWKV_MAX_DBSZ 0x7fffffff80ULL
+// Max database file size since format v5 having 40 bit block numbers: ~128Tb
+#define IWKV_MAX_DBSZ_V5 0x7fffffffff80ULL
 #endif
 
 // Size of KV fsm block as power of 2
@@ -55,6 +62,10 @@
 // Maximum length of prefix key to compare for v2 formst
 #define PREFIX_KEY_LEN_V2 115U
 
+// Maximum length of prefix key to compare for v3 format,
+// v3 SBLK stores key fingerprints in place of the lower key tail
+#define PREFIX_KEY_LEN_V3 83U
+
 // Number of skip list levels
 #define SLEVELS 24U
 
@@ -76,9 +87,33 @@
 // Data format version: v2
 #define SBLK_PAGE_SZ_V2 (SBLK_PAGE_SBLK_NUM_V2 * SBLK_SZ)
 
+// Number of decoded `SBLK` cache slots per database, power of two
+#define SBLK_CACHE_SIZE 128U
+
+// Number of `SBLK` cache slot locks, power of two
+#define SBLK_CACHE_LOCKS 8U
+
+// Minimal number of keys database Bloom filter is sized for
+#define IWDB_BLOOM_MIN_KEYS 1024U
+
+// Max number of database Bloom filter probes per key
+#define IWDB_BLOOM_MAX_HASHES 16U
+
+// Minimal number of upper level skiplist nodes in range used to estimate range size
+#define EST_SAMPLE_MIN 64U
+
+// Number of reader registration slots in struct iwkv, power of two
+#define IWKV_RSLOTS_NUM 64U
+
 // Number of `KV` blocks in struct kvblk
 #define KVBLK_IDXNUM 32U
 
+// Number of `KV` blocks in struct kvblk of `IWDB_WIDE_NODES` database
+#define KVBLK_IDXNUM_WIDE 64U
+
+// Max number of `KV` blocks in struct kvblk
+#define KVBLK_IDXNUM_MAX KVBLK_IDXNUM_WIDE
+
 // Initial `struct kvblk` size power of 2
 #define KVBLK_INISZPOW 9U
 
@@ -91,10 +126,28 @@
 // Max kvp len 0xfffffffULL bytes
 #define KVP_MAX_LEN_VLEN 5U
 
-#define KVBLK_MAX_IDX_SZ ((KVP_MAX_OFF_VLEN + KVP_MAX_LEN_VLEN) * KVBLK_IDXNUM)
+// Flag bit of persisted kvp len: value of kv pair is stored out of line
+#define KVP_EXT_BIT 0x10000000U
+
+// Size of out of line value reference stored in place of value: [blkn:u4,len:u4]
+#define KVP_EXT_REF_SZ 8U
+
+// Size of out of line value reference since format v5: [blkn:u5,len:u4]
+#define KVP_EXT_REF_SZ_V5 9U
+
+// Max length of `struct kvblk` restart key
+#define KVBLK_MAX_RK_LEN 64U
+
+// Max size of KV pairs index of struct kvblk having `n_` pairs
+#define KVBLK_MAX_IDX_SZ_N(n_) ((KVP_MAX_OFF_VLEN + KVP_MAX_LEN_VLEN) * (n_) + 1 + KVBLK_MAX_RK_LEN)
+
+#define KVBLK_MAX_IDX_SZ KVBLK_MAX_IDX_SZ_N(KVBLK_IDXNUM_MAX)
 
 // Max non KV size [blen:u1,idxsz:u2,[ps1:vn,pl1:vn,...,ps63,pl63]
-#define KVBLK_MAX_NKV_SZ (KVBLK_HDRSZ + KVBLK_MAX_IDX_SZ)
+#define KVBLK_MAX_NKV_SZ_N(n_) (KVBLK_HDRSZ + KVBLK_MAX_IDX_SZ_N(n_))
+
+// Size of persisted block number in bytes for the given format version
+#define BLKN_SZ(fmt_) ((fmt_) > 4 ? 5U : 4U)
 
 #define ADDR2BLK(addr_) ((blkn_t) (((uint64_t) (addr_)) >> IWKV_FSM_BPOW))
 
@@ -103,7 +156,7 @@
 struct iwkv;
 struct iwdb;
 
-typedef uint32_t blkn_t;
+typedef uint64_t blkn_t;
 typedef uint32_t dbid_t;
 
 /* Key/Value pair stored in `struct kvblk` */
@@ -121,6 +174,7 @@ struct kvp {
   off_t    off;   /**< KV block offset relative to `end` of struct kvblk */
   uint32_t len;   /**< Length of kv pair block */
   uint8_t  ridx;  /**< Position of the actually persisted slot in `struct kvblk` */
+  bool     ext;   /**< Value is stored out of line, kv pair holds `[blkn:u4,len:u4]` reference to it */
 };
 
 typedef struct kvp KVP;
@@ -134,6 +188,12 @@ typedef uint8_t kvblk_rmkv_opts_t;
 #define RMKV_SYNC      ((kvblk_rmkv_opts_t) 0x01U)
 #define RMKV_NO_RESIZE ((kvblk_rmkv_opts_t) 0x02U)
 
+typedef uint8_t kvblk_addkv_opts_t;
+/** Key and value are given in the stored form, eg. moved from another `struct kvblk` */
+#define ADDKV_RAW ((kvblk_addkv_opts_t) 0x01U)
+/** Value is a stored out of line value reference, used with `ADDKV_RAW` */
+#define ADDKV_EXT ((kvblk_addkv_opts_t) 0x02U)
+
 typedef uint8_t sblk_flags_t;
 /** The lowest `SBLK` key is fully contained in `SBLK`. Persistent flag. */
 #define SBLK_FULL_LKEY ((sblk_flags_t) 0x01U)
@@ -148,7 +208,7 @@ typedef uint8_t iwlctx_op_t;
 /** Delete key operation */
 #define IWLCTX_DEL ((iwlctx_op_t) 0x02U)
 
-/* struct kvblk: [szpow:u1,idxsz:u2,[ps0:vn,pl0:vn,..., ps32,pl32]____[[KV],...]] */
+/* struct kvblk: [szpow:u1,idxsz:u2,[ps0:vn,pl0:vn,..., ps32,pl32],rkl:u1,rk____[[KV],...]] */
 struct kvblk {
   struct iwdb *db;
   off_t    addr;              /**< Block address */
@@ -157,7 +217,9 @@ struct kvblk {
   int8_t   zidx;              /**< Index of first empty pair slot (zero index), or -1 */
   uint8_t  szpow;             /**< Block size as power of 2 */
   kvblk_flags_t flags;        /**< Flags */
-  KVP pidx[KVBLK_IDXNUM];     /**< KV pairs index */
+  uint8_t  rkl;               /**< Length of restart key, zero if keys are not front coded */
+  uint8_t  rk[KVBLK_MAX_RK_LEN]; /**< Restart key, keys of block are stored as suffixes of its prefix */
+  KVP pidx[KVBLK_IDXNUM_MAX]; /**< KV pairs index, `iwdb::idxnum` slots are used */
 };
 
 typedef struct kvblk KVBLK;
@@ -166,6 +228,7 @@ typedef struct kvblk KVBLK;
 #define SBLK_CACHE_FLAGS      (SBLK_CACHE_UPDATE | SBLK_CACHE_PUT | SBLK_CACHE_REMOVE)
 
 struct iwkv_cursor;
+struct iwdb_bloom;
 
 /* Database: [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u4,p0:u4,n[24]:u4,c[24]:u4]:209 */
 struct iwdb {
@@ -186,9 +249,17 @@ struct iwdb {
   blkn_t       meta_blk;              /**< Database meta block number */
   blkn_t       meta_blkn;             /**< Database meta length (number of blocks) */
   iwdb_flags_t dbflg;                 /**< Database specific flags */
+  uint8_t      idxnum;                /**< Number of KV slots per skiplist node */
   atomic_bool  open;                  /**< True if DB is in OPEN state */
   volatile bool wk_pending_exclusive; /**< If true someone wants to acquire exclusive lock on struct iwdb* */
   uint32_t      lcnt[SLEVELS];        /**< SBLK count per level */
+  struct sblk_cache *_Atomic sbc;     /**< Decoded SBLK cache, allocated on first use */
+  struct iwdb_bloom   *bloom;         /**< Optional in-memory Bloom filter of database keys */
+  uint8_t bloom_bpk;                  /**< Bloom filter bits per key, zero if filter is disabled */
+  atomic_uint_fast64_t bloom_negatives; /**< Number of lookups rejected by Bloom filter */
+  uint64_t wgen;                      /**< Database write generation, incremented on every write lock */
+  uint64_t rcnt;                      /**< Number of database records, valid if `rcnt_valid` is set */
+  bool     rcnt_valid;                /**< Records count is maintained in database header */
 };
 
 /* Skiplist block: [u1:flags,lvl:u1,lkl:u1,pnum:u1,p0:u4,kblk:u4,[pi0:u1,... pi32],n0-n23:u4,lk:u116]:u256 // SBLK */
@@ -206,12 +277,19 @@ struct sblk {
   blkn_t  kvblkn;                    /**< Associated struct kvblk block number */
   int8_t  pnum;                      /**< Number of active kv indexes in `SBLK::pi` */
   uint8_t lkl;                       /**< Lower key length within a buffer */
-  uint8_t pi[KVBLK_IDXNUM];          /**< Sorted KV slots, value is an index of kv slot in `struct kvblk` */
+  uint8_t pi[KVBLK_IDXNUM_MAX];      /**< Sorted KV slots, value is an index of kv slot in `struct kvblk` */
+  uint8_t fp[KVBLK_IDXNUM];          /**< Key fingerprints indexed by kv slot in `struct kvblk` (v3 format) */
   uint8_t lk[PREFIX_KEY_LEN_V2 + 1]; /**< Lower key buffer */
 };
 
 typedef struct sblk SBLK;
 
+/** Reader registration slot, padded to occupy its own cache line */
+struct iwkv_rslot {
+  atomic_int cnt;                      /**< Number of readers registered in this slot */
+  uint8_t    pad[64 - sizeof(atomic_int)];
+};
+
 /** struct iwkv* instance */
 struct iwkv {
   IWFS_FSM fsm;                          /**< FSM pool */
@@ -225,9 +303,58 @@ struct iwkv {
   pthread_cond_t wk_cond;                /**< Workers cond variable */
   pthread_mutex_t wk_mtx;                /**< Workers cond mutext */
   int32_t fmt_version;                   /**< Database format version */
+  uint32_t ext_value_threshold;          /**< Min size of value stored out of line, zero if disabled */
   volatile int32_t wk_count;             /**< Number of active workers */
   volatile bool    wk_pending_exclusive; /**< If true someone wants to acquire exclusive lock on struct iwkv* */
   volatile bool    open;                 /**< True if kvstore is in the operable state */
+  atomic_int excl_count;                 /**< Number of pending or active exclusive lock holders */
+  struct iwkv_rslot rslots[IWKV_RSLOTS_NUM]; /**< Database readers/writers registered without `rwl` */
+  pthread_t       reaper;                /**< Expired records reaper thread */
+  pthread_mutex_t reaper_mtx;            /**< Held by reaper while it works on a database */
+  pthread_cond_t  reaper_cond;           /**< Signalled to stop reaper */
+  int32_t reaper_interval_sec;           /**< Interval between reaper runs, negative if reaper is disabled */
+  bool    reaper_started;                /**< Reaper thread is running */
+};
+
+/** Decoded `SBLK` cache slot */
+struct sblk_cslot {
+  off_t       addr; /**< Address of cached block, zero if slot is empty */
+  struct sblk sblk; /**< Decoded block */
+};
+
+/** `SBLK` cache lock stripe, padded so adjacent stripes do not share cache line */
+struct sblk_cstripe {
+  union {
+    struct {
+      pthread_spinlock_t slk; /**< Stripe lock */
+      uint64_t hits;          /**< Number of cache hits of stripe slots, guarded by `slk` */
+      uint64_t misses;        /**< Number of cache misses of stripe slots, guarded by `slk` */
+    };
+    uint8_t pad[64];
+  };
+};
+
+/** Direct mapped cache of decoded `SBLK` blocks of upper skiplist levels */
+struct sblk_cache {
+  struct sblk_cstripe stripes[SBLK_CACHE_LOCKS]; /**< Slot `i` guarded by `stripes[i % SBLK_CACHE_LOCKS]` */
+  struct sblk_cslot   slots[SBLK_CACHE_SIZE];
+};
+
+/** In-memory Bloom filter of database keys */
+struct iwdb_bloom {
+  uint64_t *bits;     /**< Filter bit array */
+  uint64_t  mask;     /**< Number of bits in filter minus one, number of bits is a power of two */
+  uint64_t  capacity; /**< Number of keys filter is sized for */
+  uint64_t  nkeys;    /**< Number of keys added to filter */
+  uint64_t  ndel;     /**< Number of keys deleted since filter was built */
+  uint8_t   nhash;    /**< Number of probes per key */
+};
+
+/** Skiplist search finger: per level bounds of the previous lookup in a sorted sequence of keys */
+struct lxfinger {
+  off_t  lower[SLEVELS]; /**< Lower bound block address per level */
+  off_t  upper[SLEVELS]; /**< Upper bound block address per level, zero if it is the database tail */
+  int8_t lvl;            /**< Max level having valid bounds or -1 */
 };
 
 /** Database lookup context */
@@ -251,6 +378,9 @@ struct iwlctx {
   int8_t       nlvl;               /**< Level of new inserted/deleted `SBLK` node. -1 if no new node inserted/deleted */
   IWKV_PUT_HANDLER ph;             /**< Optional put handler */
   void *phop;                      /**< Put handler opaque data */
+  uint64_t expire;                 /**< Expiration time of stored value of `IWDB_EXPIRING_VALUES` database */
+  uint64_t reap_ts;                /**< If not zero only records expired at this time are deleted */
+  struct lxfinger *finger;         /**< Optional search finger updated by `_lx_find_bounds()` */
   struct sblk    *plower[SLEVELS]; /**< Pinned lower nodes per level */
   struct sblk    *pupper[SLEVELS]; /**< Pinned upper nodes per level */
   struct iwkv_val ekey;
@@ -259,6 +389,8 @@ struct iwlctx {
   struct kvblk    kaa[AANUM]; /**< `struct kvblk` allocation area */
   uint8_t nbuf[IW_VNUMBUFSZ];
   uint8_t incbuf[8];          /**< Buffer used to store incremented/decremented values `IWKV_VAL_INCREMENT` opflag */
+  struct iwkv_val pval;       /**< Packed update value of `IWDB_COMPRESSED_VALUES` database */
+  uint8_t *pbuf;              /**< Packed update value buffer */
 };
 
 typedef struct iwlctx IWLCTX;
@@ -275,6 +407,18 @@ struct iwkv_cursor {
   struct iwkv_cursor *next;  /**< Next cursor in active db cursors chain */
   struct iwlctx       lx;    /**< Lookup context */
   off_t dbaddr;              /**< Database address used as `cn` */
+  struct iwkv_val end;       /**< Optional effective end key of cursor range */
+  struct iwkv_val prefix;    /**< Optional keys prefix of cursor range */
+  struct iwkv_val prefix_sk; /**< Least key following all keys having `prefix`, empty if no such key */
+  bool     end_incl;         /**< Record with `end` key belongs to cursor range */
+  off_t    bnd_addr;         /**< Address of `SBLK` node all records of which are within cursor range */
+  uint64_t bnd_wgen;         /**< Database write generation `bnd_addr` is valid for */
+  uint8_t  ra;               /**< Readahead depth in `SBLK` nodes, zero if disabled */
+  uint8_t  ra_num;           /**< Number of nodes prefetched ahead of the current node */
+  int8_t   ra_dir;           /**< Readahead direction: 1 along `n[0]`, -1 along `p0` */
+  blkn_t   ra_blkn;          /**< Last prefetched `SBLK` node, zero if end of nodes chain reached */
+  blkn_t   ra_kvblkn;        /**< `KVBLK` head of which is prefetched at the previous readahead step */
+  uint64_t ra_wgen;          /**< Database write generation readahead window is valid for */
 };
 
 #define ENSURE_OPEN(iwkv_)                                               \
@@ -310,12 +454,91 @@ IW_INLINE iwrc _api_wlock(struct iwkv *iwkv) {
         rci_ = pthread_rwlock_unlock(&(iwkv_)->rwl); \
         if (rci_) IWRC(iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci_), rc_)
 
+/** Registration of the current thread as a shared user of `iwkv` */
+struct iwkv_rref {
+  struct iwkv       *iwkv;  /**< Store of registration, zero if registration is not tracked */
+  struct iwkv_rslot *slot;  /**< Reader slot assigned to the current thread */
+  int depth;                /**< Number of nested `_api_enter()` calls */
+};
+
+/**
+ * Returns registration record of the current thread in `iwkv`.
+ * Nested registrations are not tracked for a thread
+ * which is registered in too many stores at once.
+ */
+struct iwkv_rref* _api_rref(struct iwkv *iwkv);
+
+/**
+ * Registers the current thread as a shared user of `iwkv`.
+ * Shared users do not touch `iwkv->rwl` unless an exclusive lock
+ * is pending, in that case they wait for its release.
+ * Nested calls from a registered thread, e.g. from put handlers,
+ * do not wait since exclusive lock waits for the thread to leave anyway.
+ */
+IW_INLINE iwrc _api_enter(struct iwkv *iwkv) {
+  struct iwkv_rref *ref = _api_rref(iwkv);
+  if (ref->depth > 0) {
+    ++ref->depth;
+    return 0;
+  }
+  struct iwkv_rslot *slot = ref->slot;
+  atomic_fetch_add(&slot->cnt, 1);
+  if (IW_UNLIKELY(atomic_load(&iwkv->excl_count) != 0)) {
+    atomic_fetch_sub(&slot->cnt, 1);
+    int rci = pthread_rwlock_rdlock(&iwkv->rwl);
+    if (rci) {
+      return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+    }
+    atomic_fetch_add(&slot->cnt, 1);
+    pthread_rwlock_unlock(&iwkv->rwl);
+  }
+  if (ref->iwkv) {
+    ref->depth = 1;
+  }
+  return 0;
+}
+
+IW_INLINE void _api_leave(struct iwkv *iwkv) {
+  struct iwkv_rref *ref = _api_rref(iwkv);
+  if (ref->depth > 0 && --ref->depth > 0) {
+    return;
+  }
+  atomic_fetch_sub(&ref->slot->cnt, 1);
+}
+
+/**
+ * Acquires exclusive lock on `iwkv`.
+ * Waits for all shared users registered by `_api_enter()` to leave.
+ */
+IW_INLINE iwrc _api_excl_lock(struct iwkv *iwkv) {
+  atomic_fetch_add(&iwkv->excl_count, 1);
+  int rci = pthread_rwlock_wrlock(&iwkv->rwl);
+  if (rci) {
+    atomic_fetch_sub(&iwkv->excl_count, 1);
+    return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+  }
+  for (int i = 0; i < IWKV_RSLOTS_NUM; ++i) {
+    while (atomic_load(&iwkv->rslots[i].cnt) > 0) {
+      sched_yield();
+    }
+  }
+  return 0;
+}
+
+IW_INLINE iwrc _api_excl_unlock(struct iwkv *iwkv) {
+  int rci = pthread_rwlock_unlock(&iwkv->rwl);
+  atomic_fetch_sub(&iwkv->excl_count, 1);
+  return rci ? iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci) : 0;
+}
+
 #define API_DB_RLOCK(db_, rci_)                                    \
         do {                                                       \
-          API_RLOCK((db_)->iwkv, rci_);                            \
+          ENSURE_OPEN((db_)->iwkv);                                \
+          iwrc rc__ = _api_enter((db_)->iwkv);                     \
+          if (rc__) return rc__;                                   \
           (rci_) = pthread_rwlock_rdlock(&(db_)->rwl);             \
           if (rci_) {                                              \
-            pthread_rwlock_unlock(&(db_)->iwkv->rwl);              \
+            _api_leave((db_)->iwkv);                               \
             return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci_); \
           }                                                        \
         } while (0)
@@ -328,12 +551,15 @@ IW_INLINE iwrc _api_db_rlock(struct iwdb *db) {
 
 #define API_DB_WLOCK(db_, rci_)                                    \
         do {                                                       \
-          API_RLOCK((db_)->iwkv, rci_);                            \
+          ENSURE_OPEN((db_)->iwkv);                                \
+          iwrc rc__ = _api_enter((db_)->iwkv);                     \
+          if (rc__) return rc__;                                   \
           (rci_) = pthread_rwlock_wrlock(&(db_)->rwl);             \
           if (rci_) {                                              \
-            pthread_rwlock_unlock(&(db_)->iwkv->rwl);              \
+            _api_leave((db_)->iwkv);                               \
             return iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci_); \
           }                                                        \
+          ++(db_)->wgen;                                           \
         } while (0)
 
 IW_INLINE iwrc _api_db_wlock(struct iwdb *db) {
@@ -346,7 +572,7 @@ IW_INLINE iwrc _api_db_wlock(struct iwdb *db) {
         do {                                                                   \
           (rci_) = pthread_rwlock_unlock(&(db_)->rwl);                         \
           if (rci_) IWRC(iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci_), rc_); \
-          API_UNLOCK((db_)->iwkv, rci_, rc_);                                  \
+          _api_leave((db_)->iwkv);                                             \
         } while (0)
 
 #define AAPOS_INC(aan_)             \
@@ -361,6 +587,9 @@ IW_INLINE iwrc _api_db_wlock(struct iwdb *db) {
 
 // SBLK
 // [flags:u1,lvl:u1,lkl:u1,pnum:u1,p0:u4,kblk:u4,pi:u1[32],n:u4[24],bpos:u1,lk:u115]:u256
+// v3: [flags:u1,lvl:u1,lkl:u1,pnum:u1,p0:u4,kblk:u4,pi:u1[32],n:u4[24],bpos:u1,fp:u1[32],lk:u83]:u256
+// v5: [flags:u1,lvl:u1,lkl:u1,pnum:u1,p0:u5,kblk:u5,pi:u1[32],bpos:u1,fp:u1[32],lk,...,n:u5[lvl+1]]:u256
+//     next node pointers are stored backward from the end of block, n[i] at `SOFF_N_V5(i)`
 
 #define SOFF_FLAGS_U1   0
 #define SOFF_LVL_U1     (SOFF_FLAGS_U1 + 1)
@@ -373,12 +602,39 @@ IW_INLINE iwrc _api_db_wlock(struct iwdb *db) {
 #define SOFF_BPOS_U1_V2 (SOFF_N0_U4 + 4 * SLEVELS)
 #define SOFF_LK_V2      (SOFF_BPOS_U1_V2 + 1)
 #define SOFF_LK_V1      (SOFF_N0_U4 + 4 * SLEVELS)
+#define SOFF_FP_V3      (SOFF_BPOS_U1_V2 + 1)
+#define SOFF_LK_V3      (SOFF_FP_V3 + 1 * KVBLK_IDXNUM)
 #define SOFF_END        (SOFF_LK_V2 + SBLK_LKLEN)
 static_assert(SOFF_END == 256, "SOFF_END == 256");
+static_assert(SOFF_LK_V3 + PREFIX_KEY_LEN_V3 == SOFF_END, "SOFF_LK_V3 + PREFIX_KEY_LEN_V3 == SOFF_END");
 static_assert(SBLK_SZ >= SOFF_END, "SBLK_SZ >= SOFF_END");
 
+#define SOFF_P0_V5      SOFF_P0_U4
+#define SOFF_KBLK_V5    (SOFF_P0_V5 + 5)
+#define SOFF_PI0_V5     (SOFF_KBLK_V5 + 5)
+#define SOFF_BPOS_U1_V5 (SOFF_PI0_V5 + 1 * KVBLK_IDXNUM)
+#define SOFF_FP_V5      (SOFF_BPOS_U1_V5 + 1)
+#define SOFF_LK_V5      (SOFF_FP_V5 + 1 * KVBLK_IDXNUM)
+// v5 `IWDB_WIDE_NODES` database: [flags:u1,lvl:u1,lkl:u1,pnum:u1,p0:u5,kblk:u5,pi:u1[64],bpos:u1,lk,...,n:u5[lvl+1]]:u256
+#define SOFF_BPOS_U1_V5W (SOFF_PI0_V5 + 1 * KVBLK_IDXNUM_WIDE)
+static_assert(SOFF_BPOS_U1_V5W + 1 == SOFF_LK_V5, "SOFF_BPOS_U1_V5W + 1 == SOFF_LK_V5");
+#define SOFF_N_V5(i_)   (SOFF_END - 5 * ((i_) + 1))
+// Lower key length of v5 SBLK of the given level
+#define PREFIX_KEY_LEN_V5(lvl_) MIN(PREFIX_KEY_LEN_V2, SOFF_N_V5(lvl_) - SOFF_LK_V5)
+static_assert(PREFIX_KEY_LEN_V5(0) == PREFIX_KEY_LEN_V2, "PREFIX_KEY_LEN_V5(0) == PREFIX_KEY_LEN_V2");
+static_assert(PREFIX_KEY_LEN_V5(SLEVELS - 1) == 57, "PREFIX_KEY_LEN_V5(SLEVELS - 1) == 57");
+
+// SBLK field offsets for the given format version (database for `bpos`)
+#define SOFF_P0(fmt_)      ((fmt_) > 4 ? SOFF_P0_V5 : SOFF_P0_U4)
+#define SOFF_KBLK(fmt_)    ((fmt_) > 4 ? SOFF_KBLK_V5 : SOFF_KBLK_U4)
+#define SOFF_N(fmt_, i_)   ((fmt_) > 4 ? SOFF_N_V5(i_) : SOFF_N0_U4 + 4 * (i_))
+#define SOFF_BPOS_U1(db_)                                                                    \
+        ((db_)->iwkv->fmt_version > 4                                                        \
+         ? ((db_)->idxnum > KVBLK_IDXNUM ? SOFF_BPOS_U1_V5W : SOFF_BPOS_U1_V5) : SOFF_BPOS_U1_V2)
+
 // DB
-// [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u4,p0:u4,n[24]:u4,c[24]:u4,meta_blk:u4,meta_blkn:u4]:217
+// [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u4,p0:u4,n[24]:u4,c[24]:u4,meta_blk:u4,meta_blkn:u4,
+//  rcnt_magic:u4,rcnt:u8]:229
 #define DOFF_MAGIC_U4    0
 #define DOFF_DBFLG_U1    (DOFF_MAGIC_U4 + 4)
 #define DOFF_DBID_U4     (DOFF_DBFLG_U1 + 1)
@@ -388,10 +644,29 @@ static_assert(SBLK_SZ >= SOFF_END, "SBLK_SZ >= SOFF_END");
 #define DOFF_C0_U4       (DOFF_N0_U4 + 4 * SLEVELS)
 #define DOFF_METABLK_U4  (DOFF_C0_U4 + 4 * SLEVELS)
 #define DOFF_METABLKN_U4 (DOFF_METABLK_U4 + 4)
-#define DOFF_END         (DOFF_METABLKN_U4 + 4)
-static_assert(DOFF_END == 217, "DOFF_END == 217");
+#define DOFF_RCNTMAGIC_U4 (DOFF_METABLKN_U4 + 4)
+#define DOFF_RCNT_U8     (DOFF_RCNTMAGIC_U4 + 4)
+#define DOFF_END         (DOFF_RCNT_U8 + 8)
+static_assert(DOFF_END == 229, "DOFF_END == 229");
 static_assert(DB_SZ >= DOFF_END, "DB_SZ >= DOFF_END");
 
+// v5: [magic:u4,dbflg:u1,dbid:u4,next_db_blk:u5,p0:u5,n[24]:u5,c[24]:u4,meta_blk:u5,meta_blkn:u5,rcnt:u8]:253
+#define DOFF_NEXTDB_V5   DOFF_NEXTDB_U4
+#define DOFF_P0_V5       (DOFF_NEXTDB_V5 + 5)
+#define DOFF_N0_V5       (DOFF_P0_V5 + 5)
+#define DOFF_C0_V5       (DOFF_N0_V5 + 5 * SLEVELS)
+#define DOFF_METABLK_V5  (DOFF_C0_V5 + 4 * SLEVELS)
+#define DOFF_METABLKN_V5 (DOFF_METABLK_V5 + 5)
+#define DOFF_RCNT_V5     (DOFF_METABLKN_V5 + 5)
+#define DOFF_END_V5      (DOFF_RCNT_V5 + 8)
+static_assert(DOFF_END_V5 == 253, "DOFF_END_V5 == 253");
+static_assert(DB_SZ >= DOFF_END_V5, "DB_SZ >= DOFF_END_V5");
+
+// DB header field offsets for the given format version
+#define DOFF_P0(fmt_)      ((fmt_) > 4 ? DOFF_P0_V5 : DOFF_P0_U4)
+#define DOFF_N(fmt_, i_)   ((fmt_) > 4 ? DOFF_N0_V5 + 5 * (i_) : DOFF_N0_U4 + 4 * (i_))
+#define DOFF_METABLK(fmt_) ((fmt_) > 4 ? DOFF_METABLK_V5 : DOFF_METABLK_U4)
+
 // struct kvblk
 // [szpow:u1,idxsz:u2,[ps1:vn,pl1:vn,...,ps32,pl32]____[[_KV],...]] // struct kvblk
 #define KBLK_SZPOW_OFF 0
@@ -407,6 +682,8 @@ void iwkvd_db(FILE *f, struct iwdb *db, int flags, int plvl);
 // IWKVD Trigger commands
 #ifdef IW_TESTS
 #define IWKVD_WAL_NO_CHECKPOINT_ON_CLOSE 1UL
+#define IWKVD_WAL_CHECKPOINT_HOLD        2UL /**< Incremental checkpoint waits after applying WAL while set */
+#define IWKVD_WAL_CHECKPOINT_HELD        4UL /**< Set by incremental checkpoint when it starts waiting */
 #endif
 
 #endif
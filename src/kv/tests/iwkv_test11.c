@@ -0,0 +1,491 @@
+#include "iwkv.h"
+#include "iwlog.h"
+#include "iwutils.h"
+#include "iwkv_tests.h"
+#include "iwkv_internal.h"
+
+#define KNUM 20000
+
+int init_suite(void) {
+  return iwkv_init();
+}
+
+int clean_suite(void) {
+  return 0;
+}
+
+static void iwkv_test11_1_impl(bool wal) {
+  IWKV iwkv;
+  IWDB db;
+  IWKV_OPTS opts = {
+    .path = wal ? "iwkv_test11_1_wal.db" : "iwkv_test11_1.db",
+    .oflags = IWKV_TRUNC,
+    .wal = {
+      .enabled = wal
+    }
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  char(*keys)[16] = malloc(KNUM * sizeof(*keys));
+  char(*vals)[16] = malloc(KNUM * sizeof(*vals));
+  IWKV_kv *kvs = calloc(KNUM, sizeof(*kvs));
+  CU_ASSERT_PTR_NOT_NULL_FATAL(keys);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(vals);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(kvs);
+
+  // Every third key is stored before batch
+  for (int i = 0; i < KNUM; i += 3) {
+    IWKV_val key, val;
+    snprintf(keys[0], sizeof(keys[0]), "%08d", i);
+    key.data = keys[0];
+    key.size = strlen(keys[0]);
+    val.data = "old";
+    val.size = 3;
+    rc = iwkv_put(db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+
+  // Sorted batch
+  for (int i = 0; i < KNUM; ++i) {
+    snprintf(keys[i], sizeof(keys[i]), "%08d", i);
+    snprintf(vals[i], sizeof(vals[i]), "v%d", i);
+    kvs[i].key.data = keys[i];
+    kvs[i].key.size = strlen(keys[i]);
+    kvs[i].val.data = vals[i];
+    kvs[i].val.size = strlen(vals[i]);
+  }
+  rc = iwkv_put_batch(db, kvs, KNUM, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < KNUM; ++i) {
+    IWKV_val val;
+    int cret;
+    rc = iwkv_get(db, &kvs[i].key, &val);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    const char *v = vals[i];
+    IW_CMP(cret, v, strlen(v), val.data, val.size);
+    CU_ASSERT_EQUAL_FATAL(cret, 0);
+    iwkv_val_dispose(&val);
+  }
+
+  int cnt = 0;
+  IWKV_cursor cur;
+  rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    IWKV_val key;
+    int cret;
+    rc = iwkv_cursor_key(cur, &key);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_TRUE_FATAL(cnt < KNUM);
+    const char *k = keys[KNUM - cnt - 1]; // Keys are visited in descending order
+    IW_CMP(cret, k, strlen(k), key.data, key.size);
+    CU_ASSERT_EQUAL_FATAL(cret, 0);
+    iwkv_val_dispose(&key);
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(cnt, KNUM);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Batch in the database order with no-overwrite must fail on the first existing key
+  for (int i = 0; i < KNUM; ++i) {
+    kvs[i].key.data = keys[KNUM - i - 1];
+    kvs[i].key.size = strlen(keys[KNUM - i - 1]);
+  }
+  rc = iwkv_put_batch(db, kvs, KNUM, IWKV_NO_OVERWRITE);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_KEY_EXISTS);
+
+  rc = iwkv_put_batch(db, kvs, 0, 0);
+  CU_ASSERT_EQUAL(rc, 0);
+  rc = iwkv_put_batch(db, 0, 1, 0);
+  CU_ASSERT_EQUAL(rc, IW_ERROR_INVALID_ARGS);
+
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  free(kvs);
+  free(vals);
+  free(keys);
+}
+
+static void iwkv_test11_1(void) {
+  iwkv_test11_1_impl(false);
+}
+
+static void iwkv_test11_1_wal(void) {
+  iwkv_test11_1_impl(true);
+}
+
+// Unsorted batch with duplicated keys in numeric keys db
+static void iwkv_test11_2(void) {
+  IWKV iwkv;
+  IWDB db;
+  IWKV_OPTS opts = {
+    .path = "iwkv_test11_2.db",
+    .oflags = IWKV_TRUNC
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, IWDB_VNUM64_KEYS, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  uint64_t *knums = malloc(2 * KNUM * sizeof(*knums));
+  uint64_t *vnums = malloc(2 * KNUM * sizeof(*vnums));
+  IWKV_kv *kvs = calloc(2 * KNUM, sizeof(*kvs));
+  CU_ASSERT_PTR_NOT_NULL_FATAL(knums);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(vnums);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(kvs);
+
+  for (int i = 0; i < 2 * KNUM; ++i) {
+    // Pseudo random permutation of keys, every key is repeated twice
+    knums[i] = ((uint64_t) (i % KNUM) * 7919) % KNUM;
+    vnums[i] = i;
+    kvs[i].key.data = &knums[i];
+    kvs[i].key.size = sizeof(knums[i]);
+    kvs[i].val.data = &vnums[i];
+    kvs[i].val.size = sizeof(vnums[i]);
+  }
+  rc = iwkv_put_batch(db, kvs, 2 * KNUM, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Last value of the same key wins
+  for (int i = KNUM; i < 2 * KNUM; ++i) {
+    uint64_t llv = 0;
+    size_t sz = 0;
+    rc = iwkv_get_copy(db, &kvs[i].key, &llv, sizeof(llv), &sz);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(sz, sizeof(llv));
+    CU_ASSERT_EQUAL_FATAL(llv, (uint64_t) i);
+  }
+
+  int64_t cnt = 0;
+  uint64_t prev = 0;
+  IWKV_cursor cur;
+  rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    uint64_t llv;
+    size_t sz;
+    rc = iwkv_cursor_copy_key(cur, &llv, sizeof(llv), &sz, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    if (cnt) {
+      CU_ASSERT_TRUE_FATAL(llv < prev);
+    }
+    prev = llv;
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(cnt, KNUM);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  free(kvs);
+  free(vnums);
+  free(knums);
+}
+
+// Unsorted batch in compound keys db
+static void iwkv_test11_3(void) {
+  IWKV iwkv;
+  IWDB db;
+  IWKV_OPTS opts = {
+    .path = "iwkv_test11_3.db",
+    .oflags = IWKV_TRUNC
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, IWDB_COMPOUND_KEYS, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  const char *words[] = { "foo", "bar", "baz", "zzz", "a" };
+  IWKV_kv kvs[5 * 100];
+  int64_t vals[5 * 100];
+  for (int i = 0, n = 0; i < 100; ++i) {
+    for (int j = 0; j < 5; ++j, ++n) {
+      kvs[n].key.data = (void*) words[j];
+      kvs[n].key.size = strlen(words[j]);
+      kvs[n].key.compound = 99 - i;
+      vals[n] = n;
+      kvs[n].val.data = &vals[n];
+      kvs[n].val.size = sizeof(vals[n]);
+    }
+  }
+  rc = iwkv_put_batch(db, kvs, 5 * 100, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int n = 0; n < 5 * 100; ++n) {
+    int64_t llv = -1;
+    size_t sz = 0;
+    rc = iwkv_get_copy(db, &kvs[n].key, &llv, sizeof(llv), &sz);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(llv, n);
+  }
+
+  int cnt = 0;
+  IWKV_cursor cur;
+  rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(cnt, 5 * 100);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+// Multi get of unordered keys with missing ones
+static void iwkv_test11_4(void) {
+  IWKV iwkv;
+  IWDB db;
+  IWKV_OPTS opts = {
+    .path = "iwkv_test11_4.db",
+    .oflags = IWKV_TRUNC
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  char(*keys)[16] = malloc(KNUM * sizeof(*keys));
+  IWKV_val *kv = calloc(KNUM, sizeof(*kv));
+  IWKV_val *vals = calloc(KNUM, sizeof(*vals));
+  iwrc *rcs = calloc(KNUM, sizeof(*rcs));
+  CU_ASSERT_PTR_NOT_NULL_FATAL(keys);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(kv);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(vals);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(rcs);
+
+  // Only even keys are stored, key `0` has an empty value
+  for (int i = 0; i < KNUM; ++i) {
+    snprintf(keys[i], sizeof(keys[i]), "%d", i);
+    kv[i].data = keys[i];
+    kv[i].size = strlen(keys[i]);
+    if (!(i % 2)) {
+      IWKV_val val = { .data = keys[i], .size = i ? kv[i].size : 0 };
+      rc = iwkv_put(db, &kv[i], &val, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+    }
+  }
+
+  rc = iwkv_get_multi(db, kv, KNUM, vals, rcs);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < KNUM; ++i) {
+    if (i % 2) {
+      CU_ASSERT_EQUAL_FATAL(rcs[i], IWKV_ERROR_NOTFOUND);
+      CU_ASSERT_EQUAL_FATAL(vals[i].size, 0);
+      CU_ASSERT_PTR_NULL_FATAL(vals[i].data);
+    } else if (i == 0) {
+      CU_ASSERT_EQUAL_FATAL(rcs[i], 0);
+      CU_ASSERT_EQUAL_FATAL(vals[i].size, 0);
+    } else {
+      int cret;
+      const char *k = keys[i];
+      IWKV_val *v = &vals[i];
+      CU_ASSERT_EQUAL_FATAL(rcs[i], 0);
+      IW_CMP(cret, k, strlen(k), v->data, v->size);
+      CU_ASSERT_EQUAL_FATAL(cret, 0);
+    }
+    iwkv_val_dispose(&vals[i]);
+  }
+
+  // Keys are in the database order, same key twice, no result codes
+  IWKV_val mkeys[] = {
+    { .data = "8", .size = 1 },
+    { .data = "7", .size = 1 },
+    { .data = "10", .size = 2 },
+    { .data = "10", .size = 2 },
+  };
+  rc = iwkv_get_multi(db, mkeys, 4, vals, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(vals[0].size, 1);
+  CU_ASSERT_EQUAL(vals[1].size, 0);
+  CU_ASSERT_EQUAL(vals[2].size, 2);
+  CU_ASSERT_EQUAL(vals[3].size, 2);
+  for (int i = 0; i < 4; ++i) {
+    iwkv_val_dispose(&vals[i]);
+  }
+
+  rc = iwkv_get_multi(db, mkeys, 0, vals, 0);
+  CU_ASSERT_EQUAL(rc, 0);
+  rc = iwkv_get_multi(db, 0, 1, vals, 0);
+  CU_ASSERT_EQUAL(rc, IW_ERROR_INVALID_ARGS);
+
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  free(rcs);
+  free(vals);
+  free(kv);
+  free(keys);
+}
+
+struct bulk_src {
+  int  pos;
+  int  end;
+  int  step;
+  char kbuf[16];
+  char vbuf[16];
+};
+
+static iwrc bulk_src_next(IWKV_val *key, IWKV_val *val, void *op) {
+  struct bulk_src *src = op;
+  if (src->pos == src->end) {
+    return IWKV_ERROR_NOTFOUND;
+  }
+  snprintf(src->kbuf, sizeof(src->kbuf), "%08d", src->pos);
+  snprintf(src->vbuf, sizeof(src->vbuf), "v%d", src->pos);
+  key->data = src->kbuf;
+  key->size = strlen(src->kbuf);
+  val->data = src->vbuf;
+  val->size = (src->pos % 100) ? strlen(src->vbuf) : 0;
+  src->pos += src->step;
+  return 0;
+}
+
+static void bulk_verify(IWDB db, int num) {
+  char kbuf[16], vbuf[16];
+  for (int i = 0; i < num; ++i) {
+    int cret;
+    IWKV_val key, val;
+    snprintf(kbuf, sizeof(kbuf), "%08d", i);
+    snprintf(vbuf, sizeof(vbuf), "v%d", i);
+    key.data = kbuf;
+    key.size = strlen(kbuf);
+    iwrc rc = iwkv_get(db, &key, &val);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    IW_CMP(cret, vbuf, (i % 100) ? strlen(vbuf) : 0, val.data, val.size);
+    CU_ASSERT_EQUAL_FATAL(cret, 0);
+    iwkv_val_dispose(&val);
+  }
+  // Backward iteration visits keys in ascending order
+  int cnt = 0;
+  IWKV_cursor cur;
+  iwrc rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_AFTER_LAST, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_PREV))) {
+    int cret;
+    size_t sz;
+    rc = iwkv_cursor_copy_key(cur, vbuf, sizeof(vbuf), &sz, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    snprintf(kbuf, sizeof(kbuf), "%08d", cnt);
+    IW_CMP(cret, kbuf, strlen(kbuf), vbuf, sz);
+    CU_ASSERT_EQUAL_FATAL(cret, 0);
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(cnt, num);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static void iwkv_test11_5_impl(bool wal) {
+  IWKV iwkv;
+  IWDB db;
+  IWKV_OPTS opts = {
+    .path = wal ? "iwkv_test11_5_wal.db" : "iwkv_test11_5.db",
+    .oflags = IWKV_TRUNC,
+    .wal = {
+      .enabled = wal
+    }
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Wrong keys order
+  struct bulk_src src = { .pos = 0, .end = 100, .step = 1 };
+  rc = iwkv_db(iwkv, 2, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_bulk_load(db, bulk_src_next, &src, 0);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_KEYS_ORDER);
+
+  // Keys are provided in descending order as stored in database
+  src = (struct bulk_src) {
+    .pos = 5 * KNUM - 1, .end = -1, .step = -1
+  };
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_bulk_load(db, bulk_src_next, &src, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  bulk_verify(db, 5 * KNUM);
+
+  src.pos = 10;
+  rc = iwkv_bulk_load(db, bulk_src_next, &src, 0);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_DB_NOT_EMPTY);
+
+  // Regular updates and inserts into bulk loaded database
+  for (int i = 5 * KNUM; i < 6 * KNUM; ++i) {
+    IWKV_val key, val;
+    src.pos = i;
+    src.step = 0;
+    bulk_src_next(&key, &val, &src);
+    rc = iwkv_put(db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  opts.oflags = 0;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  bulk_verify(db, 6 * KNUM);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static void iwkv_test11_5(void) {
+  iwkv_test11_5_impl(false);
+}
+
+static void iwkv_test11_5_wal(void) {
+  iwkv_test11_5_impl(true);
+}
+
+int main(void) {
+  CU_pSuite pSuite = NULL;
+
+  /* Initialize the CUnit test registry */
+  if (CUE_SUCCESS != CU_initialize_registry()) {
+    return CU_get_error();
+  }
+
+  /* Add a suite to the registry */
+  pSuite = CU_add_suite("iwkv_test11", init_suite, clean_suite);
+
+  if (NULL == pSuite) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  /* Add the tests to the suite */
+  if (  (NULL == CU_add_test(pSuite, "iwkv_test11_1", iwkv_test11_1))
+     || (NULL == CU_add_test(pSuite, "iwkv_test11_1_wal", iwkv_test11_1_wal))
+     || (NULL == CU_add_test(pSuite, "iwkv_test11_2", iwkv_test11_2))
+     || (NULL == CU_add_test(pSuite, "iwkv_test11_3", iwkv_test11_3))
+     || (NULL == CU_add_test(pSuite, "iwkv_test11_4", iwkv_test11_4))
+     || (NULL == CU_add_test(pSuite, "iwkv_test11_5", iwkv_test11_5))
+     || (NULL == CU_add_test(pSuite, "iwkv_test11_5_wal", iwkv_test11_5_wal))) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  /* Run all tests using the CUnit Basic interface */
+  CU_basic_set_mode(CU_BRM_VERBOSE);
+  CU_basic_run_tests();
+  int ret = CU_get_error() || CU_get_number_of_failures();
+  CU_cleanup_registry();
+  return ret;
+}
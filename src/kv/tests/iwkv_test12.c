@@ -0,0 +1,307 @@
+#include "iwkv.h"
+#include "iwlog.h"
+#include "iwutils.h"
+#include "iwkv_tests.h"
+#include "iwkv_internal.h"
+
+#define KNUM 30000
+
+int init_suite(void) {
+  return iwkv_init();
+}
+
+int clean_suite(void) {
+  return 0;
+}
+
+static void verify_keys(IWDB db, int num, int mod) {
+  char kbuf[16];
+  for (int i = 0; i < num; ++i) {
+    uint32_t v = 0;
+    size_t sz = 0;
+    IWKV_val key = { .data = kbuf };
+    snprintf(kbuf, sizeof(kbuf), "%d", i);
+    key.size = strlen(kbuf);
+    iwrc rc = iwkv_get_copy(db, &key, &v, sizeof(v), &sz);
+    if (mod && !(i % mod)) {
+      CU_ASSERT_EQUAL_FATAL(rc, IWKV_ERROR_NOTFOUND);
+    } else {
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+      CU_ASSERT_EQUAL_FATAL(sz, sizeof(v));
+      CU_ASSERT_EQUAL_FATAL(v, (uint32_t) (mod ? 2 * i : i));
+    }
+  }
+}
+
+// Decoded SBLK cache is consistent with database updates
+static void iwkv_test12_1_impl(bool wal) {
+  IWKV iwkv;
+  IWDB db;
+  char kbuf[16];
+  struct iwkv_db_cache_stats stats;
+  IWKV_OPTS opts = {
+    .path = wal ? "iwkv_test12_1_wal.db" : "iwkv_test12_1.db",
+    .oflags = IWKV_TRUNC,
+    .wal = {
+      .enabled = wal
+    }
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < KNUM; ++i) {
+    uint32_t v = i;
+    IWKV_val key = { .data = kbuf };
+    IWKV_val val = { .data = &v, .size = sizeof(v) };
+    snprintf(kbuf, sizeof(kbuf), "%d", i);
+    key.size = strlen(kbuf);
+    rc = iwkv_put(db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  verify_keys(db, KNUM, 0);
+  rc = iwkv_db_cache_stats(db, &stats);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_TRUE(stats.hits > 0);
+  CU_ASSERT_TRUE(stats.misses > 0);
+
+  // Delete every 3rd key and update others
+  for (int i = 0; i < KNUM; ++i) {
+    IWKV_val key = { .data = kbuf };
+    snprintf(kbuf, sizeof(kbuf), "%d", i);
+    key.size = strlen(kbuf);
+    if (!(i % 3)) {
+      rc = iwkv_del(db, &key, 0);
+    } else {
+      uint32_t v = 2 * i;
+      IWKV_val val = { .data = &v, .size = sizeof(v) };
+      rc = iwkv_put(db, &key, &val, 0);
+    }
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  verify_keys(db, KNUM, 3);
+
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  opts.oflags = 0;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_keys(db, KNUM, 3);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static void iwkv_test12_1(void) {
+  iwkv_test12_1_impl(false);
+}
+
+static void iwkv_test12_1_wal(void) {
+  iwkv_test12_1_impl(true);
+}
+
+// Exact lookups of compound keys in v2 and v3 (with key fingerprints) formats
+static void iwkv_test12_2_impl(int fmt_version) {
+  IWKV iwkv;
+  IWDB db;
+  char kbuf[16];
+  IWKV_OPTS opts = {
+    .path = fmt_version > 2 ? "iwkv_test12_2_v3.db" : "iwkv_test12_2_v2.db",
+    .oflags = IWKV_TRUNC,
+    .fmt_version = fmt_version
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, IWDB_COMPOUND_KEYS, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < KNUM; ++i) {
+    uint32_t v = i;
+    IWKV_val key = { .data = kbuf, .compound = i % 7 };
+    IWKV_val val = { .data = &v, .size = sizeof(v) };
+    snprintf(kbuf, sizeof(kbuf), "%d", i / 7);
+    key.size = strlen(kbuf);
+    rc = iwkv_put(db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  for (int i = 0; i < KNUM + 7; ++i) {
+    uint32_t v = 0;
+    size_t sz = 0;
+    IWKV_val key = { .data = kbuf, .compound = i % 7 };
+    snprintf(kbuf, sizeof(kbuf), "%d", i / 7);
+    key.size = strlen(kbuf);
+    rc = iwkv_get_copy(db, &key, &v, sizeof(v), &sz);
+    if (i < KNUM) {
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+      CU_ASSERT_EQUAL_FATAL(v, (uint32_t) i);
+    } else {
+      CU_ASSERT_EQUAL_FATAL(rc, IWKV_ERROR_NOTFOUND);
+    }
+    // Same key data with unknown compound part
+    key.compound = 7;
+    rc = iwkv_get_copy(db, &key, &v, sizeof(v), &sz);
+    CU_ASSERT_EQUAL_FATAL(rc, IWKV_ERROR_NOTFOUND);
+    if (i < KNUM && (i % 2)) {
+      key.compound = i % 7;
+      rc = iwkv_del(db, &key, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+      rc = iwkv_del(db, &key, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, IWKV_ERROR_NOTFOUND);
+    }
+  }
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  opts.oflags = 0;
+  opts.fmt_version = 0;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, IWDB_COMPOUND_KEYS, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < KNUM; ++i) {
+    uint32_t v = 0;
+    size_t sz = 0;
+    IWKV_val key = { .data = kbuf, .compound = i % 7 };
+    snprintf(kbuf, sizeof(kbuf), "%d", i / 7);
+    key.size = strlen(kbuf);
+    rc = iwkv_get_copy(db, &key, &v, sizeof(v), &sz);
+    if (i % 2) {
+      CU_ASSERT_EQUAL_FATAL(rc, IWKV_ERROR_NOTFOUND);
+    } else {
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+      CU_ASSERT_EQUAL_FATAL(v, (uint32_t) i);
+    }
+  }
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static void iwkv_test12_2(void) {
+  iwkv_test12_2_impl(2);
+}
+
+static void iwkv_test12_2_v3(void) {
+  iwkv_test12_2_impl(3);
+}
+
+// Bloom filter rejects absent keys and stays consistent with database updates
+static void iwkv_test12_3(void) {
+  IWKV iwkv;
+  IWDB db;
+  char kbuf[16];
+  struct iwkv_db_cache_stats stats;
+  IWKV_OPTS opts = {
+    .path = "iwkv_test12_3.db",
+    .oflags = IWKV_TRUNC
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Filter is built from existing keys then grows with puts
+  for (int i = 0; i < KNUM; ++i) {
+    uint32_t v = i;
+    IWKV_val key = { .data = kbuf };
+    IWKV_val val = { .data = &v, .size = sizeof(v) };
+    snprintf(kbuf, sizeof(kbuf), "%d", i);
+    key.size = strlen(kbuf);
+    rc = iwkv_put(db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    if (i == 100) {
+      rc = iwkv_db_set_bloom(db, 10);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+    }
+  }
+  verify_keys(db, KNUM, 0);
+  rc = iwkv_db_cache_stats(db, &stats);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(stats.bloom_negatives, 0);
+
+  for (int i = KNUM; i < 2 * KNUM; ++i) {
+    uint32_t v = 0;
+    size_t sz = 0;
+    IWKV_val key = { .data = kbuf };
+    snprintf(kbuf, sizeof(kbuf), "%d", i);
+    key.size = strlen(kbuf);
+    rc = iwkv_get_copy(db, &key, &v, sizeof(v), &sz);
+    CU_ASSERT_EQUAL_FATAL(rc, IWKV_ERROR_NOTFOUND);
+  }
+  rc = iwkv_db_cache_stats(db, &stats);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_TRUE(stats.bloom_negatives > KNUM * 9 / 10);
+
+  // Delete every 3rd key and update others
+  for (int i = 0; i < KNUM; ++i) {
+    IWKV_val key = { .data = kbuf };
+    snprintf(kbuf, sizeof(kbuf), "%d", i);
+    key.size = strlen(kbuf);
+    if (!(i % 3)) {
+      rc = iwkv_del(db, &key, 0);
+    } else {
+      uint32_t v = 2 * i;
+      IWKV_val val = { .data = &v, .size = sizeof(v) };
+      rc = iwkv_put(db, &key, &val, 0);
+    }
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  verify_keys(db, KNUM, 3);
+
+  IWKV_val keys[3] = {
+    { .data = "3", .size = 1 },
+    { .data = "4", .size = 1 },
+    { .data = "absent", .size = 6 }
+  };
+  IWKV_val vals[3];
+  iwrc rcs[3];
+  rc = iwkv_get_multi(db, keys, 3, vals, rcs);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(rcs[0], IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(rcs[1], 0);
+  CU_ASSERT_EQUAL(rcs[2], IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(vals[1].size, sizeof(uint32_t));
+  iwkv_val_dispose(&vals[1]);
+
+  rc = iwkv_db_set_bloom(db, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_keys(db, KNUM, 3);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+int main(void) {
+  CU_pSuite pSuite = NULL;
+
+  /* Initialize the CUnit test registry */
+  if (CUE_SUCCESS != CU_initialize_registry()) {
+    return CU_get_error();
+  }
+
+  /* Add a suite to the registry */
+  pSuite = CU_add_suite("iwkv_test12", init_suite, clean_suite);
+
+  if (NULL == pSuite) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  /* Add the tests to the suite */
+  if (  (NULL == CU_add_test(pSuite, "iwkv_test12_1", iwkv_test12_1))
+     || (NULL == CU_add_test(pSuite, "iwkv_test12_1_wal", iwkv_test12_1_wal))
+     || (NULL == CU_add_test(pSuite, "iwkv_test12_2", iwkv_test12_2))
+     || (NULL == CU_add_test(pSuite, "iwkv_test12_2_v3", iwkv_test12_2_v3))
+     || (NULL == CU_add_test(pSuite, "iwkv_test12_3", iwkv_test12_3))) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  /* Run all tests using the CUnit Basic interface */
+  CU_basic_set_mode(CU_BRM_VERBOSE);
+  CU_basic_run_tests();
+  int ret = CU_get_error() || CU_get_number_of_failures();
+  CU_cleanup_registry();
+  return ret;
+}
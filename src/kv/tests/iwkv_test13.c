@@ -0,0 +1,517 @@
+#include "iwkv.h"
+#include "iwlog.h"
+#include "iwutils.h"
+#include "iwkv_tests.h"
+
+#include <sys/stat.h>
+
+#define KNUM 2000
+
+int init_suite(void) {
+  return iwkv_init();
+}
+
+int clean_suite(void) {
+  return 0;
+}
+
+// Fills `buf` with JSON like value of key `i`, returns value size
+static size_t value_fill(char *buf, size_t bufsz, int i) {
+  size_t sz = 0;
+  int num = i % 3 ? 10 : 0; // Every 3rd value is too small to be compressed
+  sz += snprintf(buf + sz, bufsz - sz, "{\"id\":%d,\"items\":[", i);
+  for (int j = 0; j < num; ++j) {
+    sz += snprintf(buf + sz, bufsz - sz, "{\"name\":\"item%d\",\"price\":%d,\"tags\":[\"new\",\"sale\"]},", j, i + j);
+  }
+  sz += snprintf(buf + sz, bufsz - sz, "]}");
+  return sz;
+}
+
+static void verify_values(IWDB db) {
+  char kbuf[16];
+  char vbuf[1024], vbuf2[1024];
+  for (int i = 0; i < KNUM; ++i) {
+    size_t sz = 0;
+    IWKV_val key = { .data = kbuf };
+    IWKV_val val;
+    snprintf(kbuf, sizeof(kbuf), "%d", i);
+    key.size = strlen(kbuf);
+    size_t vsz = value_fill(vbuf, sizeof(vbuf), i);
+
+    iwrc rc = iwkv_get(db, &key, &val);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(val.size, vsz);
+    CU_ASSERT_FALSE_FATAL(memcmp(val.data, vbuf, vsz));
+    iwkv_val_dispose(&val);
+
+    rc = iwkv_get_copy(db, &key, vbuf2, sizeof(vbuf2), &sz);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(sz, vsz);
+    CU_ASSERT_FALSE_FATAL(memcmp(vbuf2, vbuf, vsz));
+
+    // Value prefix into a small buffer
+    rc = iwkv_get_copy(db, &key, vbuf2, 10, &sz);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(sz, vsz);
+    CU_ASSERT_FALSE_FATAL(memcmp(vbuf2, vbuf, 10));
+  }
+}
+
+static iwrc bulk_fn(IWKV_val *key, IWKV_val *val, void *op) {
+  static char kbuf[16], vbuf[1024];
+  int *ip = op;
+  if (*ip < 0) {
+    return IWKV_ERROR_NOTFOUND;
+  }
+  // Keys are loaded in descending order as stored in database
+  snprintf(kbuf, sizeof(kbuf), "%05d", *ip);
+  key->data = kbuf;
+  key->size = strlen(kbuf);
+  val->data = vbuf;
+  val->size = value_fill(vbuf, sizeof(vbuf), *ip);
+  --(*ip);
+  return 0;
+}
+
+static off_t file_size(const char *path) {
+  struct stat st;
+  CU_ASSERT_EQUAL_FATAL(stat(path, &st), 0);
+  return st.st_size;
+}
+
+static void iwkv_test13_1_impl(iwdb_flags_t dbflg, const char *path, off_t *fsize) {
+  IWKV iwkv;
+  IWDB db, db2;
+  char kbuf[16];
+  char vbuf[1024];
+  IWKV_OPTS opts = {
+    .path = path,
+    .oflags = IWKV_TRUNC
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, dbflg, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < KNUM; ++i) {
+    IWKV_val key = { .data = kbuf };
+    IWKV_val val = { .data = vbuf };
+    snprintf(kbuf, sizeof(kbuf), "%d", i);
+    key.size = strlen(kbuf);
+    val.size = value_fill(vbuf, sizeof(vbuf), i + 1);
+    rc = iwkv_put(db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  // Overwrite all values
+  for (int i = 0; i < KNUM; ++i) {
+    IWKV_val key = { .data = kbuf };
+    IWKV_val val = { .data = vbuf };
+    snprintf(kbuf, sizeof(kbuf), "%d", i);
+    key.size = strlen(kbuf);
+    val.size = value_fill(vbuf, sizeof(vbuf), i);
+    rc = iwkv_put(db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  verify_values(db);
+
+  // Cursor access
+  IWKV_cursor cur;
+  int cnt = 0;
+  rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    IWKV_val key, val;
+    size_t sz;
+    char vbuf2[1024];
+    rc = iwkv_cursor_get(cur, &key, &val);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    snprintf(kbuf, sizeof(kbuf), "%.*s", (int) key.size, (char*) key.data);
+    size_t vsz = value_fill(vbuf, sizeof(vbuf), atoi(kbuf));
+    CU_ASSERT_EQUAL_FATAL(val.size, vsz);
+    CU_ASSERT_FALSE_FATAL(memcmp(val.data, vbuf, vsz));
+    iwkv_kv_dispose(&key, &val);
+    rc = iwkv_cursor_copy_val(cur, vbuf2, sizeof(vbuf2), &sz);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(sz, vsz);
+    CU_ASSERT_FALSE_FATAL(memcmp(vbuf2, vbuf, vsz));
+    if (cnt == 10) {
+      val.data = vbuf;
+      val.size = value_fill(vbuf, sizeof(vbuf), atoi(kbuf));
+      rc = iwkv_cursor_set(cur, &val, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+    }
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(cnt, KNUM);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Increment of small value
+  uint64_t llv = 1;
+  IWKV_val ikey = { .data = "counter", .size = 7 };
+  IWKV_val ival = { .data = &llv, .size = sizeof(llv) };
+  rc = iwkv_put(db, &ikey, &ival, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  llv = 41;
+  rc = iwkv_put(db, &ikey, &ival, IWKV_VAL_INCREMENT);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  size_t sz;
+  rc = iwkv_get_copy(db, &ikey, &llv, sizeof(llv), &sz);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(sz, sizeof(llv));
+  CU_ASSERT_EQUAL(llv, 42);
+
+  // Bulk load
+  int bi = KNUM - 1;
+  rc = iwkv_db(iwkv, 2, dbflg, &db2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_bulk_load(db2, bulk_fn, &bi, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < KNUM; i += 7) {
+    IWKV_val key = { .data = kbuf }, val;
+    snprintf(kbuf, sizeof(kbuf), "%05d", i);
+    key.size = strlen(kbuf);
+    size_t vsz = value_fill(vbuf, sizeof(vbuf), i);
+    rc = iwkv_get(db2, &key, &val);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(val.size, vsz);
+    CU_ASSERT_FALSE_FATAL(memcmp(val.data, vbuf, vsz));
+    iwkv_val_dispose(&val);
+  }
+
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  opts.oflags = 0;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, dbflg, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_values(db);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  *fsize = file_size(path);
+}
+
+// Values of `IWDB_COMPRESSED_VALUES` database
+static void iwkv_test13_1(void) {
+  off_t fsize, fsize_c;
+  iwkv_test13_1_impl(0, "iwkv_test13_1.db", &fsize);
+  iwkv_test13_1_impl(IWDB_COMPRESSED_VALUES, "iwkv_test13_1_c.db", &fsize_c);
+  CU_ASSERT_TRUE(fsize_c < fsize / 2);
+}
+
+#define EXT_KNUM      100
+#define EXT_THRESHOLD 4096
+
+// Size of `gen` generation value of key `i`, every 4th value is stored out of line
+static size_t ext_value_size(int i, int gen) {
+  if (i % 4) {
+    return 20 + (gen % 3);
+  }
+  switch (gen % 4) {
+    case 0:
+      return 100000 + i * 1000;
+    case 1:
+      return 100100 + i * 1000; // Fits into extent of generation 0
+    case 2:
+      return 300000;
+    default:
+      return 100; // Back to inline storage
+  }
+}
+
+static void ext_value_fill(uint8_t *buf, int i, int gen, size_t sz) {
+  for (size_t j = 0; j < sz; ++j) {
+    buf[j] = (uint8_t) (i * 31 + gen * 7 + j);
+  }
+}
+
+static void ext_verify(IWDB db, uint8_t *vbuf, uint8_t *vbuf2, int gen) {
+  char kbuf[16];
+  for (int i = 0; i < EXT_KNUM; ++i) {
+    IWKV_val key = { .data = kbuf }, val;
+    size_t sz;
+    snprintf(kbuf, sizeof(kbuf), "%03d", i);
+    key.size = strlen(kbuf);
+    size_t vsz = ext_value_size(i, gen);
+    ext_value_fill(vbuf, i, gen, vsz);
+    iwrc rc = iwkv_get(db, &key, &val);
+    if (i % 2) { // Odd keys are removed at second generation
+      if (gen > 1) {
+        CU_ASSERT_EQUAL_FATAL(rc, IWKV_ERROR_NOTFOUND);
+        continue;
+      }
+    }
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(val.size, vsz);
+    CU_ASSERT_FALSE_FATAL(memcmp(val.data, vbuf, vsz));
+    iwkv_val_dispose(&val);
+    rc = iwkv_get_copy(db, &key, vbuf2, vsz, &sz);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(sz, vsz);
+    CU_ASSERT_FALSE_FATAL(memcmp(vbuf2, vbuf, vsz));
+  }
+}
+
+static void iwkv_test13_2_impl(iwdb_flags_t dbflg, bool wal) {
+  IWKV iwkv;
+  IWDB db;
+  char kbuf[16];
+  uint8_t *vbuf = malloc(300000), *vbuf2 = malloc(300000);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(vbuf);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(vbuf2);
+  IWKV_OPTS opts = {
+    .path = wal ? "iwkv_test13_2w.db" : "iwkv_test13_2.db",
+    .oflags = IWKV_TRUNC,
+    .ext_value_threshold = EXT_THRESHOLD,
+    .wal = {
+      .enabled = wal
+    }
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, dbflg, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int gen = 0; gen < 4; ++gen) {
+    if (gen == 2) {
+      for (int i = 1; i < EXT_KNUM; i += 2) {
+        IWKV_val key = { .data = kbuf };
+        snprintf(kbuf, sizeof(kbuf), "%03d", i);
+        key.size = strlen(kbuf);
+        rc = iwkv_del(db, &key, 0);
+        CU_ASSERT_EQUAL_FATAL(rc, 0);
+      }
+    }
+    for (int i = 0; i < EXT_KNUM; ++i) {
+      if ((gen > 1) && (i % 2)) {
+        continue;
+      }
+      IWKV_val key = { .data = kbuf };
+      IWKV_val val = { .data = vbuf, .size = ext_value_size(i, gen) };
+      snprintf(kbuf, sizeof(kbuf), "%03d", i);
+      key.size = strlen(kbuf);
+      ext_value_fill(vbuf, i, gen, val.size);
+      rc = iwkv_put(db, &key, &val, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+    }
+    ext_verify(db, vbuf, vbuf2, gen);
+  }
+
+  // Cursor access to mixed values
+  IWKV_cursor cur;
+  int cnt = 0;
+  rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    IWKV_val key, val;
+    rc = iwkv_cursor_get(cur, &key, &val);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    snprintf(kbuf, sizeof(kbuf), "%.*s", (int) key.size, (char*) key.data);
+    int i = atoi(kbuf);
+    size_t vsz = ext_value_size(i, 3);
+    ext_value_fill(vbuf, i, 3, vsz);
+    CU_ASSERT_EQUAL_FATAL(val.size, vsz);
+    CU_ASSERT_FALSE_FATAL(memcmp(val.data, vbuf, vsz));
+    iwkv_kv_dispose(&key, &val);
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(cnt, EXT_KNUM / 2);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  opts.oflags = 0;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, dbflg, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  ext_verify(db, vbuf, vbuf2, 3);
+
+  for (int gen = 0; gen < 2; ++gen) {
+    for (int i = 0; i < EXT_KNUM; ++i) {
+      IWKV_val key = { .data = kbuf };
+      IWKV_val val = { .data = vbuf, .size = ext_value_size(i, gen) };
+      snprintf(kbuf, sizeof(kbuf), "%03d", i);
+      key.size = strlen(kbuf);
+      ext_value_fill(vbuf, i, gen, val.size);
+      rc = iwkv_put(db, &key, &val, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+    }
+  }
+  ext_verify(db, vbuf, vbuf2, 1);
+
+  // Extents of destroyed database are released
+  rc = iwkv_db_destroy(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_TRUE(file_size(opts.path) < 1024 * 1024);
+  free(vbuf);
+  free(vbuf2);
+}
+
+// Out of line storage of large values
+static void iwkv_test13_2(void) {
+  iwkv_test13_2_impl(0, false);
+  iwkv_test13_2_impl(IWDB_COMPRESSED_VALUES, false);
+  iwkv_test13_2_impl(0, true);
+}
+
+#define RK_KNUM 6000
+
+static void rk_key_fill(char *kbuf, size_t kbufsz, int i) {
+  snprintf(kbuf, kbufsz, "tenant%02d/entity%06d/ts%010d", i % 7, i / 7, 1600000000 + i);
+}
+
+static void rk_verify(IWDB db, int gen) {
+  char kbuf[64], vbuf[64], kbuf2[64];
+  for (int i = 0; i < RK_KNUM; ++i) {
+    IWKV_val key = { .data = kbuf };
+    IWKV_val val;
+    rk_key_fill(kbuf, sizeof(kbuf), i);
+    key.size = strlen(kbuf);
+    iwrc rc = iwkv_get(db, &key, &val);
+    if (i % 3 == 0) {
+      CU_ASSERT_EQUAL_FATAL(rc, IWKV_ERROR_NOTFOUND);
+      continue;
+    }
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    snprintf(vbuf, sizeof(vbuf), "%d:%d", i, (i % 2) ? gen : 0);
+    CU_ASSERT_EQUAL_FATAL(val.size, strlen(vbuf));
+    CU_ASSERT_FALSE_FATAL(memcmp(val.data, vbuf, val.size));
+    iwkv_val_dispose(&val);
+  }
+
+  // Keys are reconstructed in order by cursor
+  int cnt = 0;
+  IWKV_cursor cur;
+  iwrc rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    size_t ksz;
+    bool matched;
+    rc = iwkv_cursor_copy_key(cur, kbuf, sizeof(kbuf) - 1, &ksz, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_TRUE_FATAL(ksz < sizeof(kbuf));
+    kbuf[ksz] = '\0';
+    CU_ASSERT_TRUE_FATAL(!cnt || strcmp(kbuf2, kbuf) > 0);
+    IWKV_val key = { .data = kbuf, .size = ksz };
+    rc = iwkv_cursor_is_matched_key(cur, &key, &matched, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_TRUE_FATAL(matched);
+    --key.size;
+    rc = iwkv_cursor_is_matched_key(cur, &key, &matched, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_FALSE_FATAL(matched);
+    memcpy(kbuf2, kbuf, ksz + 1);
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(cnt, RK_KNUM - (RK_KNUM + 2) / 3);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static void iwkv_test13_3_impl(int fmt_version, bool wal, off_t *fsize) {
+  IWKV iwkv;
+  IWDB db;
+  char kbuf[64], vbuf[64];
+  IWKV_OPTS opts = {
+    .path = wal ? "iwkv_test13_3w.db" : "iwkv_test13_3.db",
+    .oflags = IWKV_TRUNC,
+    .fmt_version = fmt_version,
+    .wal = {
+      .enabled = wal
+    }
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int gen = 0; gen < 2; ++gen) {
+    for (int n = 0; n < RK_KNUM; ++n) {
+      int i = (int) ((n * 7919ULL) % RK_KNUM);
+      if (gen && !(i % 2)) {
+        continue;
+      }
+      IWKV_val key = { .data = kbuf };
+      IWKV_val val = { .data = vbuf };
+      rk_key_fill(kbuf, sizeof(kbuf), i);
+      key.size = strlen(kbuf);
+      val.size = snprintf(vbuf, sizeof(vbuf), "%d:%d", i, gen);
+      rc = iwkv_put(db, &key, &val, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+    }
+  }
+  for (int i = 0; i < RK_KNUM; i += 3) {
+    IWKV_val key = { .data = kbuf };
+    rk_key_fill(kbuf, sizeof(kbuf), i);
+    key.size = strlen(kbuf);
+    rc = iwkv_del(db, &key, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  rk_verify(db, 1);
+
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  *fsize = file_size(opts.path);
+
+  opts.oflags = 0;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rk_verify(db, 1);
+  rc = iwkv_db_destroy(&db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+// Front coding of keys in KVBLK
+static void iwkv_test13_3(void) {
+  off_t fsize3, fsize4, wfsize4;
+  iwkv_test13_3_impl(3, false, &fsize3);
+  iwkv_test13_3_impl(0, false, &fsize4);
+  iwkv_test13_3_impl(0, true, &wfsize4);
+  CU_ASSERT_TRUE(fsize4 < fsize3);
+}
+
+int main(void) {
+  CU_pSuite pSuite = NULL;
+
+  /* Initialize the CUnit test registry */
+  if (CUE_SUCCESS != CU_initialize_registry()) {
+    return CU_get_error();
+  }
+
+  /* Add a suite to the registry */
+  pSuite = CU_add_suite("iwkv_test13", init_suite, clean_suite);
+
+  if (NULL == pSuite) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  /* Add the tests to the suite */
+  if (  (NULL == CU_add_test(pSuite, "iwkv_test13_1", iwkv_test13_1))
+     || (NULL == CU_add_test(pSuite, "iwkv_test13_2", iwkv_test13_2))
+     || (NULL == CU_add_test(pSuite, "iwkv_test13_3", iwkv_test13_3))) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  /* Run all tests using the CUnit Basic interface */
+  CU_basic_set_mode(CU_BRM_VERBOSE);
+  CU_basic_run_tests();
+  int ret = CU_get_error() || CU_get_number_of_failures();
+  CU_cleanup_registry();
+  return ret;
+}
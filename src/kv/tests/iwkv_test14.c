@@ -0,0 +1,1048 @@
+#include "iwkv.h"
+#include "iwlog.h"
+#include "iwutils.h"
+#include "iwp.h"
+#include "iwkv_tests.h"
+
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define KNUM    20000
+#define BIGVSZ  2000
+
+int init_suite(void) {
+  return iwkv_init();
+}
+
+int clean_suite(void) {
+  return 0;
+}
+
+static off_t file_size(const char *path) {
+  struct stat st;
+  CU_ASSERT_EQUAL_FATAL(stat(path, &st), 0);
+  return st.st_size;
+}
+
+// Every 7th record has a large value stored out of line
+static size_t value_fill(uint8_t *vbuf, int i) {
+  size_t sz = (i % 7) ? sizeof(uint32_t) : BIGVSZ;
+  memset(vbuf, i & 0xff, sz);
+  memcpy(vbuf, &i, sizeof(uint32_t));
+  return sz;
+}
+
+static void fill_db(IWDB db) {
+  char kbuf[16];
+  uint8_t vbuf[BIGVSZ];
+  for (int i = 0; i < KNUM; ++i) {
+    IWKV_val key = { .data = kbuf };
+    IWKV_val val = { .data = vbuf };
+    key.size = snprintf(kbuf, sizeof(kbuf), "%05d", i);
+    val.size = value_fill(vbuf, i);
+    iwrc rc = iwkv_put(db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+}
+
+// Checks that only keys `i` with `rm(i) == false` are in database
+static void verify_db(IWDB db, bool (*rm)(int)) {
+  char kbuf[16];
+  uint8_t vbuf[BIGVSZ];
+  int cnt = 0;
+  for (int i = 0; i < KNUM; ++i) {
+    IWKV_val key = { .data = kbuf };
+    IWKV_val val;
+    key.size = snprintf(kbuf, sizeof(kbuf), "%05d", i);
+    iwrc rc = iwkv_get(db, &key, &val);
+    if (rm(i)) {
+      CU_ASSERT_EQUAL_FATAL(rc, IWKV_ERROR_NOTFOUND);
+      continue;
+    }
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    size_t sz = value_fill(vbuf, i);
+    CU_ASSERT_EQUAL_FATAL(val.size, sz);
+    CU_ASSERT_FALSE_FATAL(memcmp(val.data, vbuf, sz));
+    iwkv_val_dispose(&val);
+    ++cnt;
+  }
+  uint64_t rcnt;
+  iwrc rc = iwkv_db_count(db, &rcnt);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(rcnt, cnt);
+
+  // Walk database in both directions
+  IWKV_cursor cur;
+  int ccnt = 0;
+  rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    ++ccnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(ccnt, cnt);
+  rc = iwkv_cursor_to(cur, IWKV_CURSOR_AFTER_LAST);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  ccnt = 0;
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_PREV))) {
+    ++ccnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(ccnt, cnt);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static bool rm_none(int i) {
+  return false;
+}
+
+static bool rm_mid(int i) {
+  return (i > 5000 && i <= 15000) || (i > 95 && i <= 100);
+}
+
+static bool rm_mid_head(int i) {
+  return rm_mid(i) || i > 18000;
+}
+
+static bool rm_mid_head_tail(int i) {
+  return rm_mid_head(i) || i <= 2000;
+}
+
+static bool rm_all(int i) {
+  return true;
+}
+
+static void iwkv_test14_1_impl(bool wal) {
+  IWKV iwkv;
+  IWDB db;
+  IWKV_cursor cur;
+  char lbuf[16], hbuf[16];
+  IWKV_val lo = { .data = lbuf }, hi = { .data = hbuf }, key;
+  IWKV_OPTS opts = {
+    .path = wal ? "iwkv_test14_1w.db" : "iwkv_test14_1.db",
+    .oflags = IWKV_TRUNC,
+    .ext_value_threshold = 1024,
+    .wal = {
+      .enabled = wal
+    }
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  fill_db(db);
+  verify_db(db, rm_none);
+
+  // Keys are visited in descending order so range [15000, 5000) removes keys in (5000, 15000]
+  lo.size = snprintf(lbuf, sizeof(lbuf), "%05d", 15000);
+  hi.size = snprintf(hbuf, sizeof(hbuf), "%05d", 5000);
+
+  // Cursor positioned inside removed range is moved to the first key after range
+  rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_EQ, &lo);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_del_range(db, &lo, &hi, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_cursor_key(cur, &key);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(key.size, hi.size);
+  CU_ASSERT_FALSE(memcmp(key.data, hi.data, hi.size));
+  iwkv_val_dispose(&key);
+  rc = iwkv_cursor_to(cur, IWKV_CURSOR_PREV);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_cursor_key(cur, &key);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_FALSE(memcmp(key.data, "15001", 5));
+  iwkv_val_dispose(&key);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Range within single node
+  lo.size = snprintf(lbuf, sizeof(lbuf), "%05d", 100);
+  hi.size = snprintf(hbuf, sizeof(hbuf), "%05d", 95);
+  rc = iwkv_del_range(db, &lo, &hi, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_db(db, rm_mid);
+
+  // Empty and already removed ranges
+  lo.size = snprintf(lbuf, sizeof(lbuf), "%05d", 15000);
+  hi.size = snprintf(hbuf, sizeof(hbuf), "%05d", 5000);
+  rc = iwkv_del_range(db, &hi, &lo, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_del_range(db, &lo, &hi, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_db(db, rm_mid);
+
+  // Open lower bound
+  hi.size = snprintf(hbuf, sizeof(hbuf), "%05d", 18000);
+  rc = iwkv_del_range(db, 0, &hi, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_db(db, rm_mid_head);
+
+  // Open upper bound
+  lo.size = snprintf(lbuf, sizeof(lbuf), "%05d", 2000);
+  rc = iwkv_del_range(db, &lo, 0, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_db(db, rm_mid_head_tail);
+
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  opts.oflags = 0;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_db(db, rm_mid_head_tail);
+
+  // Whole database, released space is reused
+  off_t fsize = 0;
+  for (int i = 0; i < 3; ++i) {
+    rc = iwkv_del_range(db, 0, 0, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    verify_db(db, rm_all);
+    fill_db(db);
+    verify_db(db, rm_none);
+    rc = iwkv_sync(iwkv, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    if (i) {
+      CU_ASSERT_TRUE(file_size(opts.path) <= fsize);
+    }
+    fsize = file_size(opts.path);
+  }
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static void iwkv_test14_1(void) {
+  iwkv_test14_1_impl(false);
+}
+
+static void iwkv_test14_1_wal(void) {
+  iwkv_test14_1_impl(true);
+}
+
+static void iwkv_test14_3(void) {
+  IWKV iwkv;
+  IWDB db;
+  char lbuf[16], hbuf[16];
+  IWKV_val lo = { .data = lbuf }, hi = { .data = hbuf };
+  uint64_t cnt, bytes, tbytes;
+  IWKV_OPTS opts = {
+    .path = "iwkv_test14_3.db",
+    .oflags = IWKV_TRUNC
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = iwkv_db_estimate(db, 0, 0, &cnt, &bytes);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 0);
+  CU_ASSERT_EQUAL(bytes, 0);
+
+  fill_db(db);
+  rc = iwkv_db_count(db, &cnt);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, KNUM);
+
+  // Whole database
+  rc = iwkv_db_estimate(db, 0, 0, &cnt, &tbytes);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, KNUM);
+  CU_ASSERT_TRUE(tbytes > 0);
+
+  // Half of database, keys are in descending order
+  lo.size = snprintf(lbuf, sizeof(lbuf), "%05d", 15000);
+  hi.size = snprintf(hbuf, sizeof(hbuf), "%05d", 5000);
+  rc = iwkv_db_estimate(db, &lo, &hi, &cnt, &bytes);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_TRUE(cnt > KNUM / 4 && cnt < KNUM * 3 / 4);
+  CU_ASSERT_TRUE(bytes > tbytes / 4 && bytes < tbytes * 3 / 4);
+
+  // Open bounds
+  rc = iwkv_db_estimate(db, 0, &hi, &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_TRUE(cnt > KNUM / 2 && cnt < KNUM);
+  rc = iwkv_db_estimate(db, &hi, 0, &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_TRUE(cnt > KNUM / 8 && cnt < KNUM / 2);
+
+  // Small ranges are counted exactly
+  lo.size = snprintf(lbuf, sizeof(lbuf), "%05d", 120);
+  hi.size = snprintf(hbuf, sizeof(hbuf), "%05d", 100);
+  rc = iwkv_db_estimate(db, &lo, &hi, &cnt, &bytes);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 20);
+  CU_ASSERT_TRUE(bytes > 0);
+  rc = iwkv_db_estimate(db, &hi, &lo, &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 0);
+  lo.size = snprintf(lbuf, sizeof(lbuf), "%05d", 99999);
+  hi.size = snprintf(hbuf, sizeof(hbuf), "%05d", 19990);
+  rc = iwkv_db_estimate(db, &lo, &hi, &cnt, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, 9);
+
+  // Records count is persisted
+  lo.size = snprintf(lbuf, sizeof(lbuf), "%05d", 100);
+  rc = iwkv_del(db, &lo, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_put(db, &lo, &lo, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_put(db, &lo, &lo, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_del(db, &lo, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  opts.oflags = 0;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db_count(db, &cnt);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, KNUM - 1);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+#define PNUM 20
+#define PKNUM 300
+
+// Iterates cursor opened with `opts` in the given direction, checks that visited keys
+// are in the database order and returns their number. Optionally returns the first key.
+static int cursor_count(IWDB db, IWKV_CURSOR_OPTS *opts, IWKV_cursor_op op, const char *key, char *first) {
+  IWKV_cursor cur;
+  char prev[32] = { 0 };
+  IWKV_val k = { .data = (void*) key, .size = key ? strlen(key) : 0 };
+  IWKV_cursor_op sop = key ? op : op == IWKV_CURSOR_NEXT ? IWKV_CURSOR_BEFORE_FIRST : IWKV_CURSOR_AFTER_LAST;
+  iwrc rc = iwkv_cursor_open2(db, &cur, key ? IWKV_CURSOR_EQ : sop, key ? &k : 0, opts);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  int cnt = key ? 1 : 0;
+  if (key) {
+    strcpy(prev, key);
+  }
+  while (!(rc = iwkv_cursor_to(cur, op))) {
+    char cur_key[32];
+    IWKV_val ck;
+    rc = iwkv_cursor_key(cur, &ck);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_TRUE_FATAL(ck.size < sizeof(cur_key));
+    memcpy(cur_key, ck.data, ck.size);
+    cur_key[ck.size] = 0;
+    iwkv_val_dispose(&ck);
+    if (!cnt && first) {
+      strcpy(first, cur_key);
+    }
+    if (cnt) {
+      int cr = strcmp(prev, cur_key);
+      CU_ASSERT_TRUE_FATAL(op == IWKV_CURSOR_NEXT ? cr > 0 : cr < 0);
+    }
+    strcpy(prev, cur_key);
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  return cnt;
+}
+
+static void iwkv_test14_2(void) {
+  IWKV iwkv;
+  IWDB db;
+  char first[32];
+  char kbuf[32];
+  IWKV_val key = { .data = kbuf }, val = { .data = "v", .size = 1 };
+  IWKV_val end, prefix;
+  IWKV_OPTS opts = {
+    .path = "iwkv_test14_2.db",
+    .oflags = IWKV_TRUNC
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < PNUM * PKNUM; ++i) {
+    key.size = snprintf(kbuf, sizeof(kbuf), "p%02d/%03d", i % PNUM, i / PNUM);
+    rc = iwkv_put(db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+
+  // Readahead does not change visited records
+  IWKV_CURSOR_OPTS copts = { .readahead = 8 };
+  CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_NEXT, 0, 0), PNUM * PKNUM);
+  CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_PREV, 0, 0), PNUM * PKNUM);
+
+  // Prefix iteration, keys are visited in descending order
+  copts = (IWKV_CURSOR_OPTS) { .prefix = &prefix, .readahead = 2 };
+  const char *pfx[] = { "p05/", "p00/", "p19/", "p05/1", "p05/199", "p", "zz", "a", "p05/\xff" };
+  int pcnt[] = { PKNUM, PKNUM, PKNUM, 100, 1, PNUM * PKNUM, 0, 0, 0 };
+  const char *pfirst[] = { "p05/299", "p00/299", "p19/299", "p05/199", "p05/199", "p19/299" };
+  const char *plast[] = { "p05/000", "p00/000", "p19/000", "p05/100", "p05/199", "p00/000" };
+  for (int i = 0; i < sizeof(pfx) / sizeof(pfx[0]); ++i) {
+    prefix.data = (void*) pfx[i];
+    prefix.size = strlen(pfx[i]);
+    CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_NEXT, 0, first), pcnt[i]);
+    if (pcnt[i]) {
+      CU_ASSERT_STRING_EQUAL(first, pfirst[i]);
+    }
+    CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_PREV, 0, first), pcnt[i]);
+    if (pcnt[i]) {
+      CU_ASSERT_STRING_EQUAL(first, plast[i]);
+    }
+  }
+
+  // Exclusive and inclusive end key
+  end.data = "p10/000";
+  end.size = strlen(end.data);
+  copts = (IWKV_CURSOR_OPTS) { .end = &end };
+  CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_NEXT, 0, 0), 10 * PKNUM - 1);
+  CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_PREV, 0, first), 10 * PKNUM - 1);
+  CU_ASSERT_STRING_EQUAL(first, "p10/001");
+  copts.end_inclusive = true;
+  CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_NEXT, 0, 0), 10 * PKNUM);
+  CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_PREV, 0, first), 10 * PKNUM);
+  CU_ASSERT_STRING_EQUAL(first, "p10/000");
+
+  // End key starting from the given key
+  end.data = "p11/150";
+  end.size = strlen(end.data);
+  copts = (IWKV_CURSOR_OPTS) { .end = &end, .readahead = 1 };
+  CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_NEXT, "p12/000", 0), 150);
+
+  // End key preceding all records and end key in the middle of prefixed keys
+  end.data = "q";
+  end.size = 1;
+  CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_NEXT, 0, 0), 0);
+  CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_PREV, 0, 0), 0);
+  end.data = "p10/100";
+  end.size = strlen(end.data);
+  prefix.data = "p10/";
+  prefix.size = strlen(prefix.data);
+  copts = (IWKV_CURSOR_OPTS) { .end = &end, .end_inclusive = true, .prefix = &prefix };
+  CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_NEXT, 0, 0), 200);
+  CU_ASSERT_EQUAL(cursor_count(db, &copts, IWKV_CURSOR_PREV, 0, first), 200);
+  CU_ASSERT_STRING_EQUAL(first, "p10/100");
+
+  // Cursor range is kept while database is updated
+  IWKV_cursor cur;
+  copts = (IWKV_CURSOR_OPTS) { .prefix = &prefix, .readahead = 4 };
+  rc = iwkv_cursor_open2(db, &cur, IWKV_CURSOR_BEFORE_FIRST, 0, &copts);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  int cnt = 0;
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    if (cnt++ == 10) {
+      key.size = snprintf(kbuf, sizeof(kbuf), "p10/%03d", 5);
+      rc = iwkv_cursor_del(cur, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+      rc = iwkv_del(db, &key, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+      key.size = snprintf(kbuf, sizeof(kbuf), "p09/%03d", 5);
+      rc = iwkv_del(db, &key, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+    }
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(cnt, PKNUM - 1);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Prefix is not supported for numeric keys
+  IWDB ndb;
+  rc = iwkv_db(iwkv, 2, IWDB_VNUM64_KEYS, &ndb);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_cursor_open2(ndb, &cur, IWKV_CURSOR_BEFORE_FIRST, 0, &copts);
+  CU_ASSERT_EQUAL(rc, IW_ERROR_UNSUPPORTED);
+
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+// Long keys with common prefix, lower keys of nodes are truncated at level dependent length
+static void long_keys_check(IWDB db, int num) {
+  char kbuf[160];
+  IWKV_val key = { .data = kbuf, .size = 150 }, val;
+  for (int i = 0; i < num; ++i) {
+    snprintf(kbuf, sizeof(kbuf), "%0150d", i);
+    iwrc rc = iwkv_get(db, &key, &val);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(val.size, sizeof(i));
+    CU_ASSERT_FALSE_FATAL(memcmp(val.data, &i, sizeof(i)));
+    iwkv_val_dispose(&val);
+  }
+  uint64_t rcnt;
+  iwrc rc = iwkv_db_count(db, &rcnt);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(rcnt, num);
+}
+
+// Conversion of v4 store into the latest format having 40 bit block numbers
+static void iwkv_test14_4(void) {
+  IWKV iwkv;
+  IWDB db, db2, db3;
+  char kbuf[160];
+  size_t rsz;
+  uint64_t meta = 0x1122334455667788ULL, meta2 = 0;
+  IWKV_OPTS opts = {
+    .path = "iwkv_test14_4_v4.db",
+    .oflags = IWKV_TRUNC,
+    .fmt_version = 4,
+    .ext_value_threshold = 1024
+  };
+  IWKV_OPTS copts = {
+    .path = "iwkv_test14_4.db",
+    .ext_value_threshold = 1024
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  fill_db(db);
+  rc = iwkv_db_set_meta(db, &meta, sizeof(meta));
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 2, IWDB_VNUM64_KEYS, &db2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (uint64_t i = 0; i < 1000; ++i) {
+    uint64_t llv = i * 0x10000000ULL;
+    IWKV_val key = { .data = &llv, .size = sizeof(llv) };
+    IWKV_val val = { .data = &i, .size = sizeof(i) };
+    rc = iwkv_put(db2, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  rc = iwkv_db(iwkv, 3, 0, &db3);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < 3000; ++i) {
+    IWKV_val key = { .data = kbuf, .size = 150 };
+    IWKV_val val = { .data = &i, .size = sizeof(i) };
+    snprintf(kbuf, sizeof(kbuf), "%0150d", i);
+    rc = iwkv_put(db3, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+
+  // Target must not be the source file
+  copts.path = opts.path;
+  rc = iwkv_convert(iwkv, &copts);
+  CU_ASSERT_EQUAL(rc, IW_ERROR_INVALID_ARGS);
+  copts.path = "iwkv_test14_4.db";
+  rc = iwkv_convert(iwkv, &copts);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = iwkv_open(&copts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_db(db, rm_none);
+  rc = iwkv_db_get_meta(db, &meta2, sizeof(meta2), &rsz);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(rsz, sizeof(meta2));
+  CU_ASSERT_EQUAL(meta2, meta);
+  rc = iwkv_db(iwkv, 2, IWDB_VNUM64_KEYS, &db2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (uint64_t i = 0; i < 1000; ++i) {
+    uint64_t llv = i * 0x10000000ULL, vlv;
+    IWKV_val key = { .data = &llv, .size = sizeof(llv) };
+    rc = iwkv_get_copy(db2, &key, &vlv, sizeof(vlv), &rsz);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL(vlv, i);
+  }
+  rc = iwkv_db(iwkv, 3, 0, &db3);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  long_keys_check(db3, 3000);
+
+  // Updates of converted store
+  for (int i = 0; i < KNUM; ++i) {
+    if (rm_mid(i)) {
+      IWKV_val key = { .data = kbuf };
+      key.size = snprintf(kbuf, sizeof(kbuf), "%05d", i);
+      rc = iwkv_del(db, &key, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+    }
+  }
+  verify_db(db, rm_mid);
+  for (int i = 3000; i < 6000; ++i) {
+    IWKV_val key = { .data = kbuf, .size = 150 };
+    IWKV_val val = { .data = &i, .size = sizeof(i) };
+    snprintf(kbuf, sizeof(kbuf), "%0150d", i);
+    rc = iwkv_put(db3, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  copts.oflags = IWKV_RDONLY;
+  rc = iwkv_open(&copts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_db(db, rm_mid);
+  rc = iwkv_db(iwkv, 3, 0, &db3);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  long_keys_check(db3, 6000);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static iwrc bulk_next(IWKV_val *key, IWKV_val *val, void *op) {
+  static char kbuf[16];
+  static uint8_t vbuf[BIGVSZ];
+  int *ip = op;
+  int i = KNUM - 1 - *ip; // Keys are loaded in descending order
+  if (i < 0) {
+    return IWKV_ERROR_NOTFOUND;
+  }
+  ++*ip;
+  key->data = kbuf;
+  key->size = snprintf(kbuf, sizeof(kbuf), "%05d", i);
+  val->data = vbuf;
+  val->size = value_fill(vbuf, i);
+  return 0;
+}
+
+// Wide skiplist nodes
+static void iwkv_test14_5(void) {
+  IWKV iwkv;
+  IWDB db, db2;
+  char lbuf[16], hbuf[16];
+  IWKV_val lo = { .data = lbuf }, hi = { .data = hbuf };
+  IWKV_OPTS opts = {
+    .path = "iwkv_test14_5.db",
+    .oflags = IWKV_TRUNC,
+    .fmt_version = 4,
+    .ext_value_threshold = 1024
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, IWDB_WIDE_NODES, &db);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_INCOMPATIBLE_DB_FORMAT);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  opts.fmt_version = 0;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, IWDB_WIDE_NODES, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 2, IWDB_WIDE_NODES, &db2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  fill_db(db);
+  verify_db(db, rm_none);
+  int bi = 0;
+  rc = iwkv_bulk_load(db2, bulk_next, &bi, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_db(db2, rm_none);
+
+  lo.size = snprintf(lbuf, sizeof(lbuf), "%05d", 15000);
+  hi.size = snprintf(hbuf, sizeof(hbuf), "%05d", 5000);
+  rc = iwkv_del_range(db, &lo, &hi, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 96; i <= 100; ++i) {
+    IWKV_val key = { .data = lbuf };
+    key.size = snprintf(lbuf, sizeof(lbuf), "%05d", i);
+    rc = iwkv_del(db, &key, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  verify_db(db, rm_mid);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  opts.oflags = 0;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_INCOMPATIBLE_DB_MODE);
+  rc = iwkv_db(iwkv, 1, IWDB_WIDE_NODES, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_db(db, rm_mid);
+  rc = iwkv_db(iwkv, 2, IWDB_WIDE_NODES, &db2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  verify_db(db2, rm_none);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+#define RMW_THREADS 4
+#define RMW_NUM     2000
+#define RMW_KEYS    16
+
+// Stores the old counter value plus one
+static iwrc rmw_ph(const IWKV_val *key, const IWKV_val *val, IWKV_val *oldval, void *op) {
+  uint64_t cnt = 0;
+  if (oldval) {
+    if (oldval->size == sizeof(cnt)) {
+      memcpy(&cnt, oldval->data, sizeof(cnt));
+    }
+    iwkv_val_dispose(oldval);
+  }
+  ++cnt;
+  memcpy(val->data, &cnt, sizeof(cnt));
+  return 0;
+}
+
+static void* rmw_worker(void *op) {
+  IWDB db = op;
+  char kbuf[16];
+  uint64_t cnt;
+  for (int i = 0; i < RMW_NUM; ++i) {
+    IWKV_val key = { .data = kbuf };
+    IWKV_val val = { .data = &cnt, .size = sizeof(cnt) };
+    key.size = snprintf(kbuf, sizeof(kbuf), "c%02d", i % RMW_KEYS);
+    iwrc rc = iwkv_puth(db, &key, &val, 0, rmw_ph, 0);
+    if (rc) {
+      iwlog_ecode_error3(rc);
+      return (void*) (intptr_t) rc;
+    }
+  }
+  return 0;
+}
+
+// Read-modify-write counters updated by put handler
+static void iwkv_test14_6(void) {
+  IWKV iwkv;
+  IWDB db;
+  char kbuf[16];
+  pthread_t threads[RMW_THREADS];
+  IWKV_OPTS opts = {
+    .path = "iwkv_test14_6.db",
+    .oflags = IWKV_TRUNC
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < RMW_THREADS; ++i) {
+    CU_ASSERT_EQUAL_FATAL(pthread_create(&threads[i], 0, rmw_worker, db), 0);
+  }
+  for (int i = 0; i < RMW_THREADS; ++i) {
+    void *ret;
+    pthread_join(threads[i], &ret);
+    CU_ASSERT_PTR_NULL(ret);
+  }
+  for (int k = 0; k < RMW_KEYS; ++k) {
+    uint64_t cnt;
+    size_t vsz;
+    IWKV_val key = { .data = kbuf };
+    key.size = snprintf(kbuf, sizeof(kbuf), "c%02d", k);
+    rc = iwkv_get_copy(db, &key, &cnt, sizeof(cnt), &vsz);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL(vsz, sizeof(cnt));
+    CU_ASSERT_EQUAL(cnt, RMW_THREADS * RMW_NUM / RMW_KEYS);
+  }
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+#define EXP_NUM 2000
+
+// Odd records are expired, every third one expires in an hour
+static uint64_t exp_expire(int i, uint64_t now) {
+  return (i & 1) ? now - 1000 : (i % 3) ? 0 : now + 3600 * 1000;
+}
+
+static void exp_fill(IWDB db, uint64_t now) {
+  char kbuf[16];
+  for (int i = 0; i < EXP_NUM; ++i) {
+    IWKV_val key = { .data = kbuf };
+    IWKV_val val = { .data = &i, .size = sizeof(i), .expire = exp_expire(i, now) };
+    key.size = snprintf(kbuf, sizeof(kbuf), "%05d", i);
+    iwrc rc = iwkv_put(db, &key, &val, IWKV_VAL_EXPIRE);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+}
+
+static void exp_verify(IWDB db, uint64_t now) {
+  char kbuf[16];
+  int cnt = 0;
+  IWKV_cursor cur;
+  for (int i = 0; i < EXP_NUM; ++i) {
+    IWKV_val key = { .data = kbuf }, val;
+    key.size = snprintf(kbuf, sizeof(kbuf), "%05d", i);
+    iwrc rc = iwkv_get(db, &key, &val);
+    if (i & 1) {
+      CU_ASSERT_EQUAL_FATAL(rc, IWKV_ERROR_NOTFOUND);
+      continue;
+    }
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(val.size, sizeof(i));
+    CU_ASSERT_EQUAL(*(int*) val.data, i);
+    CU_ASSERT_EQUAL(val.expire, exp_expire(i, now));
+    iwkv_val_dispose(&val);
+  }
+  iwrc rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    int v;
+    size_t vsz;
+    rc = iwkv_cursor_copy_val(cur, &v, sizeof(v), &vsz);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL(v & 1, 0);
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(cnt, EXP_NUM / 2);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  IWKV_val key = { .data = "00003", .size = 5 };
+  rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_EQ, &key);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_GE, &key);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_cursor_copy_key(cur, kbuf, sizeof(kbuf), &key.size, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(key.size, 5);
+  CU_ASSERT_NSTRING_EQUAL(kbuf, "00004", 5);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+// Expiring records
+static void iwkv_test14_7_impl(iwdb_flags_t dbflg) {
+  IWKV iwkv;
+  IWDB db, db2;
+  uint64_t now, cnt;
+  IWKV_val key = { .data = "00001", .size = 5 };
+  IWKV_val val = { .data = "v", .size = 1 };
+  IWKV_OPTS opts = {
+    .path = "iwkv_test14_7.db",
+    .oflags = IWKV_TRUNC,
+    .reaper_interval_sec = -1
+  };
+  iwrc rc = iwp_current_time_ms(&now, false);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, dbflg | IWDB_EXPIRING_VALUES, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 2, dbflg, &db2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_put(db2, &key, &val, IWKV_VAL_EXPIRE);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_INCOMPATIBLE_DB_MODE);
+  rc = iwkv_db_reap(db2, &cnt);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_INCOMPATIBLE_DB_MODE);
+
+  exp_fill(db, now);
+  exp_verify(db, now);
+
+  // Expired record is replaced like an absent one
+  rc = iwkv_put(db, &key, &val, IWKV_NO_OVERWRITE);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_put(db, &key, &val, IWKV_NO_OVERWRITE);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_KEY_EXISTS);
+  rc = iwkv_del(db, &key, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  rc = iwkv_db_count(db, &cnt);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, EXP_NUM - 1);
+  rc = iwkv_db_reap(db, &cnt);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, EXP_NUM / 2 - 1);
+  rc = iwkv_db_count(db, &cnt);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(cnt, EXP_NUM / 2);
+  exp_verify(db, now);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Background reaper
+  opts.oflags = 0;
+  opts.reaper_interval_sec = 1;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, dbflg | IWDB_EXPIRING_VALUES, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  exp_verify(db, now);
+  exp_fill(db, now);
+  for (int i = 0; i < 50; ++i) {
+    rc = iwkv_db_count(db, &cnt);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    if (cnt == EXP_NUM / 2) {
+      break;
+    }
+    iwp_sleep(100);
+  }
+  CU_ASSERT_EQUAL(cnt, EXP_NUM / 2);
+  exp_verify(db, now);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static void iwkv_test14_7(void) {
+  iwkv_test14_7_impl(0);
+  iwkv_test14_7_impl(IWDB_COMPRESSED_VALUES);
+}
+
+#define OVR_NUM    3000
+#define OVR_ROUNDS 6
+
+// Model of records stored by overwrite test: value size and generation, size < 0 if removed
+static int ovr_sz[OVR_NUM];
+static uint8_t ovr_gen[OVR_NUM];
+
+static size_t ovr_fill(uint8_t *vbuf, int i) {
+  size_t sz = ovr_sz[i];
+  memset(vbuf, (i * 31 + ovr_gen[i]) & 0xff, sz);
+  return sz;
+}
+
+static void ovr_verify(IWDB db) {
+  char kbuf[16];
+  uint8_t vbuf[BIGVSZ];
+  int cnt = 0;
+  for (int i = 0; i < OVR_NUM; ++i) {
+    IWKV_val val;
+    IWKV_val key = { .data = kbuf };
+    key.size = snprintf(kbuf, sizeof(kbuf), "%05d", i);
+    iwrc rc = iwkv_get(db, &key, &val);
+    if (ovr_sz[i] < 0) {
+      CU_ASSERT_EQUAL_FATAL(rc, IWKV_ERROR_NOTFOUND);
+      continue;
+    }
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    size_t sz = ovr_fill(vbuf, i);
+    CU_ASSERT_EQUAL_FATAL(val.size, sz);
+    CU_ASSERT_FATAL(!memcmp(val.data, vbuf, sz));
+    iwkv_val_dispose(&val);
+    ++cnt;
+  }
+  // Records are visited in descending key order
+  IWKV_cursor cur;
+  int i = OVR_NUM, ccnt = 0;
+  kbuf[5] = '\0';
+  iwrc rc = iwkv_cursor_open(db, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    IWKV_val key;
+    rc = iwkv_cursor_key(cur, &key);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(key.size, 5);
+    memcpy(kbuf, key.data, 5);
+    int k = atoi(kbuf);
+    CU_ASSERT_FATAL(k < i && ovr_sz[k] >= 0);
+    i = k;
+    iwkv_val_dispose(&key);
+    ++ccnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(ccnt, cnt);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+// Overwrites of wide node records by values of different sizes
+static void iwkv_test14_8_impl(iwdb_flags_t dbflg, bool wal) {
+  IWKV iwkv;
+  IWDB db;
+  char kbuf[16];
+  uint8_t vbuf[BIGVSZ];
+  IWKV_OPTS opts = {
+    .path = "iwkv_test14_8.db",
+    .oflags = IWKV_TRUNC,
+    .ext_value_threshold = 1024,
+    .wal = {
+      .enabled = wal
+    }
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, IWDB_WIDE_NODES | dbflg, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  for (int i = 0; i < OVR_NUM; ++i) {
+    ovr_sz[i] = 8;
+    ovr_gen[i] = 0;
+    IWKV_val key = { .data = kbuf };
+    IWKV_val val = { .data = vbuf };
+    key.size = snprintf(kbuf, sizeof(kbuf), "%05d", i);
+    val.size = ovr_fill(vbuf, i);
+    rc = iwkv_put(db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  for (int r = 0; r < OVR_ROUNDS; ++r) {
+    for (int n = 0; n < OVR_NUM; ++n) {
+      int i = iwu_rand_range(OVR_NUM);
+      IWKV_val key = { .data = kbuf };
+      key.size = snprintf(kbuf, sizeof(kbuf), "%05d", i);
+      if (iwu_rand_range(16) == 0) {
+        rc = iwkv_del(db, &key, 0);
+        CU_ASSERT_EQUAL_FATAL(rc, ovr_sz[i] < 0 ? IWKV_ERROR_NOTFOUND : 0);
+        ovr_sz[i] = -1;
+        continue;
+      }
+      // Mostly small values, some of them are stored out of line
+      ovr_sz[i] = iwu_rand_range(16) ? iwu_rand_range(256) : 1024 + iwu_rand_range(BIGVSZ - 1024);
+      ovr_gen[i]++;
+      IWKV_val val = { .data = vbuf };
+      val.size = ovr_fill(vbuf, i);
+      rc = iwkv_put(db, &key, &val, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+    }
+    ovr_verify(db);
+  }
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  opts.oflags = 0;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, IWDB_WIDE_NODES | dbflg, &db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  ovr_verify(db);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static void iwkv_test14_8(void) {
+  iwkv_test14_8_impl(0, false);
+  iwkv_test14_8_impl(0, true);
+  iwkv_test14_8_impl(IWDB_COMPRESSED_VALUES, false);
+  iwkv_test14_8_impl(IWDB_COMPRESSED_VALUES, true);
+}
+
+int main(void) {
+  CU_pSuite pSuite = NULL;
+
+  /* Initialize the CUnit test registry */
+  if (CUE_SUCCESS != CU_initialize_registry()) {
+    return CU_get_error();
+  }
+
+  /* Add a suite to the registry */
+  pSuite = CU_add_suite("iwkv_test14", init_suite, clean_suite);
+
+  if (NULL == pSuite) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  /* Add the tests to the suite */
+  if (  (NULL == CU_add_test(pSuite, "iwkv_test14_1", iwkv_test14_1))
+     || (NULL == CU_add_test(pSuite, "iwkv_test14_1_wal", iwkv_test14_1_wal))
+     || (NULL == CU_add_test(pSuite, "iwkv_test14_2", iwkv_test14_2))
+     || (NULL == CU_add_test(pSuite, "iwkv_test14_3", iwkv_test14_3))
+     || (NULL == CU_add_test(pSuite, "iwkv_test14_4", iwkv_test14_4))
+     || (NULL == CU_add_test(pSuite, "iwkv_test14_5", iwkv_test14_5))
+     || (NULL == CU_add_test(pSuite, "iwkv_test14_6", iwkv_test14_6))
+     || (NULL == CU_add_test(pSuite, "iwkv_test14_7", iwkv_test14_7))
+     || (NULL == CU_add_test(pSuite, "iwkv_test14_8", iwkv_test14_8))) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  /* Run all tests using the CUnit Basic interface */
+  CU_basic_set_mode(CU_BRM_VERBOSE);
+  CU_basic_run_tests();
+  int ret = CU_get_error() || CU_get_number_of_failures();
+  CU_cleanup_registry();
+  return ret;
+}
@@ -170,6 +170,153 @@ static void iwkv_test3_2(void) {
   iwkv_test3_impl(4, 30000, true);
 }
 
+static void* iwkv_test3_reader(void *op) {
+  TASK *t = op;
+  CTX *ctx = t->ctx;
+  IWKV_val key, val;
+  for (int n = 0; n < 3; ++n) {
+    for (int i = 0; i < t->cnt; ++i) {
+      uint64_t k = i, v;
+      key.size = sizeof(uint64_t);
+      key.data = &k;
+      iwrc rc = iwkv_get(ctx->db, &key, &val);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+      CU_ASSERT_EQUAL_FATAL(val.size, sizeof(uint64_t));
+      memcpy(&v, val.data, sizeof(uint64_t));
+      CU_ASSERT_EQUAL_FATAL(v, k);
+      iwkv_val_dispose(&val);
+    }
+  }
+  return 0;
+}
+
+// Concurrent readers and exclusive operations (sync, savepoints)
+static void iwkv_test3_reader_impl(int thrnum, int nrecs, bool wal) {
+  CTX ctx = {
+    .thrnum = thrnum
+  };
+  IWKV_OPTS opts = {
+    .path = "iwkv_test3_3.db",
+    .oflags = IWKV_TRUNC,
+    .wal = {
+      .enabled = wal
+    }
+  };
+  IWKV iwkv;
+  IWKV_val key, val;
+  TASK *tasks = calloc(thrnum, sizeof(*tasks));
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, IWDB_VNUM64_KEYS, &ctx.db);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < nrecs; ++i) {
+    uint64_t k = i;
+    key.size = sizeof(uint64_t);
+    key.data = &k;
+    val.size = sizeof(uint64_t);
+    val.data = &k;
+    rc = iwkv_put(ctx.db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  for (int i = 0; i < thrnum; ++i) {
+    tasks[i].ctx = &ctx;
+    tasks[i].cnt = nrecs;
+    int rci = pthread_create(&tasks[i].thr, 0, iwkv_test3_reader, &tasks[i]);
+    CU_ASSERT_EQUAL_FATAL(rci, 0);
+  }
+  for (int i = 0; i < 20; ++i) {
+    uint64_t k = nrecs + i;
+    key.size = sizeof(uint64_t);
+    key.data = &k;
+    val.size = sizeof(uint64_t);
+    val.data = &k;
+    rc = iwkv_put(ctx.db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    rc = iwkv_sync(iwkv, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  for (int i = 0; i < thrnum; ++i) {
+    int rci = pthread_join(tasks[i].thr, 0);
+    CU_ASSERT_EQUAL_FATAL(rci, 0);
+  }
+  free(tasks);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+static void iwkv_test3_3(void) {
+  iwkv_test3_reader_impl(8, 20000, false);
+}
+
+static void iwkv_test3_4(void) {
+  iwkv_test3_reader_impl(8, 20000, true);
+}
+
+typedef struct NCTX {
+  IWDB db1;
+  IWDB db2;
+  atomic_bool in_handler;
+  iwrc nrc; // Result of nested API call
+  iwrc prc; // Result of put
+} NCTX;
+
+static iwrc iwkv_test3_nested_ph(const IWKV_val *key, const IWKV_val *val, IWKV_val *oldval, void *op) {
+  NCTX *n = op;
+  uint64_t k = 1;
+  IWKV_val nkey = { .data = &k, .size = sizeof(k) }, nval;
+  atomic_store(&n->in_handler, true);
+  usleep(100000); // Let exclusive lock become pending
+  n->nrc = iwkv_get(n->db2, &nkey, &nval);
+  if (!n->nrc) {
+    iwkv_val_dispose(&nval);
+  }
+  return 0;
+}
+
+static void* iwkv_test3_nested_worker(void *op) {
+  NCTX *n = op;
+  uint64_t k = 1;
+  IWKV_val key = { .data = &k, .size = sizeof(k) };
+  n->prc = iwkv_puth(n->db1, &key, &key, 0, iwkv_test3_nested_ph, n);
+  return 0;
+}
+
+// Nested API call from put handler while exclusive lock is pending
+static void iwkv_test3_5(void) {
+  NCTX n = { 0 };
+  IWKV_OPTS opts = {
+    .path = "iwkv_test3_5.db",
+    .oflags = IWKV_TRUNC
+  };
+  IWKV iwkv;
+  pthread_t thr;
+  uint64_t k = 1;
+  IWKV_val key = { .data = &k, .size = sizeof(k) };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, IWDB_VNUM64_KEYS, &n.db1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 2, IWDB_VNUM64_KEYS, &n.db2);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_put(n.db2, &key, &key, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  int rci = pthread_create(&thr, 0, iwkv_test3_nested_worker, &n);
+  CU_ASSERT_EQUAL_FATAL(rci, 0);
+  while (!atomic_load(&n.in_handler)) {
+    usleep(1000);
+  }
+  rc = iwkv_sync(iwkv, 0);
+  CU_ASSERT_EQUAL(rc, 0);
+  rci = pthread_join(thr, 0);
+  CU_ASSERT_EQUAL_FATAL(rci, 0);
+  CU_ASSERT_EQUAL(n.prc, 0);
+  CU_ASSERT_EQUAL(n.nrc, 0);
+
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
 int main(void) {
   CU_pSuite pSuite = NULL;
 
@@ -188,7 +335,10 @@ int main(void) {
 
   /* Add the tests to the suite */
   if (  (NULL == CU_add_test(pSuite, "iwkv_test3_1", iwkv_test3_1))
-     || (NULL == CU_add_test(pSuite, "iwkv_test3_2", iwkv_test3_2))) {
+     || (NULL == CU_add_test(pSuite, "iwkv_test3_2", iwkv_test3_2))
+     || (NULL == CU_add_test(pSuite, "iwkv_test3_3", iwkv_test3_3))
+     || (NULL == CU_add_test(pSuite, "iwkv_test3_4", iwkv_test3_4))
+     || (NULL == CU_add_test(pSuite, "iwkv_test3_5", iwkv_test3_5))) {
     CU_cleanup_registry();
     return CU_get_error();
   }
@@ -5,6 +5,8 @@
 #include "iwkv_tests.h"
 #include "iwkv_internal.h"
 
+#include <pthread.h>
+
 uint32_t g_seed;
 uint32_t g_rnd_data_pos;
 #define RND_DATA_SZ (10 * 1048576)
@@ -309,6 +311,410 @@ static void iwkv_test4_1(void) {
   fclose(iw2);
 }
 
+#define T5_THREADS 8
+#define T5_PUTS    200
+
+static void* iwkv_test4_5_worker(void *op) {
+  IWDB db = op;
+  char kbuf[32];
+  int tid = iwu_rand_range(1000000);
+  for (int i = 0; i < T5_PUTS; ++i) {
+    IWKV_val key = { .data = kbuf }, val = { .data = kbuf };
+    key.size = val.size = snprintf(kbuf, sizeof(kbuf), "%p_%03d", (void*) &tid, i);
+    iwrc rc = iwkv_put(db, &key, &val, IWKV_SYNC);
+    if (rc) {
+      iwlog_ecode_error3(rc);
+      return (void*) (intptr_t) rc;
+    }
+  }
+  return 0;
+}
+
+// Group commit of concurrent IWKV_SYNC writers
+static void iwkv_test4_5(void) {
+  IWKV iwkv;
+  IWDB db1;
+  pthread_t thr[T5_THREADS];
+  IWKV_OPTS opts = {
+    .path = "iwkv_test4_5.db",
+    .oflags = IWKV_TRUNC,
+    .random_seed = g_seed,
+    .wal = {
+      .enabled = true,
+      .savepoint_timeout_sec = UINT32_MAX,
+      .wal_buffer_sz = 4096,
+      .commit_window_us = 200
+    }
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < T5_THREADS; ++i) {
+    CU_ASSERT_EQUAL_FATAL(pthread_create(&thr[i], 0, iwkv_test4_5_worker, db1), 0);
+  }
+  for (int i = 0; i < T5_THREADS; ++i) {
+    void *ret;
+    pthread_join(thr[i], &ret);
+    CU_ASSERT_PTR_NULL(ret);
+  }
+
+  // Close without checkpoint, all synced records must survive
+  iwkvd_trigger_xor(IWKVD_WAL_NO_CHECKPOINT_ON_CLOSE);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwkvd_trigger_xor(IWKVD_WAL_NO_CHECKPOINT_ON_CLOSE);
+
+  opts.oflags &= ~IWKV_TRUNC;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  uint64_t cnt = 0;
+  IWKV_cursor cur;
+  rc = iwkv_cursor_open(db1, &cur, IWKV_CURSOR_BEFORE_FIRST, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  while (!(rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT))) {
+    ++cnt;
+  }
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  CU_ASSERT_EQUAL(cnt, T5_THREADS * T5_PUTS);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+#define T6_THREADS 4
+#define T6_PUTS    2000
+
+static void* iwkv_test4_6_worker(void *op) {
+  IWDB db = op;
+  char kbuf[32];
+  char vbuf[512];
+  static atomic_int tseq;
+  int tid = atomic_fetch_add(&tseq, 1);
+  for (int i = 0; i < T6_PUTS; ++i) {
+    IWKV_val key = { .data = kbuf }, val = { .data = vbuf, .size = sizeof(vbuf) };
+    key.size = snprintf(kbuf, sizeof(kbuf), "%d_%04d", tid, i);
+    memset(vbuf, 'a' + (i + tid) % 26, sizeof(vbuf));
+    iwrc rc = iwkv_put(db, &key, &val, 0);
+    if (rc) {
+      iwlog_ecode_error3(rc);
+      return (void*) (intptr_t) rc;
+    }
+  }
+  return 0;
+}
+
+static void iwkv_test4_6_verify(IWDB db, int nthreads) {
+  char kbuf[32];
+  char vbuf[512];
+  for (int t = 0; t < nthreads; ++t) {
+    for (int i = 0; i < T6_PUTS; ++i) {
+      IWKV_val key = { .data = kbuf }, val = { 0 };
+      key.size = snprintf(kbuf, sizeof(kbuf), "%d_%04d", t, i);
+      memset(vbuf, 'a' + (i + t) % 26, sizeof(vbuf));
+      iwrc rc = iwkv_get(db, &key, &val);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+      CU_ASSERT_EQUAL_FATAL(val.size, sizeof(vbuf));
+      CU_ASSERT_FALSE(memcmp(val.data, vbuf, sizeof(vbuf)));
+      iwkv_val_dispose(&val);
+    }
+  }
+}
+
+// Concurrent writes while WAL checkpoints are applied in background
+static void iwkv_test4_6(void) {
+  IWKV iwkv;
+  IWDB db1;
+  pthread_t thr[T6_THREADS];
+  IWKV_OPTS opts = {
+    .path = "iwkv_test4_6.db",
+    .oflags = IWKV_TRUNC,
+    .random_seed = g_seed,
+    .wal = {
+      .enabled = true,
+      .checkpoint_buffer_sz = 1024 * 1024
+    }
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < T6_THREADS; ++i) {
+    CU_ASSERT_EQUAL_FATAL(pthread_create(&thr[i], 0, iwkv_test4_6_worker, db1), 0);
+  }
+  for (int i = 0; i < T6_THREADS; ++i) {
+    void *ret;
+    pthread_join(thr[i], &ret);
+    CU_ASSERT_PTR_NULL(ret);
+  }
+  iwkv_test4_6_verify(db1, T6_THREADS);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  opts.oflags &= ~IWKV_TRUNC;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwkv_test4_6_verify(db1, T6_THREADS);
+
+  // More writes then close without checkpoint, WAL recovery on top of checkpointed data
+  for (int i = 0; i < T6_THREADS; ++i) {
+    CU_ASSERT_EQUAL_FATAL(pthread_create(&thr[i], 0, iwkv_test4_6_worker, db1), 0);
+  }
+  for (int i = 0; i < T6_THREADS; ++i) {
+    void *ret;
+    pthread_join(thr[i], &ret);
+    CU_ASSERT_PTR_NULL(ret);
+  }
+  rc = iwkv_sync(iwkv, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwkvd_trigger_xor(IWKVD_WAL_NO_CHECKPOINT_ON_CLOSE);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwkvd_trigger_xor(IWKVD_WAL_NO_CHECKPOINT_ON_CLOSE);
+
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwkv_test4_6_verify(db1, 2 * T6_THREADS);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+// Repeated updates of the same blocks merged in WAL buffer
+static void iwkv_test4_7(void) {
+  IWKV iwkv;
+  IWDB db1;
+  char kbuf[32], vbuf[64];
+  IWKV_OPTS opts = {
+    .path = "iwkv_test4_7.db",
+    .oflags = IWKV_TRUNC,
+    .random_seed = g_seed,
+    .wal = {
+      .enabled = true,
+      .check_crc_on_checkpoint = true,
+      .savepoint_timeout_sec = UINT32_MAX,
+      .checkpoint_timeout_sec = UINT32_MAX
+    }
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int r = 0; r < 50; ++r) {
+    for (int i = 0; i < 100; ++i) {
+      IWKV_val key = { .data = kbuf }, val = { .data = vbuf };
+      key.size = snprintf(kbuf, sizeof(kbuf), "%03d", i);
+      val.size = snprintf(vbuf, sizeof(vbuf), "%03d_%02d", i, r);
+      rc = iwkv_put(db1, &key, &val, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+    }
+    if (r == 25) {
+      rc = iwkv_sync(iwkv, 0);
+      CU_ASSERT_EQUAL_FATAL(rc, 0);
+    }
+  }
+  rc = iwkv_sync(iwkv, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwkvd_trigger_xor(IWKVD_WAL_NO_CHECKPOINT_ON_CLOSE);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwkvd_trigger_xor(IWKVD_WAL_NO_CHECKPOINT_ON_CLOSE);
+
+  opts.oflags &= ~IWKV_TRUNC;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < 100; ++i) {
+    IWKV_val key = { .data = kbuf }, val;
+    key.size = snprintf(kbuf, sizeof(kbuf), "%03d", i);
+    snprintf(vbuf, sizeof(vbuf), "%03d_%02d", i, 49);
+    rc = iwkv_get(db1, &key, &val);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL(val.size, strlen(vbuf));
+    CU_ASSERT_FALSE(strncmp(val.data, vbuf, val.size));
+    iwkv_val_dispose(&val);
+  }
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+// Synced cursor updates while cursor is open
+static void iwkv_test4_8(void) {
+  IWKV iwkv;
+  IWDB db1;
+  IWKV_cursor cur;
+  char kbuf[32];
+  IWKV_OPTS opts = {
+    .path = "iwkv_test4_8.db",
+    .oflags = IWKV_TRUNC,
+    .random_seed = g_seed,
+    .wal = {
+      .enabled = true,
+      .savepoint_timeout_sec = UINT32_MAX,
+      .checkpoint_timeout_sec = UINT32_MAX
+    }
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  for (int i = 0; i < 10; ++i) {
+    IWKV_val key = { .data = kbuf }, val = { .data = kbuf };
+    key.size = val.size = snprintf(kbuf, sizeof(kbuf), "%03d", i);
+    rc = iwkv_put(db1, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+  IWKV_val key = { .data = "005", .size = 3 }, val = { .data = "new", .size = 3 };
+  rc = iwkv_cursor_open(db1, &cur, IWKV_CURSOR_EQ, &key);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_cursor_set(cur, &val, IWKV_SYNC);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_cursor_to(cur, IWKV_CURSOR_NEXT);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_cursor_del(cur, IWKV_SYNC);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_cursor_close(&cur);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+
+  // Close without checkpoint, synced cursor updates must survive
+  iwkvd_trigger_xor(IWKVD_WAL_NO_CHECKPOINT_ON_CLOSE);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwkvd_trigger_xor(IWKVD_WAL_NO_CHECKPOINT_ON_CLOSE);
+
+  opts.oflags &= ~IWKV_TRUNC;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_get(db1, &key, &val);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL(val.size, 3);
+  CU_ASSERT_FALSE(strncmp(val.data, "new", val.size));
+  iwkv_val_dispose(&val);
+  // Keys are in descending order, next to "005" is "004"
+  key.data = "004";
+  rc = iwkv_get(db1, &key, &val);
+  CU_ASSERT_EQUAL(rc, IWKV_ERROR_NOTFOUND);
+  key.data = "006";
+  rc = iwkv_get(db1, &key, &val);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwkv_val_dispose(&val);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
+#define T9_KEYS 200
+
+extern atomic_uint_fast64_t g_trigger;
+
+static void iwkv_test4_9_fill(IWDB db, int round, int vsz) {
+  char kbuf[32];
+  char vbuf[4096];
+  for (int i = 0; i < T9_KEYS; ++i) {
+    IWKV_val key = { .data = kbuf }, val = { .data = vbuf, .size = vsz };
+    key.size = snprintf(kbuf, sizeof(kbuf), "%03d", i);
+    memset(vbuf, 'a' + (i + round) % 26, vsz);
+    iwrc rc = iwkv_put(db, &key, &val, 0);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+  }
+}
+
+static void iwkv_test4_9_verify(IWDB db, int round, int vsz) {
+  char kbuf[32];
+  char vbuf[4096];
+  for (int i = 0; i < T9_KEYS; ++i) {
+    IWKV_val key = { .data = kbuf }, val = { 0 };
+    key.size = snprintf(kbuf, sizeof(kbuf), "%03d", i);
+    memset(vbuf, 'a' + (i + round) % 26, vsz);
+    iwrc rc = iwkv_get(db, &key, &val);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(val.size, vsz);
+    CU_ASSERT_FALSE(memcmp(val.data, vbuf, vsz));
+    iwkv_val_dispose(&val);
+  }
+}
+
+// Starts incremental checkpoint and waits until it has applied WAL to the main file
+static void iwkv_test4_9_hold(IWKV iwkv) {
+  iwkvd_trigger_xor(IWKVD_WAL_CHECKPOINT_HOLD);
+  iwrc rc = iwal_poke_checkpoint(iwkv, true);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  while (!(g_trigger & IWKVD_WAL_CHECKPOINT_HELD)) {
+    iwp_sleep(10);
+  }
+  iwkvd_trigger_xor(IWKVD_WAL_CHECKPOINT_HELD);
+}
+
+static void* iwkv_test4_9_release(void *op) {
+  iwp_sleep(200);
+  iwkvd_trigger_xor(IWKVD_WAL_CHECKPOINT_HOLD);
+  return 0;
+}
+
+// File resize and close during incremental checkpoint,
+// full checkpoint taking over continues from WAL offset reached by incremental one
+static void iwkv_test4_9(void) {
+  IWKV iwkv;
+  IWDB db1;
+  pthread_t thr;
+  IWKV_OPTS opts = {
+    .path = "iwkv_test4_9.db",
+    .oflags = IWKV_TRUNC,
+    .random_seed = g_seed,
+    .wal = {
+      .enabled = true,
+      .check_crc_on_checkpoint = true,
+      .savepoint_timeout_sec = UINT32_MAX,
+      .checkpoint_timeout_sec = UINT32_MAX
+    }
+  };
+  iwrc rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwkv_test4_9_fill(db1, 0, 16);
+  rc = iwkv_sync(iwkv, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  // Growing values reallocate KVBLKs
+  for (int r = 1; r < 8; ++r) {
+    iwkv_test4_9_fill(db1, r, 16 << (2 * (r % 4)));
+  }
+  iwkv_test4_9_hold(iwkv);
+
+  // File is resized while checkpoint holds, full checkpoint waits for it
+  CU_ASSERT_EQUAL_FATAL(pthread_create(&thr, 0, iwkv_test4_9_release, 0), 0);
+  iwkv_test4_9_fill(db1, 8, 4096);
+  pthread_join(thr, 0);
+  iwkv_test4_9_verify(db1, 8, 4096);
+
+  for (int r = 9; r < 16; ++r) {
+    iwkv_test4_9_fill(db1, r, 16 << (2 * (r % 4)));
+  }
+  iwkv_test4_9_hold(iwkv);
+  // Closing while checkpoint holds, checkpoint on close takes over
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwkvd_trigger_xor(IWKVD_WAL_CHECKPOINT_HOLD);
+
+  opts.oflags &= ~IWKV_TRUNC;
+  rc = iwkv_open(&opts, &iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  rc = iwkv_db(iwkv, 1, 0, &db1);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  iwkv_test4_9_verify(db1, 15, 1024);
+  rc = iwkv_close(&iwkv);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+}
+
 int main(void) {
   CU_pSuite pSuite = NULL;
 
@@ -329,7 +735,12 @@ int main(void) {
      || (NULL == CU_add_test(pSuite, "iwkv_test4_2", iwkv_test4_2))
      || (NULL == CU_add_test(pSuite, "iwkv_test4_3_v1", iwkv_test4_3_v1))
      || (NULL == CU_add_test(pSuite, "iwkv_test4_3_v2", iwkv_test4_3_v2))
-     || (NULL == CU_add_test(pSuite, "iwkv_test4_4", iwkv_test4_4))) {
+     || (NULL == CU_add_test(pSuite, "iwkv_test4_4", iwkv_test4_4))
+     || (NULL == CU_add_test(pSuite, "iwkv_test4_5", iwkv_test4_5))
+     || (NULL == CU_add_test(pSuite, "iwkv_test4_6", iwkv_test4_6))
+     || (NULL == CU_add_test(pSuite, "iwkv_test4_7", iwkv_test4_7))
+     || (NULL == CU_add_test(pSuite, "iwkv_test4_8", iwkv_test4_8))
+     || (NULL == CU_add_test(pSuite, "iwkv_test4_9", iwkv_test4_9))) {
     CU_cleanup_registry();
     return CU_get_error();
   }
@@ -0,0 +1,160 @@
+#include "iwlz.h"
+#include "iwlog.h"
+
+#include <string.h>
+
+#define LZ_HASH_LOG      12
+#define LZ_MIN_MATCH     4
+#define LZ_MAX_OFFSET    65535
+#define LZ_LAST_LITERALS 5  // Last bytes of input always stored as literals
+#define LZ_MFLIMIT       12 // Min distance between match start and end of input
+
+IW_INLINE uint32_t _lz_read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+IW_INLINE uint32_t _lz_hash(uint32_t v) {
+  return (v * 2654435761U) >> (32 - LZ_HASH_LOG);
+}
+
+IW_INLINE uint8_t* _lz_put_len(uint8_t *op, size_t len) {
+  for ( ; len >= 255; len -= 255) {
+    *op++ = 255;
+  }
+  *op++ = (uint8_t) len;
+  return op;
+}
+
+static uint8_t* _lz_put_seq(
+  uint8_t *op, uint8_t *oend, const uint8_t *lit, size_t llen,
+  size_t off, size_t mlen) {
+  // token + literals length + literals + offset + match length
+  if (oend - op < (ptrdiff_t) (1 + llen / 255 + 1 + llen + 2 + mlen / 255 + 1)) {
+    return 0;
+  }
+  uint8_t *token = op++;
+  *token = (uint8_t) ((llen < 15 ? llen : 15) << 4);
+  if (llen >= 15) {
+    op = _lz_put_len(op, llen - 15);
+  }
+  memcpy(op, lit, llen);
+  op += llen;
+  if (off) {
+    *op++ = (uint8_t) off;
+    *op++ = (uint8_t) (off >> 8);
+    *token |= (uint8_t) (mlen < 15 ? mlen : 15);
+    if (mlen >= 15) {
+      op = _lz_put_len(op, mlen - 15);
+    }
+  }
+  return op;
+}
+
+size_t iwlz_compress(const void *src, size_t srcsz, void *dst, size_t dstsz) {
+  const uint8_t *base = src, *ip = base, *anchor = base, *iend = base + srcsz;
+  uint8_t *op = dst, *oend = op + dstsz;
+
+  if (srcsz > LZ_MFLIMIT) {
+    uint32_t htab[1U << LZ_HASH_LOG] = { 0 };
+    const uint8_t *mflimit = iend - LZ_MFLIMIT;
+    const uint8_t *mlimit = iend - LZ_LAST_LITERALS;
+    while (ip < mflimit) {
+      uint32_t h = _lz_hash(_lz_read32(ip));
+      const uint8_t *ref = base + htab[h];
+      htab[h] = (uint32_t) (ip - base);
+      if ((ref >= ip) || (ip - ref > LZ_MAX_OFFSET) || (_lz_read32(ref) != _lz_read32(ip))) {
+        ++ip;
+        continue;
+      }
+      const uint8_t *mp = ip + LZ_MIN_MATCH, *rp = ref + LZ_MIN_MATCH;
+      while (mp < mlimit && *mp == *rp) {
+        ++mp;
+        ++rp;
+      }
+      while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+        --ip;
+        --ref;
+      }
+      op = _lz_put_seq(op, oend, anchor, ip - anchor, ip - ref, mp - ip - LZ_MIN_MATCH);
+      if (!op) {
+        return 0;
+      }
+      ip = mp;
+      anchor = ip;
+      if (ip < mflimit) {
+        htab[_lz_hash(_lz_read32(ip - 2))] = (uint32_t) (ip - 2 - base);
+      }
+    }
+  }
+  op = _lz_put_seq(op, oend, anchor, iend - anchor, 0, 0);
+  return op ? op - (uint8_t*) dst : 0;
+}
+
+IW_INLINE bool _lz_get_len(const uint8_t **ipp, const uint8_t *iend, size_t *lenp) {
+  const uint8_t *ip = *ipp;
+  uint8_t b;
+  do {
+    if (ip >= iend) {
+      return false;
+    }
+    b = *ip++;
+    *lenp += b;
+  } while (b == 255);
+  *ipp = ip;
+  return true;
+}
+
+iwrc iwlz_decompress(const void *src, size_t srcsz, void *dst, size_t dstsz, size_t *osz) {
+  const uint8_t *ip = src, *iend = ip + srcsz;
+  uint8_t *ostart = dst, *op = ostart, *oend = op + dstsz;
+
+  *osz = 0;
+  while (ip < iend && op < oend) {
+    uint8_t token = *ip++;
+    size_t len = token >> 4;
+    if ((len == 15) && !_lz_get_len(&ip, iend, &len)) {
+      return IW_ERROR_UNEXPECTED_INPUT;
+    }
+    if (len > (size_t) (iend - ip)) {
+      return IW_ERROR_UNEXPECTED_INPUT;
+    }
+    if (len > (size_t) (oend - op)) {
+      len = oend - op;
+    }
+    memcpy(op, ip, len);
+    ip += len;
+    op += len;
+    if ((ip >= iend) || (op >= oend)) {
+      break;
+    }
+    if (iend - ip < 2) {
+      return IW_ERROR_UNEXPECTED_INPUT;
+    }
+    size_t off = ip[0] | ((size_t) ip[1] << 8);
+    ip += 2;
+    len = token & 15;
+    if ((len == 15) && !_lz_get_len(&ip, iend, &len)) {
+      return IW_ERROR_UNEXPECTED_INPUT;
+    }
+    len += LZ_MIN_MATCH;
+    if (!off || (off > (size_t) (op - ostart))) {
+      return IW_ERROR_UNEXPECTED_INPUT;
+    }
+    if (len > (size_t) (oend - op)) {
+      len = oend - op;
+    }
+    const uint8_t *mp = op - off;
+    if (off >= len) {
+      memcpy(op, mp, len);
+      op += len;
+    } else {
+      while (len--) {
+        *op++ = *mp++;
+      }
+    }
+  }
+  *osz = op - ostart;
+  return 0;
+}
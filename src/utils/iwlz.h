@@ -0,0 +1,40 @@
+#pragma once
+#ifndef IWLZ_H
+#define IWLZ_H
+
+#include "basedefs.h"
+
+IW_EXTERN_C_START;
+
+/**
+ * Fast LZ77 block codec using LZ4 block layout:
+ * sequences of `[token:u1,literals length:vn255,literals,offset:u2,match length:vn255]`
+ * with the last sequence containing literals only.
+ */
+
+/** Max size of compressed data for `sz_` bytes of input */
+#define IWLZ_BOUND(sz_) ((sz_) + (sz_) / 255 + 16)
+
+/**
+ * Compresses `src` into `dst`.
+ *
+ * @return Size of compressed data or zero if `dst` buffer is too small.
+ *         `dst` of `IWLZ_BOUND(srcsz)` bytes is always enough.
+ */
+IW_EXPORT size_t iwlz_compress(const void *src, size_t srcsz, void *dst, size_t dstsz);
+
+/**
+ * Decompresses `src` into `dst`.
+ *
+ * Decompression stops once `dst` is filled so prefix of original data
+ * can be decompressed into a smaller buffer.
+ *
+ * Returns `IW_ERROR_UNEXPECTED_INPUT` if `src` is malformed.
+ *
+ * @param [out] osz Number of bytes written into `dst`
+ */
+IW_EXPORT iwrc iwlz_decompress(const void *src, size_t srcsz, void *dst, size_t dstsz, size_t *osz);
+
+IW_EXTERN_C_END;
+
+#endif
@@ -0,0 +1,126 @@
+#include "iowow.h"
+#include "iwlz.h"
+#include "iwutils.h"
+#include "iwlog.h"
+#include <CUnit/Basic.h>
+#include <string.h>
+#include <stdlib.h>
+
+int init_suite(void) {
+  return iw_init();
+}
+
+int clean_suite(void) {
+  return 0;
+}
+
+static void _roundtrip(const uint8_t *data, size_t sz, size_t *csz) {
+  size_t osz = 0;
+  uint8_t *cbuf = malloc(IWLZ_BOUND(sz));
+  uint8_t *dbuf = malloc(sz + 1);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(cbuf);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(dbuf);
+
+  *csz = iwlz_compress(data, sz, cbuf, IWLZ_BOUND(sz));
+  CU_ASSERT_TRUE_FATAL(*csz > 0);
+  CU_ASSERT_TRUE(*csz <= IWLZ_BOUND(sz));
+
+  iwrc rc = iwlz_decompress(cbuf, *csz, dbuf, sz + 1, &osz);
+  CU_ASSERT_EQUAL_FATAL(rc, 0);
+  CU_ASSERT_EQUAL_FATAL(osz, sz);
+  CU_ASSERT_FALSE(memcmp(data, dbuf, sz));
+
+  // Prefix decompression into a smaller buffer
+  if (sz > 1) {
+    rc = iwlz_decompress(cbuf, *csz, dbuf, sz / 2, &osz);
+    CU_ASSERT_EQUAL_FATAL(rc, 0);
+    CU_ASSERT_EQUAL_FATAL(osz, sz / 2);
+    CU_ASSERT_FALSE(memcmp(data, dbuf, sz / 2));
+  }
+  // Compressed data doesn't fit
+  if (*csz > 1) {
+    CU_ASSERT_EQUAL(iwlz_compress(data, sz, cbuf, *csz - 1), 0);
+  }
+  free(cbuf);
+  free(dbuf);
+}
+
+static void test_iwlz1(void) {
+  size_t csz;
+  size_t sz = 256 * 1024;
+  uint8_t *data = malloc(sz);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(data);
+
+  _roundtrip((const uint8_t*) "", 0, &csz);
+  _roundtrip((const uint8_t*) "a", 1, &csz);
+  _roundtrip((const uint8_t*) "abcdabcdabcdabcd", 16, &csz);
+
+  // Repetitive JSON like text
+  size_t pos = 0;
+  for (int i = 0; pos < sz; ++i) {
+    char buf[128];
+    int len = snprintf(buf, sizeof(buf), "{\"id\":%d,\"name\":\"item%d\",\"tags\":[\"a\",\"b\"]},", i, i % 100);
+    len = MIN(len, (int) (sz - pos));
+    memcpy(data + pos, buf, len);
+    pos += len;
+  }
+  _roundtrip(data, sz, &csz);
+  CU_ASSERT_TRUE(csz < sz / 4);
+
+  // Long runs of a single byte
+  memset(data, 'x', sz);
+  _roundtrip(data, sz, &csz);
+  CU_ASSERT_TRUE(csz < sz / 100);
+
+  // Random data
+  for (size_t i = 0; i < sz; ++i) {
+    data[i] = (uint8_t) iwu_rand_u32();
+  }
+  _roundtrip(data, sz, &csz);
+  free(data);
+}
+
+static void test_iwlz2(void) {
+  size_t osz;
+  uint8_t buf[64];
+  // Match offset points before start of output
+  const uint8_t bad1[] = { 0x10, 'a', 0x05, 0x00 };
+  CU_ASSERT_EQUAL(iwlz_decompress(bad1, sizeof(bad1), buf, sizeof(buf), &osz), IW_ERROR_UNEXPECTED_INPUT);
+  // Literals length exceeds input
+  const uint8_t bad2[] = { 0x50, 'a', 'b' };
+  CU_ASSERT_EQUAL(iwlz_decompress(bad2, sizeof(bad2), buf, sizeof(buf), &osz), IW_ERROR_UNEXPECTED_INPUT);
+  // Truncated offset
+  const uint8_t bad3[] = { 0x10, 'a', 0x01 };
+  CU_ASSERT_EQUAL(iwlz_decompress(bad3, sizeof(bad3), buf, sizeof(buf), &osz), IW_ERROR_UNEXPECTED_INPUT);
+}
+
+int main(void) {
+  CU_pSuite pSuite = NULL;
+
+  /* Initialize the CUnit test registry */
+  if (CUE_SUCCESS != CU_initialize_registry()) {
+    return CU_get_error();
+  }
+
+  /* Add a suite to the registry */
+  pSuite = CU_add_suite("iwlz_test1", init_suite, clean_suite);
+
+  if (NULL == pSuite) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  /* Add the tests to the suite */
+  if (  (NULL == CU_add_test(pSuite, "test_iwlz1", test_iwlz1))
+     || (NULL == CU_add_test(pSuite, "test_iwlz2", test_iwlz2))) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  /* Run all tests using the CUnit Basic interface */
+  CU_basic_set_mode(CU_BRM_VERBOSE);
+  CU_basic_run_tests();
+  int ret = CU_get_error() || CU_get_number_of_failures();
+  CU_cleanup_registry();
+  return ret;
+}